@@ -7,6 +7,7 @@ Usage:
     ./pandemonium.py bench-pcpu        Per-CPU DSQ visibility stress test (v5.4.8)
     ./pandemonium.py bench-trace       Crash-detection stress test with trace capture
     ./pandemonium.py bench-contention  Contention stress test for v5.4.x features
+    ./pandemonium.py bench-overhead    Per-callback BPF run time (ns/call, calls/s)
     ./pandemonium.py bench-scx         scx CI compatibility test
     ./pandemonium.py bench-sys         Live system telemetry capture (Ctrl+C to stop)
     ./pandemonium.py install      Build + install + activate systemd service
@@ -215,6 +216,12 @@ def main() -> int:
              "bench-contention"] + sys.argv[2:],
             cwd=SCRIPT_DIR,
         ).returncode
+    elif cmd == "bench-overhead":
+        return subprocess.run(
+            [sys.executable, str(SCRIPT_DIR / "tests" / "pandemonium-tests.py"),
+             "bench-overhead"] + sys.argv[2:],
+            cwd=SCRIPT_DIR,
+        ).returncode
     elif cmd == "bench-sys":
         return subprocess.run(
             [sys.executable, str(SCRIPT_DIR / "tests" / "pandemonium-tests.py"),
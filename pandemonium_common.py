@@ -383,16 +383,3 @@ def wait_for_no_scheduler(timeout: float = 10.0) -> bool:
     log_warn("scheduler still registered after timeout")
     return False
 
-
-# TRACEFS
-
-def find_trace_pipe() -> Path:
-    """Find trace_pipe in tracefs (location varies by kernel)."""
-    candidates = [
-        Path("/sys/kernel/tracing/trace_pipe"),
-        Path("/sys/kernel/debug/tracing/trace_pipe"),
-    ]
-    for p in candidates:
-        if p.exists():
-            return p
-    return candidates[0]
@@ -1,10 +1,12 @@
 // PANDEMONIUM ADAPTIVE CONTROL LOOP
 // SINGLE-THREAD CLOSED-LOOP TUNING SYSTEM
 //
-// ONE THREAD: MONITOR LOOP (1-SECOND CONTROL LOOP)
+// ONE THREAD: MONITOR LOOP (50MS-1S CONTROL LOOP, 1S REPORTING)
 //   READS BPF PER-CPU HISTOGRAMS FOR P99 COMPUTATION.
 //   DETECTS WORKLOAD REGIME. SETS BASELINE KNOBS.
 //   TIGHTENS ON P99 SPIKES. RELAXES GRADUALLY AFTER P99 NORMALIZES.
+//   BETWEEN TICKS, BLOCKS ON THE BPF EVENT RINGBUF AND REACTS TO BURST,
+//   STARVATION AND LONGRUN EDGES WITHIN MILLISECONDS.
 //
 // BPF PRODUCES HISTOGRAMS, RUST READS AND REACTS. RUST WRITES KNOBS,
 // BPF READS THEM ON THE VERY NEXT SCHEDULING DECISION.
@@ -14,54 +16,110 @@ use std::time::Duration;
 
 use anyhow::Result;
 
-use crate::procdb::ProcessDb;
-use crate::scheduler::{PandemoniumStats, Scheduler};
-use crate::tuning::{self, detect_regime, scaled_regime_knobs, Regime, TuningKnobs, HIST_BUCKETS};
-
-// REGIME THRESHOLDS, PROFILES, AND KNOB COMPUTATION LIVE IN tuning.rs
-// (ZERO BPF DEPENDENCIES, TESTABLE OFFLINE)
+use pandemonium::cgroup::{self, CgroupTracker};
+use pandemonium::event::{BpfEvent, EventKind, EventTally, Snapshot};
+use pandemonium::metrics::{self, MetricsHandle, MetricsSnapshot};
 
-// TIGHTEN PARAMETERS
+use crate::controller::{self, ControlParams, Controller, TickInput};
+use crate::procdb::ProcessDb;
+use crate::scheduler::{knob_values, PandemoniumStats, Scheduler};
+use crate::topology::{self, CpuTopology};
+use crate::tuning::{self, TuningKnobs, HIST_BUCKETS, HIST_TIERS};
 
-const MIN_SLICE_NS: u64 = 500_000; // 500US FLOOR
+// REGIME THRESHOLDS, PROFILES, AND KNOB COMPUTATION LIVE IN tuning.rs;
+// THE TICK-TO-TICK POLICY IN controller.rs (ZERO BPF DEPENDENCIES,
+// TESTABLE OFFLINE, REPLAYABLE FROM A FLIGHT TRACE)
 
-// GRADUATED RELAX: STEP TOWARD BASELINE AFTER P99 NORMALIZES
-const RELAX_STEP_NS: u64 = 500_000; // RELAX BY 500US PER TICK
-const RELAX_HOLD_TICKS: u32 = 2; // WAIT 2S OF GOOD P99 BEFORE STEPPING
+// TELEMETRY, EVENT LOG AND PROCDB CADENCE, INDEPENDENT OF THE CONTROL PERIOD.
+// PROCDB AGES PROFILES IN THESE UNITS (STALE AFTER 60).
+const REPORT_PERIOD_NS: u64 = 1_000_000_000;
 
 // SLEEP PATTERN BUCKETS: CLASSIFY IO-WAIT VS IDLE WORKLOADS
 const SLEEP_BUCKETS: usize = 4;
 
+// RE-DETECT AND REPUBLISH TOPOLOGY AFTER CPU HOTPLUG. OFFLINE CPUs DROP OUT
+// OF THE SYSFS CACHE LISTS, SO THE L2/L3 STEAL GROUPS SHRINK TO THE ONLINE
+// SET. RETURNS THE EFFECTIVE CPU COUNT. ALSO USED BY THE BPF-ONLY LOOP.
+pub fn republish_topology(sched: &Scheduler, nr_cpus: u64) -> Option<u64> {
+    match CpuTopology::detect(nr_cpus as usize) {
+        Ok(topo) => topo.publish(sched),
+        Err(e) => log_warn!("HOTPLUG: TOPOLOGY DETECT FAILED: {}", e),
+    }
+    topology::effective_cpus()
+}
+
+fn format_scale(k: &tuning::ScaleKnobs, level: u32) -> String {
+    format!(
+        "SCALE: {} CPUS, PRESSURE {}: BUDGET {}, STARVATION {}MS, OVERFLOW {}MS, DEPTH {}",
+        k.nr_cpus,
+        level,
+        k.interactive_budget,
+        k.starvation_rescue_ns / 1_000_000,
+        k.overflow_sojourn_rescue_ns / 1_000_000,
+        k.pcpu_depth_base
+    )
+}
+
+// PUBLISH THE CONTROLLER'S KNOBS WHEN THEY MOVED SINCE THE LAST WRITE
+fn sync_knobs(sched: &mut Scheduler, ctl: &Controller, written: &mut TuningKnobs) -> Result<()> {
+    if ctl.knobs() != written {
+        sched.write_tuning_knobs(ctl.knobs())?;
+        *written = *ctl.knobs();
+    }
+    Ok(())
+}
+
+fn avg_us(sum: u64, count: u64) -> u64 {
+    if count > 0 {
+        sum / count / 1000
+    } else {
+        0
+    }
+}
+
 // MONITOR LOOP
 
-// 1-SECOND CONTROL LOOP. READS BPF HISTOGRAMS, COMPUTES P99,
-// DETECTS WORKLOAD REGIME, TIGHTENS/RELAXES KNOBS.
-// RUNS ON THE MAIN THREAD.
+// CONTROL LOOP (50MS-1S PERIOD). READS BPF HISTOGRAMS, COMPUTES P99,
+// DETECTS WORKLOAD REGIME, TIGHTENS/RELAXES KNOBS. EVENTS ARE HANDLED AS
+// THEY ARRIVE WITHIN A PERIOD. RUNS ON THE MAIN THREAD.
 pub fn monitor_loop(
     sched: &mut Scheduler,
     shutdown: &'static AtomicBool,
     verbose: bool,
     nr_cpus: u64,
+    track_online: bool,
+    period: Duration,
+    cgroup_top: usize,
+    metrics: Option<&MetricsHandle>,
 ) -> Result<bool> {
     let mut prev = PandemoniumStats::default();
-    let mut prev_hist = [[0u64; HIST_BUCKETS]; 3];
+    let mut prev_hist = [[0u64; HIST_BUCKETS]; HIST_TIERS];
     let mut prev_sleep = [0u64; SLEEP_BUCKETS];
-    let mut regime = Regime::Mixed;
-    let mut relax_counter: u32 = 0;
-    let mut tightened = false;
-    let mut pending_regime = regime;
-    let mut regime_hold: u32 = 0;
-    let mut light_ticks: u64 = 0;
-    let mut mixed_ticks: u64 = 0;
-    let mut heavy_ticks: u64 = 0;
-    let mut stability_score: u32 = 0;
-    let mut spike_count: u32 = 0;
-    let mut tick_counter: u64 = 0;
-    let mut tighten_events: u64 = 0;
-    let mut prev_tighten_events: u64 = 0;
-    let sojourn_floor_ns: u64 = (nr_cpus * 1_000_000).clamp(2_000_000, 6_000_000);
-    let sojourn_ceil_ns: u64 = sojourn_floor_ns * 2;
-    let mut sojourn_thresh_ns: u64 = sojourn_floor_ns;
+    let mut events: Vec<BpfEvent> = Vec::with_capacity(256);
+    let mut hotplug_pending = false;
+    let mut window_starvations: u64 = 0;
+    let mut pcpu_prev = sched.read_pcpu_depth(nr_cpus as usize);
+    let mut pcpu_depths: Vec<u32> = vec![0; pcpu_prev.len()]; // 0 = SCALED BASE
+
+    // CPU-SCALED KNOBS FOLLOW THE EFFECTIVE (ONLINE, cpuset-LIMITED) COUNT
+    // UNLESS --nr-cpus PINNED IT
+    let scale_cpus = if track_online {
+        topology::effective_cpus().unwrap_or(nr_cpus).min(nr_cpus)
+    } else {
+        nr_cpus
+    };
+    // THE POLICY STATE MACHINE; ITS WALL-CLOCK HOLDS BECOME WINDOWS OF
+    // THIS CONTROL PERIOD
+    let mut ctl = Controller::new(ControlParams::new(period.as_nanos() as u64), scale_cpus);
+
+    // REPORT WINDOW: TELEMETRY AND EVENT LOG STAY PER-SECOND AT ANY PERIOD
+    let mut prev_report = PandemoniumStats::default();
+    let mut report_hist = [[0u64; HIST_BUCKETS]; HIST_TIERS];
+    let mut report_sleep = [0u64; SLEEP_BUCKETS];
+    let mut report_ns: u64 = 0;
+    let mut report_counter: u64 = 0;
+    let mut tally = EventTally::default();
+    let mut cgroups = CgroupTracker::new();
 
     let mut procdb = match ProcessDb::new() {
         Ok(db) => Some(db),
@@ -71,40 +129,294 @@ pub fn monitor_loop(
         }
     };
 
-    // APPLY INITIAL REGIME
-    sched.write_tuning_knobs(&scaled_regime_knobs(regime, nr_cpus))?;
+    // APPLY INITIAL REGIME, CLAIM THE CORE-COUNT SCALING FROM BPF
+    let mut written = *ctl.knobs();
+    sched.write_tuning_knobs(&written)?;
+    let bpf_scale = sched.read_scale_knobs();
+    if bpf_scale.owner == tuning::SCALE_OWNER_BPF && bpf_scale.nr_cpus != scale_cpus {
+        log_info!(
+            "SCALE: BPF DERIVED {} ONLINE CPUS, RE-DERIVING FOR {}",
+            bpf_scale.nr_cpus,
+            scale_cpus
+        );
+    }
+    sched.write_scale_knobs(&ctl.scale_base());
+    log_info!("{}", format_scale(&ctl.scale_base(), 0));
 
+    let mut tick: u64 = 0;
     while !shutdown.load(Ordering::Relaxed) && !sched.exited() {
         let tick_start = std::time::Instant::now();
-        std::thread::sleep(Duration::from_secs(1));
+
+        // EVENT-DRIVEN WAIT: BLOCK ON THE RINGBUF UNTIL THE TICK DEADLINE.
+        // BURST / STARVATION RESCUE IN LIGHT PROMOTES TO MIXED AT ONCE;
+        // LONGRUN EDGES APPLY THE AFFINITY/BATCH OVERRIDE AT ONCE. THE TICK
+        // BELOW STILL RECONCILES AGAINST THE PERIODIC COUNTERS.
+        loop {
+            let waited = tick_start.elapsed();
+            if waited >= period || shutdown.load(Ordering::Relaxed) || sched.exited() {
+                break;
+            }
+            if sched.poll_events(period - waited, &mut events) == 0 {
+                continue;
+            }
+
+            let mut contention = false;
+            let mut longrun_edge = false;
+            for ev in events.drain(..) {
+                tally.record(&ev);
+                match ev.kind() {
+                    Some(EventKind::Burst) if ev.state != 0 => contention = true,
+                    Some(EventKind::StarvationRescue) => {
+                        contention = true;
+                        window_starvations += 1;
+                    }
+                    Some(EventKind::Hotplug) => hotplug_pending = true,
+                    Some(EventKind::Longrun) if (ev.node as usize) < topology::MAX_NODES => {
+                        ctl.longrun(ev.node as u32, ev.state != 0);
+                        longrun_edge = true;
+                    }
+                    _ => {}
+                }
+            }
+
+            if contention {
+                ctl.contention();
+            }
+            if longrun_edge {
+                ctl.longrun_override();
+            }
+            sync_knobs(sched, &ctl, &mut written)?;
+        }
         let elapsed_ns = tick_start.elapsed().as_nanos() as u64;
 
+        // CPU HOTPLUG: BPF ALREADY DRAINED THE DEAD CPU'S DSQ AND RE-SCALED
+        // ITS OWN THRESHOLDS. REPUBLISH TOPOLOGY AND RE-DERIVE THE
+        // CPU-SCALED KNOBS FROM THE NEW ONLINE COUNT, THEN RESTART FROM THE
+        // REGIME BASELINE LIKE A REGIME SWITCH.
+        if hotplug_pending {
+            hotplug_pending = false;
+            let online = republish_topology(sched, nr_cpus);
+            let next = match online {
+                Some(n) if track_online => n.min(nr_cpus),
+                _ => ctl.scale_cpus(),
+            };
+            log_info!(
+                "HOTPLUG: {} CPUS EFFECTIVE, SCALING FOR {} (WAS {})",
+                online.map_or_else(|| "?".to_string(), |n| n.to_string()),
+                next,
+                ctl.scale_cpus()
+            );
+            if ctl.rescale(next) {
+                sched.write_scale_knobs(&ctl.scale_knobs());
+                sync_knobs(sched, &ctl, &mut written)?;
+            }
+        }
+
         let stats = sched.read_stats();
 
-        // COMPUTE DELTAS
-        let delta_d = stats.nr_dispatches.wrapping_sub(prev.nr_dispatches);
-        let delta_idle = stats.nr_idle_hits.wrapping_sub(prev.nr_idle_hits);
-        let delta_shared = stats.nr_shared.wrapping_sub(prev.nr_shared);
-        let delta_preempt = stats.nr_preempt.wrapping_sub(prev.nr_preempt);
-        let delta_keep = stats.nr_keep_running.wrapping_sub(prev.nr_keep_running);
-        let delta_wake_sum = stats.wake_lat_sum.wrapping_sub(prev.wake_lat_sum);
-        let delta_wake_samples = stats.wake_lat_samples.wrapping_sub(prev.wake_lat_samples);
-        let delta_hard = stats.nr_hard_kicks.wrapping_sub(prev.nr_hard_kicks);
-        let delta_soft = stats.nr_soft_kicks.wrapping_sub(prev.nr_soft_kicks);
-        let delta_enq_wake = stats.nr_enq_wakeup.wrapping_sub(prev.nr_enq_wakeup);
-        let delta_enq_requeue = stats.nr_enq_requeue.wrapping_sub(prev.nr_enq_requeue);
-        let delta_rescue = stats.nr_overflow_rescue.wrapping_sub(prev.nr_overflow_rescue);
+        // RECONCILE: A FULL RINGBUF (OR NO RINGBUF) LEAVES THE EVENT-DERIVED
+        // LONGRUN STATE STALE. FALL BACK TO THE stats_map LEVEL AND RESYNC.
+        let delta_dropped = stats.nr_events_dropped.wrapping_sub(prev.nr_events_dropped);
+        if !sched.has_event_stream() || delta_dropped != 0 {
+            ctl.resync_longrun(stats.longrun_mode_active > 0);
+        }
+
+        // READ HISTOGRAMS (CUMULATIVE, COMPUTE DELTAS)
+        let cur_hist = sched.read_wake_lat_hist();
+        let mut delta_hist = [[0u64; HIST_BUCKETS]; HIST_TIERS];
+        for tier in 0..HIST_TIERS {
+            for b in 0..HIST_BUCKETS {
+                delta_hist[tier][b] = cur_hist[tier][b].wrapping_sub(prev_hist[tier][b]);
+            }
+        }
+
+        // AGGREGATE P99
+        let mut agg = [0u64; HIST_BUCKETS];
+        for t in 0..HIST_TIERS {
+            for b in 0..HIST_BUCKETS {
+                agg[b] += delta_hist[t][b];
+            }
+        }
+        let mut tier_p99_ns = [0u64; HIST_TIERS];
+        let mut tier_samples = [0u64; HIST_TIERS];
+        for t in 0..HIST_TIERS {
+            tier_p99_ns[t] = tuning::compute_p99_from_histogram(&delta_hist[t]);
+            tier_samples[t] = delta_hist[t].iter().sum();
+        }
+        let tick_pct = tuning::compute_percentiles(&agg);
+
+        // SLEEP HISTOGRAM
+        let cur_sleep = sched.read_sleep_hist();
+        let mut delta_sleep = [0u64; SLEEP_BUCKETS];
+        for i in 0..SLEEP_BUCKETS {
+            delta_sleep[i] = cur_sleep[i].wrapping_sub(prev_sleep[i]);
+        }
+        let sleep_total: u64 = delta_sleep.iter().sum();
+        let io_pct = if sleep_total > 0 {
+            (delta_sleep[0] + delta_sleep[1]) * 100 / sleep_total
+        } else {
+            0
+        };
+
+        // CONTROL TICK: REGIME, TIGHTEN/RELAX, SLEEP-INFORMED BATCH,
+        // SOJOURN THRESHOLD, RESCUE PRESSURE
+        let mut decisions = ctl.tick(&TickInput {
+            elapsed_ns,
+            dispatches: stats.nr_dispatches.wrapping_sub(prev.nr_dispatches),
+            idle_hits: stats.nr_idle_hits.wrapping_sub(prev.nr_idle_hits),
+            rescues: stats
+                .nr_overflow_rescue
+                .wrapping_sub(prev.nr_overflow_rescue)
+                + window_starvations,
+            p99_ns: tick_pct.p99_ns,
+            samples: tier_samples.iter().sum(),
+            p99_i_ns: tier_p99_ns[1],
+            samples_i: tier_samples[1],
+            io_pct,
+        });
+        let starvations = window_starvations;
+        window_starvations = 0;
+        sync_knobs(sched, &ctl, &mut written)?;
+        if decisions & controller::DECISION_SCALE_PRESSURE != 0 {
+            let k = ctl.scale_knobs();
+            sched.write_scale_knobs(&k);
+            log_info!("{}", format_scale(&k, ctl.pressure()));
+        }
+
+        // CONTROLLER SNAPSHOT: THIS TICK'S INPUTS, DECISIONS AND LIVE KNOBS,
+        // INTO THE EVENT LOG AND (WITH --flight-recorder) ONTO DISK
+        if stats.burst_mode_active != prev.burst_mode_active {
+            decisions |= controller::STATE_BURST;
+        }
+        tick += 1;
+        let snap = Snapshot {
+            elapsed_ns,
+            tick,
+            stats: metrics::stat_deltas(&stats.counters(), &prev.counters()),
+            knobs: knob_values(&sched.live_knobs()),
+            knob_gen: sched.knob_gen(),
+            wake_avg_us: avg_us(
+                stats.wake_lat_sum.wrapping_sub(prev.wake_lat_sum),
+                stats.wake_lat_samples.wrapping_sub(prev.wake_lat_samples),
+            ),
+            lat_idle_us: avg_us(
+                stats.wake_lat_idle_sum.wrapping_sub(prev.wake_lat_idle_sum),
+                stats.wake_lat_idle_cnt.wrapping_sub(prev.wake_lat_idle_cnt),
+            ),
+            lat_kick_us: avg_us(
+                stats.wake_lat_kick_sum.wrapping_sub(prev.wake_lat_kick_sum),
+                stats.wake_lat_kick_cnt.wrapping_sub(prev.wake_lat_kick_cnt),
+            ),
+            p50_us: tick_pct.p50_ns / 1000,
+            p90_us: tick_pct.p90_ns / 1000,
+            p99_us: tick_pct.p99_ns / 1000,
+            p999_us: tick_pct.p999_ns / 1000,
+            p99_ns: tick_pct.p99_ns,
+            tier_p99_ns,
+            tier_samples,
+            regime_hold: ctl.regime_hold(),
+            spike_count: ctl.spike_count(),
+            relax_counter: ctl.relax_counter(),
+            stability: ctl.stability(),
+            decisions,
+            io_pct: io_pct as u32,
+            regime: ctl.regime() as u8,
+            pending_regime: ctl.pending_regime() as u8,
+            scale_pressure: ctl.pressure().min(u8::MAX as u32) as u8,
+            scale_cpus: ctl.scale_cpus() as u32,
+            starvations: starvations.min(u32::MAX as u64) as u32,
+            ..Default::default()
+        };
+        if let Err(e) = sched.log.snapshot(&snap) {
+            log_warn!("FLIGHT RECORDER DISABLED: {}", e);
+        }
+
+        prev_hist = cur_hist;
+        prev_sleep = cur_sleep;
+        prev = stats;
+
+        // ACCUMULATE THE REPORT WINDOW
+        for tier in 0..HIST_TIERS {
+            for b in 0..HIST_BUCKETS {
+                report_hist[tier][b] += delta_hist[tier][b];
+            }
+        }
+        for i in 0..SLEEP_BUCKETS {
+            report_sleep[i] += delta_sleep[i];
+        }
+        report_ns += elapsed_ns;
+        if report_ns < REPORT_PERIOD_NS {
+            continue;
+        }
+
+        // ONCE PER REPORT PERIOD: STABILITY, PROCDB, TELEMETRY, EVENT LOG.
+        // AT THE DEFAULT 1S CONTROL PERIOD EVERY TICK IS A REPORT.
+        let base = prev_report;
+
+        // STABILITY TRACKING
+        let mut report_agg = [0u64; HIST_BUCKETS];
+        for t in 0..HIST_TIERS {
+            for b in 0..HIST_BUCKETS {
+                report_agg[b] += report_hist[t][b];
+            }
+        }
+        let pct = tuning::compute_percentiles(&report_agg);
+        let report_p99_ns = pct.p99_ns;
+        let stability_score = ctl.report(report_p99_ns);
+
+        // PROCESS CLASSIFICATION DATABASE: INGEST, PREDICT, EVICT
+        let (db_total, db_confident) = if let Some(ref mut db) = procdb {
+            db.ingest();
+            db.flush_predictions();
+            db.tick();
+            db.summary()
+        } else {
+            (0, 0)
+        };
+
+        // REPORT DELTAS
+        let delta_d = stats.nr_dispatches.wrapping_sub(base.nr_dispatches);
+        let delta_idle = stats.nr_idle_hits.wrapping_sub(base.nr_idle_hits);
+        let delta_shared = stats.nr_shared.wrapping_sub(base.nr_shared);
+        let delta_preempt = stats.nr_preempt.wrapping_sub(base.nr_preempt);
+        let delta_keep = stats.nr_keep_running.wrapping_sub(base.nr_keep_running);
+        let delta_wake_sum = stats.wake_lat_sum.wrapping_sub(base.wake_lat_sum);
+        let delta_wake_samples = stats.wake_lat_samples.wrapping_sub(base.wake_lat_samples);
+        let delta_hard = stats.nr_hard_kicks.wrapping_sub(base.nr_hard_kicks);
+        let delta_soft = stats.nr_soft_kicks.wrapping_sub(base.nr_soft_kicks);
+        let delta_enq_wake = stats.nr_enq_wakeup.wrapping_sub(base.nr_enq_wakeup);
+        let delta_enq_requeue = stats.nr_enq_requeue.wrapping_sub(base.nr_enq_requeue);
+        let delta_rescue = stats.nr_overflow_rescue.wrapping_sub(base.nr_overflow_rescue);
+        let delta_dropped = stats.nr_events_dropped.wrapping_sub(base.nr_events_dropped);
+        let delta_fill = stats.nr_dispatch_batched.wrapping_sub(base.nr_dispatch_batched);
+        let reclass_pct = tuning::reclass_pct(
+            stats.nr_reclassify.wrapping_sub(base.nr_reclassify),
+            stats.nr_reclass_skipped.wrapping_sub(base.nr_reclass_skipped),
+        );
+        let delta_pair = stats.nr_pair_affine.wrapping_sub(base.nr_pair_affine);
+        let delta_pair_sync = stats.nr_pair_sync.wrapping_sub(base.nr_pair_sync);
+        let delta_cst_shallow = stats.nr_idle_shallow.wrapping_sub(base.nr_idle_shallow);
+        let delta_cst_warm = stats.nr_idle_warm.wrapping_sub(base.nr_idle_warm);
+        let dx_near = stats.nr_xnode_steal_near.wrapping_sub(base.nr_xnode_steal_near);
+        let dx_mid = stats.nr_xnode_steal_mid.wrapping_sub(base.nr_xnode_steal_mid);
+        let dx_far = stats.nr_xnode_steal_far.wrapping_sub(base.nr_xnode_steal_far);
+        let dx_gated = stats.nr_xnode_steal_gated.wrapping_sub(base.nr_xnode_steal_gated);
         let wake_avg_us = if delta_wake_samples > 0 {
             delta_wake_sum / delta_wake_samples / 1000
         } else {
             0
         };
+        let idle_pct = if delta_d > 0 {
+            delta_idle * 100 / delta_d
+        } else {
+            0
+        };
 
         // PER-PATH LATENCY
-        let d_idle_sum = stats.wake_lat_idle_sum.wrapping_sub(prev.wake_lat_idle_sum);
-        let d_idle_cnt = stats.wake_lat_idle_cnt.wrapping_sub(prev.wake_lat_idle_cnt);
-        let d_kick_sum = stats.wake_lat_kick_sum.wrapping_sub(prev.wake_lat_kick_sum);
-        let d_kick_cnt = stats.wake_lat_kick_cnt.wrapping_sub(prev.wake_lat_kick_cnt);
+        let d_idle_sum = stats.wake_lat_idle_sum.wrapping_sub(base.wake_lat_idle_sum);
+        let d_idle_cnt = stats.wake_lat_idle_cnt.wrapping_sub(base.wake_lat_idle_cnt);
+        let d_kick_sum = stats.wake_lat_kick_sum.wrapping_sub(base.wake_lat_kick_sum);
+        let d_kick_cnt = stats.wake_lat_kick_cnt.wrapping_sub(base.wake_lat_kick_cnt);
         let lat_idle_us = if d_idle_cnt > 0 {
             d_idle_sum / d_idle_cnt / 1000
         } else {
@@ -115,23 +427,23 @@ pub fn monitor_loop(
         } else {
             0
         };
-        let delta_reenq = stats.nr_reenqueue.wrapping_sub(prev.nr_reenqueue);
+        let delta_reenq = stats.nr_reenqueue.wrapping_sub(base.nr_reenqueue);
 
         // L2 CACHE AFFINITY DELTAS
-        let dl2_hb = stats.nr_l2_hit_batch.wrapping_sub(prev.nr_l2_hit_batch);
-        let dl2_mb = stats.nr_l2_miss_batch.wrapping_sub(prev.nr_l2_miss_batch);
+        let dl2_hb = stats.nr_l2_hit_batch.wrapping_sub(base.nr_l2_hit_batch);
+        let dl2_mb = stats.nr_l2_miss_batch.wrapping_sub(base.nr_l2_miss_batch);
         let dl2_hi = stats
             .nr_l2_hit_interactive
-            .wrapping_sub(prev.nr_l2_hit_interactive);
+            .wrapping_sub(base.nr_l2_hit_interactive);
         let dl2_mi = stats
             .nr_l2_miss_interactive
-            .wrapping_sub(prev.nr_l2_miss_interactive);
+            .wrapping_sub(base.nr_l2_miss_interactive);
         let dl2_hl = stats
             .nr_l2_hit_lat_crit
-            .wrapping_sub(prev.nr_l2_hit_lat_crit);
+            .wrapping_sub(base.nr_l2_hit_lat_crit);
         let dl2_ml = stats
             .nr_l2_miss_lat_crit
-            .wrapping_sub(prev.nr_l2_miss_lat_crit);
+            .wrapping_sub(base.nr_l2_miss_lat_crit);
         let l2_pct_b = if dl2_hb + dl2_mb > 0 {
             dl2_hb * 100 / (dl2_hb + dl2_mb)
         } else {
@@ -148,270 +460,165 @@ pub fn monitor_loop(
             0
         };
 
-        let idle_pct = if delta_d > 0 {
-            delta_idle * 100 / delta_d
+        // SMT PLACEMENT DELTAS: % OF ATTEMPTS THAT FOUND AN IDLE CORE / A PACK SLOT
+        let dsmt_ch = stats.nr_smt_core_hit.wrapping_sub(base.nr_smt_core_hit);
+        let dsmt_cm = stats.nr_smt_core_miss.wrapping_sub(base.nr_smt_core_miss);
+        let dsmt_ph = stats.nr_smt_pack_hit.wrapping_sub(base.nr_smt_pack_hit);
+        let dsmt_pm = stats.nr_smt_pack_miss.wrapping_sub(base.nr_smt_pack_miss);
+        let smt_pct_core = if dsmt_ch + dsmt_cm > 0 {
+            dsmt_ch * 100 / (dsmt_ch + dsmt_cm)
         } else {
             0
         };
-
-        // READ HISTOGRAMS (CUMULATIVE, COMPUTE DELTAS)
-        let cur_hist = sched.read_wake_lat_hist();
-        let mut delta_hist = [[0u64; HIST_BUCKETS]; 3];
-        for tier in 0..3 {
-            for b in 0..HIST_BUCKETS {
-                delta_hist[tier][b] = cur_hist[tier][b].wrapping_sub(prev_hist[tier][b]);
-            }
-        }
-
-        // COMPUTE P99 PER TIER
-        let tp99_b_ns = tuning::compute_p99_from_histogram(&delta_hist[0]);
-        let tp99_i_ns = tuning::compute_p99_from_histogram(&delta_hist[1]);
-        let tp99_l_ns = tuning::compute_p99_from_histogram(&delta_hist[2]);
-
-        // AGGREGATE P99
-        let mut agg = [0u64; HIST_BUCKETS];
-        for t in 0..3 {
-            for b in 0..HIST_BUCKETS {
-                agg[b] += delta_hist[t][b];
-            }
-        }
-        let p99_ns = tuning::compute_p99_from_histogram(&agg);
-
-        // SLEEP HISTOGRAM
-        let cur_sleep = sched.read_sleep_hist();
-        let mut delta_sleep = [0u64; SLEEP_BUCKETS];
-        for i in 0..SLEEP_BUCKETS {
-            delta_sleep[i] = cur_sleep[i].wrapping_sub(prev_sleep[i]);
-        }
-        let sleep_total: u64 = delta_sleep.iter().sum();
-        let io_pct = if sleep_total > 0 {
-            (delta_sleep[0] + delta_sleep[1]) * 100 / sleep_total
+        let smt_pct_pack = if dsmt_ph + dsmt_pm > 0 {
+            dsmt_ph * 100 / (dsmt_ph + dsmt_pm)
         } else {
             0
         };
 
-        // DETECT REGIME (SCHMITT TRIGGER + 2-TICK HOLD)
-        let detected = detect_regime(regime, idle_pct);
-
-        let mut regime_changed_this_tick = false;
-        if detected != regime {
-            if detected == pending_regime {
-                regime_hold += 1;
-            } else {
-                pending_regime = detected;
-                regime_hold = 1;
-            }
-            if regime_hold >= 2 {
-                regime = detected;
-                sched.write_tuning_knobs(&scaled_regime_knobs(regime, nr_cpus))?;
-                regime_changed_this_tick = true;
-                tightened = false;
-                relax_counter = 0;
-                spike_count = 0;
-            }
-        } else {
-            pending_regime = regime;
-            regime_hold = 0;
-        }
-
-        // TIGHTEN CHECK: P99 SPIKE DETECTION
-        // REQUIRE 2 CONSECUTIVE ABOVE-CEILING TICKS BEFORE TIGHTENING.
-        // ONLY TIGHTEN IN MIXED: LIGHT HAS NO CONTENTION (POINTLESS),
-        // HEAVY IS FULLY SATURATED (MORE PREEMPTION JUST ADDS OVERHEAD).
-        if !tightened && !regime_changed_this_tick {
-            let ceiling = regime.p99_ceiling();
-            if tuning::should_reflex_tighten(p99_ns, tp99_i_ns, ceiling) {
-                spike_count += 1;
-                if spike_count >= 2 && regime == Regime::Mixed {
-                    let current = sched.read_tuning_knobs();
-                    let new_slice = (current.slice_ns * 3 / 4).max(MIN_SLICE_NS);
-                    let knobs = TuningKnobs {
-                        slice_ns: new_slice,
-                        preempt_thresh_ns: new_slice,
-                        ..current
-                    };
-                    sched.write_tuning_knobs(&knobs)?;
-                    tightened = true;
-                    tighten_events += 1;
-                    spike_count = 0;
-                }
-            } else {
-                spike_count = 0;
-            }
-        }
-
-        // GRADUATED RELAX: STEP SLICE TOWARD BASELINE (BATCH UNTOUCHED)
-        if tightened && !regime_changed_this_tick {
-            let ceiling = regime.p99_ceiling();
-            let baseline = scaled_regime_knobs(regime, nr_cpus);
-            if p99_ns <= ceiling {
-                relax_counter += 1;
-                if relax_counter >= RELAX_HOLD_TICKS {
-                    let current = sched.read_tuning_knobs();
-                    if current.slice_ns < baseline.slice_ns {
-                        let new_slice = (current.slice_ns + RELAX_STEP_NS).min(baseline.slice_ns);
-                        let knobs = TuningKnobs {
-                            slice_ns: new_slice,
-                            preempt_thresh_ns: baseline.preempt_thresh_ns.min(new_slice),
-                            batch_slice_ns: current.batch_slice_ns,
-                            ..baseline
-                        };
-                        sched.write_tuning_knobs(&knobs)?;
-                        if new_slice >= baseline.slice_ns {
-                            tightened = false;
-                        }
-                    } else {
-                        tightened = false;
-                    }
-                    relax_counter = 0;
-                }
-            } else {
-                relax_counter = 0;
-            }
-        }
-
-        // SLEEP-INFORMED BATCH TUNING (EVERY TICK)
-        let baseline = scaled_regime_knobs(regime, nr_cpus);
-        let longrun_active = stats.longrun_mode_active > 0;
-
-        // LONGRUN OVERRIDE: DURING SUSTAINED BATCH PRESSURE (>2S),
-        // USE BASE BATCH SLICE (SKIP SLEEP ADJUSTMENT -- LONG-RUNNERS ARE
-        // CPU-BOUND, NOT IO-BOUND) AND WEAKEN AFFINITY TO SPREAD BATCH
-        // TASKS ACROSS MORE CPUS INSTEAD OF CONCENTRATING ON HOTSPOTS.
-        // BURST IS OWNED ENTIRELY BY BPF (CUSUM + WAKEUP RATE IN TICK).
-        let final_batch = if longrun_active {
-            baseline.batch_slice_ns
-        } else {
-            tuning::sleep_adjust_batch_ns(baseline.batch_slice_ns, io_pct)
-        };
-        let final_affinity = if longrun_active {
-            tuning::AFFINITY_WEAK
-        } else {
-            baseline.affinity_mode
-        };
-
-        // DISPATCH-RATE ADAPTIVE SOJOURN THRESHOLD
-        // MEASURE, DON'T ASSUME. DISPATCH RATE REFLECTS ACTUAL SYSTEM
-        // CAPACITY (PHYSICAL CORES, SMT, FREQUENCY, WORKLOAD INTENSITY).
-        // NORMALIZED TO ACTUAL ELAPSED TIME (SLEEP OVERSHOOTS UNDER LOAD).
-        const SOJOURN_MULTIPLIER: u64 = 4;         // 4X DISPATCH INTERVAL
-
-        if delta_d > 0 && elapsed_ns > 0 {
-            let dispatch_rate = delta_d * 1_000_000_000 / elapsed_ns;
-            let interval_ns = if dispatch_rate > 0 { 1_000_000_000 / dispatch_rate } else { 0 };
-            let target = (interval_ns * SOJOURN_MULTIPLIER).clamp(sojourn_floor_ns, sojourn_ceil_ns);
-            // EWMA: 7/8 OLD + 1/8 NEW (SMOOTH, NO JITTER)
-            sojourn_thresh_ns = sojourn_thresh_ns - (sojourn_thresh_ns >> 3) + (target >> 3);
-        }
-
-        {
-            let current = sched.read_tuning_knobs();
-            if current.batch_slice_ns != final_batch
-                || current.sojourn_thresh_ns != sojourn_thresh_ns
-                || current.affinity_mode != final_affinity
-            {
-                sched.write_tuning_knobs(&TuningKnobs {
-                    batch_slice_ns: final_batch,
-                    sojourn_thresh_ns,
-                    affinity_mode: final_affinity,
-                    ..current
-                })?;
-            }
-        }
-
-        // STABILITY TRACKING
-        let tighten_delta = tighten_events.wrapping_sub(prev_tighten_events);
-        prev_tighten_events = tighten_events;
-        stability_score = tuning::compute_stability_score(
-            stability_score,
-            regime_changed_this_tick,
-            tighten_delta,
-            p99_ns,
-            regime.p99_ceiling(),
-        );
-
-        // PROCESS CLASSIFICATION DATABASE: INGEST, PREDICT, EVICT
-        let (db_total, db_confident) = if let Some(ref mut db) = procdb {
-            db.ingest();
-            db.flush_predictions();
-            db.tick();
-            db.summary()
+        // REPORT-WINDOW P99 PER TIER AND SLEEP MIX
+        let pct_us = [
+            pct.p50_ns / 1000,
+            pct.p90_ns / 1000,
+            pct.p99_ns / 1000,
+            pct.p999_ns / 1000,
+        ];
+        let tp99_b = tuning::compute_p99_from_histogram(&report_hist[0]) / 1000;
+        let tp99_i = tuning::compute_p99_from_histogram(&report_hist[1]) / 1000;
+        let tp99_l = tuning::compute_p99_from_histogram(&report_hist[2]) / 1000;
+        let sleep_total: u64 = report_sleep.iter().sum();
+        let io_pct = if sleep_total > 0 {
+            (report_sleep[0] + report_sleep[1]) * 100 / sleep_total
         } else {
-            (0, 0)
+            0
         };
-
-        let p99_us = p99_ns / 1000;
-        let tp99_b = tp99_b_ns / 1000;
-        let tp99_i = tp99_i_ns / 1000;
-        let tp99_l = tp99_l_ns / 1000;
         let knobs = sched.read_tuning_knobs();
 
         let sojourn_ms = stats.batch_sojourn_ns / 1_000_000;
-        let sojourn_thresh_ms = sojourn_thresh_ns / 1_000_000;
-        let delta_burst = stats.burst_mode_active.wrapping_sub(prev.burst_mode_active);
+        let sojourn_thresh_ms = ctl.sojourn_thresh_ns() / 1_000_000;
+        let delta_burst = stats.burst_mode_active.wrapping_sub(base.burst_mode_active);
         let burst_label = if delta_burst > 0 { " BURST" } else { "" };
-        let longrun_label = if stats.longrun_mode_active > 0 { " LONGRUN" } else { "" };
+        let longrun_active = ctl.longrun_active();
+        let longrun_label = if longrun_active { " LONGRUN" } else { "" };
 
-        if verbose && tuning::should_print_telemetry(tick_counter, stability_score) {
+        let print_now = verbose && tuning::should_print_telemetry(report_counter, stability_score);
+        if print_now {
             println!(
-                "d/s: {:<8} idle: {}% shared: {:<6} preempt: {:<4} keep: {:<4} kick: H={:<4} S={:<4} enq: W={:<4} R={:<4} wake: {}us p99: {}us [B:{} I:{} L:{}] lat_idle: {}us lat_kick: {}us procdb: {}/{} sleep: io={}% slice: {}us batch: {}us reenq: {} sjrn: {}ms/{}ms rescue: {} l2: B={}% I={}% L={}% [{}{}{}]",
+                "d/s: {:<8} idle: {}% shared: {:<6} preempt: {:<4} keep: {:<4} kick: H={:<4} S={:<4} enq: W={:<4} R={:<4} wake: {}us p50: {}us p90: {}us p99: {}us p999: {}us [B:{} I:{} L:{}] lat_idle: {}us lat_kick: {}us procdb: {}/{} sleep: io={}% slice: {}us batch: {}us reenq: {} sjrn: {}ms/{}ms rescue: {} fill: {} reclass: {}% pair: A={} S={} cst: S={} W={} xnode: N={} M={} F={} G={} evt: {} D={} l2: B={}% I={}% L={}% smt: C={}% P={}% [{}{}{}]",
                 delta_d, idle_pct, delta_shared, delta_preempt, delta_keep,
                 delta_hard, delta_soft, delta_enq_wake, delta_enq_requeue,
-                wake_avg_us, p99_us, tp99_b, tp99_i, tp99_l,
+                wake_avg_us, pct_us[0], pct_us[1], pct_us[2], pct_us[3], tp99_b, tp99_i, tp99_l,
                 lat_idle_us, lat_kick_us,
                 db_total, db_confident,
                 io_pct, knobs.slice_ns / 1000, knobs.batch_slice_ns / 1000,
                 delta_reenq, sojourn_ms, sojourn_thresh_ms,
-                delta_rescue,
-                l2_pct_b, l2_pct_i, l2_pct_l, regime.label(), burst_label, longrun_label,
+                delta_rescue, delta_fill, reclass_pct, delta_pair, delta_pair_sync,
+                delta_cst_shallow, delta_cst_warm,
+                dx_near, dx_mid, dx_far, dx_gated,
+                tally.total(), delta_dropped,
+                l2_pct_b, l2_pct_i, l2_pct_l, smt_pct_core, smt_pct_pack, ctl.regime().label(), burst_label, longrun_label,
             );
         }
 
-        sched.log.snapshot(
-            delta_d,
-            delta_idle,
-            delta_shared,
-            delta_preempt,
-            delta_keep,
-            wake_avg_us,
-            delta_hard,
-            delta_soft,
-            lat_idle_us,
-            lat_kick_us,
-        );
+        // ADAPTIVE PER-CPU DSQ DEPTH: AT MOST ONE STEP PER CPU PER REPORT.
+        // UNDER RESCUE PRESSURE EVERY CPU FOLLOWS THE CONTENDED BASE (1).
+        let pcpu_now = sched.read_pcpu_depth(nr_cpus as usize);
+        let base_depth = ctl.scale_base().pcpu_depth_base as u32;
+        for (cpu, (now_pd, prev_pd)) in pcpu_now.iter().zip(pcpu_prev.iter()).enumerate() {
+            let cur = match pcpu_depths[cpu] {
+                0 => base_depth,
+                d => d,
+            };
+            let next = if ctl.pressure() > 0 {
+                0
+            } else {
+                tuning::next_pcpu_depth(cur, &now_pd.delta(prev_pd))
+            };
+            if next != pcpu_depths[cpu] {
+                sched.write_pcpu_depth(cpu, next);
+                pcpu_depths[cpu] = next;
+            }
+        }
+        pcpu_prev = pcpu_now;
+        if print_now {
+            let live_base = sched.read_scale_knobs().pcpu_depth_base as u32;
+            let effective: Vec<u32> = pcpu_depths
+                .iter()
+                .map(|&d| if d == 0 { live_base } else { d })
+                .collect();
+            println!(
+                "pcpu depth: {}",
+                tuning::format_depth_hist(&tuning::depth_histogram(&effective))
+            );
+        }
+
+        report_cgroups(sched, &mut cgroups, cgroup_top, print_now);
 
-        match regime {
-            Regime::Light => light_ticks += 1,
-            Regime::Mixed => mixed_ticks += 1,
-            Regime::Heavy => heavy_ticks += 1,
+        // KNOB GENERATIONS SUPERSEDED THIS REPORT: WHAT EACH UPDATE DID
+        for r in sched.take_retired_knob_gens() {
+            if print_now {
+                println!("{}", tuning::format_knob_gen(&r));
+            }
         }
 
-        tick_counter += 1;
-        prev_hist = cur_hist;
-        prev_sleep = cur_sleep;
-        prev = stats;
+        // LIVE METRICS: COPY WHAT THIS REPORT ALREADY COMPUTED INTO THE SLOT
+        if let Some(m) = metrics {
+            let mut tier_pct_ns = [[0u64; 4]; HIST_TIERS];
+            for (t, row) in tier_pct_ns.iter_mut().enumerate() {
+                let p = tuning::compute_percentiles(&report_hist[t]);
+                *row = [p.p50_ns, p.p90_ns, p.p99_ns, p.p999_ns];
+            }
+            m.publish(&MetricsSnapshot {
+                reports: report_counter + 1,
+                stats: stats.counters(),
+                tier_pct_ns,
+                all_pct_ns: [pct.p50_ns, pct.p90_ns, pct.p99_ns, pct.p999_ns],
+                regime: ctl.regime().label(),
+                burst: delta_burst > 0,
+                longrun: longrun_active,
+                tightened: ctl.tightened(),
+                stability: stability_score,
+                knobs: knob_values(&knobs),
+                procdb_profiles: db_total as u64,
+                procdb_confident: db_confident as u64,
+            });
+        }
+
+        report_counter += 1;
+        report_ns = 0;
+        report_hist = [[0u64; HIST_BUCKETS]; HIST_TIERS];
+        report_sleep = [0u64; SLEEP_BUCKETS];
+        tally = EventTally::default();
+        prev_report = stats;
     }
 
-    // PROCDB: SAVE LEARNED CLASSIFICATIONS TO DISK
-    if let Some(ref db) = procdb {
-        let path = ProcessDb::default_path();
-        match db.save(&path) {
+    // PROCDB: FINAL SYNC OF THE MAPPED STORE (WRITTEN INCREMENTALLY ALL RUN)
+    if let Some(ref mut db) = procdb {
+        match db.sync() {
             Ok(()) => {
                 let (total, confident) = db.summary();
                 log_info!(
-                    "PROCDB: SAVED {}/{} PROFILES TO {}",
+                    "PROCDB: SYNCED {}/{} PROFILES ({} STORED) TO {}",
                     confident,
                     total,
-                    path.display()
+                    db.stored(),
+                    ProcessDb::store_path().display()
                 );
             }
-            Err(e) => log_warn!("PROCDB SAVE FAILED: {}", e),
+            Err(e) => log_warn!("PROCDB SYNC FAILED: {}", e),
         }
     }
 
     // KNOBS SUMMARY: CAPTURED BY TEST HARNESS FOR ARCHIVE
     let final_knobs = sched.read_tuning_knobs();
+    let final_scale = sched.read_scale_knobs();
+    let final_depths: Vec<u32> = sched
+        .read_pcpu_depth(nr_cpus as usize)
+        .iter()
+        .map(|pd| if pd.depth == 0 { final_scale.pcpu_depth_base as u32 } else { pd.depth })
+        .collect();
     let final_stats = sched.read_stats();
+    let regime_ns = ctl.regime_ns(); // BY Regime: LIGHT, MIXED, HEAVY
     let l2_total_b = final_stats.nr_l2_hit_batch + final_stats.nr_l2_miss_batch;
     let l2_total_i = final_stats.nr_l2_hit_interactive + final_stats.nr_l2_miss_interactive;
     let l2_total_l = final_stats.nr_l2_hit_lat_crit + final_stats.nr_l2_miss_lat_crit;
@@ -431,15 +638,39 @@ pub fn monitor_loop(
         0
     };
     println!(
-        "[KNOBS] regime={} slice_ns={} batch_ns={} preempt_ns={} demotion_ns={} lag={} tightened={} tighten_events={} ticks=L:{}/M:{}/H:{} l2_hit=B:{}%/I:{}%/L:{}%",
-        regime.label(), final_knobs.slice_ns, final_knobs.batch_slice_ns,
+        "[KNOBS] regime={} slice_ns={} batch_ns={} preempt_ns={} demotion_ns={} lag={} tightened={} tighten_events={} fast_promotions={} ticks=L:{}/M:{}/H:{} l2_hit=B:{}%/I:{}%/L:{}% knob_gen={} scale_cpus={} scale_budget={} scale_starve_ns={} scale_overflow_ns={} scale_depth={} scale_pressure={} pcpu_depth={}",
+        ctl.regime().label(), final_knobs.slice_ns, final_knobs.batch_slice_ns,
         final_knobs.preempt_thresh_ns, final_knobs.cpu_bound_thresh_ns,
-        final_knobs.lag_scale, tightened, tighten_events,
-        light_ticks, mixed_ticks, heavy_ticks,
-        l2_cum_b, l2_cum_i, l2_cum_l,
+        final_knobs.lag_scale, ctl.tightened(), ctl.tighten_events(), ctl.fast_promotions(),
+        regime_ns[0] / 1_000_000_000, regime_ns[1] / 1_000_000_000, regime_ns[2] / 1_000_000_000,
+        l2_cum_b, l2_cum_i, l2_cum_l, sched.knob_gen(),
+        final_scale.nr_cpus, final_scale.interactive_budget, final_scale.starvation_rescue_ns,
+        final_scale.overflow_sojourn_rescue_ns, final_scale.pcpu_depth_base, ctl.pressure(),
+        tuning::format_depth_hist(&tuning::depth_histogram(&final_depths)),
     );
 
     // READ UEI EXIT REASON
     let should_restart = sched.read_exit_info();
     Ok(should_restart)
 }
+
+// PER-CGROUP TOP-N: DIFF cgrp_stats_map AGAINST THE LAST REPORT AND PRINT
+// THE HEAVIEST CGROUPS. CALLED ONCE PER REPORT PERIOD. top = 0 DISABLES.
+pub fn report_cgroups(sched: &Scheduler, tracker: &mut CgroupTracker, top: usize, print: bool) {
+    if top == 0 {
+        return;
+    }
+    let usage = tracker.update(sched.read_cgroup_stats());
+    if !print {
+        return;
+    }
+    let ranked = cgroup::rank_top_n(usage, top);
+    if ranked.is_empty() {
+        return;
+    }
+    let entries: Vec<String> = ranked
+        .iter()
+        .map(|u| cgroup::format_usage(&tracker.name(u.id), u))
+        .collect();
+    println!("cgrp: {}", entries.join(" | "));
+}
@@ -4,15 +4,22 @@
 #ifndef __INTF_H
 #define __INTF_H
 
-// BPF VERIFIER LOOP BOUNDS
-#define MAX_CPUS  1024
+// BPF VERIFIER LOOP BOUNDS. MAX_CPUS ALSO SIZES THE .bss PER-CPU ARRAYS
+// (MASKED WITH MAX_CPUS - 1, SO IT STAYS A POWER OF TWO); CPU-INDEXED MAPS
+// ARE SIZED AT LOAD FROM nr_cpu_ids AND THE DETECTED TOPOLOGY.
+#define MAX_CPUS  4096
 #define MAX_NODES 32
 
 // KERNEL PROCESS FLAGS (NOT IN vmlinux.h -- THESE ARE #define MACROS)
 #define PF_KTHREAD 0x00200000
 
 // TUNING KNOBS -- RUST ADAPTIVE LOOP WRITES THESE, BPF READS THEM
-// SINGLE-ELEMENT BPF_MAP_TYPE_ARRAY, UPDATED EVERY 50-1000MS
+// DOUBLE-BUFFERED: tuning_knobs_map HOLDS KNOB_SLOTS COPIES. RUST WRITES THE
+// SLOT NOT IN USE, THEN BUMPS knob_gen (.bss); BPF READS SLOT
+// knob_gen % KNOB_SLOTS, SO NO READER SEES HALF OF ONE REGIME AND HALF OF
+// THE NEXT. UPDATED EVERY 50-1000MS.
+#define KNOB_SLOTS 2
+
 struct tuning_knobs {
 	u64 slice_ns;           // BASE TIME SLICE (DEFAULT 1MS)
 	u64 preempt_thresh_ns;  // TICK PREEMPTION THRESHOLD (DEFAULT 1MS)
@@ -24,8 +31,48 @@ struct tuning_knobs {
 	u64 affinity_mode;      // L2 PLACEMENT: 0=OFF, 1=WEAK, 2=STRONG
 	u64 sojourn_thresh_ns;  // BATCH DSQ RESCUE THRESHOLD (SET BY RUST)
 	u64 burst_slice_ns;     // SLICE CEILING DURING BURST/LONGRUN (SET BY RUST, DEFAULT 1MS)
+	u64 smt_mode;           // SMT PLACEMENT: BITMASK OF SMT_* BELOW (0 = OFF)
 };
 
+// CORE-COUNT SCALING -- DRR BUDGET, RESCUE THRESHOLDS, PER-CPU DEPTH GATE.
+// A .bss GLOBAL (scale_knobs), NOT A MAP: dispatch() READS IT ON EVERY CALL
+// AND EACH FIELD STANDS ALONE, SO A READER RACING AN UPDATE SEES EVERY
+// FIELD EITHER OLD OR NEW, BOTH VALID. BPF DERIVES IT FROM THE ONLINE CPU
+// COUNT IN init() AND ON HOTPLUG UNTIL RUST CLAIMS IT (owner =
+// SCALE_OWNER_RUST); FROM THEN ON ONLY RUST WRITES IT.
+#define SCALE_OWNER_BPF  0
+#define SCALE_OWNER_RUST 1
+
+struct scale_knobs {
+	u64 interactive_budget;         // DRR: MACHINE-WIDE, SPLIT ACROSS NODES BY CPU SHARE
+	u64 starvation_rescue_ns;       // HARD BATCH STARVATION RESCUE AGE
+	u64 overflow_sojourn_rescue_ns; // OVERFLOW DSQ AGE THAT OVERRIDES PER-CPU DSQs
+	u64 pcpu_depth_base;            // select_cpu() PER-CPU DSQ DEPTH GATE
+	u64 nr_cpus;                    // CPU COUNT THE VALUES WERE DERIVED FOR
+	u64 owner;                      // SCALE_OWNER_*
+};
+
+// ADAPTIVE PER-CPU DSQ DEPTH: pcpu_depth_ctl[cpu] IN .bss, ONE LINE PER CPU.
+// BPF COUNTS, RUST PICKS depth FROM THE PER-SECOND DELTAS. COUNTERS ARE
+// INDEXED BY THE CPU THAT OWNS THE DSQ, NOT THE CPU DOING THE WORK.
+#define PCPU_DEPTH_MAX 4
+
+struct pcpu_depth {
+	u32 depth;          // RUST: GATE FOR THIS CPU'S DSQ, 0 = scale_knobs.pcpu_depth_base
+	u32 _pad0;
+	u64 idle_hits;      // select_cpu() FAST PATH INSERTED INTO THIS DSQ
+	u64 spills;         // FAST PATH FOUND IT AT DEPTH, SPILLED TO THE NODE DSQ
+	u64 steals;         // L2/L3 SIBLINGS PULLED FROM IT IN dispatch()
+	u64 sojourn_kicks;  // tick() KICKED THIS CPU FOR A STALE DSQ
+	u64 _pad[3];
+};
+
+// SMT PLACEMENT MODES (tuning_knobs.smt_mode, COMBINABLE)
+// SMT_IDLE_CORE:  INTERACTIVE/LAT_CRITICAL TAKE A FULLY IDLE CORE FIRST
+// SMT_BATCH_PACK: BATCH TAKES AN IDLE THREAD WHOSE SIBLING IS BUSY
+#define SMT_IDLE_CORE  (1ULL << 0)
+#define SMT_BATCH_PACK (1ULL << 1)
+
 // PER-CPU STATISTICS (BPF_MAP_TYPE_PERCPU_ARRAY VALUE)
 // RUST READS THESE FOR WORKLOAD REGIME DETECTION
 struct pandemonium_stats {
@@ -54,6 +101,11 @@ struct pandemonium_stats {
 	u64 nr_l2_miss_interactive;
 	u64 nr_l2_hit_lat_crit;
 	u64 nr_l2_miss_lat_crit;
+	// SMT PLACEMENT (tuning_knobs.smt_mode), SAME CALL SITES AS L2 COUNTERS
+	u64 nr_smt_core_hit;    // NON-BATCH PLACED ON A FULLY IDLE CORE
+	u64 nr_smt_core_miss;   // NO IDLE CORE, FELL BACK TO ANY IDLE CPU
+	u64 nr_smt_pack_hit;    // BATCH PLACED BESIDE A BUSY SIBLING
+	u64 nr_smt_pack_miss;   // NO PARTLY BUSY CORE, FELL BACK
 	// CPU RELEASE: TASKS RESCUED FROM LOCAL DSQ BY scx_bpf_reenqueue_local()
 	u64 nr_reenqueue;
 	// CODEL SOJOURN: CURRENT BATCH WAIT AGE (NS), WRITTEN BY tick()
@@ -64,13 +116,174 @@ struct pandemonium_stats {
 	u64 longrun_mode_active;
 	// OVERFLOW SOJOURN RESCUE: TASKS DISPATCHED BY STEP 0 OVERFLOW AMPLIFICATION
 	u64 nr_overflow_rescue;
+	// CROSS-NODE STEAL BY SLIT DISTANCE CLASS (SEE xnode_class() IN BPF)
+	u64 nr_xnode_steal_near;   // SAME PACKAGE (SNC / MULTI-DIE), DIST <= 15
+	u64 nr_xnode_steal_mid;    // ONE INTERCONNECT HOP, DIST <= 25
+	u64 nr_xnode_steal_far;    // MULTI-HOP, DIST > 25
+	u64 nr_xnode_steal_gated;  // REMOTE WORK SEEN BUT TOO CHEAP TO MIGRATE
+	u64 nr_events_dropped;     // RINGBUF FULL: EVENT LOST, RUST RESYNCS FROM LEVELS
+	u64 nr_hotplug_drained;    // cpu_offline: TASKS MOVED FROM THE DEAD CPU'S DSQ
+	u64 nr_dispatch_batched;   // --dispatch-batch: EXTRA TASKS PER OVERFLOW PULL (NO LADDER WALK)
+	u64 nr_reclassify;         // runnable(): FULL TIER CLASSIFICATIONS
+	u64 nr_reclass_skipped;    // --reclass-interval: WAKEUPS THAT KEPT THE CACHED TIER
+	u64 nr_trace_dropped;      // --trace-out: RECORDS LOST TO A FULL trace_rb
+	u64 nr_pair_affine;        // --pair-affinity: WAKEE PLACED ON AN IDLE CPU NEAR ITS WAKER
+	u64 nr_pair_sync;          // --pair-affinity: SYNC WAKEUP HANDED OFF TO THE WAKER'S CPU
+	u64 nr_idle_shallow;       // --idle-aware: LATENCY TIER PLACED ON A SHALLOW, RECENTLY IDLED CPU
+	u64 nr_idle_warm;          // --idle-aware: BATCH PLACED ON A RECENTLY IDLED, HIGH-CLOCKED CPU
+};
+
+// WAKEUP LATENCY HISTOGRAM: LOG-LINEAR (HDR-STYLE), ONE PER-CPU RECORD
+// UNIT = 1024NS. UNITS 0-3 ARE LINEAR; EACH HIGHER POWER OF TWO SPLITS INTO
+// LAT_HIST_SUB SUB-BUCKETS (<= 25% WIDE). 64 BUCKETS SPAN 1US TO ~117MS, THE
+// LAST ONE COLLECTS EVERYTHING ABOVE. MATCHES HIST_* IN tuning.rs.
+#define LAT_HIST_UNIT_SHIFT 10
+#define LAT_HIST_SUB_BITS   2
+#define LAT_HIST_SUB        (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS    64
+#define LAT_HIST_TIERS      3
+
+struct lat_hist {
+	u64 cnt[LAT_HIST_TIERS][LAT_HIST_BUCKETS];
+};
+
+// PER-GENERATION ACCOUNTING: knob_gen_stats[SLOT] (PERCPU_ARRAY, KNOB_SLOTS).
+// EACH CPU CHARGES THE SLOT OF THE GENERATION IT READ AND RESETS IT WHEN
+// IT FIRST SEES A NEWER gen THERE. RUST SUMS CPUS WHOSE gen MATCHES.
+struct knob_gen_stats {
+	u64 gen;
+	u64 nr_runs;        // running() CALLS UNDER THIS GENERATION
+	u64 wake_lat_sum;   // WAKEUP-TO-RUN LATENCY, ALL TIERS
+	u64 wake_lat_cnt;
+	u64 wake_lat_max;
+	u64 lat_hist[LAT_HIST_BUCKETS];  // SAME BUCKETS AS lat_hist
+};
+
+// PER-CGROUP ACCOUNTING: cgrp_stats_map[CGROUP ID] (CGROUP V2 kernfs ID)
+// BOUNDED LRU HASH SHARED BY ALL CPUS, ATOMIC ADDS. RUST DIFFS SNAPSHOTS
+// AND PUBLISHES THE TOP-N CGROUPS.
+#define MAX_CGROUPS 1024
+
+struct cgrp_stats {
+	u64 runtime_ns;     // CPU TIME CHARGED IN stopping()
+	u64 nr_runs;        // stopping() CALLS: SLICES THAT RAN
+	u64 nr_rescues;     // OVERFLOW / STARVATION RESCUE DISPATCHES THAT RAN
+	u64 wake_lat_sum;   // WAKEUP-TO-RUN LATENCY, ALL TIERS
+	u64 wake_lat_cnt;
+	u64 batch_lat_sum;  // BATCH-TIER SHARE OF THE ABOVE (DSQ SOJOURN ON WAKEUP)
+	u64 batch_lat_cnt;
+	u64 hweight;        // GAUGE: cpu.weight SHARE AT LAST CHARGE, 0 = FLAT
+	u64 lat_hist[LAT_HIST_BUCKETS];  // ALL TIERS, SAME BUCKETS AS lat_hist
+};
+
+// HIERARCHICAL CGROUP WEIGHT. hweight IS A CGROUP'S SHARE OF THE MACHINE:
+// THE PRODUCT OF weight / ACTIVE SIBLING WEIGHT AT EACH LEVEL, WALKED FOR
+// AT MOST CGRP_MAX_DEPTH ANCESTORS.
+#define CGRP_WEIGHT_DFL   100         // cpu.weight DEFAULT
+#define CGRP_HWEIGHT_ONE  (1 << 16)   // THE WHOLE MACHINE
+#define CGRP_MAX_DEPTH    4
+
+// EVENT STREAM: BPF_MAP_TYPE_RINGBUF, EDGE-TRIGGERED, RUST EPOLLS IN adaptive.rs
+// STATE CHANGES WAKE USERSPACE IMMEDIATELY; TIER CHANGES RIDE ALONG
+// WITHOUT A WAKEUP (BPF_RB_NO_WAKEUP) SINCE NOTHING REACTS TO THEM FAST.
+#define EVT_BURST             1   // state = NEW burst_mode, node = NODE, value = WAKEUPS/WINDOW
+#define EVT_LONGRUN           2   // state = NEW longrun_mode, node = NODE
+#define EVT_STARVATION_RESCUE 3   // value = BATCH WAIT (NS), node = NODE
+#define EVT_SOJOURN_CROSS     4   // state = 1 ABOVE / 0 BELOW, value = SOJOURN (NS)
+#define EVT_TIER_CHANGE       5   // prev_state -> state, pid, value = lat_cri
+#define EVT_HOTPLUG           6   // state = 1 ONLINE / 0 OFFLINE, value = TASKS DRAINED
+
+struct pand_event {
+	u64 ts_ns;
+	u64 value;
+	u32 kind;          // EVT_*
+	s32 cpu;
+	u32 pid;           // 0 FOR NON-TASK EVENTS
+	u16 node;
+	u8  state;
+	u8  prev_state;
+};
+
+// SCHEDULING TRACE: SAMPLED BINARY RECORDS OVER trace_rb (--trace-out).
+// RUST FILLS trace_ctl IN .bss, sample LAST; sample == 0 IS THE ONE LOAD
+// EVERY TRACE POINT PAYS WHEN TRACING IS OFF.
+#define TRACE_SELECT_IDLE    1   // select_cpu(): IDLE CPU'S PER-CPU DSQ
+#define TRACE_ENQ_SIBLING    2   // enqueue() TIER 1: NODE DSQ + KICK AN IDLE CPU
+#define TRACE_ENQ_PREEMPT    3   // enqueue() TIER 2: NODE DSQ + KICK_PREEMPT
+#define TRACE_ENQ_OVERFLOW   4   // enqueue() TIER 3: INTERACTIVE OR BATCH OVERFLOW DSQ
+#define TRACE_RUNNING        5   // running(): lat_ns = WAKEUP-TO-RUN LATENCY
+#define TRACE_TIER_NONE      0xff
+
+struct trace_ctl {
+	u32 sample;        // 0 = OFF, 1 = EVERY MATCHING EVENT, N = ~1 IN N
+	u32 pid;           // TGID FILTER, 0 = ANY
+	u64 cgid;          // CGROUP FILTER, 0 = ANY
+	char comm[16];     // comm PREFIX FILTER, "" = ANY
+};
+
+struct pand_trace {
+	u64 ts_ns;
+	u64 lat_ns;
+	u64 dsq;           // TARGET DSQ (0 FOR TRACE_RUNNING)
+	u32 pid;
+	s32 cpu;
+	u8  path;          // TRACE_*
+	u8  tier;          // TIER_* AT THE TRACE POINT, TRACE_TIER_NONE WITHOUT task_ctx
+	u8  wake_path;     // TRACE_RUNNING: dispatch_path (0=IDLE, 1=HARD_KICK, 2=SOFT_KICK)
+	u8  _pad[5];
+};
+
+// NUMA STEAL ORDER: RUST PUBLISHES NEAREST-FIRST REMOTE NODES PER NODE
+// node_steal_order[node * MAX_NODES + slot], SENTINEL node == (u32)-1
+struct node_steal_entry {
+	u32 node;       // REMOTE NODE ID
+	u32 distance;   // SLIT DISTANCE FROM /sys/devices/system/node (0 = UNKNOWN)
+};
+
+// CPU TOPOLOGY: RUST PUBLISHES ONE RECORD PER CPU FROM SYSFS AT STARTUP
+// cpu_topo_map[cpu]. core_type STAYS CORE_TYPE_UNIFORM ON NON-HYBRID PARTS.
+// cst_*: ENABLED cpuidle STATES, SHALLOWEST FIRST; nr_cstates = 0 WITHOUT
+// cpuidle (VMs, idle=poll). BPF ESTIMATES A CPU'S STATE FROM HOW LONG IT
+// HAS BEEN IDLE: THE DEEPEST ONE WHOSE TARGET RESIDENCY HAS ELAPSED.
+#define CORE_TYPE_UNIFORM     0
+#define CORE_TYPE_PERFORMANCE 1
+#define CORE_TYPE_EFFICIENCY  2
+#define MAX_SMT_SIBLINGS      4
+#define MAX_CSTATES           8
+
+struct cpu_topo {
+	u32 l2_group;                 // SAME AS cache_domain[cpu]
+	u32 l3_group;                 // LAST-LEVEL CACHE / CCX GROUP
+	u32 capacity;                 // 0..1024, 1024 = FASTEST CORE
+	u8  core_type;                // CORE_TYPE_*
+	u8  nr_smt;                   // VALID ENTRIES IN smt[]
+	u8  nr_cstates;               // VALID ENTRIES IN cst_*[]
+	u8  _pad;
+	u32 smt[MAX_SMT_SIBLINGS];    // OTHER HARDWARE THREADS OF THIS CORE
+	u32 cst_target_ns[MAX_CSTATES]; // stateN/residency: IDLE TIME BEFORE THE GOVERNOR PICKS IT
+	u32 cst_exit_ns[MAX_CSTATES];   // stateN/latency: WAKEUP COST OUT OF IT
 };
 
 // PROCESS CLASSIFICATION: BPF OBSERVES, RUST LEARNS, BPF APPLIES
 // SHARED BETWEEN BPF MAPS (task_class_observe, task_class_init) AND RUST (procdb.rs)
+// PROFILES RUST KEEPS (AND task_class_init CAN HOLD); THE OBSERVE LRU IS
+// DRAINED EVERY SECOND SO IT ONLY NEEDS ONE SECOND OF MATURING TASKS
+#define PROCDB_MAX_ENTRIES 16384
+#define PROCDB_OBSERVE_ENTRIES 1024
+
+// PROFILE KEY: EXECUTABLE IDENTITY + comm, OPTIONALLY + CGROUP.
+// exe_id = 0 AND cgid = 0 IS THE comm-ONLY FALLBACK PROFILE: RUST KEEPS
+// ONE PER comm ACROSS ALL EXECUTABLES, enable() TRIES IT ON AN EXACT MISS.
+struct task_class_key {
+	u64  exe_id;        // MIXED (s_dev, i_ino) OF mm->exe_file, 0 = NONE (KTHREAD)
+	u64  cgid;          // CGROUP ID WITH --procdb-cgroup, OTHERWISE 0
+	char comm[16];
+};
+
 struct task_class_entry {
 	u8  tier;
-	u8  _pad[7];
+	u8  _pad[3];
+	u32 period_us;      // DETECTED WAKEUP PERIOD, 0 = NOT PERIODIC
 	u64 avg_runtime;
 	u64 runtime_dev;    // EWMA |RUNTIME - AVG_RUNTIME|
 	u64 wakeup_freq;    // WAKEUP FREQUENCY (EWMA)
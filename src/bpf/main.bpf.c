@@ -28,15 +28,53 @@ char _license[] SEC("license") = "GPL";
 
 const volatile u64 nr_cpu_ids = 1;
 
-// BEHAVIORAL CONSTANTS
+// PER-CPU HOT-STATE LAYOUT: false = PACKED u64 SOJOURN ARRAY (DEFAULT),
+// true = ONE CACHE-LINE-PADDED pcpu_state RECORD PER CPU (--pcpu-padded).
+// RODATA: THE VERIFIER PRUNES THE UNUSED LAYOUT AT LOAD.
+const volatile bool pcpu_padded = false;
+
+// PROCDB KEY INCLUDES THE CGROUP ID (--procdb-cgroup). OFF BY DEFAULT:
+// CGROUP IDS ARE NOT STABLE ACROSS REBOOTS, SO PERSISTED PROFILES KEYED
+// BY THEM ONLY MATCH WITHIN ONE BOOT.
+const volatile bool procdb_cgroup_key = false;
+
+// BATCHED DISPATCH (--dispatch-batch): AN OVERFLOW PULL IN dispatch() MAY
+// MOVE A FEW MORE TASKS FROM THE SAME DSQ INSTEAD OF RE-WALKING THE WHOLE
+// STEP LADDER FOR EACH ONE. SEE dispatch_fill().
+const volatile bool dispatch_batch = false;
+
+// AMORTIZED RECLASSIFICATION (--reclass-interval N, 0 = OFF): A SETTLED
+// TASK WHOSE TIER HELD AT ITS LAST CLASSIFICATION SKIPS THE lat_cri SCORE
+// AND KNOB LOOKUP FOR N-1 WAKEUPS, UNLESS A RUN LEAVES ITS runtime_dev BAND.
+const volatile u32 reclass_interval = 0;
+
+// PERIODIC DEADLINES (--periodic-deadline): A TASK WAKING ON A STABLE
+// PERIOD (FRAME, AUDIO, GAME LOOPS) IS LAT_CRITICAL AND ITS DEADLINE COMES
+// FROM ITS PERIOD AND RUNTIME INSTEAD OF VTIME LAG. THE PERIOD IS TRACKED
+// AND PUBLISHED TO procdb EITHER WAY. SEE task_periodic().
+const volatile bool periodic_deadline = false;
+
+// WAKER/WAKEE PAIRS (--pair-affinity): A SHORT-RUNNING TASK WOKEN BY THE
+// SAME WAKER AGAIN AND AGAIN LANDS ON AN IDLE CPU NEAR THE WAKER, OR ON
+// THE WAKER'S OWN CPU FOR A SYNC WAKEUP. SEE pick_pair_cpu().
+const volatile bool pair_affinity = false;
+
+// IDLE-STATE PLACEMENT (--idle-aware): update_idle() STAMPS EACH CPU'S IDLE
+// ENTRY AND KEEPS A SHORT PER-NODE LIST OF THE CPUs THAT IDLED LAST.
+// LATENCY TIERS PREFER ONE STILL IN A SHALLOW C-STATE, BATCH ONE STILL
+// CLOCKED HIGH. SEE pick_recent_idle_cpu().
+const volatile bool idle_aware = false;
+
+// TOPOLOGY MAP GEOMETRY: RUST SETS THESE FROM THE DETECTED TOPOLOGY AND
+// SIZES l2_siblings / l3_siblings TO MATCH (set_max_entries) BEFORE LOAD.
+// *_stride IS THE LARGEST GROUP (A ROW SHORTER THAN IT ENDS IN A (u32)-1
+// SENTINEL), CAPPED AT MAX_L2_SIBLINGS / MAX_L3_SIBLINGS. THE DEFAULTS ARE
+// THE OLD FIXED LAYOUT.
+const volatile u32 l2_stride = 8;
+const volatile u32 l3_stride = 32;
+const volatile u32 nr_l3_rows = 64;
 
-// TEST: CUMULATIVE BURST COUNTER FOR RUST TELEMETRY VISIBILITY.
-// INCREMENTS PER-CPU STAT EACH TICK BURST IS DETECTED INSTEAD OF
-// SNAPSHOT (WHICH THE 1HZ RUST POLL ALWAYS MISSES). DISABLE FOR
-// PRODUCTION -- THE PER-TICK INCREMENT IS UNNECESSARY OVERHEAD
-// ONCE TELEMETRY VALIDATION IS COMPLETE.
-#define BURST_COUNTER_TEST 1
-#define TRACE_SCHED 1
+// BEHAVIORAL CONSTANTS
 
 #define TIER_BATCH        0
 #define TIER_INTERACTIVE  1
@@ -56,6 +94,31 @@ const volatile u64 nr_cpu_ids = 1;
 #define MAX_CSW_RATE         512
 #define LAG_CAP_NS           (40ULL * 1000000ULL)
 
+// PERIOD DETECTION: 2MS (500HZ AUDIO) TO 100MS (10HZ) BETWEEN WAKEUPS,
+// MEAN DEVIATION UNDER 1/8 OF THE PERIOD, RUNTIME UNDER 1/4 OF IT
+#define PERIOD_MIN_NS        (2ULL * 1000000ULL)
+#define PERIOD_MAX_NS        (100ULL * 1000000ULL)
+#define PERIOD_DEV_SHIFT     3
+#define PERIOD_UTIL_SHIFT    2
+
+// WAKER/WAKEE PAIRS: STABLE AFTER PAIR_STREAK_MIN CONSECUTIVE WAKEUPS BY
+// ONE WAKER. ONLY WAKEES RUNNING UNDER PAIR_RUNTIME_MAX_NS ARE PULLED IN:
+// LONGER RUNS OUTLIVE THE CACHE FOOTPRINT THE WAKER LEFT BEHIND.
+#define PAIR_STREAK_MIN      4
+#define PAIR_RUNTIME_MAX_NS  (500ULL * 1000ULL)
+
+// IDLE-STATE PLACEMENT: A LATENCY-TIER WAKEUP TAKES A CPU WHOSE ESTIMATED
+// EXIT LATENCY IS AT MOST IDLE_EXIT_MAX_NS (C1/C1E, NOT C6). WITHOUT
+// cpuidle DATA, "SHALLOW" MEANS IDLE FOR UNDER IDLE_SHALLOW_NS. BATCH
+// TAKES A CPU IDLE FOR UNDER IDLE_WARM_NS WHOSE LAST SAMPLED CLOCK WAS
+// AT LEAST IDLE_WARM_PERF / 1024 OF ITS MAXIMUM: cpufreq GOVERNORS RAMP
+// DOWN OVER MILLISECONDS, SO IT IS STILL FAST WHEN THE TASK LANDS.
+#define IDLE_RING_SLOTS   8
+#define IDLE_EXIT_MAX_NS  (20ULL * 1000ULL)
+#define IDLE_SHALLOW_NS   (200ULL * 1000ULL)
+#define IDLE_WARM_NS      (2ULL * 1000000ULL)
+#define IDLE_WARM_PERF    768
+
 #define SLICE_MIN_NS 100000     // 100US FLOOR
 #define STARVATION_RESCUE_NS (500ULL * 1000000ULL) // 500MS HARD LIMIT
 // OVERFLOW SOJOURN RESCUE: COMPUTED IN init() FROM nr_cpu_ids
@@ -72,53 +135,181 @@ static u64 vtime_now;
 // CLEARED BY tick() AFTER PREEMPTING A BATCH TASK.
 static bool interactive_waiting;
 
+// PER-NODE SHARED-DSQ STATE: ONE CACHE LINE PER NUMA NODE.
+// THE OVERFLOW DSQs ARE PER-NODE (nr_cpu_ids + NODE, nr_cpu_ids + nr_nodes
+// + NODE), SO THE STATE THAT GUARDS THEM IS TOO. A STARVING BATCH DSQ ON
+// NODE 1 ONLY TRIGGERS RESCUE ON NODE 1 CPUs, AND THE DRR INCREMENT ON
+// EVERY DISPATCH STAYS ON A NODE-LOCAL LINE INSTEAD OF BOUNCING ACROSS
+// SOCKETS.
+//
 // SOJOURN TRACKERS: RECORD WHEN OVERFLOW DSQs TRANSITION FROM EMPTY.
 // DISPATCH STEP 0 CHECKS THESE TO RESCUE OVERFLOW TASKS AGING PAST
 // overflow_sojourn_rescue_ns. WITHOUT THIS, PER-CPU DSQ DOMINANCE
 // UNDER SUSTAINED LOAD MAKES ALL DOWNSTREAM ANTI-STARVATION LOGIC
 // (DEFICIT, SOJOURN, STARVATION_RESCUE) UNREACHABLE.
-static u64 batch_enqueue_ns;
-static u64 interactive_enqueue_ns;
+//
+// DEFICIT COUNTER: ANTI-STARVATION INTERLEAVE (DRR)
+// COUNTS DISPATCHES SINCE LAST BATCH SERVICE ON THIS NODE. WHEN
+// interactive_run EXCEEDS interactive_budget AND BATCH IS STARVING, FORCE
+// ONE BATCH DISPATCH. PROPORTIONAL: BUDGET = nr_cpus * ratio (RATIO
+// SCALES 2-4), CUT TO THIS NODE'S SHARE OF THE ONLINE CPUs (SEE
+// node_budget()).
+//
+// NR_CPUS: ONLINE CPUs ON THIS NODE. COUNTED AT init(), KEPT CURRENT BY
+// THE HOTPLUG CALLBACKS.
+//
+// LONGRUN: SET BY tick() WHEN THIS NODE'S BATCH DSQ HAS BEEN NON-EMPTY
+// FOR > LONGRUN_THRESH_NS. READ BY dispatch() AND task_slice().
+//
+// BURST: SET BY THE tick() THAT CLOSES THIS NODE'S BURST WINDOW (SEE
+// struct node_burst). A FORK STORM ON NODE 0 SHORTENS SLICES ON NODE 0
+// ONLY. READ BY select_cpu(), task_slice() AND tick().
+#define CACHELINE_SIZE 64
+
+struct node_state {
+	u64 batch_enqueue_ns;
+	u64 interactive_enqueue_ns;
+	u64 interactive_run;
+	u64 longrun_mode;       // 0/1 -- u64 SO THE LINE LAYOUT IS EXPLICIT
+	u64 sojourn_over;       // 0/1 -- BATCH SOJOURN ABOVE sojourn_thresh_ns (EVT EDGE)
+	u64 burst_mode;         // 0/1 -- FORK/WAKEUP STORM ON THIS NODE
+	u64 nr_cpus;            // ONLINE CPUs ON THIS NODE
+	u64 _pad[1];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+_Static_assert(sizeof(struct node_state) == CACHELINE_SIZE,
+	       "node_state must occupy exactly one cache line");
+
+static struct node_state node_state[MAX_NODES];
 
 // PER-CPU DSQ SOJOURN: TRACKS WHEN EACH PER-CPU DSQ TRANSITIONS
 // FROM EMPTY. DISPATCH AND TICK CHECK THESE TO DETECT STALE TASKS.
 // WORK STEALING + DEPTH GATE HANDLE MOST CASES; THIS IS THE SAFETY NET.
+// PACKED LAYOUT: 8 CPUs SHARE A CACHE LINE. EVERY select_cpu() CASes ITS
+// OWN SLOT WHILE tick() SCANS REMOTE SLOTS, SO THE LINES BOUNCE ON WIDE
+// HOSTS. ACCESS THROUGH pcpu_stamp() SO THE PADDED LAYOUT CAN REPLACE IT.
 static u64 pcpu_enqueue_ns[MAX_CPUS];
 
-// DEFICIT COUNTER: ANTI-STARVATION INTERLEAVE (DRR)
-// COUNTS DISPATCHES SINCE LAST BATCH SERVICE. WHEN interactive_run
-// EXCEEDS interactive_budget AND BATCH IS STARVING, FORCE ONE BATCH
-// DISPATCH. PROPORTIONAL: BUDGET = nr_cpu_ids * ratio (RATIO SCALES 2-4).
-static u64 interactive_run;
-static u64 interactive_budget;
-static u64 starvation_rescue_ns;
-static u64 overflow_sojourn_rescue_ns;
-static u32 pcpu_depth_base;
-
-// CUSUM BURST DETECTION (TOTAL-ENQUEUE)
-// MONITORS ENQUEUE RATE TO DETECT FORK/EXEC STORMS.
-// SAMPLES EVERY 64TH ENQUEUE: TRACKS TIME INTERVAL (SHORTER = BURST).
-// EFFECTIVE FOR BPF-ONLY (1MS SLICES). RATE-BOUNDED UNDER ADAPTIVE (4MS).
-static u64 cusum_enq_count;
-static u64 cusum_last_check_ns;
-static u64 cusum_interval_ewma;
-static u64 cusum_s;
-static u64 cusum_lock;
-static bool burst_mode;
-
-// WAKEUP RATE COUNTER: ABSOLUTE BURST DETECTION FOR ADAPTIVE MODE.
-// TOTAL-ENQUEUE CUSUM IS RATE-BOUNDED BY NCPU/SLICE_NS -- WITH 4MS HEAVY
-// SLICES, FORK STORMS DON'T CHANGE THE RATE ENOUGH TO TRIGGER.
-// ABSOLUTE RATE COUNTER: COUNT WAKEUPS SINCE LAST tick(). IF COUNT EXCEEDS
-// THRESHOLD (nr_cpu_ids * 2), THAT'S A FORK STORM. NO CALIBRATION NEEDED.
-static u64 wake_rate_count;
-
-// LONGRUN DETECTION
-// TRACKS SUSTAINED BATCH DSQ PRESSURE. WHEN BATCH DSQ IS NON-EMPTY
-// FOR > LONGRUN_THRESH_NS, TIGHTEN DEFICIT RATIO TO INCREASE BATCH SHARE.
-// CLEARS WHEN BATCH DSQ EMPTIES.
+// PADDED LAYOUT (pcpu_padded): EACH CPU'S HOT STATE ON ITS OWN LINE.
+// enqueue_ns:     SOJOURN STAMP (SAME SEMANTICS AS pcpu_enqueue_ns)
+// last_refill_ns: LAST TIME dispatch() PULLED FROM THIS PER-CPU DSQ
+// depth:          QUEUE DEPTH OBSERVED AT THE LAST INSERT/DRAIN
+struct pcpu_state {
+	u64 enqueue_ns;
+	u64 last_refill_ns;
+	u32 depth;
+	u32 _pad0;
+	u64 _pad[5];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+_Static_assert(sizeof(struct pcpu_state) == CACHELINE_SIZE,
+	       "pcpu_state must occupy exactly one cache line");
+
+static struct pcpu_state pcpu_state[MAX_CPUS];
+
+// DRR BUDGET + RESCUE THRESHOLDS (SEE struct scale_knobs IN intf.h).
+// NON-STATIC SO THE SKELETON EXPOSES IT: RUST REWRITES IT AT RUNTIME.
+volatile struct scale_knobs scale_knobs;
+static u64 nr_online_cpus;
+
+// ADAPTIVE PER-CPU DEPTH (SEE struct pcpu_depth IN intf.h). .bss, NOT A MAP:
+// select_cpu() READS IT ON EVERY IDLE WAKEUP AND RUST SCANS EVERY CPU EACH
+// SECOND WITHOUT A SYSCALL PER ENTRY.
+struct pcpu_depth pcpu_depth_ctl[MAX_CPUS];
+
+_Static_assert(sizeof(struct pcpu_depth) == CACHELINE_SIZE,
+	       "pcpu_depth must occupy exactly one cache line");
+
+// PER-NODE BACKLOG INDEX: ONE BIT PER CPU WHOSE PER-CPU DSQ IS NON-EMPTY,
+// IN THE ROW OF THAT CPU'S NODE. SET BY THE select_cpu() INSERT, CLEARED
+// WHEN A DRAIN LEAVES THE DSQ EMPTY. tick() WALKS ITS NODE'S SET BITS
+// INSTEAD OF PROBING BLIND ROTATING SLOTS, AND dispatch() SKIPS SIBLINGS
+// WITH NOTHING TO STEAL. A STALE SET BIT COSTS ONE PROBE AND IS DROPPED
+// THE NEXT TIME ANYONE SEES THE DSQ EMPTY. summary HAS ONE BIT PER
+// NON-EMPTY WORD, SO tick() LOADS ONLY WORDS THAT HOLD A BACKLOGGED CPU.
+#define BACKLOG_WORDS  (MAX_CPUS / 64)
+#define BACKLOG_PROBES 8   // STAMPS CHECKED PER tick()
+
+_Static_assert(BACKLOG_WORDS <= 64, "node_backlog summary is one u64");
+
+struct node_backlog {
+	u64 summary;
+	u64 bits[BACKLOG_WORDS];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+static struct node_backlog node_backlog[MAX_NODES];
+
+// BURST DETECTION: PER-CPU COUNTS, PER-NODE WINDOWS.
+// enqueue() BUMPS ITS OWN CPU'S pcpu_burst LINE WITH PLAIN STORES. A BPF
+// PROGRAM CAN'T BE PREEMPTED AND enqueue()/tick() BOTH RUN WITH IRQS OFF,
+// SO NOTHING ELSE WRITES THE LINE. EVERY BURST_FLUSH_BATCH ENQUEUES, AND
+// ON EVERY tick(), THE CPU ADDS ITS COUNTS TO ITS NODE'S node_burst: ONE
+// SHARED ATOMIC PER 16 EVENTS INSTEAD OF TWO PER EVENT.
+//
+// THE FIRST tick() ON A NODE PAST BURST_WINDOW_NS CLOSES THE WINDOW (CAS
+// ON window_ns). COUNTS ARE NORMALIZED TO BURST_WINDOW_NS, SO THE WINDOW
+// IS THE SAME LENGTH WHATEVER HZ IS AND WHICHEVER CPU TICKS FIRST.
+//
+// CUSUM (Page, 1954): ON THE NODE'S ENQUEUES PER WINDOW, EWMA BASELINE
+// (1/8) WITH 25% SLACK. EFFECTIVE FOR BPF-ONLY (1MS SLICES). IT IS
+// RATE-BOUNDED UNDER ADAPTIVE (4MS): WITH LONG SLICES A FORK STORM
+// BARELY MOVES THE TOTAL ENQUEUE RATE.
+// WAKEUP RATE: ABSOLUTE AND NEEDS NO CALIBRATION. MORE THAN
+// BURST_WAKE_PER_CPU_MS WAKEUPS PER NODE CPU PER MILLISECOND (8 PER CPU
+// IN A 4MS WINDOW) IS A FORK STORM -- THE RATE THE PER-TICK CHECK USED
+// AT HZ=1000.
+#define BURST_WINDOW_NS        (4ULL * 1000000ULL)
+#define BURST_FLUSH_BATCH      16
+#define BURST_WAKE_PER_CPU_MS  2
+#define BURST_WAKE_PER_CPU     (BURST_WAKE_PER_CPU_MS * BURST_WINDOW_NS / 1000000ULL)
+
+struct pcpu_burst {
+	u64 enq;     // ENQUEUES NOT YET FLUSHED TO THE NODE
+	u64 wake;    // WAKEUPS NOT YET FLUSHED TO THE NODE
+	u64 _pad[6];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+struct node_burst {
+	u64 window_ns;  // START OF THE OPEN WINDOW
+	u64 enq;        // ENQUEUES FLUSHED INTO THE OPEN WINDOW
+	u64 wake;       // WAKEUPS FLUSHED INTO THE OPEN WINDOW
+	u64 enq_ewma;   // CUSUM BASELINE: ENQUEUES PER WINDOW
+	u64 cusum_s;    // CUSUM ACCUMULATOR (WRITTEN ONLY BY THE CLOSING tick())
+	u64 _pad[3];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+_Static_assert(sizeof(struct pcpu_burst) == CACHELINE_SIZE,
+	       "pcpu_burst must occupy exactly one cache line");
+_Static_assert(sizeof(struct node_burst) == CACHELINE_SIZE,
+	       "node_burst must occupy exactly one cache line");
+
+static struct pcpu_burst pcpu_burst[MAX_CPUS];
+static struct node_burst node_burst[MAX_NODES];
+
+// IDLE-STATE TRACKING (--idle-aware). cpu_idle_since[cpu] IS THE LAST IDLE
+// ENTRY, 0 WHILE THE CPU RUNS A TASK. ONLY THE CPU ITSELF WRITES ITS SLOT.
+// idle_ring[node] HOLDS THE LAST IDLE_RING_SLOTS CPUs OF THE NODE TO GO
+// IDLE; head COUNTS PUSHES, SO cpu[(head - 1) % SLOTS] IS THE NEWEST.
+// ENTRIES GO STALE AS CPUs WAKE: READERS RECHECK THE STAMP AND CLAIM
+// THROUGH scx_bpf_test_and_clear_cpu_idle() AS EVERY OTHER PICK DOES.
+static u64 cpu_idle_since[MAX_CPUS];
+
+struct idle_ring {
+	u32 head;
+	u32 cpu[IDLE_RING_SLOTS];
+	u32 _pad[7];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
+_Static_assert(sizeof(struct idle_ring) == CACHELINE_SIZE,
+	       "idle_ring must occupy exactly one cache line");
+
+static struct idle_ring idle_ring[MAX_NODES];
+
+// LONGRUN DETECTION (PER-NODE, SEE struct node_state)
+// TRACKS SUSTAINED BATCH DSQ PRESSURE. WHEN A NODE'S BATCH DSQ IS NON-EMPTY
+// FOR > LONGRUN_THRESH_NS, TIGHTEN THAT NODE'S DEFICIT RATIO TO INCREASE
+// BATCH SHARE. CLEARS WHEN THE NODE'S BATCH DSQ EMPTIES.
 #define LONGRUN_THRESH_NS (2000ULL * 1000000ULL)
-static bool longrun_mode;
 
 // USER EXIT
 
@@ -128,11 +319,22 @@ UEI_DEFINE(uei);
 
 struct {
 	__uint(type, BPF_MAP_TYPE_ARRAY);
-	__uint(max_entries, 1);
+	__uint(max_entries, KNOB_SLOTS);
 	__type(key, u32);
 	__type(value, struct tuning_knobs);
 } tuning_knobs_map SEC(".maps");
 
+// PUBLISHED KNOB GENERATION: RUST STORES IT (MMAPED .bss) AFTER FILLING
+// SLOT gen % KNOB_SLOTS. NON-STATIC SO THE SKELETON EXPOSES IT.
+volatile u64 knob_gen;
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, KNOB_SLOTS);
+	__type(key, u32);
+	__type(value, struct knob_gen_stats);
+} knob_gen_stats SEC(".maps");
+
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
 	__uint(max_entries, 1);
@@ -153,20 +355,22 @@ struct {
 // OBSERVE: BPF WRITES MATURE TASK CLASSIFICATION, RUST DRAINS EVERY SECOND
 struct {
 	__uint(type, BPF_MAP_TYPE_LRU_HASH);
-	__uint(max_entries, 512);
-	__type(key, char[16]);
+	__uint(max_entries, PROCDB_OBSERVE_ENTRIES);
+	__type(key, struct task_class_key);
 	__type(value, struct task_class_entry);
 } task_class_observe SEC(".maps");
 
 // INIT: RUST WRITES PREDICTIONS, BPF READS IN enable() FOR NEW TASKS
+// HOLDS EXACT PROFILES AND THE comm-ONLY FALLBACKS, HENCE 2X PER comm
 struct {
 	__uint(type, BPF_MAP_TYPE_HASH);
-	__uint(max_entries, 512);
-	__type(key, char[16]);
+	__uint(max_entries, PROCDB_MAX_ENTRIES);
+	__type(key, struct task_class_key);
 	__type(value, struct task_class_entry);
 } task_class_init SEC(".maps");
 
-// COMPOSITOR MAP: RUST POPULATES AT STARTUP, BPF LOOKS UP IN runnable()
+// COMPOSITOR MAP: RUST POPULATES AT STARTUP, BPF LOOKS UP WHEN A TASK'S
+// POLICY FLAGS ARE RESOLVED (enable(), comm CHANGE, policy_gen BUMP)
 // KEY: COMM NAME (16 BYTES), VALUE: UNUSED (EXISTENCE = COMPOSITOR)
 struct {
 	__uint(type, BPF_MAP_TYPE_HASH);
@@ -175,11 +379,17 @@ struct {
 	__type(value, u8);
 } compositor_map SEC(".maps");
 
+// POLICY GENERATION: RUST BUMPS IT (MMAPED .bss) AFTER EVERY compositor_map
+// WRITE. TASKS ENABLED BEFORE THE WRITE RE-RESOLVE THEIR FLAGS ON THEIR
+// NEXT WAKEUP.
+volatile u64 policy_gen;
+
 // L2 SIBLINGS MAP: FLAT ARRAY FOR L2-AWARE CPU PLACEMENT
-// l2_siblings[group_id * MAX_L2_SIBLINGS + slot] = cpu_id
+// l2_siblings[group_id * l2_stride + slot] = cpu_id
 // SENTINEL: (u32)-1 MARKS END OF GROUP
-// POPULATED BY RUST AT STARTUP FROM CpuTopology
-#define MAX_L2_SIBLINGS 8
+// POPULATED BY RUST AT STARTUP FROM CpuTopology, WHICH ALSO SETS
+// max_entries. MAX_L2_SIBLINGS BOUNDS THE SCAN LOOPS FOR THE VERIFIER.
+#define MAX_L2_SIBLINGS 32
 
 struct {
 	__uint(type, BPF_MAP_TYPE_ARRAY);
@@ -188,13 +398,72 @@ struct {
 	__type(value, u32);
 } l2_siblings SEC(".maps");
 
-// WAKEUP LATENCY HISTOGRAM: 3 TIERS x 12 BUCKETS = 36 ENTRIES PER CPU
-// BPF INCREMENTS IN running(); RUST READS ONCE PER SECOND IN MONITOR LOOP
+// NUMA STEAL ORDER: NEAREST-FIRST REMOTE NODES PER NODE
+// init() SEEDS INDEX ORDER WITH DISTANCE 0; RUST OVERWRITES FROM SYSFS
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, MAX_NODES * MAX_NODES);
+	__type(key, u32);
+	__type(value, struct node_steal_entry);
+} node_steal_order SEC(".maps");
+
+// CPU TOPOLOGY RECORDS: L3 GROUP, CAPACITY, CORE TYPE, SMT SIBLINGS
+// POPULATED BY RUST AT STARTUP FROM CpuTopology; max_entries = nr_cpu_ids
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, MAX_CPUS);
+	__type(key, u32);
+	__type(value, struct cpu_topo);
+} cpu_topo_map SEC(".maps");
+
+// L3 SIBLINGS MAP: SAME LAYOUT AS l2_siblings, ONE ROW PER L3/CCX GROUP
+// l3_siblings[group_id * l3_stride + slot] = cpu_id, nr_l3_rows ROWS
+// SENTINEL: (u32)-1 MARKS END OF GROUP
+#define MAX_L3_SIBLINGS 128
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 64 * 32);
+	__type(key, u32);
+	__type(value, u32);
+} l3_siblings SEC(".maps");
+
+// CORE-TYPE CPU LISTS (HYBRID ONLY): ROW 0 = P-CORES, ROW 1 = E-CORES
+// core_type_cpus[row * nr_cpu_ids + slot] = cpu_id, SENTINEL (u32)-1
+// PLACEMENT SCANS AT MOST MAX_CORE_TYPE_SCAN ENTRIES PER ENQUEUE.
+#define MAX_CORE_TYPE_SCAN 32
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 2 * MAX_CPUS);
+	__type(key, u32);
+	__type(value, u32);
+} core_type_cpus SEC(".maps");
+
+// EVENT STREAM: EDGE-TRIGGERED STATE CHANGES FOR THE RUST ADAPTIVE LOOP
+// 64KB = 2048 EVENTS. FULL BUFFER DROPS (COUNTED), NEVER BLOCKS.
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 64 * 1024);
+} events SEC(".maps");
+
+// SCHEDULING TRACE: 4MB = ~100K RECORDS, DRAINED ON EVERY MONITOR POLL.
+// SUBMITTED WITHOUT WAKEUPS; FULL BUFFER DROPS (COUNTED).
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 4 * 1024 * 1024);
+} trace_rb SEC(".maps");
+
+// TRACE FILTER + SAMPLE RATE: WRITTEN BY RUST (MMAPED .bss), sample LAST
+struct trace_ctl trace_ctl;
+
+// WAKEUP LATENCY HISTOGRAM: 3 TIERS x 64 LOG-LINEAR BUCKETS, ONE RECORD PER CPU
+// BPF INCREMENTS IN running(); RUST READS THE WHOLE RECORD IN ONE LOOKUP
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
-	__uint(max_entries, 36);
+	__uint(max_entries, 1);
 	__type(key, u32);
-	__type(value, u64);
+	__type(value, struct lat_hist);
 } wake_lat_hist SEC(".maps");
 
 // SLEEP DURATION HISTOGRAM: 4 BUCKETS PER CPU
@@ -206,6 +475,49 @@ struct {
 	__type(value, u64);
 } sleep_hist SEC(".maps");
 
+// PER-CGROUP ACCOUNTING (SEE struct cgrp_stats). LRU: WITH MORE THAN
+// MAX_CGROUPS ACTIVE, THE COLDEST CGROUP IS EVICTED AND RECOUNTED FROM ZERO.
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, MAX_CGROUPS);
+	__type(key, u64);
+	__type(value, struct cgrp_stats);
+} cgrp_stats_map SEC(".maps");
+
+// INSERT TEMPLATE: struct cgrp_stats IS TOO LARGE FOR THE BPF STACK
+static struct cgrp_stats cgrp_stats_zero;
+
+// SET IN dispatch() WHEN A RESCUE MOVES A TASK TO THIS CPU'S LOCAL DSQ.
+// THE NEXT running() HERE CHARGES THE RESCUE TO THAT TASK'S CGROUP.
+static u8 cpu_rescued[MAX_CPUS];
+
+// HIERARCHICAL CGROUP FAIR SHARE. ONE ENTRY PER LIVE CGROUP, CREATED IN
+// cgroup_init() AND DELETED IN cgroup_exit(). KEYED BY CGROUP ID SO THE
+// HOT PATH RESOLVES IT FROM tctx->cgid WITHOUT ACQUIRING THE CGROUP.
+struct cgrp_ctx {
+	u64 parent;             // PARENT CGROUP ID, 0 AT THE ROOT
+	u64 vtime;              // CGROUP VTIME: FRONTIER OF MEMBER TASK VTIME
+	u64 task_wsum;          // EFFECTIVE WEIGHT OF RUNNABLE MEMBER TASKS
+	u64 hweight_gen;        // cgrp_hweight_gen WHEN hweight WAS COMPUTED
+	u32 weight;             // cpu.weight (1-10000)
+	u32 hweight;            // SHARE OF THE MACHINE, CGRP_HWEIGHT_ONE = ALL
+	u32 child_wsum;         // weight OF ACTIVE CHILDREN
+	u32 nr_active_children;
+	u32 nr_tasks;           // RUNNABLE MEMBER TASKS
+	u32 _pad;
+};
+
+// TABLE FULL: A CGROUP WITHOUT AN ENTRY SCHEDULES FLAT (PER-TASK FAIRNESS)
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, MAX_CGROUPS);
+	__type(key, u64);
+	__type(value, struct cgrp_ctx);
+} cgrp_ctx_map SEC(".maps");
+
+static u64 cgrp_task_wsum;    // EFFECTIVE WEIGHT OF ALL RUNNABLE TASKS
+static u64 cgrp_hweight_gen;  // BUMPED ON ANY ACTIVATION OR WEIGHT CHANGE
+
 // PER-TASK CONTEXT
 
 struct task_ctx {
@@ -220,13 +532,32 @@ struct task_ctx {
 	u64 csw_rate;
 	u64 lat_cri;
 	u64 sleep_start_ns;  // SET IN quiescent(), USED IN running()
+	u64 period_ns;       // EWMA OF THE INTER-WAKEUP INTERVAL
+	u64 period_dev;      // EWMA OF |INTERVAL - period_ns| (JITTER SIGNAL)
 	u32 tier;
 	u32 ewma_age;
 	s32 last_cpu;        // LAST CPU THIS TASK RAN ON (FOR CACHE AFFINITY)
 	u8  dispatch_path;   // 0=IDLE, 1=HARD_KICK, 2=SOFT_KICK
-	u8  _pad[3];
+	u8  cg_queued;       // COUNTED IN ITS CGROUP'S task_wsum (runnable)
+	u8  policy;          // TASK_F_* FLAGS, RESOLVED BY task_policy_resolve()
+	u8  reclass_left;    // --reclass-interval: WAKEUPS LEFT BEFORE A FULL RECLASSIFY
+	u32 cg_weight;       // WEIGHT ADDED TO task_wsum, REMOVED ON quiescent
+	u64 cgid;            // CGROUP ID (cgrp_stats_map, cgrp_ctx_map), 0 = UNKNOWN
+	u64 comm_sig;        // FIRST 8 comm BYTES WHEN policy WAS RESOLVED
+	u32 policy_gen;      // policy_gen WHEN policy WAS RESOLVED
+	u32 waker_pid;       // --pair-affinity: LAST TASK THAT WOKE THIS ONE
+	u32 waker_streak;    // CONSECUTIVE WAKEUPS BY waker_pid, CAPPED AT PAIR_STREAK_MIN
 };
 
+// PER-TASK POLICY FLAGS. RESOLVED IN enable() AND AGAIN WHEN THE comm
+// CHANGES (exec, PR_SET_NAME) OR USERSPACE BUMPS policy_gen, SO THE
+// WAKEUP PATH TESTS A BIT INSTEAD OF HASHING THE comm INTO compositor_map.
+#define TASK_F_COMPOSITOR  (1 << 0)  // comm IS IN compositor_map
+#define TASK_F_KTHREAD     (1 << 1)  // PF_KTHREAD (FIXED AT FORK)
+#define TASK_F_PROCDB      (1 << 2)  // TIER SEEDED FROM A CONFIDENT procdb PROFILE
+#define TASK_F_RECLASS     (1 << 3)  // LAST RUN LEFT THE runtime_dev BAND
+#define TASK_F_PERIODIC    (1 << 4)  // task_periodic() WITH --periodic-deadline
+
 struct {
 	__uint(type, BPF_MAP_TYPE_TASK_STORAGE);
 	__uint(map_flags, BPF_F_NO_PREALLOC);
@@ -244,8 +575,201 @@ static __always_inline struct pandemonium_stats *get_stats(void)
 
 static __always_inline struct tuning_knobs *get_knobs(void)
 {
-	u32 zero = 0;
-	return bpf_map_lookup_elem(&tuning_knobs_map, &zero);
+	u32 slot = (u32)(READ_ONCE(knob_gen) % KNOB_SLOTS);
+	return bpf_map_lookup_elem(&tuning_knobs_map, &slot);
+}
+
+// THIS CPU'S COUNTERS FOR THE LIVE GENERATION, RESET ON FIRST SIGHT OF IT
+static __always_inline struct knob_gen_stats *get_knob_gen_stats(void)
+{
+	u64 gen = READ_ONCE(knob_gen);
+	u32 slot = (u32)(gen % KNOB_SLOTS);
+	struct knob_gen_stats *ks = bpf_map_lookup_elem(&knob_gen_stats, &slot);
+	if (ks && ks->gen != gen) {
+		__builtin_memset(ks, 0, sizeof(*ks));
+		ks->gen = gen;
+	}
+	return ks;
+}
+
+// NODE OF A CPU, CLAMPED TO A VALID node_state / DSQ INDEX
+static __always_inline s32 cpu_node(s32 cpu)
+{
+	s32 node = __COMPAT_scx_bpf_cpu_node(cpu);
+	if (node < 0 || (u32)node >= nr_nodes)
+		node = 0;
+	return node;
+}
+
+// MASK FOR VERIFIER SAFETY: node IS ALREADY < nr_nodes <= MAX_NODES
+static __always_inline struct node_state *get_node_state(s32 node)
+{
+	return &node_state[(u32)node & (MAX_NODES - 1)];
+}
+
+// PER-CPU SOJOURN STAMP FOR THE ACTIVE LAYOUT
+static __always_inline u64 *pcpu_stamp(u32 cpu)
+{
+	cpu &= MAX_CPUS - 1;
+	if (pcpu_padded)
+		return &pcpu_state[cpu].enqueue_ns;
+	return &pcpu_enqueue_ns[cpu];
+}
+
+// PADDED LAYOUT ONLY: RECORD DEPTH + REFILL TIME NEXT TO THE STAMP.
+// PACKED LAYOUT HAS NO SLOT FOR THEM AND SKIPS THE WRITE.
+static __always_inline void pcpu_note_insert(u32 cpu, u32 depth)
+{
+	if (!pcpu_padded)
+		return;
+	pcpu_state[cpu & (MAX_CPUS - 1)].depth = depth;
+}
+
+static __always_inline void pcpu_note_drain(u32 cpu, u64 now)
+{
+	if (!pcpu_padded)
+		return;
+	struct pcpu_state *pc = &pcpu_state[cpu & (MAX_CPUS - 1)];
+	pc->last_refill_ns = now;
+	pc->depth = (u32)scx_bpf_dsq_nr_queued((u64)cpu);
+}
+
+// DEPTH GATE FOR cpu's DSQ: RUST'S PER-CPU CHOICE, ELSE THE SCALED BASE
+static __always_inline u32 pcpu_depth_gate(u32 cpu)
+{
+	u32 d = READ_ONCE(pcpu_depth_ctl[cpu & (MAX_CPUS - 1)].depth);
+	if (d == 0 || d > PCPU_DEPTH_MAX)
+		d = (u32)READ_ONCE(scale_knobs.pcpu_depth_base);
+	return d;
+}
+
+static __always_inline struct pcpu_depth *pcpu_depth_of(u32 cpu)
+{
+	return &pcpu_depth_ctl[cpu & (MAX_CPUS - 1)];
+}
+
+static __always_inline struct node_backlog *backlog_of(u32 cpu)
+{
+	return &node_backlog[(u32)cpu_node((s32)cpu) & (MAX_NODES - 1)];
+}
+
+static __always_inline u64 *backlog_word(u32 cpu)
+{
+	return &backlog_of(cpu)->bits[(cpu >> 6) & (BACKLOG_WORDS - 1)];
+}
+
+static __always_inline bool pcpu_backlogged(u32 cpu)
+{
+	return READ_ONCE(*backlog_word(cpu)) & (1ULL << (cpu & 63));
+}
+
+// TEST BEFORE THE ATOMIC: REPEAT INSERTS ON A BACKLOGGED CPU STAY READ-ONLY.
+// CPU BIT FIRST, THEN ITS WORD'S SUMMARY BIT: A CLEARER DROPS THE SUMMARY
+// BIT AND THEN RE-READS THE WORD, SO A SET CPU BIT IS NEVER LEFT BEHIND A
+// CLEAR SUMMARY BIT.
+static __always_inline void pcpu_backlog_set(u32 cpu)
+{
+	struct node_backlog *nb = backlog_of(cpu);
+	u64 *w = &nb->bits[(cpu >> 6) & (BACKLOG_WORDS - 1)];
+	u64 bit = 1ULL << (cpu & 63);
+	u64 sbit = 1ULL << ((cpu >> 6) & 63);
+	if (!(READ_ONCE(*w) & bit))
+		__sync_fetch_and_or(w, bit);
+	if (!(READ_ONCE(nb->summary) & sbit))
+		__sync_fetch_and_or(&nb->summary, sbit);
+}
+
+// CLEAR, THEN RE-CHECK: AN INSERT THAT RACED OUR EMPTY CHECK SAW THE BIT
+// STILL SET AND SKIPPED IT, SO PUT IT BACK. THE LAST BIT OUT OF A WORD
+// DROPS THE SUMMARY BIT, AND A WORD REFILLED MEANWHILE RESTORES IT.
+static __always_inline void pcpu_backlog_clear(u32 cpu)
+{
+	struct node_backlog *nb = backlog_of(cpu);
+	u64 *w = &nb->bits[(cpu >> 6) & (BACKLOG_WORDS - 1)];
+	u64 bit = 1ULL << (cpu & 63);
+	u64 sbit = 1ULL << ((cpu >> 6) & 63);
+	if (!(READ_ONCE(*w) & bit))
+		return;
+	if ((__sync_fetch_and_and(w, ~bit) & ~bit) == 0) {
+		__sync_fetch_and_and(&nb->summary, ~sbit);
+		if (READ_ONCE(*w))
+			__sync_fetch_and_or(&nb->summary, sbit);
+	}
+	if (scx_bpf_dsq_nr_queued((u64)cpu) != 0)
+		pcpu_backlog_set(cpu);
+}
+
+// CLEAR A PER-CPU SOJOURN STAMP (AND BACKLOG BIT) ONCE THE DSQ HAS DRAINED
+static __always_inline void pcpu_clear_if_empty(u32 cpu)
+{
+	if (scx_bpf_dsq_nr_queued((u64)cpu) != 0)
+		return;
+	pcpu_backlog_clear(cpu);
+	u64 *stamp = pcpu_stamp(cpu);
+	u64 old = *stamp;
+	if (old > 0)
+		__sync_val_compare_and_swap(stamp, old, 0);
+}
+
+// ONLINE CPUs ON THIS NODE FOR THRESHOLDS. FALLS BACK TO THE ONLINE COUNT
+// SPREAD EVENLY ACROSS NODES IF THE NODE COUNT IS NOT SET
+static __always_inline u64 node_nr_cpus(struct node_state *ns)
+{
+	u64 n = READ_ONCE(ns->nr_cpus);
+	if (!n)
+		n = READ_ONCE(nr_online_cpus) / nr_nodes;
+	return n ? n : 1;
+}
+
+// DRR BUDGET FOR ONE NODE. interactive_run IS COUNTED PER NODE, SO THE
+// MACHINE-WIDE scale_knobs BUDGET IS CUT TO THE NODE'S SHARE OF THE ONLINE
+// CPUs. LONGRUN: ONE INTERACTIVE DISPATCH PER NODE CPU.
+static __always_inline u64 node_budget(struct node_state *ns)
+{
+	u64 cpus = node_nr_cpus(ns);
+	if (ns->longrun_mode)
+		return cpus;
+
+	u64 budget = READ_ONCE(scale_knobs.interactive_budget);
+	u64 online = READ_ONCE(nr_online_cpus);
+	if (nr_nodes > 1 && online > cpus) {
+		budget = budget * cpus / online;
+		if (budget < 2)
+			budget = 2;
+	}
+	return budget;
+}
+
+static __always_inline struct node_burst *get_node_burst(s32 node)
+{
+	return &node_burst[(u32)node & (MAX_NODES - 1)];
+}
+
+static __always_inline void burst_flush(u32 cpu, struct pcpu_burst *pb)
+{
+	struct node_burst *nb = get_node_burst(cpu_node((s32)cpu));
+
+	if (pb->enq) {
+		__sync_fetch_and_add(&nb->enq, pb->enq);
+		pb->enq = 0;
+	}
+	if (pb->wake) {
+		__sync_fetch_and_add(&nb->wake, pb->wake);
+		pb->wake = 0;
+	}
+}
+
+// ENQUEUE SIDE: CPU-LOCAL UNTIL A BATCH FILLS (wake <= enq, ONE CHECK)
+static __always_inline void burst_count(bool is_wakeup)
+{
+	u32 cpu = bpf_get_smp_processor_id() & (MAX_CPUS - 1);
+	struct pcpu_burst *pb = &pcpu_burst[cpu];
+
+	pb->enq += 1;
+	if (is_wakeup)
+		pb->wake += 1;
+	if (pb->enq >= BURST_FLUSH_BATCH)
+		burst_flush(cpu, pb);
 }
 
 static __always_inline struct task_ctx *lookup_task_ctx(const struct task_struct *p)
@@ -261,6 +785,296 @@ static __always_inline struct task_ctx *ensure_task_ctx(struct task_struct *p)
 				    BPF_LOCAL_STORAGE_GET_F_CREATE);
 }
 
+// CGROUP ID OF A TASK ON THE DEFAULT HIERARCHY (kernfs NODE ID)
+static __always_inline u64 task_cgid(struct task_struct *p)
+{
+	struct cgroup *cg = scx_bpf_task_cgroup(p);
+	u64 id = 0;
+
+	if (cg) {
+		id = cg->kn->id;
+		bpf_cgroup_release(cg);
+	}
+	return id;
+}
+
+static __always_inline struct cgrp_stats *get_cgrp_stats(u64 cgid)
+{
+	struct cgrp_stats *cs;
+
+	if (!cgid)
+		return NULL;
+	cs = bpf_map_lookup_elem(&cgrp_stats_map, &cgid);
+	if (cs)
+		return cs;
+	bpf_map_update_elem(&cgrp_stats_map, &cgid, &cgrp_stats_zero, BPF_NOEXIST);
+	return bpf_map_lookup_elem(&cgrp_stats_map, &cgid);
+}
+
+static __always_inline void mark_rescued(s32 cpu)
+{
+	if ((u32)cpu < MAX_CPUS)
+		cpu_rescued[cpu] = 1;
+}
+
+// MONOTONIC VTIME CLOCK: ADVANCE *clock TO v, BOUNDED CAS RETRIES
+static __always_inline void advance_vtime(u64 *clock, u64 v)
+{
+	u64 cur = *clock;
+	for (int i = 0; i < 4; i++) {
+		if (!time_before(cur, v))
+			break;
+		if (__sync_bool_compare_and_swap(clock, cur, v))
+			break;
+		cur = *clock;
+	}
+}
+
+static __always_inline struct cgrp_ctx *lookup_cgrp_ctx(u64 cgid)
+{
+	if (!cgid)
+		return NULL;
+	return bpf_map_lookup_elem(&cgrp_ctx_map, &cgid);
+}
+
+// A CGROUP COMPETES FOR ITS PARENT'S SHARE WHILE IT HAS RUNNABLE TASKS OR
+// ACTIVE CHILDREN. CARRY A 0->1 (on) OR 1->0 (!on) TRANSITION UP THE
+// HIERARCHY, STOPPING AT THE FIRST ANCESTOR WHOSE STATE DID NOT FLIP.
+static __always_inline void cgrp_propagate(struct cgrp_ctx *cgc, bool on)
+{
+	for (int i = 0; i < CGRP_MAX_DEPTH; i++) {
+		struct cgrp_ctx *pc = lookup_cgrp_ctx(cgc->parent);
+		u32 was;
+
+		if (!pc)
+			break;
+		if (on) {
+			__sync_fetch_and_add(&pc->child_wsum, cgc->weight);
+			was = __sync_fetch_and_add(&pc->nr_active_children, 1);
+			if (was != 0 || pc->nr_tasks)
+				break;
+		} else {
+			if (!pc->nr_active_children)
+				break;
+			__sync_fetch_and_sub(&pc->child_wsum, cgc->weight);
+			was = __sync_fetch_and_sub(&pc->nr_active_children, 1);
+			if (was != 1 || pc->nr_tasks)
+				break;
+		}
+		cgc = pc;
+	}
+	__sync_fetch_and_add(&cgrp_hweight_gen, 1);
+}
+
+// TASK BECOMES RUNNABLE: ADD ITS WEIGHT TO ITS CGROUP AND THE GLOBAL SUM.
+// cg_queued: 1 = GLOBAL SUM ONLY, 2 = ALSO ITS CGROUP'S task_wsum.
+// A CGROUP WAKING FROM IDLE RE-ENTERS AT MOST LAG_CAP_NS BEHIND vtime_now,
+// SO AN IDLE TENANT CANNOT BANK UNBOUNDED CREDIT.
+static __always_inline void cgrp_task_join(struct task_ctx *tctx, u32 weight)
+{
+	struct cgrp_ctx *cgc;
+
+	tctx->cg_queued = 1;
+	tctx->cg_weight = weight;
+	__sync_fetch_and_add(&cgrp_task_wsum, weight);
+
+	cgc = lookup_cgrp_ctx(tctx->cgid);
+	if (!cgc)
+		return;
+	tctx->cg_queued = 2;
+	__sync_fetch_and_add(&cgc->task_wsum, weight);
+	if (__sync_fetch_and_add(&cgc->nr_tasks, 1) != 0)
+		return;
+
+	u64 floor = vtime_now - LAG_CAP_NS;
+	if (time_before(cgc->vtime, floor))
+		cgc->vtime = floor;
+	if (!cgc->nr_active_children)
+		cgrp_propagate(cgc, true);
+}
+
+static __always_inline void cgrp_task_leave(struct task_ctx *tctx)
+{
+	struct cgrp_ctx *cgc;
+	u8 queued = tctx->cg_queued;
+
+	if (!queued)
+		return;
+	tctx->cg_queued = 0;
+	__sync_fetch_and_sub(&cgrp_task_wsum, tctx->cg_weight);
+
+	cgc = lookup_cgrp_ctx(tctx->cgid);
+	if (queued < 2 || !cgc)
+		return;
+	__sync_fetch_and_sub(&cgc->task_wsum, tctx->cg_weight);
+	if (__sync_fetch_and_sub(&cgc->nr_tasks, 1) != 1)
+		return;
+	if (!cgc->nr_active_children)
+		cgrp_propagate(cgc, false);
+}
+
+// SHARE OF THE MACHINE FOR A CGROUP'S TASKS: THE PRODUCT OF
+// weight / ACTIVE SIBLING weight UP THE HIERARCHY. CACHED UNTIL AN
+// ACTIVATION OR WEIGHT CHANGE BUMPS cgrp_hweight_gen. ANCESTORS BEYOND
+// CGRP_MAX_DEPTH COUNT AS THE WHOLE MACHINE.
+static __always_inline u32 cgrp_hweight(struct cgrp_ctx *cgc)
+{
+	u64 gen = cgrp_hweight_gen;
+	if (cgc->hweight && cgc->hweight_gen == gen)
+		return cgc->hweight;
+
+	u64 hw = CGRP_HWEIGHT_ONE;
+	struct cgrp_ctx *cur = cgc;
+	for (int i = 0; i < CGRP_MAX_DEPTH; i++) {
+		struct cgrp_ctx *pc = lookup_cgrp_ctx(cur->parent);
+		if (!pc)
+			break;
+		if (pc->child_wsum > cur->weight)
+			hw = hw * cur->weight / pc->child_wsum;
+		cur = pc;
+	}
+	if (hw < 1)
+		hw = 1;
+	cgc->hweight = (u32)hw;
+	cgc->hweight_gen = gen;
+	return (u32)hw;
+}
+
+// FAIR-SHARE CHARGE. WITH PER-TASK FAIRNESS A CGROUP WOULD GET
+// task_wsum / cgrp_task_wsum OF THE MACHINE; cpu.weight ENTITLES IT TO
+// hweight. SCALING ITS TASKS' CHARGE BY THE RATIO ADVANCES THEIR VTIME AS
+// IF THE CGROUP RECEIVED ITS ENTITLEMENT: 500 THREADS IN ONE CGROUP AND 4
+// IN ANOTHER SPLIT THE MACHINE BY cpu.weight, NOT 500:4. THE FACTOR IS
+// UNIFORM ACROSS A CGROUP, SO TIER ORDERING INSIDE IT IS UNCHANGED.
+// ROOT-CGROUP TASKS (MOSTLY KERNEL THREADS) COMPETE PER TASK, AS UNDER CFS.
+static __always_inline u64 cgrp_scale_charge(struct cgrp_ctx *cgc, u64 delta)
+{
+	u64 total = cgrp_task_wsum;
+	u64 mine = cgc->task_wsum;
+
+	if (!cgc->parent || !total || !mine)
+		return delta;
+	if (mine > total)
+		mine = total;
+	return delta * mine / total * CGRP_HWEIGHT_ONE / cgrp_hweight(cgc);
+}
+
+// VTIME ANCHOR FOR THE LAG FLOOR AND BATCH CEILING: THE TASK'S CGROUP
+// VTIME, OR vtime_now FOR ROOT-CGROUP AND UNTRACKED TASKS
+static __always_inline u64 task_vtime_base(const struct task_ctx *tctx)
+{
+	struct cgrp_ctx *cgc = lookup_cgrp_ctx(tctx->cgid);
+
+	if (!cgc || !cgc->parent)
+		return vtime_now;
+	return cgc->vtime;
+}
+
+// EXECUTABLE IDENTITY FOR THE PROCDB KEY: (s_dev, i_ino) OF THE TASK'S
+// exe_file, MIXED TO 64 BITS. SEPARATES THE "java" OF ONE SERVICE FROM
+// ANOTHER'S AND python3 WORKERS FROM EACH OTHER WHEN THEIR BINARIES
+// DIFFER. 0 FOR KERNEL THREADS AND TASKS PAST exit_mm().
+static __always_inline u64 task_exe_id(const struct task_struct *p)
+{
+	struct mm_struct *mm = p->mm;
+	struct file *exe;
+	struct inode *inode;
+
+	if (!mm || (p->flags & PF_KTHREAD))
+		return 0;
+	exe = mm->exe_file;
+	if (!exe)
+		return 0;
+	inode = exe->f_inode;
+	if (!inode)
+		return 0;
+
+	u64 id = ((u64)inode->i_ino * 0x9E3779B97F4A7C15ULL) ^ (u64)inode->i_sb->s_dev;
+	return id ? id : 1;
+}
+
+static __always_inline void task_class_key_of(struct task_struct *p,
+					      const struct task_ctx *tctx,
+					      struct task_class_key *key)
+{
+	key->exe_id = task_exe_id(p);
+	key->cgid = procdb_cgroup_key ? tctx->cgid : 0;
+	__builtin_memcpy(key->comm, p->comm, 16);
+}
+
+// PUSH ONE EVENT TO THE RINGBUF. wake = false FOR EVENTS NOTHING WAITS ON.
+static __always_inline void emit_event(u32 kind, s32 cpu, u32 pid, s32 node,
+				       u8 state, u8 prev_state, u64 value,
+				       bool wake)
+{
+	struct pand_event *e = bpf_ringbuf_reserve(&events, sizeof(*e), 0);
+	if (!e) {
+		struct pandemonium_stats *s = get_stats();
+		if (s)
+			s->nr_events_dropped += 1;
+		return;
+	}
+	e->ts_ns = bpf_ktime_get_ns();
+	e->value = value;
+	e->kind = kind;
+	e->cpu = cpu;
+	e->pid = pid;
+	e->node = (u16)node;
+	e->state = state;
+	e->prev_state = prev_state;
+	bpf_ringbuf_submit(e, wake ? 0 : BPF_RB_NO_WAKEUP);
+}
+
+// SCHEDULING TRACE
+
+static __always_inline bool trace_match(const struct task_struct *p,
+					const struct task_ctx *tctx)
+{
+	u32 pid = trace_ctl.pid;
+	u64 cgid = trace_ctl.cgid;
+	unsigned int i;
+
+	if (pid && (u32)p->tgid != pid)
+		return false;
+	if (cgid && (!tctx || tctx->cgid != cgid))
+		return false;
+	for (i = 0; i < 16 && trace_ctl.comm[i]; i++)
+		if (p->comm[i] != trace_ctl.comm[i])
+			return false;
+	return true;
+}
+
+static __always_inline void trace_sched(const struct task_struct *p,
+					const struct task_ctx *tctx, u8 path,
+					s32 cpu, u64 dsq, u64 lat_ns)
+{
+	u32 sample = READ_ONCE(trace_ctl.sample);
+	if (!sample)
+		return;
+	if (!trace_match(p, tctx))
+		return;
+	if (sample > 1 && bpf_get_prandom_u32() % sample)
+		return;
+
+	struct pand_trace *r = bpf_ringbuf_reserve(&trace_rb, sizeof(*r), 0);
+	if (!r) {
+		struct pandemonium_stats *s = get_stats();
+		if (s)
+			s->nr_trace_dropped += 1;
+		return;
+	}
+	r->ts_ns = bpf_ktime_get_ns();
+	r->lat_ns = lat_ns;
+	r->dsq = dsq;
+	r->pid = (u32)p->pid;
+	r->cpu = cpu;
+	r->path = path;
+	r->tier = tctx ? (u8)tctx->tier : TRACE_TIER_NONE;
+	r->wake_path = tctx ? tctx->dispatch_path : 0;
+	__builtin_memset(r->_pad, 0, sizeof(r->_pad));
+	bpf_ringbuf_submit(r, BPF_RB_NO_WAKEUP);
+}
+
 // L2 CACHE AFFINITY INSTRUMENTATION
 // COMPARE SELECTED CPU'S L2 DOMAIN WITH TASK'S LAST_CPU DOMAIN.
 // INCREMENT PER-TIER HIT/MISS COUNTERS. CALLED FROM select_cpu() AND enqueue().
@@ -287,49 +1101,397 @@ static __always_inline void count_l2_affinity(struct pandemonium_stats *s,
 	}
 }
 
-// L2 CACHE PLACEMENT: FIND IDLE SIBLING IN SAME L2 DOMAIN
-// BOUNDED LOOP (MAX 8 ITERATIONS), VERIFIER-SAFE.
+// L2 CACHE PLACEMENT: FIND IDLE SIBLING IN anchor's L2 DOMAIN
+// (THE TASK'S last_cpu, OR ITS WAKER'S CPU FOR A PAIR).
+// BOUNDED LOOP (l2_stride, AT MOST MAX_L2_SIBLINGS), VERIFIER-SAFE.
 // RETURNS IDLE CPU IN SAME L2 GROUP, OR -1 IF NONE FOUND.
 
-static __always_inline s32 find_idle_l2_sibling(const struct task_ctx *tctx)
+static __always_inline s32 find_idle_l2_sibling(struct task_struct *p,
+						s32 anchor)
 {
-	if (tctx->last_cpu < 0)
+	if (anchor < 0)
 		return -1;
 
-	u32 lcpu = (u32)tctx->last_cpu;
+	u32 lcpu = (u32)anchor;
 	u32 *group = bpf_map_lookup_elem(&cache_domain, &lcpu);
 	if (!group)
 		return -1;
 
-	u32 base = *group * MAX_L2_SIBLINGS;
+	u32 base = *group * l2_stride;
 	for (int i = 0; i < MAX_L2_SIBLINGS; i++) {
+		if (i >= l2_stride)
+			break;
 		u32 key = base + i;
 		u32 *val = bpf_map_lookup_elem(&l2_siblings, &key);
 		if (!val || *val == (u32)-1)
 			break;
 		s32 cpu = (s32)*val;
+		if (!bpf_cpumask_test_cpu((u32)cpu, p->cpus_ptr))
+			continue;
 		if (scx_bpf_test_and_clear_cpu_idle(cpu))
 			return cpu;
 	}
 	return -1;
 }
 
-// HISTOGRAM BUCKETING: MATCHES HIST_EDGES_NS AND SLEEP_EDGES_NS IN RUST
+// L3 CACHE PLACEMENT: FIND IDLE CPU IN anchor's L3/CCX, OUTSIDE ITS L2.
+// RUNS AFTER find_idle_l2_sibling() FAILS, SO SAME-L2 CPUs ARE SKIPPED.
+// BOUNDED LOOP (l3_stride, AT MOST MAX_L3_SIBLINGS). RETURNS -1 IF NONE FOUND.
+static __always_inline s32 find_idle_l3_sibling(struct task_struct *p,
+						s32 anchor)
+{
+	if (anchor < 0)
+		return -1;
+
+	u32 lcpu = (u32)anchor;
+	struct cpu_topo *t = bpf_map_lookup_elem(&cpu_topo_map, &lcpu);
+	if (!t || t->l3_group >= nr_l3_rows)
+		return -1;
+
+	u32 my_l2 = t->l2_group;
+	u32 base = t->l3_group * l3_stride;
+	for (int i = 0; i < MAX_L3_SIBLINGS; i++) {
+		if (i >= l3_stride)
+			break;
+		u32 key = base + i;
+		u32 *val = bpf_map_lookup_elem(&l3_siblings, &key);
+		if (!val || *val == (u32)-1)
+			break;
+		u32 sib = *val;
+		if (sib >= nr_cpu_ids)
+			continue;
+		u32 *sib_l2 = bpf_map_lookup_elem(&cache_domain, &sib);
+		if (sib_l2 && *sib_l2 == my_l2)
+			continue;
+		if (!bpf_cpumask_test_cpu(sib, p->cpus_ptr))
+			continue;
+		if (scx_bpf_test_and_clear_cpu_idle((s32)sib))
+			return (s32)sib;
+	}
+	return -1;
+}
+
+// HYBRID PLACEMENT: LAT_CRITICAL PREFERS P-CORES, BATCH PREFERS E-CORES.
+// NO-OP ON UNIFORM SYSTEMS (RUST ONLY PUBLISHES THE LISTS WHEN HYBRID).
+// BOUNDED LOOP (MAX_CORE_TYPE_SCAN). RETURNS -1 IF NONE FOUND.
+static __always_inline s32 find_idle_core_type(struct task_struct *p,
+					       const struct task_ctx *tctx)
+{
+	u32 row;
+	if (tctx->tier == TIER_LAT_CRITICAL)
+		row = 0;
+	else if (tctx->tier == TIER_BATCH)
+		row = 1;
+	else
+		return -1;
+
+	u32 lcpu = tctx->last_cpu >= 0 ? (u32)tctx->last_cpu : 0;
+	struct cpu_topo *t = bpf_map_lookup_elem(&cpu_topo_map, &lcpu);
+	if (!t || t->core_type == CORE_TYPE_UNIFORM)
+		return -1;
+
+	u32 base = row * (u32)nr_cpu_ids;
+	for (int i = 0; i < MAX_CORE_TYPE_SCAN; i++) {
+		u32 key = base + i;
+		u32 *val = bpf_map_lookup_elem(&core_type_cpus, &key);
+		if (!val || *val == (u32)-1)
+			break;
+		u32 c = *val;
+		if (c >= nr_cpu_ids || !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		if (scx_bpf_test_and_clear_cpu_idle((s32)c))
+			return (s32)c;
+	}
+	return -1;
+}
+
+// SMT PLACEMENT (tuning_knobs.smt_mode)
+// NON-BATCH + SMT_IDLE_CORE: prev_cpu IF ITS WHOLE CORE IS IDLE, ELSE ANY
+// FULLY IDLE CORE ON THE NODE. KEEPS LAT_CRITICAL OFF A BUSY HYPERTHREAD.
+// BATCH + SMT_BATCH_PACK: AN IDLE THREAD OF prev_cpu's CORE WHOSE SIBLING
+// IS BUSY (IN THE IDLE MASK, NOT IN THE IDLE-SMT MASK), LEAVING WHOLE
+// CORES FREE FOR THE TIERS ABOVE. BOUNDED LOOP (1 + MAX_SMT_SIBLINGS).
+// RETURNS A CLAIMED IDLE CPU, OR -1 TO FALL THROUGH TO NORMAL PLACEMENT.
+static __always_inline s32 pick_smt_cpu(struct task_struct *p,
+					const struct task_ctx *tctx,
+					const struct tuning_knobs *knobs,
+					s32 prev_cpu, s32 node)
+{
+	if (!knobs || !knobs->smt_mode || (p->flags & PF_KTHREAD))
+		return -1;
+
+	struct pandemonium_stats *s;
+	s32 cpu = -1;
+
+	if (tctx->tier != TIER_BATCH) {
+		if (!(knobs->smt_mode & SMT_IDLE_CORE))
+			return -1;
+
+		// SCX_OPS_BUILTIN_IDLE_PER_NODE REJECTS THE GLOBAL IDLE MASKS:
+		// READ prev_cpu's NODE MASK INSTEAD
+		if (prev_cpu >= 0 && (u64)prev_cpu < nr_cpu_ids) {
+			const struct cpumask *smt =
+				__COMPAT_scx_bpf_get_idle_smtmask_node(cpu_node(prev_cpu));
+			if (bpf_cpumask_test_cpu(prev_cpu, smt) &&
+			    bpf_cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
+			    scx_bpf_test_and_clear_cpu_idle(prev_cpu))
+				cpu = prev_cpu;
+			scx_bpf_put_idle_cpumask(smt);
+		}
+
+		if (cpu < 0)
+			cpu = __COMPAT_scx_bpf_pick_idle_cpu_node(
+				p->cpus_ptr, node, SCX_PICK_IDLE_CORE);
+
+		s = get_stats();
+		if (s) {
+			if (cpu >= 0) s->nr_smt_core_hit += 1;
+			else          s->nr_smt_core_miss += 1;
+		}
+		return cpu;
+	}
+
+	if (!(knobs->smt_mode & SMT_BATCH_PACK) || prev_cpu < 0)
+		return -1;
+
+	u32 pcpu = (u32)prev_cpu;
+	struct cpu_topo *t = bpf_map_lookup_elem(&cpu_topo_map, &pcpu);
+	if (!t || t->nr_smt == 0)
+		return -1;
+
+	// SMT SIBLINGS SHARE prev_cpu's NODE
+	s32 pnode = cpu_node(prev_cpu);
+	const struct cpumask *idle = __COMPAT_scx_bpf_get_idle_cpumask_node(pnode);
+	const struct cpumask *smt = __COMPAT_scx_bpf_get_idle_smtmask_node(pnode);
+	for (int i = 0; i <= MAX_SMT_SIBLINGS; i++) {
+		if (i > t->nr_smt)
+			break;
+		u32 c = i == 0 ? pcpu : t->smt[(i - 1) & (MAX_SMT_SIBLINGS - 1)];
+		if (c >= nr_cpu_ids)
+			continue;
+		if (!bpf_cpumask_test_cpu(c, idle) ||
+		    bpf_cpumask_test_cpu(c, smt) ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		if (scx_bpf_test_and_clear_cpu_idle((s32)c)) {
+			cpu = (s32)c;
+			break;
+		}
+	}
+	scx_bpf_put_idle_cpumask(smt);
+	scx_bpf_put_idle_cpumask(idle);
+
+	s = get_stats();
+	if (s) {
+		if (cpu >= 0) s->nr_smt_pack_hit += 1;
+		else          s->nr_smt_pack_miss += 1;
+	}
+	return cpu;
+}
+
+// WAKER/WAKEE PAIRS: COUNT CONSECUTIVE WAKEUPS OF p BY THE SAME current.
+// AN IRQ-CONTEXT WAKEUP SEES THE INTERRUPTED TASK AS current; IT CARRIES NO
+// SCX_WAKE_SYNC, SO AT WORST IT STEERS TOWARD AN IDLE CPU NEAR THAT TASK.
+static __always_inline bool pair_track_waker(struct task_struct *p,
+					     struct task_ctx *tctx)
+{
+	struct task_struct *waker = bpf_get_current_task_btf();
+	u32 wpid = (u32)waker->pid;
+
+	if (!wpid || wpid == (u32)p->pid) {
+		tctx->waker_pid = 0;
+		tctx->waker_streak = 0;
+		return false;
+	}
+	if (wpid != tctx->waker_pid) {
+		tctx->waker_pid = wpid;
+		tctx->waker_streak = 1;
+	} else if (tctx->waker_streak < PAIR_STREAK_MIN) {
+		tctx->waker_streak += 1;
+	}
+	return tctx->waker_streak >= PAIR_STREAK_MIN;
+}
+
+// PAIR PLACEMENT FOR A STABLE, SHORT-RUNNING WAKEE: AN IDLE CPU IN THE
+// WAKER'S L2, THEN ITS L3. FAILING THAT, A SYNC WAKEUP HANDS OFF TO THE
+// WAKER'S OWN CPU WHEN NOTHING IS QUEUED THERE: THE WAKER IS ABOUT TO
+// BLOCK ON THE ANSWER, AND THE WAKEE READS WHAT IT JUST WROTE.
+// *sync IS SET FOR THE HANDOFF, WHERE THE RETURNED CPU IS BUSY.
+// GATED ON --pair-affinity ALONE: THE REGIME'S affinity_mode GOVERNS
+// prev_cpu AFFINITY, NOT A PLACEMENT THE USER ASKED FOR EXPLICITLY.
+static __always_inline s32 pick_pair_cpu(struct task_struct *p,
+					 const struct task_ctx *tctx,
+					 u64 wake_flags, bool *sync)
+{
+	if ((tctx->policy & TASK_F_KTHREAD) ||
+	    tctx->avg_runtime >= PAIR_RUNTIME_MAX_NS)
+		return -1;
+
+	s32 waker_cpu = (s32)bpf_get_smp_processor_id();
+	s32 cpu = find_idle_l2_sibling(p, waker_cpu);
+	if (cpu < 0)
+		cpu = find_idle_l3_sibling(p, waker_cpu);
+	if (cpu >= 0)
+		return cpu;
+
+	if ((wake_flags & SCX_WAKE_SYNC) && (u64)waker_cpu < nr_cpu_ids &&
+	    bpf_cpumask_test_cpu((u32)waker_cpu, p->cpus_ptr) &&
+	    scx_bpf_dsq_nr_queued((u64)waker_cpu) == 0) {
+		*sync = true;
+		return waker_cpu;
+	}
+	return -1;
+}
+
+// ESTIMATED EXIT LATENCY OF AN IDLE CPU: THE DEEPEST ENABLED cpuidle
+// STATE WHOSE TARGET RESIDENCY IS SHORTER THAN THE TIME IT HAS BEEN IDLE.
+// menu/teo PICK BY PREDICTED SLEEP, AND A CPU THAT STAYS IDLE IS PROMOTED
+// DEEPER ON ITS NEXT TIMER, SO ELAPSED IDLE TIME TRACKS DEPTH. RETURNS
+// (u32)-1 FOR A BUSY CPU, OR AN IDLE ONE OF UNKNOWN DEPTH PAST
+// IDLE_SHALLOW_NS. BOUNDED LOOP (MAX_CSTATES).
+static __always_inline u32 idle_exit_ns(u32 cpu, u64 now)
+{
+	if (cpu >= MAX_CPUS)
+		return (u32)-1;
+	u64 since = cpu_idle_since[cpu];
+	if (!since)
+		return (u32)-1;
+	u64 idle_for = now > since ? now - since : 0;
+
+	struct cpu_topo *t = bpf_map_lookup_elem(&cpu_topo_map, &cpu);
+	if (!t || t->nr_cstates == 0)
+		return idle_for < IDLE_SHALLOW_NS ? 0 : (u32)-1;
+
+	u32 lat = 0;
+	for (int i = 0; i < MAX_CSTATES; i++) {
+		if (i >= t->nr_cstates || idle_for < t->cst_target_ns[i])
+			break;
+		lat = t->cst_exit_ns[i];
+	}
+	return lat;
+}
+
+// IDLE-STATE PLACEMENT (--idle-aware): WALK THE NODE'S RECENTLY IDLED
+// CPUs, NEWEST FIRST, AND CLAIM THE FIRST ONE THAT SUITS THE TIER.
+// LAT_CRITICAL/INTERACTIVE: ESTIMATED EXIT LATENCY <= IDLE_EXIT_MAX_NS.
+// BATCH: IDLE UNDER IDLE_WARM_NS AND, WHERE THE KERNEL EXPOSES IT,
+// scx_bpf_cpuperf_cur() >= IDLE_WARM_PERF. BOUNDED LOOP (IDLE_RING_SLOTS).
+// RETURNS A CLAIMED IDLE CPU, OR -1 TO FALL THROUGH TO THE BLIND PICKS.
+static __always_inline s32 pick_recent_idle_cpu(struct task_struct *p,
+						const struct task_ctx *tctx,
+						s32 node)
+{
+	if (!idle_aware || (p->flags & PF_KTHREAD) ||
+	    node < 0 || node >= MAX_NODES)
+		return -1;
+
+	struct idle_ring *r = &idle_ring[node];
+	bool batch = tctx->tier == TIER_BATCH;
+	bool perf = batch && bpf_ksym_exists(scx_bpf_cpuperf_cur);
+	u64 now = bpf_ktime_get_ns();
+	u32 head = r->head;
+	s32 cpu = -1;
+
+	for (int i = 0; i < IDLE_RING_SLOTS; i++) {
+		u32 c = r->cpu[(head - 1 - i) & (IDLE_RING_SLOTS - 1)];
+		if (c >= nr_cpu_ids || c >= MAX_CPUS ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		if (batch) {
+			u64 since = cpu_idle_since[c];
+			if (!since || now - since >= IDLE_WARM_NS)
+				continue;
+			if (perf && scx_bpf_cpuperf_cur((s32)c) < IDLE_WARM_PERF)
+				continue;
+		} else if (idle_exit_ns(c, now) > IDLE_EXIT_MAX_NS) {
+			continue;
+		}
+		if (scx_bpf_test_and_clear_cpu_idle((s32)c)) {
+			cpu = (s32)c;
+			break;
+		}
+	}
+
+	struct pandemonium_stats *s = get_stats();
+	if (s && cpu >= 0) {
+		if (batch) s->nr_idle_warm += 1;
+		else       s->nr_idle_shallow += 1;
+	}
+	return cpu;
+}
+
+// NUMA COST MODEL: SLIT DISTANCES (LOCAL = 10)
+// CLASSES: NEAR (SAME PACKAGE), MID (ONE HOP), FAR (MULTI-HOP)
+#define XNODE_DIST_LOCAL   10
+#define XNODE_NEAR_MAX     15
+#define XNODE_MID_MAX      25
+#define XNODE_SOJOURN_UNIT_NS 250000ULL  // 250US PER DISTANCE UNIT ABOVE LOCAL
+
+static __always_inline u32 xnode_class(u32 dist)
+{
+	if (dist <= XNODE_NEAR_MAX)
+		return 0;
+	if (dist <= XNODE_MID_MAX)
+		return 1;
+	return 2;
+}
+
+// MIGRATION COST GATE: A REMOTE STEAL PAYS OFF ONLY WHEN THE REMOTE QUEUE
+// IS DEEP OR ITS OLDEST TASK HAS WAITED LONG ENOUGH TO AMORTIZE A COLD
+// CACHE AND REMOTE MEMORY. BOTH THRESHOLDS GROW WITH DISTANCE:
+//   DEPTH:   1 + (dist - 10) / 4     (11: 1, 21: 3, 32: 6)
+//   SOJOURN: (dist - 10) * 250US     (11: 250US, 21: 2.75MS, 32: 5.5MS)
+// DISTANCE 0 (NOT PUBLISHED BY RUST) DISABLES THE GATE: OLD BEHAVIOR.
+static __always_inline bool xnode_steal_pays(u32 dist, u64 nr_queued,
+					     u64 stamp, u64 now)
+{
+	if (dist <= XNODE_DIST_LOCAL)
+		return true;
+	u64 extra = dist - XNODE_DIST_LOCAL;
+	if (nr_queued >= 1 + (extra >> 2))
+		return true;
+	return stamp > 0 && (now - stamp) >= extra * XNODE_SOJOURN_UNIT_NS;
+}
+
+static __always_inline void count_xnode_steal(u32 dist)
+{
+	struct pandemonium_stats *s = get_stats();
+	if (!s)
+		return;
+	s->nr_dispatches += 1;
+	u32 cls = xnode_class(dist);
+	if (cls == 0)      s->nr_xnode_steal_near += 1;
+	else if (cls == 1) s->nr_xnode_steal_mid += 1;
+	else               s->nr_xnode_steal_far += 1;
+}
+
+// HISTOGRAM BUCKETING: MATCHES lat_bucket() AND SLEEP_EDGES_NS IN RUST
+
+// INDEX OF THE HIGHEST SET BIT. BRANCHLESS BINARY SEARCH, v != 0.
+static __always_inline u32 msb64(u64 v)
+{
+	u32 r = 0, s;
+
+	s = (v > 0xFFFFFFFFULL) << 5; v >>= s; r |= s;
+	s = (v > 0xFFFF) << 4;        v >>= s; r |= s;
+	s = (v > 0xFF) << 3;          v >>= s; r |= s;
+	s = (v > 0xF) << 2;           v >>= s; r |= s;
+	s = (v > 0x3) << 1;           v >>= s; r |= s;
+	return r | (u32)(v >> 1);
+}
 
+// LOG-LINEAR: BUCKET = (MSB - SUB_BITS + 1) * SUB + TOP SUB_BITS BELOW THE MSB
 static __always_inline u32 lat_bucket(u64 lat_ns)
 {
-	if (lat_ns <= 10000) return 0;
-	if (lat_ns <= 25000) return 1;
-	if (lat_ns <= 50000) return 2;
-	if (lat_ns <= 100000) return 3;
-	if (lat_ns <= 250000) return 4;
-	if (lat_ns <= 500000) return 5;
-	if (lat_ns <= 1000000) return 6;
-	if (lat_ns <= 2000000) return 7;
-	if (lat_ns <= 5000000) return 8;
-	if (lat_ns <= 10000000) return 9;
-	if (lat_ns <= 20000000) return 10;
-	return 11;
+	u64 units = lat_ns >> LAT_HIST_UNIT_SHIFT;
+	u32 msb, b;
+
+	if (units < LAT_HIST_SUB)
+		return (u32)units;
+	msb = msb64(units);
+	b = ((msb - LAT_HIST_SUB_BITS + 1) << LAT_HIST_SUB_BITS) +
+	    (u32)((units >> (msb - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB - 1));
+	return b < LAT_HIST_BUCKETS ? b : LAT_HIST_BUCKETS - 1;
 }
 
 static __always_inline u32 sleep_bucket(u64 sleep_ns)
@@ -397,12 +1559,33 @@ static __always_inline bool is_compositor(const struct task_struct *p)
 	return bpf_map_lookup_elem(&compositor_map, key) != NULL;
 }
 
-// TRACE: FAST 4-BYTE COMM CHECK FOR SCHEDULER PROCESS TRACING
-// CATCHES "pandemonium" WITH ZERO MAP OVERHEAD. DISABLE VIA TRACE_SCHED=0.
-static __always_inline bool is_sched_task(const struct task_struct *p)
+// FIRST 8 comm BYTES AS ONE WORD. set_task_comm() ZERO-PADS, SO A RENAME
+// OR exec TO A DIFFERENT NAME CHANGES IT.
+static __always_inline u64 task_comm_sig(const struct task_struct *p)
+{
+	u64 sig = 0;
+	unsigned int i;
+	for (i = 0; i < 8; i++)
+		sig |= (u64)(u8)p->comm[i] << (i * 8);
+	return sig;
+}
+
+// RESOLVE THE comm- AND FLAG-DERIVED BITS OF tctx->policy. TASK_F_PROCDB,
+// TASK_F_RECLASS AND TASK_F_PERIODIC ARE OWNED BY enable(), stopping()
+// AND runnable().
+static __always_inline void task_policy_resolve(const struct task_struct *p,
+						struct task_ctx *tctx,
+						u64 sig, u32 gen)
 {
-	return p->comm[0] == 'p' && p->comm[1] == 'a' &&
-	       p->comm[2] == 'n' && p->comm[3] == 'd';
+	u8 policy = tctx->policy &
+		    (TASK_F_PROCDB | TASK_F_RECLASS | TASK_F_PERIODIC);
+	if (p->flags & PF_KTHREAD)
+		policy |= TASK_F_KTHREAD;
+	if (is_compositor(p))
+		policy |= TASK_F_COMPOSITOR;
+	tctx->policy = policy;
+	tctx->comm_sig = sig;
+	tctx->policy_gen = gen;
 }
 
 // EFFECTIVE WEIGHT: TIER-BASED MULTIPLIER ON NICE WEIGHT
@@ -424,6 +1607,19 @@ static __always_inline u64 effective_weight(const struct task_struct *p,
 
 // SCHEDULING HELPERS
 
+// PERIODIC: A STABLE INTER-WAKEUP PERIOD AND A SHORT RUN EACH TIME.
+// NEEDS AN AGED EWMA OR A period SEEDED FROM A CONFIDENT procdb PROFILE.
+static __always_inline bool task_periodic(const struct task_ctx *tctx)
+{
+	u64 period = tctx->period_ns;
+
+	if (tctx->ewma_age < EWMA_AGE_MATURE && !(tctx->policy & TASK_F_PROCDB))
+		return false;
+	return period >= PERIOD_MIN_NS && period <= PERIOD_MAX_NS &&
+	       tctx->period_dev < (period >> PERIOD_DEV_SHIFT) &&
+	       tctx->avg_runtime < (period >> PERIOD_UTIL_SHIFT);
+}
+
 // DEADLINE = DSQ_VTIME + AWAKE_VTIME
 // PER-TASK LAG SCALING: INTERACTIVE TASKS GET MORE VTIME CREDIT
 // QUEUE-PRESSURE SCALING: CREDIT SHRINKS WHEN DSQ IS DEEP
@@ -447,8 +1643,10 @@ static __always_inline u64 task_deadline(struct task_struct *p,
 	else if (nr_queued > 4 && lag_scale > 2)
 		lag_scale >>= 1;
 
-	// CLAMP VTIME TO PREVENT UNBOUNDED BOOST AFTER LONG SLEEP
-	u64 vtime_floor = vtime_now - LAG_CAP_NS * lag_scale;
+	// CLAMP VTIME TO PREVENT UNBOUNDED BOOST AFTER LONG SLEEP.
+	// RELATIVE TO THE CGROUP VTIME: A SLEEPER IN A TENANT THAT IS AHEAD OF
+	// ITS SHARE CANNOT JUMP AHEAD OF TENANTS THAT ARE BEHIND THEIRS.
+	u64 vtime_floor = task_vtime_base(tctx) - LAG_CAP_NS * lag_scale;
 	if (time_before(p->scx.dsq_vtime, vtime_floor))
 		p->scx.dsq_vtime = vtime_floor;
 
@@ -464,6 +1662,21 @@ static __always_inline u64 task_deadline(struct task_struct *p,
 	if (tctx->awake_vtime > awake_cap)
 		tctx->awake_vtime = awake_cap;
 
+	// PERIODIC: EARLIEST DEADLINE BY LAXITY (PERIOD - RUNTIME), THE SLACK
+	// BEFORE THE NEXT ACTIVATION, MAPPED INTO THE SAME LAG WINDOW A SLEEPER
+	// GETS: NO MORE CREDIT THAN vtime_floor, SO A SET OF PERIODIC TASKS
+	// CANNOT HOLD LAG-ORDERED WORK OFF THE DSQ. awake_vtime STILL ACCRUES,
+	// SO A RUN THAT OVERSTAYS ITS PERIOD LOSES THE PRIORITY WITHIN IT.
+	if (tctx->policy & TASK_F_PERIODIC) {
+		u64 window = LAG_CAP_NS * lag_scale;
+		u64 laxity = tctx->period_ns > tctx->avg_runtime ?
+			     tctx->period_ns - tctx->avg_runtime : 0;
+		if (laxity > PERIOD_MAX_NS)
+			laxity = PERIOD_MAX_NS;
+		return vtime_floor + laxity * window / PERIOD_MAX_NS +
+		       tctx->awake_vtime;
+	}
+
 	return p->scx.dsq_vtime + tctx->awake_vtime;
 }
 
@@ -471,10 +1684,12 @@ static __always_inline u64 task_deadline(struct task_struct *p,
 // LAT_CRITICAL: 1.5X AVG_RUNTIME (TIGHT -- FAST PREEMPTION)
 // INTERACTIVE:  2X AVG_RUNTIME (RESPONSIVE)
 // BATCH:        KNOB BASE SLICE (CONTROLLED BY ADAPTIVE LAYER)
+// BURST/LONGRUN: CALLER PASSES THE STATE OF THE NODE THE TASK RUNS ON
 static __always_inline u64 task_slice(const struct task_ctx *tctx,
-				      const struct tuning_knobs *knobs)
+				      const struct tuning_knobs *knobs,
+				      const struct node_state *ns)
 {
-	u64 base_slice = knobs ? ((burst_mode || longrun_mode)
+	u64 base_slice = knobs ? ((ns->burst_mode || ns->longrun_mode)
 		? knobs->burst_slice_ns : knobs->slice_ns) : 1000000;
 	u64 base;
 
@@ -518,59 +1733,90 @@ static __always_inline u64 task_slice(const struct task_ctx *tctx,
 // AND SOJOURN RESCUE. DEPTH-GATED: IF PER-CPU DSQ ALREADY HAS TASKS,
 // SPILL TO SHARED NODE DSQ SO ANY CPU CAN GRAB IT.
 // THE CPU IS IDLE SO IT ENTERS dispatch() IMMEDIATELY AND DRAINS.
+// SMT PLACEMENT (smt_mode) RUNS FIRST; DEFAULT SELECTION IF IT PASSES.
 s32 BPF_STRUCT_OPS(pandemonium_select_cpu, struct task_struct *p,
 		   s32 prev_cpu, u64 wake_flags)
 {
 	bool is_idle = false;
-	s32 cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
+	bool pair_idle = false, pair_sync = false;
+	struct task_ctx *tctx = lookup_task_ctx(p);
+	struct tuning_knobs *knobs = get_knobs();
+	bool paired = pair_affinity && tctx && pair_track_waker(p, tctx);
+	s32 cpu = tctx ? pick_smt_cpu(p, tctx, knobs, prev_cpu,
+				      cpu_node(prev_cpu)) : -1;
+	if (cpu < 0 && paired) {
+		cpu = pick_pair_cpu(p, tctx, wake_flags, &pair_sync);
+		pair_idle = cpu >= 0 && !pair_sync;
+	}
+	// IDLE-STATE: A LATENCY-TIER WAKEUP WHOSE prev_cpu IS BUSY OR IN A DEEP
+	// C-STATE TAKES A SHALLOW ONE INSTEAD OF WHATEVER THE DEFAULT FINDS
+	if (cpu < 0 && idle_aware && tctx && tctx->tier != TIER_BATCH &&
+	    idle_exit_ns((u32)prev_cpu, bpf_ktime_get_ns()) > IDLE_EXIT_MAX_NS)
+		cpu = pick_recent_idle_cpu(p, tctx, cpu_node(prev_cpu));
+	// A SYNC HANDOFF TAKES THE PER-CPU DSQ PATH BELOW WITHOUT AN IDLE CPU:
+	// ITS SCX_KICK_IDLE IS A NO-OP ON THE WAKER'S BUSY CPU
+	if (cpu >= 0)
+		is_idle = true;
+	else
+		cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
 
 	if (is_idle) {
-		struct task_ctx *tctx = lookup_task_ctx(p);
-		struct tuning_knobs *knobs = get_knobs();
-		u64 sl = tctx ? task_slice(tctx, knobs) : 1000000;
-
-		u32 depth_thresh = burst_mode ? 1 : pcpu_depth_base;
-		if ((u64)cpu < nr_cpu_ids &&
-		    scx_bpf_dsq_nr_queued((u64)cpu) < depth_thresh) {
+		s32 node = cpu_node(cpu);
+		struct node_state *ns = get_node_state(node);
+		u64 sl = tctx ? task_slice(tctx, knobs, ns) : 1000000;
+
+		u32 depth_thresh = ns->burst_mode ? 1 : pcpu_depth_gate((u32)cpu);
+		u32 depth = (u64)cpu < nr_cpu_ids
+			? (u32)scx_bpf_dsq_nr_queued((u64)cpu) : (u32)-1;
+		if (depth < depth_thresh) {
 			// PER-CPU DSQ: CACHE-HOT, VISIBLE, STEALABLE
 			u64 dl = tctx ? task_deadline(p, tctx, (u64)cpu, knobs)
 				      : vtime_now;
 			scx_bpf_dsq_insert_vtime(p, (u64)cpu, sl, dl, 0);
-			if ((u32)cpu < MAX_CPUS)
+			if ((u32)cpu < MAX_CPUS) {
 				__sync_val_compare_and_swap(
-					&pcpu_enqueue_ns[cpu], 0,
+					pcpu_stamp((u32)cpu), 0,
 					bpf_ktime_get_ns());
+				pcpu_note_insert((u32)cpu, depth + 1);
+				pcpu_backlog_set((u32)cpu);
+				if (!pair_sync)
+					__sync_fetch_and_add(&pcpu_depth_of((u32)cpu)->idle_hits, 1);
+			}
 		} else {
 			// DEPTH EXCEEDED: SPILL TO SHARED NODE DSQ
-			s32 node = __COMPAT_scx_bpf_cpu_node(cpu);
-			if (node < 0 || (u32)node >= nr_nodes) node = 0;
 			u64 node_dsq = nr_cpu_ids + (u64)node;
 			u64 dl = tctx ? task_deadline(p, tctx, node_dsq, knobs)
 				      : vtime_now;
 			scx_bpf_dsq_insert_vtime(p, node_dsq, sl, dl, 0);
 			__sync_val_compare_and_swap(
-				&interactive_enqueue_ns, 0,
+				&ns->interactive_enqueue_ns, 0,
 				bpf_ktime_get_ns());
+			if ((u64)cpu < nr_cpu_ids)
+				__sync_fetch_and_add(&pcpu_depth_of((u32)cpu)->spills, 1);
 		}
 
 		scx_bpf_kick_cpu(cpu, SCX_KICK_IDLE);
-		__sync_fetch_and_add(&interactive_run, 1);
+		__sync_fetch_and_add(&ns->interactive_run, 1);
 
 		if (tctx)
 			tctx->dispatch_path = 0;
 
 		struct pandemonium_stats *s = get_stats();
 		if (s) {
-			s->nr_idle_hits += 1;
+			if (pair_sync)
+				s->nr_pair_sync += 1;
+			else
+				s->nr_idle_hits += 1;
+			if (pair_idle)
+				s->nr_pair_affine += 1;
 			s->nr_dispatches += 1;
 			if (tctx)
 				count_l2_affinity(s, tctx, cpu);
 		}
 
-#if TRACE_SCHED
-		if (is_sched_task(p))
-			bpf_printk("PAND: select_cpu pid=%d cpu=%d", p->pid, cpu);
-#endif
+		trace_sched(p, tctx, TRACE_SELECT_IDLE, cpu,
+			    depth < depth_thresh ? (u64)cpu : nr_cpu_ids + (u64)node,
+			    0);
 	}
 
 	return cpu;
@@ -583,28 +1829,38 @@ s32 BPF_STRUCT_OPS(pandemonium_select_cpu, struct task_struct *p,
 void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 		    u64 enq_flags)
 {
-	s32 node = __COMPAT_scx_bpf_cpu_node(scx_bpf_task_cpu(p));
-	if (node < 0 || (u32)node >= nr_nodes) node = 0;
+	s32 node = cpu_node(scx_bpf_task_cpu(p));
+	struct node_state *ns = get_node_state(node);
 	u64 node_dsq = nr_cpu_ids + (u64)node;
 
 	struct task_ctx *tctx = lookup_task_ctx(p);
 	struct tuning_knobs *knobs = get_knobs();
-	u64 sl = tctx ? task_slice(tctx, knobs) : 1000000;
+	u64 sl = tctx ? task_slice(tctx, knobs, ns) : 1000000;
 	u64 dl;
 
 	// CLASSIFY: WAKEUP VS RE-ENQUEUE
 	bool is_wakeup = tctx && tctx->awake_vtime == 0;
 
 	// TIER 1: IDLE CPU -> NODE DSQ + KICK
-	// L2 PLACEMENT: TRY IDLE SIBLING IN SAME L2 DOMAIN FIRST.
+	// CACHE PLACEMENT: TRY IDLE SIBLING IN SAME L2 DOMAIN, THEN SAME L3/CCX.
 	// LAT_CRITICAL AND KERNEL THREADS SKIP AFFINITY -- FASTEST CPU WINS.
+	// IDLE-STATE (--idle-aware): THEN A RECENTLY IDLED CPU -- SHALLOW C-STATE
+	// FOR LATENCY TIERS, STILL CLOCKED HIGH FOR BATCH.
+	// HYBRID: LAT_CRITICAL THEN PREFERS P-CORES, BATCH PREFERS E-CORES.
+	// SMT PLACEMENT (smt_mode) GOES FIRST WHEN ENABLED FOR THE TIER.
 	// TASK GOES TO SHARED NODE DSQ SO ANY CPU ON THE NODE CAN DRAIN IT.
-	s32 cpu = -1;
-	if (knobs && knobs->affinity_mode > 0 && tctx &&
+	s32 cpu = tctx ? pick_smt_cpu(p, tctx, knobs, tctx->last_cpu, node) : -1;
+	if (cpu < 0 && knobs && knobs->affinity_mode > 0 && tctx &&
 	    tctx->tier != TIER_LAT_CRITICAL &&
 	    !(p->flags & PF_KTHREAD)) {
-		cpu = find_idle_l2_sibling(tctx);
+		cpu = find_idle_l2_sibling(p, tctx->last_cpu);
+		if (cpu < 0)
+			cpu = find_idle_l3_sibling(p, tctx->last_cpu);
 	}
+	if (cpu < 0 && tctx)
+		cpu = pick_recent_idle_cpu(p, tctx, node);
+	if (cpu < 0 && tctx && !(p->flags & PF_KTHREAD))
+		cpu = find_idle_core_type(p, tctx);
 	if (cpu < 0)
 		cpu = __COMPAT_scx_bpf_pick_idle_cpu_node(p->cpus_ptr, node, 0);
 	if (cpu >= 0 && (u64)cpu < nr_cpu_ids) {
@@ -630,10 +1886,7 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 			if (tctx)
 				count_l2_affinity(s, tctx, cpu);
 		}
-#if TRACE_SCHED
-		if (is_sched_task(p))
-			bpf_printk("PAND: enq tier1 pid=%d cpu=%d", p->pid, cpu);
-#endif
+		trace_sched(p, tctx, TRACE_ENQ_SIBLING, cpu, node_dsq, 0);
 		return;
 	}
 
@@ -671,10 +1924,7 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 				else
 					s->nr_enq_requeue += 1;
 			}
-#if TRACE_SCHED
-			if (is_sched_task(p))
-				bpf_printk("PAND: enq tier2 pid=%d cpu=%d", p->pid, cpu);
-#endif
+			trace_sched(p, tctx, TRACE_ENQ_PREEMPT, cpu, node_dsq, 0);
 			return;
 		}
 	}
@@ -693,9 +1943,9 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 	// SOJOURN TRACKING: RECORD WHEN OVERFLOW DSQs TRANSITION FROM EMPTY.
 	// DISPATCH STEP 0 CHECKS THESE TO RESCUE TASKS AGING PAST THRESHOLD.
 	if (target_dsq != node_dsq)
-		__sync_val_compare_and_swap(&batch_enqueue_ns, 0, bpf_ktime_get_ns());
+		__sync_val_compare_and_swap(&ns->batch_enqueue_ns, 0, bpf_ktime_get_ns());
 	if (target_dsq == node_dsq)
-		__sync_val_compare_and_swap(&interactive_enqueue_ns, 0, bpf_ktime_get_ns());
+		__sync_val_compare_and_swap(&ns->interactive_enqueue_ns, 0, bpf_ktime_get_ns());
 
 	dl = tctx ? task_deadline(p, tctx, target_dsq, knobs) : vtime_now;
 
@@ -708,18 +1958,18 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 	// GATED AT >= 8 CORES: ON LOW CORE COUNTS THE BATCH DSQ IS SHALLOW
 	// ENOUGH THAT SOJOURN RESCUE REACHES EVERY TASK NATURALLY. THE CEILING
 	// COMPRESSES VTIME AND DESTROYS PRIORITY DIFFERENTIATION AT 2-4 CORES.
+	// ANCHORED AT THE CGROUP VTIME SO THE CAP BOUNDS A TASK WITHIN ITS
+	// TENANT'S SHARE RATHER THAN FLATTENING EVERY TENANT TO ONE CLOCK.
 	if (target_dsq != node_dsq && nr_cpu_ids >= 8) {
-		u64 vtime_ceiling = vtime_now + (LAG_CAP_NS * 3 >> 2);
+		u64 vtime_ceiling = (tctx ? task_vtime_base(tctx) : vtime_now)
+				  + (LAG_CAP_NS * 3 >> 2);
 		if (time_after(dl, vtime_ceiling))
 			dl = vtime_ceiling;
 	}
 
 	scx_bpf_dsq_insert_vtime(p, target_dsq, sl, dl, enq_flags);
 
-#if TRACE_SCHED
-	if (is_sched_task(p))
-		bpf_printk("PAND: enq tier3 pid=%d dsq=%llu tier=%d", p->pid, target_dsq, tctx ? tctx->tier : -1);
-#endif
+	trace_sched(p, tctx, TRACE_ENQ_OVERFLOW, scx_bpf_task_cpu(p), target_dsq, 0);
 
 	// ARM TICK SAFETY NET: SIGNAL THAT INTERACTIVE TASKS ARE WAITING IN OVERFLOW.
 	// tick() CHECKS THIS FLAG TO PREEMPT BATCH TASKS VIA preempt_thresh_ns.
@@ -744,41 +1994,9 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 		}
 	}
 
-	// WAKEUP RATE COUNTER: INCREMENT ON EVERY WAKEUP.
-	// tick() READS AND RESETS THIS EVERY KERNEL TICK (1-4MS).
-	// THRESHOLD: nr_cpu_ids * 2 WAKEUPS PER TICK = FORK STORM.
-	if (is_wakeup)
-		__sync_fetch_and_add(&wake_rate_count, 1);
-
-	// TOTAL-ENQUEUE CUSUM: SAMPLE EVERY 64TH ENQUEUE.
-	// TRACKS TIME INTERVAL PER 64 ENQUEUES (SHORTER = HIGHER RATE).
-	// EWMA BASELINE SELF-TUNES TO ACTUAL SYSTEM CAPACITY.
-	// EFFECTIVE FOR BPF (1MS SLICES) WHERE RATE INCREASES DURING BURST.
-	// RATE-BOUNDED UNDER ADAPTIVE (4MS SLICES) -- WAKEUP CUSUM ABOVE
-	// COVERS THAT CASE. EITHER CUSUM FIRING ACTIVATES burst_mode IN tick().
-	u64 count = __sync_fetch_and_add(&cusum_enq_count, 1);
-	if ((count & 63) == 0) {
-		if (__sync_bool_compare_and_swap(&cusum_lock, 0, 1)) {
-			u64 now = bpf_ktime_get_ns();
-			u64 interval = now - cusum_last_check_ns;
-			cusum_last_check_ns = now;
-
-			if (cusum_interval_ewma == 0) {
-				cusum_interval_ewma = interval;
-			} else {
-				cusum_interval_ewma = cusum_interval_ewma
-					- (cusum_interval_ewma >> 3)
-					+ (interval >> 3);
-			}
-
-			u64 k = cusum_interval_ewma >> 2;
-			if (interval + k < cusum_interval_ewma)
-				cusum_s += (cusum_interval_ewma - interval - k);
-			else
-				cusum_s >>= 1;
-			__sync_lock_test_and_set(&cusum_lock, 0);
-		}
-	}
+	// BURST DETECTION INPUT: ENQUEUE + WAKEUP COUNTS ON THIS CPU'S LINE.
+	// tick() TURNS THEM INTO THE NODE'S burst_mode (burst_window_close()).
+	burst_count(is_wakeup);
 }
 
 // DISPATCH: CPU IS IDLE AND NEEDS WORK
@@ -794,28 +2012,75 @@ void BPF_STRUCT_OPS(pandemonium_enqueue, struct task_struct *p,
 // 4. HARD STARVATION RESCUE (ABSOLUTE SAFETY NET FOR BATCH)
 // 5. NODE INTERACTIVE OVERFLOW (ALL INTERACTIVE TASKS, VTIME-ORDERED)
 // 6. BATCH SOJOURN RESCUE + NODE BATCH OVERFLOW
-// 7. CROSS-NODE STEAL (BOTH INTERACTIVE AND BATCH PER REMOTE NODE)
+// 7. CROSS-NODE STEAL (NEAREST-FIRST, DISTANCE COST-GATED)
 // 8. KEEP_RUNNING IF PREV STILL WANTS CPU AND NOTHING QUEUED
+// BATCHED DISPATCH: EXTRA TASKS PER OVERFLOW PULL, BY TIER OF THE SOURCE.
+// INTERACTIVE SLICES ARE SHORT, SO A FEW QUEUED LOCALLY ALL START SOON.
+// BATCH SLICES ARE LONG: ONE EXTRA ALREADY SKIPS A LADDER WALK, MORE
+// WOULD STRAND WORK BEHIND A LONG SLICE.
+#define DISPATCH_FILL_INTERACTIVE 3
+#define DISPATCH_FILL_BATCH       1
+
+// AFTER ONE SUCCESSFUL PULL FROM dsq, KEEP FILLING THE LOCAL DSQ FROM IT.
+// ONLY WHILE dsq STILL HOLDS MORE TASKS THAN THE NODE HAS CPUs: NO IDLE
+// SIBLING GOES WITHOUT WORK BECAUSE THIS CPU HOARDED IT. INTERACTIVE
+// EXTRAS ARE CHARGED TO THE DEFICIT ONE BY ONE AND STOP AT THE BUDGET
+// WHILE BATCH STARVES. BATCH EXTRAS STOP WHEN INTERACTIVE WORK IS QUEUED
+// ON THE NODE. RETURNS THE NUMBER OF EXTRA TASKS MOVED.
+static __always_inline u32 dispatch_fill(u64 dsq, u64 node_dsq,
+					 struct node_state *ns, bool interactive,
+					 u64 budget, bool batch_starving)
+{
+	if (!dispatch_batch)
+		return 0;
+
+	u32 cap = interactive ? DISPATCH_FILL_INTERACTIVE : DISPATCH_FILL_BATCH;
+	u64 node_cpus = node_nr_cpus(ns);
+	u32 n = 0;
+
+	for (u32 i = 0; i < DISPATCH_FILL_INTERACTIVE && i < cap; i++) {
+		if (scx_bpf_dsq_nr_queued(dsq) <= node_cpus)
+			break;
+		if (interactive) {
+			if (batch_starving && ns->interactive_run >= budget)
+				break;
+		} else if (scx_bpf_dsq_nr_queued(node_dsq) > 0) {
+			break;
+		}
+		if (!scx_bpf_dsq_move_to_local(dsq))
+			break;
+		if (interactive)
+			__sync_fetch_and_add(&ns->interactive_run, 1);
+		n++;
+	}
+
+	if (n) {
+		struct pandemonium_stats *s = get_stats();
+		if (s)
+			s->nr_dispatch_batched += n;
+	}
+	return n;
+}
+
 void BPF_STRUCT_OPS(pandemonium_dispatch, s32 cpu, struct task_struct *prev)
 {
-	s32 node = __COMPAT_scx_bpf_cpu_node(cpu);
-	if (node < 0 || (u32)node >= nr_nodes) node = 0;
+	s32 node = cpu_node(cpu);
+	struct node_state *ns = get_node_state(node);
 	u64 node_dsq = nr_cpu_ids + (u64)node;
 	u64 batch_dsq = nr_cpu_ids + nr_nodes + (u64)node;
 	struct pandemonium_stats *s;
 	u64 now = bpf_ktime_get_ns();
+	u64 overflow_sojourn_rescue_ns =
+		READ_ONCE(scale_knobs.overflow_sojourn_rescue_ns);
 
 	// STEP 0: OWN PER-CPU DSQ -- HIGHEST PRIORITY, CACHE-HOT
 	if ((u64)cpu < nr_cpu_ids &&
 	    scx_bpf_dsq_move_to_local((u64)cpu)) {
-		if ((u32)cpu < MAX_CPUS &&
-		    scx_bpf_dsq_nr_queued((u64)cpu) == 0) {
-			u64 old = pcpu_enqueue_ns[cpu];
-			if (old > 0)
-				__sync_val_compare_and_swap(
-					&pcpu_enqueue_ns[cpu], old, 0);
+		if ((u32)cpu < MAX_CPUS) {
+			pcpu_clear_if_empty((u32)cpu);
+			pcpu_note_drain((u32)cpu, now);
 		}
-		__sync_fetch_and_add(&interactive_run, 1);
+		__sync_fetch_and_add(&ns->interactive_run, 1);
 		s = get_stats();
 		if (s)
 			s->nr_dispatches += 1;
@@ -823,8 +2088,8 @@ void BPF_STRUCT_OPS(pandemonium_dispatch, s32 cpu, struct task_struct *prev)
 		// IF EITHER OVERFLOW DSQ HAS TASKS AGING PAST THRESHOLD,
 		// FALL THROUGH SO DOWNSTREAM RESCUE LOGIC CAN FIRE.
 		{
-			u64 ie = interactive_enqueue_ns;
-			u64 be = batch_enqueue_ns;
+			u64 ie = ns->interactive_enqueue_ns;
+			u64 be = ns->batch_enqueue_ns;
 			if ((ie == 0 || (now - ie) <= overflow_sojourn_rescue_ns) &&
 			    (be == 0 || (now - be) <= overflow_sojourn_rescue_ns))
 				return;
@@ -833,12 +2098,16 @@ void BPF_STRUCT_OPS(pandemonium_dispatch, s32 cpu, struct task_struct *prev)
 
 	// STEP 1: L2 WORK STEALING -- PULL FROM SIBLING PER-CPU DSQs
 	// SAME L2 CACHE DOMAIN = MINIMAL CACHE PENALTY ON STEAL.
-	// BOUNDED LOOP (MAX_L2_SIBLINGS), SAME PATTERN AS find_idle_l2_sibling.
+	// BOUNDED LOOP (l2_stride), SAME PATTERN AS find_idle_l2_sibling.
+	// ONLY SIBLINGS SET IN node_backlog ARE WORTH A MOVE ATTEMPT.
 	u32 my_cpu = (u32)cpu;
+	bool stole = false;
 	u32 *group = bpf_map_lookup_elem(&cache_domain, &my_cpu);
 	if (group) {
-		u32 base = *group * MAX_L2_SIBLINGS;
+		u32 base = *group * l2_stride;
 		for (int i = 0; i < MAX_L2_SIBLINGS; i++) {
+			if (i >= l2_stride)
+				break;
 			u32 key = base + i;
 			u32 *val = bpf_map_lookup_elem(&l2_siblings, &key);
 			if (!val || *val == (u32)-1)
@@ -846,23 +2115,67 @@ void BPF_STRUCT_OPS(pandemonium_dispatch, s32 cpu, struct task_struct *prev)
 			u32 sibling = *val;
 			if (sibling == my_cpu || sibling >= nr_cpu_ids)
 				continue;
+			if (!pcpu_backlogged(sibling))
+				continue;
+			if (scx_bpf_dsq_move_to_local((u64)sibling)) {
+				if (sibling < MAX_CPUS) {
+					pcpu_clear_if_empty(sibling);
+					pcpu_note_drain(sibling, now);
+					__sync_fetch_and_add(&pcpu_depth_of(sibling)->steals, 1);
+				}
+				__sync_fetch_and_add(&ns->interactive_run, 1);
+				s = get_stats();
+				if (s)
+					s->nr_dispatches += 1;
+				// SOJOURN GATE: SAME CHECK AS STEP 0.
+				{
+					u64 ie = ns->interactive_enqueue_ns;
+					u64 be = ns->batch_enqueue_ns;
+					if ((ie == 0 || (now - ie) <= overflow_sojourn_rescue_ns) &&
+					    (be == 0 || (now - be) <= overflow_sojourn_rescue_ns))
+						return;
+				}
+				stole = true;
+				break;
+			}
+		}
+	}
+
+	// STEP 1b: L3 WORK STEALING -- SAME L3/CCX, OUTSIDE OUR L2.
+	// SHARED LAST-LEVEL CACHE KEEPS THE WORKING SET WARM; CROSSING THE
+	// CCX BOUNDARY IS LEFT TO THE NODE DSQs. SKIPPED IF STEP 1 STOLE.
+	struct cpu_topo *my_topo = bpf_map_lookup_elem(&cpu_topo_map, &my_cpu);
+	if (!stole && my_topo && my_topo->l3_group < nr_l3_rows) {
+		u32 base = my_topo->l3_group * l3_stride;
+		for (int i = 0; i < MAX_L3_SIBLINGS; i++) {
+			if (i >= l3_stride)
+				break;
+			u32 key = base + i;
+			u32 *val = bpf_map_lookup_elem(&l3_siblings, &key);
+			if (!val || *val == (u32)-1)
+				break;
+			u32 sibling = *val;
+			if (sibling == my_cpu || sibling >= nr_cpu_ids)
+				continue;
+			u32 *sib_l2 = bpf_map_lookup_elem(&cache_domain, &sibling);
+			if (sib_l2 && *sib_l2 == my_topo->l2_group)
+				continue;
+			if (!pcpu_backlogged(sibling))
+				continue;
 			if (scx_bpf_dsq_move_to_local((u64)sibling)) {
-				if (sibling < MAX_CPUS &&
-				    scx_bpf_dsq_nr_queued((u64)sibling) == 0) {
-					u64 old = pcpu_enqueue_ns[sibling];
-					if (old > 0)
-						__sync_val_compare_and_swap(
-							&pcpu_enqueue_ns[sibling],
-							old, 0);
+				if (sibling < MAX_CPUS) {
+					pcpu_clear_if_empty(sibling);
+					pcpu_note_drain(sibling, now);
+					__sync_fetch_and_add(&pcpu_depth_of(sibling)->steals, 1);
 				}
-				__sync_fetch_and_add(&interactive_run, 1);
+				__sync_fetch_and_add(&ns->interactive_run, 1);
 				s = get_stats();
 				if (s)
 					s->nr_dispatches += 1;
 				// SOJOURN GATE: SAME CHECK AS STEP 0.
 				{
-					u64 ie = interactive_enqueue_ns;
-					u64 be = batch_enqueue_ns;
+					u64 ie = ns->interactive_enqueue_ns;
+					u64 be = ns->batch_enqueue_ns;
 					if ((ie == 0 || (now - ie) <= overflow_sojourn_rescue_ns) &&
 					    (be == 0 || (now - be) <= overflow_sojourn_rescue_ns))
 						return;
@@ -874,91 +2187,99 @@ void BPF_STRUCT_OPS(pandemonium_dispatch, s32 cpu, struct task_struct *prev)
 
 	struct tuning_knobs *knobs = get_knobs();
 	u64 sojourn_thresh = knobs ? knobs->sojourn_thresh_ns : 5000000;
-	u64 oldest = batch_enqueue_ns;
+	u64 oldest = ns->batch_enqueue_ns;
 	bool batch_starving = oldest > 0 && (now - oldest) > sojourn_thresh;
-	u64 effective_budget = longrun_mode ? nr_cpu_ids : interactive_budget;
+	u64 effective_budget = node_budget(ns);
 
 	// DEFICIT GATE: WHEN INTERACTIVE HAS EXCEEDED ITS BUDGET AND BATCH
 	// IS STARVING, SKIP INTERACTIVE OVERFLOW RESCUE SO BATCH
 	// GETS SERVED VIA DEFICIT CHECK OR STARVATION RESCUE INSTEAD.
-	if (interactive_run >= effective_budget && batch_starving)
+	if (ns->interactive_run >= effective_budget && batch_starving)
 		goto skip_interactive_rescue;
 
 	// STEP 2: OVERFLOW SOJOURN AMPLIFICATION
 	// WHEN OVERFLOW DSQs HAVE TASKS AGING PAST 10MS, SERVE THEM.
-	u64 int_oldest = interactive_enqueue_ns;
+	u64 int_oldest = ns->interactive_enqueue_ns;
 	if (int_oldest > 0 &&
 	    (now - int_oldest) > overflow_sojourn_rescue_ns) {
 		if (scx_bpf_dsq_move_to_local(node_dsq)) {
+			u32 extra = dispatch_fill(node_dsq, node_dsq, ns, true,
+				  effective_budget, batch_starving);
 			if (scx_bpf_dsq_nr_queued(node_dsq) == 0) {
-				u64 old_iens = interactive_enqueue_ns;
+				u64 old_iens = ns->interactive_enqueue_ns;
 				if (old_iens > 0)
-					__sync_val_compare_and_swap(&interactive_enqueue_ns, old_iens, 0);
+					__sync_val_compare_and_swap(&ns->interactive_enqueue_ns, old_iens, 0);
 			} else {
-				interactive_enqueue_ns = bpf_ktime_get_ns();
+				ns->interactive_enqueue_ns = bpf_ktime_get_ns();
 			}
-			__sync_fetch_and_add(&interactive_run, 1);
+			__sync_fetch_and_add(&ns->interactive_run, 1);
 			s = get_stats();
 			if (s) {
-				s->nr_dispatches += 1;
+				s->nr_dispatches += 1 + extra;
 				s->nr_overflow_rescue += 1;
 			}
+			mark_rescued(cpu);
 			return;
 		}
-		u64 old_iens = interactive_enqueue_ns;
+		u64 old_iens = ns->interactive_enqueue_ns;
 		if (old_iens > 0)
-			__sync_val_compare_and_swap(&interactive_enqueue_ns, old_iens, 0);
+			__sync_val_compare_and_swap(&ns->interactive_enqueue_ns, old_iens, 0);
 	}
 
 skip_interactive_rescue:;
 
 	// BATCH OVERFLOW RESCUE
-	u64 bat_oldest = batch_enqueue_ns;
+	u64 bat_oldest = ns->batch_enqueue_ns;
 	if (bat_oldest > 0 &&
 	    (now - bat_oldest) > overflow_sojourn_rescue_ns) {
 		if (scx_bpf_dsq_move_to_local(batch_dsq)) {
+			u32 extra = dispatch_fill(batch_dsq, node_dsq, ns, false,
+				  effective_budget, batch_starving);
 			if (scx_bpf_dsq_nr_queued(batch_dsq) == 0) {
-				u64 old_bens = batch_enqueue_ns;
+				u64 old_bens = ns->batch_enqueue_ns;
 				if (old_bens > 0)
-					__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+					__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 			} else {
-				batch_enqueue_ns = bpf_ktime_get_ns();
+				ns->batch_enqueue_ns = bpf_ktime_get_ns();
 			}
-			__sync_lock_test_and_set(&interactive_run, 0);
+			__sync_lock_test_and_set(&ns->interactive_run, 0);
 			s = get_stats();
 			if (s) {
-				s->nr_dispatches += 1;
+				s->nr_dispatches += 1 + extra;
 				s->nr_overflow_rescue += 1;
 			}
+			mark_rescued(cpu);
 			return;
 		}
-		u64 old_bens = batch_enqueue_ns;
+		u64 old_bens = ns->batch_enqueue_ns;
 		if (old_bens > 0)
-			__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+			__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 	}
 
 	// DEFICIT COUNTER: ANTI-STARVATION INTERLEAVE (DRR)
 	// AFTER interactive_budget DISPATCHES WITHOUT BATCH SERVICE,
 	// FORCE ONE BATCH DISPATCH WHEN BATCH IS STARVING.
-	// PROPORTIONAL: BUDGET = nr_cpu_ids * 4 (SET IN init()).
+	// PROPORTIONAL: BUDGET = nr_cpus * 4 (scale_knobs, SEE scale_for_cpus()).
 	// LONGRUN OVERRIDE: WHEN SUSTAINED BATCH PRESSURE (>2S), TIGHTEN
 	// FROM nr_cpu_ids*4 TO nr_cpu_ids*1, QUADRUPLING BATCH SHARE.
-	if (interactive_run >= effective_budget && batch_starving) {
+	if (ns->interactive_run >= effective_budget && batch_starving) {
 		if (scx_bpf_dsq_move_to_local(batch_dsq)) {
+			u32 extra = dispatch_fill(batch_dsq, node_dsq, ns, false,
+				  effective_budget, batch_starving);
 			if (scx_bpf_dsq_nr_queued(batch_dsq) == 0) {
-				u64 old_bens = batch_enqueue_ns;
+				u64 old_bens = ns->batch_enqueue_ns;
 				if (old_bens > 0)
-					__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+					__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 			} else {
-				batch_enqueue_ns = bpf_ktime_get_ns();
+				ns->batch_enqueue_ns = bpf_ktime_get_ns();
 			}
-			__sync_lock_test_and_set(&interactive_run, 0);
+			__sync_lock_test_and_set(&ns->interactive_run, 0);
 			s = get_stats();
 			if (s)
-				s->nr_dispatches += 1;
+				s->nr_dispatches += 1 + extra;
 			return;
 		}
-		__sync_lock_test_and_set(&interactive_run, 0);
+		__sync_lock_test_and_set(&ns->interactive_run, 0);
 	}
 
 	// HARD STARVATION RESCUE: ABSOLUTE SAFETY NET
@@ -969,19 +2290,24 @@ skip_interactive_rescue:;
 	// THIS CHECK FIRES BEFORE THE INTERACTIVE DSQ AND GUARANTEES BATCH
 	// SERVICE WITHIN 500MS REGARDLESS OF INTERACTIVE PRESSURE.
 	if (oldest > 0 &&
-	    (now - oldest) > starvation_rescue_ns) {
+	    (now - oldest) > READ_ONCE(scale_knobs.starvation_rescue_ns)) {
 		if (scx_bpf_dsq_move_to_local(batch_dsq)) {
+			u32 extra = dispatch_fill(batch_dsq, node_dsq, ns, false,
+				  effective_budget, batch_starving);
 			if (scx_bpf_dsq_nr_queued(batch_dsq) == 0) {
-				u64 old_bens = batch_enqueue_ns;
+				u64 old_bens = ns->batch_enqueue_ns;
 				if (old_bens > 0)
-					__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+					__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 			} else {
-				batch_enqueue_ns = bpf_ktime_get_ns();
+				ns->batch_enqueue_ns = bpf_ktime_get_ns();
 			}
-			__sync_lock_test_and_set(&interactive_run, 0);
+			__sync_lock_test_and_set(&ns->interactive_run, 0);
 			s = get_stats();
 			if (s)
-				s->nr_dispatches += 1;
+				s->nr_dispatches += 1 + extra;
+			emit_event(EVT_STARVATION_RESCUE, cpu, 0, node, 0, 0,
+				   now - oldest, true);
+			mark_rescued(cpu);
 			return;
 		}
 	}
@@ -989,17 +2315,19 @@ skip_interactive_rescue:;
 	// NODE INTERACTIVE OVERFLOW: LATCRIT + INTERACTIVE TASKS
 	// INTERACTIVE FIRST WITHIN EACH BUDGET CYCLE. NO PRIORITY INVERSION.
 	if (scx_bpf_dsq_move_to_local(node_dsq)) {
+		u32 extra = dispatch_fill(node_dsq, node_dsq, ns, true,
+						  effective_budget, batch_starving);
 		if (scx_bpf_dsq_nr_queued(node_dsq) == 0) {
-			u64 old_iens = interactive_enqueue_ns;
+			u64 old_iens = ns->interactive_enqueue_ns;
 			if (old_iens > 0)
-				__sync_val_compare_and_swap(&interactive_enqueue_ns, old_iens, 0);
+				__sync_val_compare_and_swap(&ns->interactive_enqueue_ns, old_iens, 0);
 		} else {
-			interactive_enqueue_ns = bpf_ktime_get_ns();
+			ns->interactive_enqueue_ns = bpf_ktime_get_ns();
 		}
-		__sync_fetch_and_add(&interactive_run, 1);
+		__sync_fetch_and_add(&ns->interactive_run, 1);
 		s = get_stats();
 		if (s)
-			s->nr_dispatches += 1;
+			s->nr_dispatches += 1 + extra;
 		return;
 	}
 
@@ -1008,58 +2336,91 @@ skip_interactive_rescue:;
 	// THRESHOLD SET BY RUST ADAPTIVE LAYER FROM OBSERVED DISPATCH RATE.
 	if (batch_starving) {
 		if (scx_bpf_dsq_move_to_local(batch_dsq)) {
+			u32 extra = dispatch_fill(batch_dsq, node_dsq, ns, false,
+				  effective_budget, batch_starving);
 			if (scx_bpf_dsq_nr_queued(batch_dsq) == 0) {
-				u64 old_bens = batch_enqueue_ns;
+				u64 old_bens = ns->batch_enqueue_ns;
 				if (old_bens > 0)
-					__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+					__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 			} else {
-				batch_enqueue_ns = bpf_ktime_get_ns();
+				ns->batch_enqueue_ns = bpf_ktime_get_ns();
 			}
 			s = get_stats();
 			if (s)
-				s->nr_dispatches += 1;
+				s->nr_dispatches += 1 + extra;
 			return;
 		}
 	}
 
 	// NODE BATCH OVERFLOW: NORMAL FALLBACK FOR BATCH TASKS
 	if (scx_bpf_dsq_move_to_local(batch_dsq)) {
+		u32 extra = dispatch_fill(batch_dsq, node_dsq, ns, false,
+						  effective_budget, batch_starving);
 		if (scx_bpf_dsq_nr_queued(batch_dsq) == 0) {
-			u64 old_bens = batch_enqueue_ns;
+			u64 old_bens = ns->batch_enqueue_ns;
 			if (old_bens > 0)
-				__sync_val_compare_and_swap(&batch_enqueue_ns, old_bens, 0);
+				__sync_val_compare_and_swap(&ns->batch_enqueue_ns, old_bens, 0);
 		} else {
-			batch_enqueue_ns = bpf_ktime_get_ns();
+			ns->batch_enqueue_ns = bpf_ktime_get_ns();
 		}
 		s = get_stats();
 		if (s)
-			s->nr_dispatches += 1;
+			s->nr_dispatches += 1 + extra;
 		return;
 	}
 
-	// CROSS-NODE STEAL
-	for (u32 n = 0; n < nr_nodes && n < MAX_NODES; n++) {
-		if (n != (u32)node) {
-			if (scx_bpf_dsq_move_to_local(nr_cpu_ids + (u64)n)) {
-				s = get_stats();
-				if (s)
-					s->nr_dispatches += 1;
-				return;
+	// CROSS-NODE STEAL: NEAREST NODE FIRST, COST-GATED BY DISTANCE.
+	// REMOTE WORK BELOW THE GATE IS LEFT FOR THE REMOTE NODE'S OWN CPUs;
+	// ITS SOJOURN STAMP KEEPS AGING UNTIL THE GATE OPENS.
+	if (nr_nodes > 1) {
+		bool gated = false;
+		u32 base = (u32)node * MAX_NODES;
+		for (u32 i = 0; i < MAX_NODES - 1 && i + 1 < nr_nodes; i++) {
+			u32 key = base + i;
+			struct node_steal_entry *e =
+				bpf_map_lookup_elem(&node_steal_order, &key);
+			if (!e || e->node == (u32)-1)
+				break;
+			u32 n = e->node;
+			if (n == (u32)node || n >= nr_nodes)
+				continue;
+			struct node_state *rns = get_node_state((s32)n);
+			u64 rdsq = nr_cpu_ids + (u64)n;
+			u64 rbatch = nr_cpu_ids + nr_nodes + (u64)n;
+
+			u64 depth = scx_bpf_dsq_nr_queued(rdsq);
+			if (depth > 0) {
+				if (xnode_steal_pays(e->distance, depth,
+						     rns->interactive_enqueue_ns, now) &&
+				    scx_bpf_dsq_move_to_local(rdsq)) {
+					count_xnode_steal(e->distance);
+					return;
+				}
+				gated = true;
 			}
-			if (scx_bpf_dsq_move_to_local(nr_cpu_ids + nr_nodes + (u64)n)) {
-				s = get_stats();
-				if (s)
-					s->nr_dispatches += 1;
-				return;
+			depth = scx_bpf_dsq_nr_queued(rbatch);
+			if (depth > 0) {
+				if (xnode_steal_pays(e->distance, depth,
+						     rns->batch_enqueue_ns, now) &&
+				    scx_bpf_dsq_move_to_local(rbatch)) {
+					count_xnode_steal(e->distance);
+					return;
+				}
+				gated = true;
 			}
 		}
+		if (gated) {
+			s = get_stats();
+			if (s)
+				s->nr_xnode_steal_gated += 1;
+		}
 	}
 
 	// NOTHING IN ANY DSQ -- KEEP PREV RUNNING IF POSSIBLE
 	if (prev && !(prev->flags & PF_EXITING) &&
 	    (prev->scx.flags & SCX_TASK_QUEUED)) {
 		struct task_ctx *tctx = lookup_task_ctx(prev);
-		prev->scx.slice = tctx ? task_slice(tctx, knobs) :
+		prev->scx.slice = tctx ? task_slice(tctx, knobs, ns) :
 				  (knobs ? knobs->slice_ns : 1000000);
 		s = get_stats();
 		if (s) {
@@ -1080,6 +2441,11 @@ void BPF_STRUCT_OPS(pandemonium_runnable, struct task_struct *p,
 	u64 now = bpf_ktime_get_ns();
 	tctx->awake_vtime = 0;
 
+	// CGROUP FAIR SHARE: COUNT THE TASK'S WEIGHT WHILE IT IS RUNNABLE
+	if (tctx->cg_queued)
+		cgrp_task_leave(tctx);
+	cgrp_task_join(tctx, (u32)effective_weight(p, tctx));
+
 	// FAST PATH: BRAND-NEW TASKS (< 2 WAKEUPS)
 	if (tctx->ewma_age < 2) {
 		tctx->last_woke_at = now;
@@ -1096,9 +2462,27 @@ void BPF_STRUCT_OPS(pandemonium_runnable, struct task_struct *p,
 		tctx->wakeup_freq = MAX_WAKEUP_FREQ;
 	tctx->last_woke_at = now;
 
+	// PERIOD: EWMA OF THE INTERVAL AND OF ITS DEVIATION FROM THE EWMA
+	u64 period_diff = delta_t > tctx->period_ns ? delta_t - tctx->period_ns
+						    : tctx->period_ns - delta_t;
+	tctx->period_ns = calc_avg(tctx->period_ns, delta_t, tctx->ewma_age);
+	tctx->period_dev = calc_avg(tctx->period_dev, period_diff,
+				    tctx->ewma_age);
+
 	if (tctx->ewma_age < EWMA_AGE_CAP)
 		tctx->ewma_age += 1;
 
+	// A TASK ENTERING OR LEAVING THE PERIODIC BAND IS RECLASSIFIED NOW
+	if (periodic_deadline) {
+		u8 was = tctx->policy & TASK_F_PERIODIC;
+		if (task_periodic(tctx))
+			tctx->policy |= TASK_F_PERIODIC;
+		else
+			tctx->policy &= ~TASK_F_PERIODIC;
+		if (reclass_interval && (tctx->policy & TASK_F_PERIODIC) != was)
+			tctx->policy |= TASK_F_RECLASS;
+	}
+
 	// VOLUNTARY CONTEXT SWITCH RATE
 	u64 nvcsw = p->nvcsw;
 	u64 csw_delta = nvcsw > tctx->prev_nvcsw ? nvcsw - tctx->prev_nvcsw : 0;
@@ -1114,41 +2498,79 @@ void BPF_STRUCT_OPS(pandemonium_runnable, struct task_struct *p,
 	if (tctx->csw_rate > MAX_CSW_RATE)
 		tctx->csw_rate = MAX_CSW_RATE;
 
+	// POLICY FLAGS: RE-RESOLVE ONLY WHEN THE comm OR policy_gen MOVED
+	u64 sig = task_comm_sig(p);
+	u32 gen = (u32)READ_ONCE(policy_gen);
+	if (sig != tctx->comm_sig || gen != tctx->policy_gen) {
+		// exec OR RENAME: THE procdb SEED DESCRIBED THE OLD IMAGE
+		if (sig != tctx->comm_sig)
+			tctx->policy &= ~TASK_F_PROCDB;
+		task_policy_resolve(p, tctx, sig, gen);
+	}
+
+	struct pandemonium_stats *s = get_stats();
+
+	// AMORTIZED RECLASSIFICATION: THE EWMAS ABOVE STAY CURRENT, ONLY THE
+	// SCORE, KNOB LOOKUP AND TIER DECISION ARE SKIPPED
+	if (reclass_interval && tctx->reclass_left &&
+	    !(tctx->policy & TASK_F_RECLASS)) {
+		tctx->reclass_left -= 1;
+		if (s)
+			s->nr_reclass_skipped += 1;
+		return;
+	}
+
 	// BEHAVIORAL CLASSIFICATION
 	tctx->lat_cri = compute_lat_cri(tctx->wakeup_freq, tctx->csw_rate,
 					 tctx->avg_runtime, tctx->runtime_dev);
 	struct tuning_knobs *knobs = get_knobs();
 	u32 new_tier = classify_tier(tctx->lat_cri, knobs);
+	if (s)
+		s->nr_reclassify += 1;
 
 	// COMPOSITOR BOOST: ALWAYS LAT_CRITICAL
-	if (new_tier != TIER_LAT_CRITICAL && is_compositor(p))
+	if (new_tier != TIER_LAT_CRITICAL && (tctx->policy & TASK_F_COMPOSITOR))
+		new_tier = TIER_LAT_CRITICAL;
+
+	// PERIODIC FLOOR: FRAME- AND AUDIO-PACED TASKS ARE LAT_CRITICAL
+	if (new_tier != TIER_LAT_CRITICAL && (tctx->policy & TASK_F_PERIODIC))
 		new_tier = TIER_LAT_CRITICAL;
 
 	// KWORKER FLOOR: WORKQUEUE WORKERS HANDLE I/O COMPLETIONS, TIMER
 	// CALLBACKS, AND DEFERRED INTERRUPT WORK. USERSPACE BLOCKS ON THESE.
 	// THEIR LOW EWMA SCORES (INFREQUENT WAKEUPS, LONG RUNTIMES) PUSH
 	// THEM TO BATCH, BUT THEY ARE LATENCY-CRITICAL KERNEL INFRASTRUCTURE.
-	if (new_tier == TIER_BATCH && (p->flags & PF_WQ_WORKER))
+	// worker_thread() SETS PF_WQ_WORKER AFTER enable(), SO IT STAYS A LIVE
+	// FLAG TEST -- ONLY FOR TASKS ALREADY CACHED AS KTHREADS.
+	if (new_tier == TIER_BATCH && (tctx->policy & TASK_F_KTHREAD) &&
+	    (p->flags & PF_WQ_WORKER))
 		new_tier = TIER_INTERACTIVE;
 
+	// SETTLED (AGED EWMA OR CONFIDENT procdb SEED) AND THE TIER HELD:
+	// TRUST IT FOR THE NEXT reclass_interval - 1 WAKEUPS
+	if (reclass_interval) {
+		bool settled = tctx->ewma_age >= EWMA_AGE_CAP ||
+			       (tctx->policy & TASK_F_PROCDB);
+		tctx->reclass_left = settled && new_tier == tctx->tier ?
+				     (u8)(reclass_interval - 1) : 0;
+		tctx->policy &= ~TASK_F_RECLASS;
+	}
+
+	// EVENT STREAM: SETTLED TASKS MOVING INTO OR OUT OF LAT_CRITICAL.
+	// YOUNG TASKS FLAP WHILE THE EWMA CONVERGES; THOSE ARE NOT REPORTED.
+	if (new_tier != tctx->tier && tctx->ewma_age >= EWMA_AGE_CAP &&
+	    (new_tier == TIER_LAT_CRITICAL || tctx->tier == TIER_LAT_CRITICAL))
+		emit_event(EVT_TIER_CHANGE, scx_bpf_task_cpu(p), (u32)p->pid,
+			   cpu_node(scx_bpf_task_cpu(p)), (u8)new_tier,
+			   (u8)tctx->tier, tctx->lat_cri, false);
+
 	tctx->tier = new_tier;
 }
 
 // RUNNING: TASK STARTS EXECUTING -- ADVANCE VTIME, RECORD WAKE LATENCY
 void BPF_STRUCT_OPS(pandemonium_running, struct task_struct *p)
 {
-#if TRACE_SCHED
-	if (is_sched_task(p))
-		bpf_printk("PAND: running pid=%d cpu=%d", p->pid, bpf_get_smp_processor_id());
-#endif
-	u64 cur = vtime_now;
-	for (int i = 0; i < 4; i++) {
-		if (!time_before(cur, p->scx.dsq_vtime))
-			break;
-		if (__sync_bool_compare_and_swap(&vtime_now, cur, p->scx.dsq_vtime))
-			break;
-		cur = vtime_now;
-	}
+	advance_vtime(&vtime_now, p->scx.dsq_vtime);
 
 	struct task_ctx *tctx = lookup_task_ctx(p);
 	if (!tctx) {
@@ -1157,9 +2579,17 @@ void BPF_STRUCT_OPS(pandemonium_running, struct task_struct *p)
 		return;
 	}
 
+	struct cgrp_ctx *cgc = lookup_cgrp_ctx(tctx->cgid);
+	if (cgc)
+		advance_vtime(&cgc->vtime, p->scx.dsq_vtime);
+
 	u64 now = bpf_ktime_get_ns();
 	tctx->last_run_at = now;
 
+	struct knob_gen_stats *ks = get_knob_gen_stats();
+	if (ks)
+		ks->nr_runs += 1;
+
 	// WAKEUP-TO-RUN LATENCY
 	// ONLY RECORD ONCE PER WAKEUP: CLEAR last_woke_at AFTER RECORDING.
 	if (tctx->last_woke_at && now > tctx->last_woke_at) {
@@ -1175,6 +2605,8 @@ void BPF_STRUCT_OPS(pandemonium_running, struct task_struct *p)
 		}
 
 		tctx->last_woke_at = 0;
+		trace_sched(p, tctx, TRACE_RUNNING, bpf_get_smp_processor_id(),
+			    0, wake_lat);
 
 		struct pandemonium_stats *s = get_stats();
 		if (s) {
@@ -1195,11 +2627,32 @@ void BPF_STRUCT_OPS(pandemonium_running, struct task_struct *p)
 		// HISTOGRAM: BPF-SIDE LATENCY BUCKETING (NO RING BUFFER)
 		u32 tier_idx = (u32)tctx->tier;
 		if (tier_idx > 2) tier_idx = 2;
-		u32 bucket = lat_bucket(wake_lat);
-		u32 hist_key = tier_idx * 12 + bucket;
-		u64 *hist_val = bpf_map_lookup_elem(&wake_lat_hist, &hist_key);
-		if (hist_val)
-			*hist_val += 1;
+		u32 bucket = lat_bucket(wake_lat) & (LAT_HIST_BUCKETS - 1);
+		u32 hist_key = 0;
+		struct lat_hist *hist = bpf_map_lookup_elem(&wake_lat_hist, &hist_key);
+		if (hist)
+			hist->cnt[tier_idx][bucket] += 1;
+
+		// PER-KNOB-GENERATION LATENCY: ATTRIBUTES SHIFTS TO ONE UPDATE
+		if (ks) {
+			ks->wake_lat_sum += wake_lat;
+			ks->wake_lat_cnt += 1;
+			if (wake_lat > ks->wake_lat_max)
+				ks->wake_lat_max = wake_lat;
+			ks->lat_hist[bucket] += 1;
+		}
+
+		// PER-CGROUP WAKEUP LATENCY
+		struct cgrp_stats *cs = get_cgrp_stats(tctx->cgid);
+		if (cs) {
+			__sync_fetch_and_add(&cs->wake_lat_sum, wake_lat);
+			__sync_fetch_and_add(&cs->wake_lat_cnt, 1);
+			if (tier_idx == TIER_BATCH) {
+				__sync_fetch_and_add(&cs->batch_lat_sum, wake_lat);
+				__sync_fetch_and_add(&cs->batch_lat_cnt, 1);
+			}
+			__sync_fetch_and_add(&cs->lat_hist[bucket], 1);
+		}
 
 		if (sleep_dur > 0) {
 			u32 sbucket = sleep_bucket(sleep_dur);
@@ -1209,8 +2662,18 @@ void BPF_STRUCT_OPS(pandemonium_running, struct task_struct *p)
 		}
 	}
 
+	// RESCUE ATTRIBUTION: dispatch() FLAGGED THIS CPU
+	u32 run_cpu = bpf_get_smp_processor_id();
+	if (run_cpu < MAX_CPUS && cpu_rescued[run_cpu]) {
+		cpu_rescued[run_cpu] = 0;
+		struct cgrp_stats *cs = get_cgrp_stats(tctx->cgid);
+		if (cs)
+			__sync_fetch_and_add(&cs->nr_rescues, 1);
+	}
+
 	struct tuning_knobs *knobs = get_knobs();
-	p->scx.slice = task_slice(tctx, knobs);
+	struct node_state *ns = get_node_state(cpu_node((s32)run_cpu));
+	p->scx.slice = task_slice(tctx, knobs, ns);
 }
 
 // STOPPING: TASK YIELDS CPU -- CHARGE VTIME WITH TIER-BASED WEIGHT
@@ -1230,11 +2693,28 @@ void BPF_STRUCT_OPS(pandemonium_stopping, struct task_struct *p,
 	{
 		u64 avg = tctx->avg_runtime;
 		u64 diff = slice > avg ? slice - avg : avg - slice;
+		// TWICE THE MEAN DEVIATION: OUTSIDE THE TASK'S NORMAL JITTER,
+		// SO THE NEXT WAKEUP RECLASSIFIES EVEN IN AMORTIZED MODE
+		if (reclass_interval && diff > (tctx->runtime_dev << 1))
+			tctx->policy |= TASK_F_RECLASS;
 		tctx->avg_runtime = calc_avg(avg, slice, tctx->ewma_age);
 		tctx->runtime_dev = calc_avg(tctx->runtime_dev, diff,
 					      tctx->ewma_age);
 	}
 
+	// PER-CGROUP RUNTIME. enable() AND cgroup_move() KEEP cgid CURRENT;
+	// RESOLVE HERE ONLY IF enable() COULD NOT.
+	if (!tctx->cgid)
+		tctx->cgid = task_cgid(p);
+	struct cgrp_ctx *cgc = lookup_cgrp_ctx(tctx->cgid);
+	struct cgrp_stats *cs = get_cgrp_stats(tctx->cgid);
+	if (cs) {
+		__sync_fetch_and_add(&cs->runtime_ns, slice);
+		__sync_fetch_and_add(&cs->nr_runs, 1);
+		cs->hweight = !cgc ? 0 : cgc->parent ? cgrp_hweight(cgc)
+						    : CGRP_HWEIGHT_ONE;
+	}
+
 	// PROCDB: PUBLISH TASK CLASSIFICATION FOR USERSPACE
 	// INITIAL AT EWMA MATURITY, THEN EVERY 64 SCHEDULING EVENTS
 	// RE-PUBLISHING KEEPS PROCDB FRESH FOR LONG-LIVED TASKS
@@ -1246,9 +2726,11 @@ void BPF_STRUCT_OPS(pandemonium_stopping, struct task_struct *p,
 		obs.runtime_dev = tctx->runtime_dev;
 		obs.wakeup_freq = tctx->wakeup_freq;
 		obs.csw_rate = tctx->csw_rate;
-		char key[16];
-		__builtin_memcpy(key, p->comm, 16);
-		bpf_map_update_elem(&task_class_observe, key, &obs, BPF_ANY);
+		if (task_periodic(tctx))
+			obs.period_us = (u32)(tctx->period_ns / 1000);
+		struct task_class_key key = {};
+		task_class_key_of(p, tctx, &key);
+		bpf_map_update_elem(&task_class_observe, &key, &obs, BPF_ANY);
 	}
 
 	u64 delta_vtime;
@@ -1257,8 +2739,56 @@ void BPF_STRUCT_OPS(pandemonium_stopping, struct task_struct *p,
 	else
 		delta_vtime = slice;
 
-	p->scx.dsq_vtime += delta_vtime;
+	// awake_vtime STAYS UNSCALED: IT ORDERS TASKS WITHIN THE CGROUP
 	tctx->awake_vtime += delta_vtime;
+	if (cgc)
+		delta_vtime = cgrp_scale_charge(cgc, delta_vtime);
+	p->scx.dsq_vtime += delta_vtime;
+}
+
+// CLOSE node's BURST WINDOW: THE WINNER OF THE window_ns CAS TAKES THE
+// COUNTS, NORMALIZES THEM TO BURST_WINDOW_NS AND DECIDES burst_mode. ONLY
+// THE WINNER WRITES cusum_s/enq_ewma/burst_mode, SO EACH EDGE IS EMITTED
+// ONCE WITHOUT A SECOND CAS.
+static __always_inline void burst_window_close(s32 node, struct node_state *ns,
+					       u32 this_cpu, u64 now)
+{
+	struct node_burst *nb = get_node_burst(node);
+	u64 start = nb->window_ns;
+
+	// now <= start: ANOTHER CPU CLOSED THE WINDOW WITH A LATER CLOCK READ
+	if (now <= start || now - start < BURST_WINDOW_NS)
+		return;
+	if (__sync_val_compare_and_swap(&nb->window_ns, start, now) != start)
+		return;
+
+	// A LATE CLOSE (NO TICKS ON AN IDLE NODE) SCALES DOWN, NEVER UP
+	u64 elapsed = now - start;
+	u64 enq = __sync_lock_test_and_set(&nb->enq, 0) * BURST_WINDOW_NS / elapsed;
+	u64 wake = __sync_lock_test_and_set(&nb->wake, 0) * BURST_WINDOW_NS / elapsed;
+
+	u64 ewma = nb->enq_ewma;
+	if (ewma == 0)
+		ewma = enq;
+	else
+		ewma = ewma - (ewma >> 3) + (enq >> 3);
+	nb->enq_ewma = ewma;
+
+	u64 k = ewma >> 2;
+	if (enq > ewma + k)
+		nb->cusum_s += enq - ewma - k;
+	else
+		nb->cusum_s >>= 1;
+
+	bool cusum_burst = ewma > 0 && nb->cusum_s > (ewma << 1);
+	bool wake_burst = wake > node_nr_cpus(ns) * BURST_WAKE_PER_CPU;
+	u64 bm = (cusum_burst || wake_burst) ? 1 : 0;
+
+	if (ns->burst_mode != bm) {
+		WRITE_ONCE(ns->burst_mode, bm);
+		emit_event(EVT_BURST, (s32)this_cpu, 0, node, (u8)bm, (u8)!bm,
+			   wake, true);
+	}
 }
 
 // TICK: SOJOURN ENFORCEMENT + EVENT-DRIVEN BATCH PREEMPTION
@@ -1274,33 +2804,28 @@ void BPF_STRUCT_OPS(pandemonium_tick, struct task_struct *p)
 	// SOJOURN: COMPUTE BATCH WAIT AGE AND WRITE TO STATS FOR RUST
 	struct pandemonium_stats *s = get_stats();
 	struct tuning_knobs *knobs = get_knobs();
+	u32 this_cpu = bpf_get_smp_processor_id();
+	s32 this_node = cpu_node((s32)this_cpu);
+	struct node_state *ns = get_node_state(this_node);
 
-	// BURST DETECTION: TOTAL-ENQUEUE CUSUM OR WAKEUP RATE COUNTER.
-	// CUSUM: EFFECTIVE FOR BPF (1MS SLICES) WHERE ENQUEUE RATE SPIKES DURING BURST.
-	// WAKEUP RATE: EFFECTIVE FOR ADAPTIVE (4MS SLICES) WHERE CUSUM IS RATE-BOUNDED.
-	// ABSOLUTE THRESHOLD: nr_cpu_ids * 2 WAKEUPS PER TICK INTERVAL = FORK STORM.
-	// NO CALIBRATION NEEDED -- WORKS IMMEDIATELY ON FIRST TICK.
-	// burst_mode REDUCES SLICE (burst_slice_ns) AND PREEMPT THRESHOLD (0).
-	bool cusum_burst = cusum_interval_ewma > 0 &&
-		cusum_s > (cusum_interval_ewma << 1);
-	u64 wakeups = __sync_fetch_and_add(&wake_rate_count, 0);
-	bool wake_burst = wakeups > (nr_cpu_ids << 1);
-	if (bpf_get_smp_processor_id() == 0)
-		__sync_lock_test_and_set(&wake_rate_count, 0);
-
-	burst_mode = cusum_burst || wake_burst;
+	// BURST DETECTION: FLUSH THIS CPU'S COUNTS, THEN CLOSE THE NODE'S
+	// WINDOW IF IT HAS RUN ITS LENGTH. burst_mode REDUCES SLICE
+	// (burst_slice_ns), DEPTH GATE (1) AND PREEMPT THRESHOLD (0) ON THIS
+	// NODE ONLY.
+	burst_flush(this_cpu, &pcpu_burst[this_cpu & (MAX_CPUS - 1)]);
+	burst_window_close(this_node, ns, this_cpu, bpf_ktime_get_ns());
 
 	if (s) {
 
-#if BURST_COUNTER_TEST
-		if (burst_mode) s->burst_mode_active++;
-#else
-		s->burst_mode_active = burst_mode ? 1 : 0;
-#endif
-		s->longrun_mode_active = longrun_mode ? 1 : 0;
+		// CUMULATIVE: A 1HZ SNAPSHOT WOULD MISS MOST BURSTS. RUST
+		// READS THE DELTA, SO THIS IS A COUNTER, NOT A FLAG.
+		if (ns->burst_mode) s->burst_mode_active++;
+		s->longrun_mode_active = ns->longrun_mode ? 1 : 0;
 	}
 
-	u64 bens = batch_enqueue_ns;
+	// PER-NODE: EACH CPU REPORTS ITS OWN NODE'S BATCH SOJOURN. RUST TAKES
+	// THE MAX ACROSS CPUs, SO THE WORST NODE DRIVES THE ADAPTIVE LAYER.
+	u64 bens = ns->batch_enqueue_ns;
 	if (bens > 0) {
 		u64 now = bpf_ktime_get_ns();
 		u64 sojourn = now - bens;
@@ -1308,10 +2833,17 @@ void BPF_STRUCT_OPS(pandemonium_tick, struct task_struct *p)
 			s->batch_sojourn_ns = sojourn;
 
 		// LONGRUN DETECTION: SUSTAINED BATCH PRESSURE
-		// BATCH DSQ NON-EMPTY FOR > 2S SETS longrun_mode, WHICH
-		// TIGHTENS THE DEFICIT RATIO IN dispatch() FROM nr_cpu_ids*4
-		// TO nr_cpu_ids*1 (QUADRUPLING BATCH'S DISPATCH SHARE).
-		longrun_mode = sojourn > LONGRUN_THRESH_NS;
+		// NODE BATCH DSQ NON-EMPTY FOR > 2S SETS longrun_mode, WHICH
+		// TIGHTENS THE NODE'S DEFICIT RATIO IN dispatch() FROM
+		// nr_cpu_ids*4 TO nr_cpu_ids*1 (QUADRUPLING BATCH'S DISPATCH
+		// SHARE). WRITE ONLY ON CHANGE: THE LINE IS READ BY EVERY
+		// DISPATCH ON THE NODE.
+		u64 lr = sojourn > LONGRUN_THRESH_NS ? 1 : 0;
+		if (ns->longrun_mode != lr &&
+		    __sync_val_compare_and_swap(&ns->longrun_mode, !lr, lr) == !lr)
+			emit_event(EVT_LONGRUN, (s32)this_cpu, 0,
+				   cpu_node((s32)this_cpu), (u8)lr, (u8)!lr,
+				   sojourn, true);
 
 		// SOJOURN ENFORCEMENT: THRESHOLD SET BY RUST ADAPTIVE LAYER
 		// FROM OBSERVED DISPATCH RATE. IF BATCH STARVING PAST THRESHOLD
@@ -1319,7 +2851,13 @@ void BPF_STRUCT_OPS(pandemonium_tick, struct task_struct *p)
 		// ONLY PREEMPT BATCH: INTERACTIVE/LATCRIT SLICES ARE ALREADY
 		// SHORT (CAPPED AT slice_ns) AND WILL YIELD QUICKLY ON THEIR OWN.
 		u64 sojourn_thresh = knobs ? knobs->sojourn_thresh_ns : 5000000;
-		if (sojourn > sojourn_thresh) {
+		u64 over = sojourn > sojourn_thresh ? 1 : 0;
+		if (ns->sojourn_over != over &&
+		    __sync_val_compare_and_swap(&ns->sojourn_over, !over, over) == !over)
+			emit_event(EVT_SOJOURN_CROSS, (s32)this_cpu, 0,
+				   cpu_node((s32)this_cpu), (u8)over, (u8)!over,
+				   sojourn, true);
+		if (over) {
 			struct task_ctx *tctx = lookup_task_ctx(p);
 			if (tctx && tctx->tier == TIER_BATCH) {
 				scx_bpf_kick_cpu(scx_bpf_task_cpu(p), SCX_KICK_PREEMPT);
@@ -1327,49 +2865,94 @@ void BPF_STRUCT_OPS(pandemonium_tick, struct task_struct *p)
 			}
 		}
 	} else {
-		longrun_mode = false;
+		if (ns->longrun_mode &&
+		    __sync_val_compare_and_swap(&ns->longrun_mode, 1, 0) == 1)
+			emit_event(EVT_LONGRUN, (s32)this_cpu, 0,
+				   cpu_node((s32)this_cpu), 0, 1, 0, true);
+		if (ns->sojourn_over &&
+		    __sync_val_compare_and_swap(&ns->sojourn_over, 1, 0) == 1)
+			emit_event(EVT_SOJOURN_CROSS, (s32)this_cpu, 0,
+				   cpu_node((s32)this_cpu), 0, 1, 0, true);
 		if (s)
 			s->batch_sojourn_ns = 0;
 	}
 
-	// PER-CPU DSQ SOJOURN: CHECK OWN DSQ + ROTATING GLOBAL SCAN.
+	// PER-CPU DSQ SOJOURN: CHECK OWN DSQ + NODE BACKLOG SCAN.
 	// LOCAL CHECK: CATCHES STALE TASKS ON THIS CPU.
-	// GLOBAL SCAN: CATCHES STALE TASKS ON IDLE CPUS WHERE tick() NEVER
-	// FIRES. ROTATES 4 CPUS PER TICK SO ALL CPUS GET COVERED OVER TIME.
+	// NODE SCAN: CATCHES STALE TASKS ON IDLE CPUS WHERE tick() NEVER
+	// FIRES. ONLY CPUs SET IN node_backlog ARE PROBED, AT MOST
+	// BACKLOG_PROBES PER TICK FROM A START THAT ROTATES EVERY ~1ms: A NODE
+	// WITH MORE BACKLOGGED CPUs THAN THAT SEES EACH ONE OVER SEVERAL
+	// TICKS (EVERY CPU ON THE NODE RUNS THIS SCAN), NOT ON EVERY TICK.
 	{
-		u32 this_cpu = bpf_get_smp_processor_id();
 		u64 now2 = bpf_ktime_get_ns();
 		u64 pcpu_sojourn_thresh = knobs
 			? knobs->sojourn_thresh_ns : 5000000;
 
 		// LOCAL: OWN PER-CPU DSQ
 		if (this_cpu < MAX_CPUS) {
-			u64 pcpu_oldest = pcpu_enqueue_ns[this_cpu];
+			u64 pcpu_oldest = *pcpu_stamp(this_cpu);
 			if (pcpu_oldest > 0 &&
 			    (now2 - pcpu_oldest) > pcpu_sojourn_thresh) {
 				scx_bpf_kick_cpu(this_cpu,
 						 SCX_KICK_PREEMPT);
+				__sync_fetch_and_add(&pcpu_depth_of(this_cpu)->sojourn_kicks, 1);
 				return;
 			}
 		}
 
-		// GLOBAL: ROTATING SCAN OF REMOTE PER-CPU DSQs
-		// SHIFT BY 20 (~1ms ROTATION) TO AVOID u64 DIVISION.
-		// CONSTANT MODULO (MAX_CPUS) + MASK FOR VERIFIER SAFETY.
-		u32 scan_base = (u32)(now2 >> 20);
-		for (int i = 0; i < 4; i++) {
-			u32 scan_cpu = (scan_base + (u32)i) &
-				       (MAX_CPUS - 1);
-			if (scan_cpu == this_cpu)
+		// NODE: FIND-FIRST-SET OVER THE SUMMARY, THEN OVER EACH
+		// NON-EMPTY WORD IT NAMES. EVERY WORD LOADED HOLDS A BIT TO
+		// PROBE (BAR A STALE SUMMARY BIT OR THIS CPU), SO THE WALK IS
+		// BOUNDED BY BACKLOG_PROBES, NOT BY nr_cpu_ids. THE START WORD
+		// AND THE BIT OFFSET ROTATE (~1ms, SHIFT BY 20) SO A NODE WITH
+		// MORE BACKLOGGED CPUs THAN PROBES HAS EVERY ONE CHECKED IN TURN.
+		struct node_backlog *nb = backlog_of(this_cpu);
+		u32 rot = (u32)(now2 >> 20);
+		u32 shift = rot & 63;
+		u32 start = (rot >> 6) & (BACKLOG_WORDS - 1);
+		u64 sm = READ_ONCE(nb->summary);
+		u64 sm_hi = sm & (~0ULL << start);
+		u64 sm_lo = sm & ~sm_hi;
+		u32 word = 0, probes = 0;
+		u64 w = 0;
+		for (int i = 0; i < 2 * BACKLOG_PROBES + 2; i++) {
+			if (!w) {
+				u64 sbit;
+				if (sm_hi) {
+					sbit = sm_hi & -sm_hi;
+					sm_hi ^= sbit;
+				} else if (sm_lo) {
+					sbit = sm_lo & -sm_lo;
+					sm_lo ^= sbit;
+				} else {
+					break;
+				}
+				word = msb64(sbit);
+				w = READ_ONCE(nb->bits[word & (BACKLOG_WORDS - 1)]);
+				if (shift)
+					w = (w >> shift) | (w << (64 - shift));
 				continue;
-			if (scan_cpu >= nr_cpu_ids)
+			}
+			u64 low = w & -w;
+			w ^= low;
+			u32 scan_cpu = (word << 6) | ((msb64(low) + shift) & 63);
+			if (scan_cpu == this_cpu || scan_cpu >= nr_cpu_ids)
 				continue;
-			u64 remote_stamp =
-				pcpu_enqueue_ns[scan_cpu & (MAX_CPUS - 1)];
+			u64 remote_stamp = *pcpu_stamp(scan_cpu);
 			if (remote_stamp > 0 &&
-			    (now2 - remote_stamp) > pcpu_sojourn_thresh)
-				scx_bpf_kick_cpu(scan_cpu,
-						 SCX_KICK_PREEMPT);
+			    (now2 - remote_stamp) > pcpu_sojourn_thresh) {
+				// DEQUEUED BEHIND OUR BACK: DROP THE STAMP, DON'T KICK
+				if (scx_bpf_dsq_nr_queued((u64)scan_cpu) == 0) {
+					pcpu_clear_if_empty(scan_cpu);
+				} else {
+					scx_bpf_kick_cpu(scan_cpu,
+							 SCX_KICK_PREEMPT);
+					__sync_fetch_and_add(&pcpu_depth_of(scan_cpu)->sojourn_kicks, 1);
+				}
+			}
+			if (++probes >= BACKLOG_PROBES)
+				break;
 		}
 	}
 
@@ -1380,7 +2963,7 @@ void BPF_STRUCT_OPS(pandemonium_tick, struct task_struct *p)
 	if (!tctx)
 		return;
 
-	u64 thresh = burst_mode ? 0 : (knobs ? knobs->preempt_thresh_ns : 1000000);
+	u64 thresh = ns->burst_mode ? 0 : (knobs ? knobs->preempt_thresh_ns : 1000000);
 
 	if (tctx->tier == TIER_BATCH && tctx->avg_runtime >= thresh) {
 		scx_bpf_kick_cpu(scx_bpf_task_cpu(p), SCX_KICK_PREEMPT);
@@ -1408,22 +2991,49 @@ void BPF_STRUCT_OPS(pandemonium_enable, struct task_struct *p)
 		tctx->prev_nvcsw = p->nvcsw;
 		tctx->csw_rate = 0;
 		tctx->lat_cri = 0;
+		tctx->period_ns = 0;
+		tctx->period_dev = 0;
+		tctx->waker_pid = 0;
+		tctx->waker_streak = 0;
 		tctx->tier = TIER_INTERACTIVE;
 		tctx->ewma_age = 0;
 		tctx->dispatch_path = 0;
-
-		// PROCDB: APPLY LEARNED CLASSIFICATION FROM PRIOR RUNS
-		char key[16];
-		__builtin_memcpy(key, p->comm, 16);
+		tctx->cg_queued = 0;
+		tctx->policy = 0;
+		tctx->reclass_left = 0;
+		tctx->cgid = task_cgid(p);
+		task_policy_resolve(p, tctx, task_comm_sig(p),
+				    (u32)READ_ONCE(policy_gen));
+		p->scx.dsq_vtime = task_vtime_base(tctx);
+
+		// PROCDB: APPLY LEARNED CLASSIFICATION FROM PRIOR RUNS.
+		// EXACT (EXECUTABLE, comm[, CGROUP]) PROFILE FIRST, THEN THE
+		// comm-ONLY FALLBACK.
+		struct task_class_key key = {};
+		task_class_key_of(p, tctx, &key);
 		struct task_class_entry *init_entry =
-		    bpf_map_lookup_elem(&task_class_init, key);
+		    bpf_map_lookup_elem(&task_class_init, &key);
+		if (!init_entry && (key.exe_id || key.cgid)) {
+			key.exe_id = 0;
+			key.cgid = 0;
+			init_entry = bpf_map_lookup_elem(&task_class_init, &key);
+		}
 		if (init_entry) {
 			tctx->tier = (u32)init_entry->tier;
 			tctx->avg_runtime = init_entry->avg_runtime;
 			tctx->runtime_dev = init_entry->runtime_dev;
 			tctx->wakeup_freq = init_entry->wakeup_freq;
 			tctx->csw_rate = init_entry->csw_rate;
+			// A LEARNED PERIOD STARTS INSIDE THE DEVIATION BAND
+			if (init_entry->period_us) {
+				tctx->period_ns = (u64)init_entry->period_us * 1000;
+				tctx->period_dev = tctx->period_ns >>
+						   (PERIOD_DEV_SHIFT + 1);
+			}
 			tctx->cached_weight = effective_weight(p, tctx);
+			tctx->policy |= TASK_F_PROCDB;
+			if (periodic_deadline && task_periodic(tctx))
+				tctx->policy |= TASK_F_PERIODIC;
 			struct pandemonium_stats *s = get_stats();
 			if (s)
 				s->nr_procdb_hits += 1;
@@ -1431,6 +3041,60 @@ void BPF_STRUCT_OPS(pandemonium_enable, struct task_struct *p)
 	}
 }
 
+// CORE-COUNT-SCALED THRESHOLDS FOR n ONLINE CPUs.
+// MIRRORED BY tuning::scale_knobs() IN RUST -- KEEP THE FORMULAS IN SYNC.
+static void scale_for_cpus(u64 n)
+{
+	u64 budget, starve, overflow;
+
+	// ANTI-STARVATION BUDGET: SCALE RATIO WITH CORE COUNT
+	// 2C: RATIO=3 (BUDGET=6), 4C+: RATIO=4 (SAME AS BEFORE)
+	{
+		u64 ratio = 2 + (n >> 1);
+		if (ratio > 4) ratio = 4;
+		budget = n * ratio;
+		if (budget < 2) budget = 2;
+	}
+
+	// STARVATION RESCUE: MIN OF TWO LINEAR FUNCTIONS
+	// linear_up: SHORT AT LOW CORES (FAST STARVATION)
+	// linear_down: SHORT AT HIGH CORES (DISPATCH CONTENTION)
+	// 2C: 50MS, 4C: 100MS, 8C: 200MS, 12C: 167MS, 128C: 20MS
+	{
+		u64 linear_up = n * 25000000ULL;
+		u64 sr_divisor = n / 4;
+		if (sr_divisor < 1) sr_divisor = 1;
+		u64 linear_down = 500000000ULL / sr_divisor;
+		starve = linear_up < linear_down ? linear_up : linear_down;
+		if (starve < 20000000ULL)
+			starve = 20000000ULL;
+		if (starve > 500000000ULL)
+			starve = 500000000ULL;
+	}
+
+	// OVERFLOW SOJOURN RESCUE: SCALE WITH CORE COUNT
+	// 2C: 4MS, 4C: 8MS, 5C+: 10MS (CAPPED AT OLD STATIC VALUE)
+	overflow = n * 2000000ULL;
+	if (overflow < 4000000ULL)
+		overflow = 4000000ULL;
+	if (overflow > 10000000ULL)
+		overflow = 10000000ULL;
+
+	WRITE_ONCE(scale_knobs.interactive_budget, budget);
+	WRITE_ONCE(scale_knobs.starvation_rescue_ns, starve);
+	WRITE_ONCE(scale_knobs.overflow_sojourn_rescue_ns, overflow);
+	// PER-CPU DSQ DEPTH GATE: 1 BELOW 4 CPUS, 2 AT 4+
+	WRITE_ONCE(scale_knobs.pcpu_depth_base, (n < 4) ? 1 : 2);
+	WRITE_ONCE(scale_knobs.nr_cpus, n);
+}
+
+// HOTPLUG: BPF KEEPS THE SCALING CURRENT ONLY WHILE RUST HASN'T CLAIMED IT
+static __always_inline void rescale_for_hotplug(u64 n)
+{
+	if (READ_ONCE(scale_knobs.owner) != SCALE_OWNER_RUST)
+		scale_for_cpus(n);
+}
+
 // INIT: DETECT TOPOLOGY, CREATE DSQs, CALIBRATE
 s32 BPF_STRUCT_OPS_SLEEPABLE(pandemonium_init)
 {
@@ -1446,7 +3110,7 @@ s32 BPF_STRUCT_OPS_SLEEPABLE(pandemonium_init)
 	// SELECT_CPU DISPATCHES TO PER-CPU DSQ (CACHE-HOT, VISIBLE, STEALABLE).
 	// ENQUEUE ALWAYS USES SHARED NODE DSQ (EVEN DISTRIBUTION).
 	// VISIBILITY LAYERS:
-	//   1. L2 WORK STEALING IN DISPATCH -- IDLE CPUs PULL FROM SIBLINGS
+	//   1. L2/L3 WORK STEALING IN DISPATCH -- IDLE CPUs PULL FROM SIBLINGS
 	//   2. ROTATING TICK SCAN -- CATCHES STALE TASKS ON IDLE CPUs
 	//   3. PER-CPU SOJOURN RESCUE -- THRESHOLD CEILING ON INVISIBILITY
 	for (u32 i = 0; i < nr_cpu_ids && i < MAX_CPUS; i++)
@@ -1460,52 +3124,59 @@ s32 BPF_STRUCT_OPS_SLEEPABLE(pandemonium_init)
 	for (u32 i = 0; i < nr_nodes && i < MAX_NODES; i++)
 		scx_bpf_create_dsq(nr_cpu_ids + nr_nodes + i, (s32)i);
 
-	// ANTI-STARVATION BUDGET: SCALE RATIO WITH CORE COUNT
-	// 2C: RATIO=3 (BUDGET=6), 4C+: RATIO=4 (SAME AS BEFORE)
-	{
-		u64 ratio = 2 + (nr_cpu_ids >> 1);
-		if (ratio > 4) ratio = 4;
-		interactive_budget = nr_cpu_ids * ratio;
-		if (interactive_budget < 2) interactive_budget = 2;
+	// DEFAULT STEAL ORDER: REMOTE NODES IN INDEX ORDER, DISTANCE UNKNOWN.
+	// RUST REPLACES THIS WITH THE SYSFS NEAREST-FIRST ORDER AFTER ATTACH.
+	for (u32 i = 0; i < nr_nodes && i < MAX_NODES; i++) {
+		u32 slot = 0;
+		for (u32 j = 0; j < nr_nodes && j < MAX_NODES; j++) {
+			if (j == i)
+				continue;
+			u32 key = i * MAX_NODES + slot;
+			struct node_steal_entry e = { .node = j, .distance = 0 };
+			bpf_map_update_elem(&node_steal_order, &key, &e, BPF_ANY);
+			slot++;
+		}
+		if (slot < MAX_NODES) {
+			u32 key = i * MAX_NODES + slot;
+			struct node_steal_entry e = { .node = (u32)-1, .distance = 0 };
+			bpf_map_update_elem(&node_steal_order, &key, &e, BPF_ANY);
+		}
 	}
 
-	// STARVATION RESCUE: MIN OF TWO LINEAR FUNCTIONS
-	// linear_up: SHORT AT LOW CORES (FAST STARVATION)
-	// linear_down: SHORT AT HIGH CORES (DISPATCH CONTENTION)
-	// 2C: 50MS, 4C: 100MS, 8C: 200MS, 12C: 167MS, 128C: 20MS
-	{
-		u64 linear_up = nr_cpu_ids * 25000000ULL;
-		u64 sr_divisor = nr_cpu_ids / 4;
-		if (sr_divisor < 1) sr_divisor = 1;
-		u64 linear_down = 500000000ULL / sr_divisor;
-		starvation_rescue_ns = linear_up < linear_down
-			? linear_up : linear_down;
-		if (starvation_rescue_ns < 20000000ULL)
-			starvation_rescue_ns = 20000000ULL;
-		if (starvation_rescue_ns > 500000000ULL)
-			starvation_rescue_ns = 500000000ULL;
+	// EMPTY L3 GROUPS UNTIL RUST PUBLISHES THE SYSFS TOPOLOGY
+	for (u32 i = 0; i < nr_l3_rows && i < MAX_CPUS; i++) {
+		u32 key = i * l3_stride;
+		u32 end = (u32)-1;
+		bpf_map_update_elem(&l3_siblings, &key, &end, BPF_ANY);
 	}
 
-	// OVERFLOW SOJOURN RESCUE: SCALE WITH CORE COUNT
-	// 2C: 4MS, 4C: 8MS, 5C+: 10MS (CAPPED AT OLD STATIC VALUE)
-	overflow_sojourn_rescue_ns = nr_cpu_ids * 2000000ULL;
-	if (overflow_sojourn_rescue_ns < 4000000ULL)
-		overflow_sojourn_rescue_ns = 4000000ULL;
-	if (overflow_sojourn_rescue_ns > 10000000ULL)
-		overflow_sojourn_rescue_ns = 10000000ULL;
-
-	// PER-CPU DSQ DEPTH GATE: 1 BELOW 4 CPUS, 2 AT 4+
-	pcpu_depth_base = (nr_cpu_ids < 4) ? 1 : 2;
-
-	// CUSUM BURST DETECTION: CALIBRATES ON FIRST 64 ENQUEUES
-	cusum_last_check_ns = bpf_ktime_get_ns();
-	cusum_interval_ewma = 0;
-	cusum_s = 0;
-	burst_mode = false;
-	longrun_mode = false;
-
-	// WAKEUP RATE COUNTER: NO CALIBRATION NEEDED
-	wake_rate_count = 0;
+	// SCALE FROM THE ONLINE COUNT: POSSIBLE-BUT-OFFLINE CPUs NEVER DISPATCH.
+	// THE HOTPLUG CALLBACKS KEEP nr_online_cpus CURRENT AND RE-SCALE.
+	{
+		const struct cpumask *online = scx_bpf_get_online_cpumask();
+		nr_online_cpus = bpf_cpumask_weight(online);
+		for (u32 i = 0; i < nr_cpu_ids && i < MAX_CPUS; i++) {
+			if (bpf_cpumask_test_cpu(i, online))
+				get_node_state(cpu_node((s32)i))->nr_cpus++;
+		}
+		scx_bpf_put_cpumask(online);
+		if (nr_online_cpus < 1 || nr_online_cpus > nr_cpu_ids)
+			nr_online_cpus = nr_cpu_ids;
+	}
+	scale_knobs.owner = SCALE_OWNER_BPF;
+	scale_for_cpus(nr_online_cpus);
+
+	// BURST DETECTION: CUSUM CALIBRATES ON EACH NODE'S FIRST WINDOW,
+	// THE WAKEUP RATE NEEDS NO CALIBRATION
+	u64 init_ns = bpf_ktime_get_ns();
+	for (u32 i = 0; i < MAX_NODES; i++) {
+		node_state[i].longrun_mode = 0;
+		node_state[i].sojourn_over = 0;
+		node_state[i].burst_mode = 0;
+		node_burst[i].window_ns = init_ns;
+		node_burst[i].enq_ewma = 0;
+		node_burst[i].cusum_s = 0;
+	}
 
 	// INITIALIZE DEFAULT TUNING KNOBS
 	struct tuning_knobs *knobs = bpf_map_lookup_elem(&tuning_knobs_map, &zero);
@@ -1520,7 +3191,16 @@ s32 BPF_STRUCT_OPS_SLEEPABLE(pandemonium_init)
 		knobs->affinity_mode = 0;                // OFF BY DEFAULT (RUST SETS PER REGIME)
 		knobs->sojourn_thresh_ns = 5000000;      // 5MS DEFAULT (RUST OVERRIDES)
 		knobs->burst_slice_ns = 1000000;         // 1MS DEFAULT (BURST/LONGRUN CEILING)
+		knobs->smt_mode = 0;                     // OFF BY DEFAULT (RUST SETS PER REGIME)
+
+		// EVERY SLOT STARTS SANE; knob_gen = 0 SELECTS SLOT 0
+		for (u32 i = 1; i < KNOB_SLOTS; i++) {
+			struct tuning_knobs *k = bpf_map_lookup_elem(&tuning_knobs_map, &i);
+			if (k)
+				*k = *knobs;
+		}
 	}
+	knob_gen = 0;
 
 	return 0;
 }
@@ -1536,8 +3216,74 @@ void BPF_STRUCT_OPS(pandemonium_quiescent, struct task_struct *p,
 		    u64 deq_flags)
 {
 	struct task_ctx *tctx = lookup_task_ctx(p);
-	if (tctx)
+	if (tctx) {
 		tctx->sleep_start_ns = bpf_ktime_get_ns();
+		cgrp_task_leave(tctx);
+	}
+}
+
+// CGROUP INIT: RECORD cpu.weight AND THE PARENT LINK. CALLED PARENT FIRST
+// FOR EVERY EXISTING CGROUP AT LOAD, THEN ON EACH mkdir. NEVER FAILS: A
+// CGROUP THAT DOES NOT FIT IN cgrp_ctx_map SCHEDULES FLAT.
+s32 BPF_STRUCT_OPS_SLEEPABLE(pandemonium_cgroup_init, struct cgroup *cgrp,
+			     struct scx_cgroup_init_args *args)
+{
+	struct cgrp_ctx cgc = {};
+	u64 cgid = cgrp->kn->id;
+
+	cgc.weight = args->weight ? args->weight : CGRP_WEIGHT_DFL;
+	cgc.vtime = vtime_now;
+	if (cgrp->level > 0) {
+		struct cgroup *parent = bpf_cgroup_ancestor(cgrp, cgrp->level - 1);
+		if (parent) {
+			cgc.parent = parent->kn->id;
+			bpf_cgroup_release(parent);
+		}
+	}
+	bpf_map_update_elem(&cgrp_ctx_map, &cgid, &cgc, BPF_ANY);
+	return 0;
+}
+
+// CGROUP EXIT: rmdir. AN EMPTY CGROUP HAS NO RUNNABLE TASKS TO UNWIND.
+void BPF_STRUCT_OPS(pandemonium_cgroup_exit, struct cgroup *cgrp)
+{
+	u64 cgid = cgrp->kn->id;
+	bpf_map_delete_elem(&cgrp_ctx_map, &cgid);
+}
+
+// CGROUP MOVE: CARRY A RUNNABLE TASK'S WEIGHT TO ITS NEW CGROUP
+void BPF_STRUCT_OPS(pandemonium_cgroup_move, struct task_struct *p,
+		    struct cgroup *from, struct cgroup *to)
+{
+	struct task_ctx *tctx = lookup_task_ctx(p);
+	if (!tctx)
+		return;
+
+	bool queued = tctx->cg_queued;
+	if (queued)
+		cgrp_task_leave(tctx);
+	tctx->cgid = to->kn->id;
+	if (queued)
+		cgrp_task_join(tctx, tctx->cg_weight);
+}
+
+// CGROUP SET WEIGHT: cpu.weight WRITE. AN ACTIVE CGROUP ALSO MOVES ITS
+// PARENT'S ACTIVE CHILD WEIGHT; EVERY CACHED hweight IS INVALIDATED.
+void BPF_STRUCT_OPS(pandemonium_cgroup_set_weight, struct cgroup *cgrp,
+		    u32 weight)
+{
+	u64 cgid = cgrp->kn->id;
+	struct cgrp_ctx *cgc = lookup_cgrp_ctx(cgid);
+	if (!cgc)
+		return;
+
+	if (cgc->nr_tasks || cgc->nr_active_children) {
+		struct cgrp_ctx *pc = lookup_cgrp_ctx(cgc->parent);
+		if (pc)
+			__sync_fetch_and_add(&pc->child_wsum, weight - cgc->weight);
+	}
+	cgc->weight = weight;
+	__sync_fetch_and_add(&cgrp_hweight_gen, 1);
 }
 
 // CPU RELEASE: RESCUE STRANDED TASKS WHEN RT/DL PREEMPTS OUR CPU
@@ -1557,8 +3303,90 @@ void BPF_STRUCT_OPS(pandemonium_cpu_release, s32 cpu,
 }
 
 // CPU HOTPLUG CALLBACKS
-void BPF_STRUCT_OPS(pandemonium_cpu_online, s32 cpu) {}
-void BPF_STRUCT_OPS(pandemonium_cpu_offline, s32 cpu) {}
+// DEFINED SO sched_ext DOESN'T AUTO-EXIT ON CPU RESTRICTION, AND SO THE
+// CORE-COUNT-SCALED STATE FOLLOWS THE ONLINE SET. BOTH RE-SCALE THE DRR
+// BUDGET AND RESCUE THRESHOLDS (UNLESS RUST OWNS scale_knobs) AND WAKE
+// RUST WITH EVT_HOTPLUG, WHICH RE-DETECTS TOPOLOGY (L2/L3 GROUPS, STEAL
+// ORDER) AND RE-DERIVES ITS CPU-SCALED KNOBS FROM THE NEW ONLINE COUNT.
+void BPF_STRUCT_OPS(pandemonium_cpu_online, s32 cpu)
+{
+	s32 node = cpu_node(cpu);
+	__sync_fetch_and_add(&get_node_state(node)->nr_cpus, 1);
+
+	u64 n = __sync_add_and_fetch(&nr_online_cpus, 1);
+	if (n > nr_cpu_ids)
+		n = nr_cpu_ids;
+	rescale_for_hotplug(n);
+	emit_event(EVT_HOTPLUG, cpu, 0, node, 1, 0, 0, true);
+}
+
+// OFFLINE: NOTHING WILL EVER DISPATCH FROM THIS CPU'S DSQ AGAIN. MOVE
+// ITS TASKS TO THE NODE OVERFLOW DSQs, KEEPING THEIR DEADLINES (ALL DSQs
+// ARE VTIME-ORDERED) AND THEIR SOJOURN AGE, THEN CLEAR THE STALE STAMP
+// THAT WOULD OTHERWISE KEEP TRIGGERING PER-CPU SOJOURN RESCUE.
+void BPF_STRUCT_OPS(pandemonium_cpu_offline, s32 cpu)
+{
+	struct task_struct *p;
+	s32 node = cpu_node(cpu);
+	struct node_state *ns = get_node_state(node);
+	u64 int_dsq = nr_cpu_ids + (u64)node;
+	u64 bat_dsq = nr_cpu_ids + nr_nodes + (u64)node;
+	u64 since = *pcpu_stamp((u32)cpu);
+	u64 moved = 0;
+
+	if (!since)
+		since = bpf_ktime_get_ns();
+
+	bpf_for_each(scx_dsq, p, (u64)cpu, 0) {
+		struct task_ctx *tctx = lookup_task_ctx(p);
+		u64 dsq = (tctx && tctx->tier == TIER_BATCH) ? bat_dsq : int_dsq;
+		if (!__COMPAT_scx_bpf_dsq_move_vtime(BPF_FOR_EACH_ITER, p, dsq, 0))
+			continue;
+		if (dsq == bat_dsq)
+			__sync_val_compare_and_swap(&ns->batch_enqueue_ns, 0, since);
+		else
+			__sync_val_compare_and_swap(&ns->interactive_enqueue_ns, 0, since);
+		moved++;
+	}
+
+	*pcpu_stamp((u32)cpu) = 0;
+	pcpu_note_insert((u32)cpu, 0);
+	pcpu_backlog_clear((u32)cpu);
+
+	if (ns->nr_cpus > 0)
+		__sync_fetch_and_sub(&ns->nr_cpus, 1);
+
+	u64 n = __sync_sub_and_fetch(&nr_online_cpus, 1);
+	if (n < 1 || n > nr_cpu_ids)
+		n = 1;
+	rescale_for_hotplug(n);
+
+	struct pandemonium_stats *s = get_stats();
+	if (s)
+		s->nr_hotplug_drained += moved;
+	emit_event(EVT_HOTPLUG, cpu, 0, node, 0, 1, moved, true);
+}
+
+// UPDATE_IDLE: IDLE-STATE TRACKING FOR --idle-aware (SEE cpu_idle_since).
+// RUNS ON cpu ITSELF. THE BUILT-IN IDLE MASKS STAY ON
+// (SCX_OPS_KEEP_BUILTIN_IDLE); THIS ONLY ADDS TIMESTAMPS.
+void BPF_STRUCT_OPS(pandemonium_update_idle, s32 cpu, bool idle)
+{
+	if (!idle_aware || cpu < 0 || cpu >= MAX_CPUS)
+		return;
+	if (!idle) {
+		cpu_idle_since[cpu] = 0;
+		return;
+	}
+	cpu_idle_since[cpu] = bpf_ktime_get_ns();
+
+	s32 node = cpu_node(cpu);
+	if (node < 0 || node >= MAX_NODES)
+		return;
+	struct idle_ring *r = &idle_ring[node];
+	u32 slot = __sync_fetch_and_add(&r->head, 1);
+	r->cpu[slot & (IDLE_RING_SLOTS - 1)] = (u32)cpu;
+}
 
 SCX_OPS_DEFINE(pandemonium_ops,
 	       .select_cpu   = (void *)pandemonium_select_cpu,
@@ -1570,10 +3398,18 @@ SCX_OPS_DEFINE(pandemonium_ops,
 	       .tick         = (void *)pandemonium_tick,
 	       .enable       = (void *)pandemonium_enable,
 	       .quiescent    = (void *)pandemonium_quiescent,
+	       .cgroup_init  = (void *)pandemonium_cgroup_init,
+	       .cgroup_exit  = (void *)pandemonium_cgroup_exit,
+	       .cgroup_move  = (void *)pandemonium_cgroup_move,
+	       .cgroup_set_weight = (void *)pandemonium_cgroup_set_weight,
 	       .cpu_release  = (void *)pandemonium_cpu_release,
 	       .cpu_online   = (void *)pandemonium_cpu_online,
 	       .cpu_offline  = (void *)pandemonium_cpu_offline,
+	       .update_idle  = (void *)pandemonium_update_idle,
 	       .init         = (void *)pandemonium_init,
 	       .exit         = (void *)pandemonium_exit,
-	       .flags        = SCX_OPS_BUILTIN_IDLE_PER_NODE,
+	       // SCX_OPS_HAS_CGROUP_WEIGHT IS OR'D IN AT LOAD BY Scheduler::init()
+	       // (__COMPAT_ENUM_OR_ZERO): NEWER KERNELS DEPRECATE OR DROP IT
+	       .flags        = SCX_OPS_BUILTIN_IDLE_PER_NODE |
+			       SCX_OPS_KEEP_BUILTIN_IDLE,
 	       .name         = "pandemonium");
\ No newline at end of file
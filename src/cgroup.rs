@@ -0,0 +1,227 @@
+// PANDEMONIUM PER-CGROUP ACCOUNTING
+// BPF AGGREGATES WAKEUP LATENCY, RUNTIME, RUNS AND RESCUES PER CGROUP IN
+// cgrp_stats_map (LRU HASH, KEYED BY CGROUP V2 ID). RUST SNAPSHOTS THE MAP
+// ONCE PER REPORT PERIOD, DIFFS AGAINST THE PREVIOUS SNAPSHOT, AND RANKS
+// CGROUPS SO TELEMETRY NAMES THE SERVICE THAT OWNS THE CPU AND THE TAIL.
+
+use std::collections::HashMap;
+use std::os::unix::fs::MetadataExt;
+use std::path::Path;
+
+use crate::tuning::{compute_p99_from_histogram, HIST_BUCKETS};
+
+// MATCHES CGRP_HWEIGHT_ONE IN intf.h: hweight OF THE WHOLE MACHINE
+pub const HWEIGHT_ONE: u64 = 1 << 16;
+
+const CGROUP_ROOT: &str = "/sys/fs/cgroup";
+const MAX_WALK_DEPTH: usize = 8;
+
+// MATCHES struct cgrp_stats IN intf.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct CgroupStats {
+    pub runtime_ns: u64,
+    pub nr_runs: u64,
+    pub nr_rescues: u64,
+    pub wake_lat_sum: u64,
+    pub wake_lat_cnt: u64,
+    pub batch_lat_sum: u64,
+    pub batch_lat_cnt: u64,
+    pub hweight: u64,
+    pub lat_hist: [u64; HIST_BUCKETS],
+}
+
+impl Default for CgroupStats {
+    fn default() -> Self {
+        Self {
+            runtime_ns: 0,
+            nr_runs: 0,
+            nr_rescues: 0,
+            wake_lat_sum: 0,
+            wake_lat_cnt: 0,
+            batch_lat_sum: 0,
+            batch_lat_cnt: 0,
+            hweight: 0,
+            lat_hist: [0; HIST_BUCKETS],
+        }
+    }
+}
+
+impl CgroupStats {
+    pub fn parse(bytes: &[u8]) -> Option<Self> {
+        if bytes.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        Some(unsafe { std::ptr::read_unaligned(bytes.as_ptr() as *const Self) })
+    }
+
+    // WINDOW DELTA. A COUNTER THAT WENT BACKWARDS MEANS THE LRU EVICTED AND
+    // RE-INSERTED THE CGROUP: THE NEW VALUE IS THE WHOLE DELTA.
+    // hweight IS A GAUGE AND CARRIES THROUGH AS-IS.
+    pub fn delta(&self, prev: &Self) -> Self {
+        fn d(cur: u64, prev: u64) -> u64 {
+            if cur >= prev {
+                cur - prev
+            } else {
+                cur
+            }
+        }
+        let mut lat_hist = [0u64; HIST_BUCKETS];
+        for b in 0..HIST_BUCKETS {
+            lat_hist[b] = d(self.lat_hist[b], prev.lat_hist[b]);
+        }
+        Self {
+            runtime_ns: d(self.runtime_ns, prev.runtime_ns),
+            nr_runs: d(self.nr_runs, prev.nr_runs),
+            nr_rescues: d(self.nr_rescues, prev.nr_rescues),
+            wake_lat_sum: d(self.wake_lat_sum, prev.wake_lat_sum),
+            wake_lat_cnt: d(self.wake_lat_cnt, prev.wake_lat_cnt),
+            batch_lat_sum: d(self.batch_lat_sum, prev.batch_lat_sum),
+            batch_lat_cnt: d(self.batch_lat_cnt, prev.batch_lat_cnt),
+            hweight: self.hweight,
+            lat_hist,
+        }
+    }
+}
+
+// ONE CGROUP'S ACTIVITY OVER A REPORT WINDOW
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct CgroupUsage {
+    pub id: u64,
+    pub runtime_ns: u64,
+    pub runs: u64,
+    pub rescues: u64,
+    pub wake_avg_ns: u64,
+    pub batch_wait_avg_ns: u64,
+    pub p99_ns: u64,
+    pub share_pct: Option<u64>,
+}
+
+impl CgroupUsage {
+    pub fn from_delta(id: u64, d: &CgroupStats) -> Self {
+        Self {
+            id,
+            runtime_ns: d.runtime_ns,
+            runs: d.nr_runs,
+            rescues: d.nr_rescues,
+            wake_avg_ns: if d.wake_lat_cnt > 0 {
+                d.wake_lat_sum / d.wake_lat_cnt
+            } else {
+                0
+            },
+            batch_wait_avg_ns: if d.batch_lat_cnt > 0 {
+                d.batch_lat_sum / d.batch_lat_cnt
+            } else {
+                0
+            },
+            p99_ns: compute_p99_from_histogram(&d.lat_hist),
+            share_pct: if d.hweight > 0 {
+                Some(d.hweight * 100 / HWEIGHT_ONE)
+            } else {
+                None
+            },
+        }
+    }
+
+    pub fn is_idle(&self) -> bool {
+        self.runtime_ns == 0 && self.runs == 0
+    }
+}
+
+// RANK: MOST CPU TIME FIRST, WORST P99 BREAKS TIES. IDLE CGROUPS DROPPED.
+pub fn rank_top_n(mut usage: Vec<CgroupUsage>, n: usize) -> Vec<CgroupUsage> {
+    usage.retain(|u| !u.is_idle());
+    usage.sort_by(|a, b| {
+        b.runtime_ns
+            .cmp(&a.runtime_ns)
+            .then(b.p99_ns.cmp(&a.p99_ns))
+            .then(a.id.cmp(&b.id))
+    });
+    usage.truncate(n);
+    usage
+}
+
+pub struct CgroupTracker {
+    prev: HashMap<u64, CgroupStats>,
+    names: HashMap<u64, String>,
+}
+
+impl CgroupTracker {
+    pub fn new() -> Self {
+        Self {
+            prev: HashMap::new(),
+            names: HashMap::new(),
+        }
+    }
+
+    // FEED ONE FULL MAP SNAPSHOT. RETURNS EACH CGROUP'S USAGE SINCE THE
+    // PREVIOUS CALL. CGROUPS MISSING FROM THE SNAPSHOT (EVICTED) ARE FORGOTTEN.
+    pub fn update(&mut self, snapshot: Vec<(u64, CgroupStats)>) -> Vec<CgroupUsage> {
+        let mut next = HashMap::with_capacity(snapshot.len());
+        let mut usage = Vec::with_capacity(snapshot.len());
+        for (id, cur) in snapshot {
+            let d = match self.prev.get(&id) {
+                Some(prev) => cur.delta(prev),
+                None => cur,
+            };
+            usage.push(CgroupUsage::from_delta(id, &d));
+            next.insert(id, cur);
+        }
+        self.prev = next;
+        usage
+    }
+
+    // CGROUP PATH RELATIVE TO THE V2 MOUNT. A CGROUP'S ID IS ITS DIRECTORY'S
+    // INODE NUMBER; ON A MISS, RE-INDEX THE HIERARCHY ONCE.
+    pub fn name(&mut self, id: u64) -> String {
+        if let Some(n) = self.names.get(&id) {
+            return n.clone();
+        }
+        index_cgroups(Path::new(CGROUP_ROOT), "", 0, &mut self.names);
+        self.names
+            .entry(id)
+            .or_insert_with(|| format!("cgroup:{}", id))
+            .clone()
+    }
+}
+
+fn index_cgroups(dir: &Path, rel: &str, depth: usize, out: &mut HashMap<u64, String>) {
+    if let Ok(meta) = std::fs::metadata(dir) {
+        let name = if rel.is_empty() { "/".to_string() } else { rel.to_string() };
+        out.insert(meta.ino(), name);
+    }
+    if depth >= MAX_WALK_DEPTH {
+        return;
+    }
+    let entries = match std::fs::read_dir(dir) {
+        Ok(e) => e,
+        Err(_) => return,
+    };
+    for entry in entries.flatten() {
+        if !entry.file_type().map(|t| t.is_dir()).unwrap_or(false) {
+            continue;
+        }
+        let child = format!("{}/{}", rel, entry.file_name().to_string_lossy());
+        index_cgroups(&entry.path(), &child, depth + 1, out);
+    }
+}
+
+// ONE TELEMETRY ENTRY: name run=MS d=RUNS wake=US p99=US bwait=US rescue=N
+// share=PCT (cpu.weight SHARE; OMITTED FOR CGROUPS SCHEDULED FLAT)
+pub fn format_usage(name: &str, u: &CgroupUsage) -> String {
+    let share = match u.share_pct {
+        Some(pct) => format!(" share={}%", pct),
+        None => String::new(),
+    };
+    format!(
+        "{} run={}ms d={} wake={}us p99={}us bwait={}us rescue={}{}",
+        name,
+        u.runtime_ns / 1_000_000,
+        u.runs,
+        u.wake_avg_ns / 1000,
+        u.p99_ns / 1000,
+        u.batch_wait_avg_ns / 1000,
+        u.rescues,
+        share,
+    )
+}
@@ -0,0 +1,35 @@
+// PANDEMONIUM FLIGHT RECORDING VIEWER
+// flight FILE: PRINT THE RECORDED CONTROL TICKS (ROTATED FILES FIRST)
+// IN THE --dump-log FORMAT, FOR POST-MORTEMS OF A LIVE OR DEAD SCHEDULER.
+
+use std::path::Path;
+
+use anyhow::Result;
+
+use pandemonium::event::{dump_snapshots, Snapshot};
+use pandemonium::flight::read_flight_set;
+
+use crate::controller::DECISION_MASK;
+
+pub fn run_flight(path: &Path, last: Option<usize>) -> Result<()> {
+    let snaps: Vec<Snapshot> = read_flight_set(path)?;
+    let skip = match last {
+        Some(n) => snaps.len().saturating_sub(n),
+        None => 0,
+    };
+    log_info!(
+        "FLIGHT: {} TICKS IN {}, SHOWING {}",
+        snaps.len(),
+        path.display(),
+        snaps.len() - skip
+    );
+    if snaps.len() > skip {
+        dump_snapshots(snaps[skip..].iter());
+    }
+    let decided = snaps[skip..]
+        .iter()
+        .filter(|s| s.decisions & DECISION_MASK != 0)
+        .count();
+    println!("TICKS WITH CONTROLLER DECISIONS: {}", decided);
+    Ok(())
+}
@@ -2,7 +2,10 @@ pub mod bench;
 pub mod check;
 pub mod child_guard;
 pub mod death_pipe;
+pub mod flight;
 pub mod probe;
+pub mod procdb;
+pub mod replay;
 pub mod report;
 pub mod run;
 pub mod stress;
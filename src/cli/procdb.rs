@@ -0,0 +1,153 @@
+// PANDEMONIUM PROCDB FLEET TOOLS
+// export: LOCAL STORE -> PORTABLE procdb.bin (CONFIDENT PROFILES, HOST TAG)
+// import: procdb.bin -> LOCAL STORE (MERGED, SCHEDULER MUST BE STOPPED)
+// merge:  N x procdb.bin -> ONE GOLDEN procdb.bin (VOTES POOLED, RE-SCORED)
+//
+// cgroup-KEYED PROFILES NEVER LEAVE THE HOST: CGROUP IDS ARE PER-BOOT.
+// EXECUTABLE-KEYED PROFILES ONLY MATCH ON HOSTS BUILT FROM THE SAME IMAGE
+// (SAME DEVICE + INODE), SO export KEEPS JUST THE comm-ONLY FALLBACKS
+// UNLESS --with-exact.
+
+use std::path::{Path, PathBuf};
+
+use anyhow::{bail, Result};
+
+use crate::procdb::{HostTag, ProcessDb, ProfileKey, MIN_CONFIDENCE};
+use crate::procstore::ProfileStore;
+use crate::topology::CpuTopology;
+
+fn local_tag() -> HostTag {
+    let nr_cpus = libbpf_rs::num_possible_cpus().unwrap_or(1);
+    match CpuTopology::detect(nr_cpus) {
+        Ok(topo) => topo.host_tag(),
+        Err(e) => {
+            log_warn!("TOPOLOGY DETECTION FAILED ({}): SNAPSHOT UNTAGGED", e);
+            HostTag::default()
+        }
+    }
+}
+
+fn portable(key: &ProfileKey, with_exact: bool) -> bool {
+    key.cgid == 0 && (with_exact || key.is_fallback())
+}
+
+fn check_tag(what: &Path, theirs: &HostTag, ours: &HostTag, force: bool) -> Result<()> {
+    if ours.compatible(theirs) {
+        return Ok(());
+    }
+    if force {
+        log_warn!(
+            "{}: LEARNED ON {} (THIS: {}), MERGING ANYWAY (--force)",
+            what.display(),
+            theirs,
+            ours
+        );
+        return Ok(());
+    }
+    bail!(
+        "{}: LEARNED ON {}, INCOMPATIBLE WITH {} (--force TO OVERRIDE)",
+        what.display(),
+        theirs,
+        ours
+    );
+}
+
+pub fn run_export(out: &Path, with_exact: bool) -> Result<()> {
+    // READ, DON'T LOCK: EXPORT WORKS WHILE THE SCHEDULER IS RUNNING
+    let store_path = ProcessDb::store_path();
+    let mut db = ProcessDb::detached(None);
+    let records = ProfileStore::read_records(&store_path)?;
+    let source = if records.is_empty() {
+        db.profiles = ProcessDb::load_from_disk(&ProcessDb::default_path())?;
+        ProcessDb::default_path()
+    } else {
+        db.profiles = records.into_iter().collect();
+        store_path
+    };
+    db.tag = local_tag();
+    db.save_filtered(out, |k| portable(k, with_exact))?;
+
+    let exported = db
+        .profiles
+        .iter()
+        .filter(|(k, p)| portable(k, with_exact) && p.behavioral_confidence() >= MIN_CONFIDENCE)
+        .count();
+    log_info!(
+        "PROCDB: EXPORTED {}/{} PROFILES FROM {} TO {} ({})",
+        exported,
+        db.profiles.len(),
+        source.display(),
+        out.display(),
+        db.tag
+    );
+    Ok(())
+}
+
+pub fn run_import(file: &Path, force: bool) -> Result<()> {
+    let (tag, incoming) = ProcessDb::load_snapshot(file)?;
+    if incoming.is_empty() {
+        bail!("{}: NO PROFILES", file.display());
+    }
+    check_tag(file, &tag, &local_tag(), force)?;
+
+    // EXCLUSIVE: FAILS WHILE A SCHEDULER INSTANCE HOLDS THE STORE
+    let store = ProfileStore::open(&ProcessDb::store_path())?;
+    let mut db = ProcessDb::detached(Some(store));
+    let before = db.profiles.len();
+    let mut skipped = 0;
+    for (key, profile) in &incoming {
+        if key.cgid != 0 {
+            skipped += 1;
+            continue;
+        }
+        db.merge_profile(*key, profile);
+    }
+    db.sync()?;
+
+    let (total, confident) = db.summary();
+    log_info!(
+        "PROCDB: IMPORTED {} PROFILES FROM {} ({}), {} NEW, {} CGROUP-KEYED SKIPPED",
+        incoming.len() - skipped,
+        file.display(),
+        tag,
+        total - before,
+        skipped
+    );
+    log_info!("PROCDB: {}/{} PROFILES CONFIDENT", confident, total);
+    Ok(())
+}
+
+pub fn run_merge(out: &Path, inputs: &[PathBuf], force: bool) -> Result<()> {
+    if inputs.is_empty() {
+        bail!("merge needs at least one input");
+    }
+    let mut db = ProcessDb::detached(None);
+    let mut reference: Option<HostTag> = None;
+    for path in inputs {
+        let (tag, profiles) = ProcessDb::load_snapshot(path)?;
+        match reference {
+            // THE FIRST TAGGED INPUT DEFINES THE HARDWARE CLASS OF THE RESULT
+            Some(r) => check_tag(path, &tag, &r, force)?,
+            None if !tag.is_untagged() => reference = Some(tag),
+            None => {}
+        }
+        log_info!("PROCDB: {} -- {} PROFILES ({})", path.display(), profiles.len(), tag);
+        for (key, profile) in &profiles {
+            db.merge_profile(*key, profile);
+        }
+    }
+    db.tag = reference.unwrap_or_default();
+    db.save(out)?;
+
+    // POOLED VOTES THAT DISAGREE FALL BELOW MIN_CONFIDENCE AND ARE DROPPED
+    let (total, confident) = db.summary();
+    log_info!(
+        "PROCDB: MERGED {} FILES -> {} ({}/{} PROFILES CONFIDENT, {})",
+        inputs.len(),
+        out.display(),
+        confident,
+        total,
+        db.tag
+    );
+    Ok(())
+}
@@ -0,0 +1,163 @@
+// PANDEMONIUM CONTROLLER REPLAY
+// replay FILE: RUN THE ADAPTIVE POLICY OVER A FLIGHT RECORDING (A LIVE
+// --flight-recorder FILE OR ONE SAVED BY bench-contention) WITH CANDIDATE
+// PARAMETERS. PRINTS THE PREDICTED KNOB TRAJECTORY AND DECISIONS NEXT TO
+// THE RECORDED ONES, THEN PER-DECISION COUNTS.
+
+use std::path::Path;
+
+use anyhow::{bail, Result};
+
+use pandemonium::controller::{
+    ControlParams, DECISION_FAST_PROMOTE, DECISION_REGIME_SWITCH, DECISION_RELAX_DONE,
+    DECISION_RELAX_STEP, DECISION_RESCALE, DECISION_SCALE_PRESSURE, DECISION_TIGHTEN,
+};
+use pandemonium::event::{decision_label, regime_label};
+use pandemonium::flight::read_flight_set;
+use pandemonium::metrics::REGIMES;
+use pandemonium::replay::{replay, trace_cpus, trace_period_ns, ReplayTick};
+
+// CANDIDATE PARAMETERS. None KEEPS THE DEFAULT; PERIOD AND CPU COUNT
+// DEFAULT TO THE TRACE'S OWN.
+pub struct ReplayOverrides {
+    pub period_ms: Option<u64>,
+    pub nr_cpus: Option<u64>,
+    pub regime_hold_ms: Option<u64>,
+    pub tighten_hold_ms: Option<u64>,
+    pub relax_hold_ms: Option<u64>,
+    pub relax_step_us: Option<u64>,
+    pub min_slice_us: Option<u64>,
+    pub tighten_pct: Option<u64>,
+    pub sojourn_tau_ms: Option<u64>,
+}
+
+fn print_row(t: &ReplayTick) {
+    let mark = if t.diverged() { "*" } else { "" };
+    println!(
+        "{:<8} {:<8.1} {:<8} {:<6} {:<6} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<10} {:<10} {}",
+        t.tick,
+        t.at_ns as f64 / 1_000_000_000.0,
+        t.p99_ns / 1000,
+        regime_label(t.rec_regime),
+        regime_label(t.regime),
+        t.rec_knobs[0] / 1000,
+        t.knobs[0] / 1000,
+        t.rec_knobs[2] / 1000,
+        t.knobs[2] / 1000,
+        t.rec_knobs[4] / 1000,
+        t.knobs[4] / 1000,
+        decision_label(t.rec_decisions),
+        decision_label(t.decisions),
+        mark,
+    );
+}
+
+pub fn run_replay(path: &Path, o: &ReplayOverrides, all: bool) -> Result<()> {
+    let trace = read_flight_set(path)?;
+    if trace.is_empty() {
+        bail!("{}: no flight records", path.display());
+    }
+
+    let period_ns = match o.period_ms {
+        Some(ms) => pandemonium::tuning::clamp_control_period_ms(ms) * 1_000_000,
+        None => trace_period_ns(&trace),
+    };
+    let nr_cpus = match o.nr_cpus.or_else(|| trace_cpus(&trace)) {
+        Some(n) => n.max(1),
+        None => bail!("{}: trace has no CPU count, pass --nr-cpus", path.display()),
+    };
+    let mut params = ControlParams::new(period_ns);
+    let ms = |v: Option<u64>, d: u64| v.map_or(d, |ms| ms * 1_000_000);
+    let us = |v: Option<u64>, d: u64| v.map_or(d, |us| us * 1000);
+    params.regime_hold_ns = ms(o.regime_hold_ms, params.regime_hold_ns);
+    params.tighten_hold_ns = ms(o.tighten_hold_ms, params.tighten_hold_ns);
+    params.relax_hold_ns = ms(o.relax_hold_ms, params.relax_hold_ns);
+    params.sojourn_tau_ns = ms(o.sojourn_tau_ms, params.sojourn_tau_ns);
+    params.relax_step_ns = us(o.relax_step_us, params.relax_step_ns);
+    params.min_slice_ns = us(o.min_slice_us, params.min_slice_ns);
+    params.tighten_pct = o.tighten_pct.unwrap_or(params.tighten_pct).clamp(1, 100);
+
+    log_info!(
+        "REPLAY: {} TICKS FROM {}, PERIOD {}MS, {} CPUS",
+        trace.len(),
+        path.display(),
+        period_ns / 1_000_000,
+        nr_cpus
+    );
+    log_info!(
+        "PARAMS: REGIME HOLD {}MS, TIGHTEN HOLD {}MS TO {}% (FLOOR {}US), RELAX {}US PER {}MS, SOJOURN TAU {}MS",
+        params.regime_hold_ns / 1_000_000,
+        params.tighten_hold_ns / 1_000_000,
+        params.tighten_pct,
+        params.min_slice_ns / 1000,
+        params.relax_step_ns / 1000,
+        params.relax_hold_ns / 1_000_000,
+        params.sojourn_tau_ns / 1_000_000
+    );
+
+    let run = replay(&trace, params, nr_cpus);
+
+    // THE TRAJECTORY: EVERY TICK WITH --all, ELSE TICKS WHERE EITHER
+    // SIDE DECIDED SOMETHING. REC = RECORDED, SIM = REPLAYED, * = DIVERGED.
+    println!(
+        "\n{:<8} {:<8} {:<8} {:<6} {:<6} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<10} {:<10}",
+        "TICK",
+        "TIME_S",
+        "P99_US",
+        "REC",
+        "SIM",
+        "SLICE",
+        "SLICE",
+        "BATCH",
+        "BATCH",
+        "SJRN",
+        "SJRN",
+        "DECIDE",
+        "DECIDE"
+    );
+    for t in run.ticks.iter().filter(|t| all || t.decided()) {
+        print_row(t);
+    }
+
+    println!("\n{:<16} {:<10} {:<10}", "DECISION", "RECORDED", "PREDICTED");
+    for (name, bit) in [
+        ("TIGHTEN", DECISION_TIGHTEN),
+        ("RELAX_STEP", DECISION_RELAX_STEP),
+        ("RELAX_DONE", DECISION_RELAX_DONE),
+        ("REGIME_SWITCH", DECISION_REGIME_SWITCH),
+        ("FAST_PROMOTE", DECISION_FAST_PROMOTE),
+        ("RESCALE", DECISION_RESCALE),
+        ("SCALE_PRESSURE", DECISION_SCALE_PRESSURE),
+    ] {
+        let (rec, pred) = run.count(bit);
+        println!("{:<16} {:<10} {:<10}", name, rec, pred);
+    }
+
+    let (rec_min, pred_min) = run.min_slice_ns();
+    println!(
+        "MIN SLICE: {}us RECORDED, {}us PREDICTED",
+        rec_min / 1000,
+        pred_min / 1000
+    );
+    let total: u64 = run.regime_ns.iter().sum::<u64>().max(1);
+    let shares: Vec<String> = REGIMES
+        .iter()
+        .zip(run.regime_ns)
+        .map(|(r, ns)| format!("{}={}%", r, ns * 100 / total))
+        .collect();
+    println!("PREDICTED REGIME TIME: {}", shares.join(" "));
+    if run.restarts > 0 {
+        println!("SCHEDULER RESTARTS IN TRACE: {}", run.restarts);
+    }
+    match run.first_divergence() {
+        Some(t) => println!(
+            "DIVERGED ON {} OF {} TICKS, FIRST AT TICK {} ({:.1}s)",
+            run.diverged_ticks(),
+            run.ticks.len(),
+            t.tick,
+            t.at_ns as f64 / 1_000_000_000.0
+        ),
+        None => println!("KNOB TRAJECTORY MATCHES THE RECORDING"),
+    }
+    Ok(())
+}
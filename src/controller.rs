@@ -0,0 +1,496 @@
+// PANDEMONIUM CONTROLLER
+// THE ADAPTIVE POLICY AS A STATE MACHINE: ONE CONTROL WINDOW OF INPUTS
+// IN, TUNING KNOBS AND DECISION BITS OUT. NO BPF, NO CLOCK, NO I/O.
+//
+// adaptive.rs DRIVES IT FROM THE LIVE MAPS AND WRITES THE KNOBS WHEN THEY
+// MOVE. replay.rs DRIVES IT FROM A RECORDED FLIGHT TRACE WITH CANDIDATE
+// PARAMETERS. THE SAME INPUTS GIVE THE SAME KNOBS EITHER WAY.
+
+use crate::tuning::{
+    self, detect_regime, scaled_regime_knobs, Regime, ScaleKnobs, ScalePressure, TuningKnobs,
+    MAX_NODES,
+};
+
+// CONTROLLER DECISIONS TAKEN IN ONE TICK (Snapshot::decisions)
+pub const DECISION_FAST_PROMOTE: u32 = 1 << 0; // RINGBUF CONTENTION EDGE PROMOTED THE REGIME
+pub const DECISION_REGIME_SWITCH: u32 = 1 << 1; // HELD DETECTION SWITCHED THE REGIME
+pub const DECISION_RESCALE: u32 = 1 << 2; // HOTPLUG RE-DERIVED THE CPU-SCALED KNOBS
+pub const DECISION_TIGHTEN: u32 = 1 << 3; // P99 SPIKE HELD: SLICE CUT
+pub const DECISION_RELAX_STEP: u32 = 1 << 4; // SLICE STEPPED TOWARD BASELINE
+pub const DECISION_RELAX_DONE: u32 = 1 << 5; // BACK AT BASELINE, NO LONGER TIGHTENED
+pub const DECISION_SCALE_PRESSURE: u32 = 1 << 6; // RESCUE PRESSURE LEVEL CHANGED
+// THE DECISION_* HALF OF Snapshot::decisions
+pub const DECISION_MASK: u32 = 0xffff;
+// STATE AT THE END OF THE TICK
+pub const STATE_TIGHTENED: u32 = 1 << 16;
+pub const STATE_BURST: u32 = 1 << 17;
+pub const STATE_LONGRUN: u32 = 1 << 18;
+pub const STATE_CONTENTION: u32 = 1 << 19; // BURST OR STARVATION EVENT THIS TICK
+
+// DEFAULT POLICY PARAMETERS
+
+// TIGHTEN: CUT THE SLICE TO 3/4, NEVER BELOW 500US
+pub const MIN_SLICE_NS: u64 = 500_000;
+pub const TIGHTEN_PCT: u64 = 75;
+
+// HYSTERESIS IN WALL-CLOCK TIME: A CONDITION MUST HOLD THIS LONG (AND FOR
+// AT LEAST 2 CONSECUTIVE WINDOWS) BEFORE A REGIME SWITCH OR A TIGHTEN
+pub const REGIME_HOLD_NS: u64 = 200_000_000; // 200MS
+pub const TIGHTEN_HOLD_NS: u64 = 200_000_000; // 200MS
+
+// GRADUATED RELAX: STEP TOWARD BASELINE AFTER P99 NORMALIZES
+pub const RELAX_STEP_NS: u64 = 500_000; // RELAX BY 500US PER STEP
+pub const RELAX_HOLD_NS: u64 = 2_000_000_000; // WAIT 2S OF GOOD P99 BEFORE STEPPING
+
+// SOJOURN THRESHOLD EWMA TIME CONSTANT: 7/8 OLD + 1/8 NEW AT A 1S PERIOD
+pub const SOJOURN_EWMA_TAU_NS: u64 = 8_000_000_000;
+
+// SOJOURN TARGET: 4X THE MEASURED DISPATCH INTERVAL
+const SOJOURN_MULTIPLIER: u64 = 4;
+
+// BATCH SOJOURN THRESHOLD BOUNDS: FLOOR SCALES 1MS PER CPU (2-6MS)
+pub fn sojourn_floor_for(nr_cpus: u64) -> u64 {
+    (nr_cpus * 1_000_000).clamp(2_000_000, 6_000_000)
+}
+
+// THE TUNABLE PART OF THE POLICY. REGIME THRESHOLDS, PROFILES AND P99
+// CEILINGS STAY IN tuning.rs.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct ControlParams {
+    pub period_ns: u64,
+    pub regime_hold_ns: u64,
+    pub tighten_hold_ns: u64,
+    pub relax_hold_ns: u64,
+    pub relax_step_ns: u64,
+    pub min_slice_ns: u64,
+    pub tighten_pct: u64, // SLICE KEPT PER TIGHTEN, PERCENT
+    pub sojourn_tau_ns: u64,
+}
+
+impl ControlParams {
+    pub fn new(period_ns: u64) -> Self {
+        Self {
+            period_ns,
+            regime_hold_ns: REGIME_HOLD_NS,
+            tighten_hold_ns: TIGHTEN_HOLD_NS,
+            relax_hold_ns: RELAX_HOLD_NS,
+            relax_step_ns: RELAX_STEP_NS,
+            min_slice_ns: MIN_SLICE_NS,
+            tighten_pct: TIGHTEN_PCT,
+            sojourn_tau_ns: SOJOURN_EWMA_TAU_NS,
+        }
+    }
+}
+
+// ONE CONTROL WINDOW, AS DELTAS. P99s ARE FROM THE WINDOW'S HISTOGRAMS;
+// THE SAMPLE COUNTS DRIVE THE P99 SAMPLE GATE.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TickInput {
+    pub elapsed_ns: u64,
+    pub dispatches: u64,
+    pub idle_hits: u64,
+    pub rescues: u64, // OVERFLOW + STARVATION RESCUES
+    pub p99_ns: u64,  // ALL TIERS
+    pub samples: u64,
+    pub p99_i_ns: u64, // INTERACTIVE TIER
+    pub samples_i: u64,
+    pub io_pct: u64,
+}
+
+pub struct Controller {
+    params: ControlParams,
+    regime_hold_windows: u32,
+    tighten_hold_windows: u32,
+    relax_hold_windows: u32,
+    knobs: TuningKnobs,
+    regime: Regime,
+    pending_regime: Regime,
+    regime_hold: u32,
+    spike_count: u32,
+    relax_counter: u32,
+    tightened: bool,
+    stability: u32,
+    scale_cpus: u64,
+    sojourn_floor_ns: u64,
+    sojourn_ceil_ns: u64,
+    sojourn_thresh_ns: u64,
+    pressure: ScalePressure,
+    longrun_nodes: u64, // BIT PER NODE, FROM EVT_LONGRUN
+    // EDGES SINCE THE LAST TICK
+    fast_promoted: bool,
+    rescaled: bool,
+    contended: bool,
+    regime_changed_in_report: bool,
+    tighten_events: u64,
+    report_tighten_events: u64,
+    fast_promotions: u64,
+    regime_ns: [u64; 3], // BY Regime
+}
+
+impl Controller {
+    // STARTS IN MIXED WITH THE CPU-SCALED BASELINE
+    pub fn new(params: ControlParams, scale_cpus: u64) -> Self {
+        let period_ns = params.period_ns;
+        let regime = Regime::Mixed;
+        let sojourn_floor_ns = sojourn_floor_for(scale_cpus);
+        Self {
+            params,
+            regime_hold_windows: tuning::hold_windows(params.regime_hold_ns, period_ns),
+            tighten_hold_windows: tuning::hold_windows(params.tighten_hold_ns, period_ns),
+            relax_hold_windows: tuning::windows_for(params.relax_hold_ns, period_ns),
+            knobs: scaled_regime_knobs(regime, scale_cpus),
+            regime,
+            pending_regime: regime,
+            regime_hold: 0,
+            spike_count: 0,
+            relax_counter: 0,
+            tightened: false,
+            stability: 0,
+            scale_cpus,
+            sojourn_floor_ns,
+            sojourn_ceil_ns: sojourn_floor_ns * 2,
+            sojourn_thresh_ns: sojourn_floor_ns,
+            pressure: ScalePressure::default(),
+            longrun_nodes: 0,
+            fast_promoted: false,
+            rescaled: false,
+            contended: false,
+            regime_changed_in_report: false,
+            tighten_events: 0,
+            report_tighten_events: 0,
+            fast_promotions: 0,
+            regime_ns: [0; 3],
+        }
+    }
+
+    fn reset_to_baseline(&mut self) {
+        self.tightened = false;
+        self.relax_counter = 0;
+        self.spike_count = 0;
+    }
+
+    // BURST / STARVATION EDGE: LIGHT PROMOTES TO MIXED AT ONCE.
+    // RETURNS TRUE WHEN THE KNOBS CHANGED.
+    pub fn contention(&mut self) -> bool {
+        self.contended = true;
+        let Some(next) = tuning::promote_on_contention(self.regime) else {
+            return false;
+        };
+        self.regime = next;
+        self.pending_regime = next;
+        self.regime_hold = 0;
+        self.knobs = scaled_regime_knobs(next, self.scale_cpus);
+        self.reset_to_baseline();
+        self.fast_promoted = true;
+        self.fast_promotions += 1;
+        true
+    }
+
+    // LONGRUN EDGE FOR ONE NODE. APPLY WITH longrun_override().
+    pub fn longrun(&mut self, node: u32, active: bool) {
+        if node as usize >= MAX_NODES {
+            return;
+        }
+        if active {
+            self.longrun_nodes |= 1 << node;
+        } else {
+            self.longrun_nodes &= !(1 << node);
+        }
+    }
+
+    // THE EVENT STREAM LOST RECORDS: FALL BACK TO THE stats_map LEVEL
+    pub fn resync_longrun(&mut self, active: bool) {
+        self.longrun_nodes = if active { 1 } else { 0 };
+    }
+
+    // LONGRUN ON: BASE BATCH SLICE, WEAK AFFINITY. OFF: REGIME AFFINITY
+    // BACK, BATCH LEFT FOR THE NEXT TICK'S SLEEP ADJUSTMENT.
+    // RETURNS TRUE WHEN THE KNOBS CHANGED.
+    pub fn longrun_override(&mut self) -> bool {
+        let baseline = scaled_regime_knobs(self.regime, self.scale_cpus);
+        let (batch, affinity) = if self.longrun_nodes != 0 {
+            (baseline.batch_slice_ns, tuning::AFFINITY_WEAK)
+        } else {
+            (self.knobs.batch_slice_ns, baseline.affinity_mode)
+        };
+        if self.knobs.batch_slice_ns == batch && self.knobs.affinity_mode == affinity {
+            return false;
+        }
+        self.knobs.batch_slice_ns = batch;
+        self.knobs.affinity_mode = affinity;
+        true
+    }
+
+    // HOTPLUG: RE-DERIVE THE CPU-SCALED KNOBS AND RESTART FROM THE REGIME
+    // BASELINE LIKE A REGIME SWITCH. RETURNS TRUE WHEN THE COUNT CHANGED.
+    pub fn rescale(&mut self, scale_cpus: u64) -> bool {
+        if scale_cpus == self.scale_cpus {
+            return false;
+        }
+        self.scale_cpus = scale_cpus;
+        self.sojourn_floor_ns = sojourn_floor_for(scale_cpus);
+        self.sojourn_ceil_ns = self.sojourn_floor_ns * 2;
+        self.sojourn_thresh_ns = self
+            .sojourn_thresh_ns
+            .clamp(self.sojourn_floor_ns, self.sojourn_ceil_ns);
+        self.knobs = TuningKnobs {
+            sojourn_thresh_ns: self.sojourn_thresh_ns,
+            ..scaled_regime_knobs(self.regime, scale_cpus)
+        };
+        self.reset_to_baseline();
+        self.rescaled = true;
+        true
+    }
+
+    // ONE CONTROL TICK. RETURNS DECISION_* | STATE_* (STATE_BURST IS THE
+    // DRIVER'S: BURST IS OWNED BY BPF).
+    pub fn tick(&mut self, input: &TickInput) -> u32 {
+        let mut decisions: u32 = 0;
+        let elapsed_ns = input.elapsed_ns;
+        let idle_pct = if input.dispatches > 0 {
+            input.idle_hits * 100 / input.dispatches
+        } else {
+            0
+        };
+
+        // DETECT REGIME (SCHMITT TRIGGER + WALL-CLOCK HOLD)
+        let detected = detect_regime(self.regime, idle_pct);
+        let mut regime_changed = self.fast_promoted || self.rescaled;
+        if detected != self.regime {
+            if detected == self.pending_regime {
+                self.regime_hold += 1;
+            } else {
+                self.pending_regime = detected;
+                self.regime_hold = 1;
+            }
+            if self.regime_hold >= self.regime_hold_windows {
+                self.regime = detected;
+                self.knobs = scaled_regime_knobs(detected, self.scale_cpus);
+                regime_changed = true;
+                decisions |= DECISION_REGIME_SWITCH;
+                self.reset_to_baseline();
+            }
+        } else {
+            self.pending_regime = self.regime;
+            self.regime_hold = 0;
+        }
+
+        // TIGHTEN CHECK: P99 SPIKE DETECTION
+        // REQUIRE THE SPIKE TO HOLD FOR tighten_hold_ns (AND 2+ WINDOWS).
+        // A WINDOW WITH TOO FEW SAMPLES NEITHER COUNTS NOR RESETS THE HOLD.
+        // ONLY TIGHTEN IN MIXED: LIGHT HAS NO CONTENTION (POINTLESS),
+        // HEAVY IS FULLY SATURATED (MORE PREEMPTION JUST ADDS OVERHEAD).
+        let gated_p99 = tuning::gated_p99(input.p99_ns, input.samples);
+        let gated_p99_i = tuning::gated_p99(input.p99_i_ns, input.samples_i);
+        if !self.tightened && !regime_changed && (gated_p99.is_some() || gated_p99_i.is_some()) {
+            if tuning::should_reflex_tighten(
+                gated_p99.unwrap_or(0),
+                gated_p99_i.unwrap_or(0),
+                self.regime.p99_ceiling(),
+            ) {
+                self.spike_count += 1;
+                if self.spike_count >= self.tighten_hold_windows && self.regime == Regime::Mixed {
+                    let new_slice = (self.knobs.slice_ns * self.params.tighten_pct / 100)
+                        .max(self.params.min_slice_ns);
+                    self.knobs.slice_ns = new_slice;
+                    self.knobs.preempt_thresh_ns = new_slice;
+                    self.tightened = true;
+                    self.tighten_events += 1;
+                    decisions |= DECISION_TIGHTEN;
+                    self.spike_count = 0;
+                }
+            } else {
+                self.spike_count = 0;
+            }
+        }
+
+        // GRADUATED RELAX: STEP SLICE TOWARD BASELINE (BATCH UNTOUCHED)
+        if self.tightened && !regime_changed {
+            let baseline = scaled_regime_knobs(self.regime, self.scale_cpus);
+            if input.p99_ns <= self.regime.p99_ceiling() {
+                self.relax_counter += 1;
+                if self.relax_counter >= self.relax_hold_windows {
+                    let current = self.knobs;
+                    if current.slice_ns < baseline.slice_ns {
+                        let new_slice =
+                            (current.slice_ns + self.params.relax_step_ns).min(baseline.slice_ns);
+                        self.knobs = TuningKnobs {
+                            slice_ns: new_slice,
+                            preempt_thresh_ns: baseline.preempt_thresh_ns.min(new_slice),
+                            batch_slice_ns: current.batch_slice_ns,
+                            ..baseline
+                        };
+                        decisions |= DECISION_RELAX_STEP;
+                        if new_slice >= baseline.slice_ns {
+                            self.tightened = false;
+                            decisions |= DECISION_RELAX_DONE;
+                        }
+                    } else {
+                        self.tightened = false;
+                        decisions |= DECISION_RELAX_DONE;
+                    }
+                    self.relax_counter = 0;
+                }
+            } else {
+                self.relax_counter = 0;
+            }
+        }
+
+        // SLEEP-INFORMED BATCH TUNING (EVERY TICK)
+        // LONGRUN OVERRIDE: DURING SUSTAINED BATCH PRESSURE (>2S),
+        // USE BASE BATCH SLICE (SKIP SLEEP ADJUSTMENT -- LONG-RUNNERS ARE
+        // CPU-BOUND, NOT IO-BOUND) AND WEAKEN AFFINITY TO SPREAD BATCH
+        // TASKS ACROSS MORE CPUS INSTEAD OF CONCENTRATING ON HOTSPOTS.
+        // BURST IS OWNED ENTIRELY BY BPF (CUSUM + WAKEUP RATE IN TICK).
+        let baseline = scaled_regime_knobs(self.regime, self.scale_cpus);
+        let longrun = self.longrun_nodes != 0;
+        self.knobs.batch_slice_ns = if longrun {
+            baseline.batch_slice_ns
+        } else {
+            tuning::sleep_adjust_batch_ns(baseline.batch_slice_ns, input.io_pct)
+        };
+        self.knobs.affinity_mode = if longrun {
+            tuning::AFFINITY_WEAK
+        } else {
+            baseline.affinity_mode
+        };
+
+        // DISPATCH-RATE ADAPTIVE SOJOURN THRESHOLD
+        // MEASURE, DON'T ASSUME. DISPATCH RATE REFLECTS ACTUAL SYSTEM
+        // CAPACITY (PHYSICAL CORES, SMT, FREQUENCY, WORKLOAD INTENSITY).
+        // NORMALIZED TO ACTUAL ELAPSED TIME (SLEEP OVERSHOOTS UNDER LOAD).
+        if input.dispatches > 0 && elapsed_ns > 0 {
+            let dispatch_rate = input.dispatches * 1_000_000_000 / elapsed_ns;
+            let interval_ns = if dispatch_rate > 0 { 1_000_000_000 / dispatch_rate } else { 0 };
+            let target = (interval_ns * SOJOURN_MULTIPLIER)
+                .clamp(self.sojourn_floor_ns, self.sojourn_ceil_ns);
+            // EWMA OVER sojourn_tau_ns OF WALL TIME (SMOOTH, NO JITTER)
+            self.sojourn_thresh_ns = tuning::ewma_step(
+                self.sojourn_thresh_ns,
+                target,
+                elapsed_ns,
+                self.params.sojourn_tau_ns,
+            );
+        }
+        self.knobs.sojourn_thresh_ns = self.sojourn_thresh_ns;
+
+        self.regime_ns[self.regime as usize] += elapsed_ns;
+
+        // CORE-COUNT SCALING UNDER RESCUE PRESSURE: OVERFLOW + STARVATION
+        // RESCUES OUTPACING THE CPU COUNT STEP THE BUDGET AND RESCUE AGES
+        // DOWN (SAME HOLD/RELAX HYSTERESIS AS TIGHTEN/RELAX)
+        let pressured = tuning::rescue_pressure(input.rescues, elapsed_ns, self.scale_cpus);
+        if self
+            .pressure
+            .update(pressured, self.tighten_hold_windows, self.relax_hold_windows)
+        {
+            decisions |= DECISION_SCALE_PRESSURE;
+        }
+
+        if self.fast_promoted {
+            decisions |= DECISION_FAST_PROMOTE;
+        }
+        if self.rescaled {
+            decisions |= DECISION_RESCALE;
+        }
+        if self.tightened {
+            decisions |= STATE_TIGHTENED;
+        }
+        if longrun {
+            decisions |= STATE_LONGRUN;
+        }
+        if self.contended {
+            decisions |= STATE_CONTENTION;
+        }
+        self.regime_changed_in_report |= regime_changed;
+        self.fast_promoted = false;
+        self.rescaled = false;
+        self.contended = false;
+        decisions
+    }
+
+    // ONCE PER REPORT PERIOD: STABILITY OVER THE REPORT WINDOW'S P99
+    pub fn report(&mut self, report_p99_ns: u64) -> u32 {
+        let tighten_delta = self.tighten_events - self.report_tighten_events;
+        self.report_tighten_events = self.tighten_events;
+        self.stability = tuning::compute_stability_score(
+            self.stability,
+            self.regime_changed_in_report,
+            tighten_delta,
+            report_p99_ns,
+            self.regime.p99_ceiling(),
+        );
+        self.regime_changed_in_report = false;
+        self.stability
+    }
+
+    pub fn knobs(&self) -> &TuningKnobs {
+        &self.knobs
+    }
+
+    pub fn regime(&self) -> Regime {
+        self.regime
+    }
+
+    pub fn pending_regime(&self) -> Regime {
+        self.pending_regime
+    }
+
+    pub fn regime_hold(&self) -> u32 {
+        self.regime_hold
+    }
+
+    pub fn spike_count(&self) -> u32 {
+        self.spike_count
+    }
+
+    pub fn relax_counter(&self) -> u32 {
+        self.relax_counter
+    }
+
+    pub fn tightened(&self) -> bool {
+        self.tightened
+    }
+
+    pub fn longrun_active(&self) -> bool {
+        self.longrun_nodes != 0
+    }
+
+    pub fn stability(&self) -> u32 {
+        self.stability
+    }
+
+    pub fn pressure(&self) -> u32 {
+        self.pressure.level
+    }
+
+    pub fn scale_cpus(&self) -> u64 {
+        self.scale_cpus
+    }
+
+    pub fn sojourn_thresh_ns(&self) -> u64 {
+        self.sojourn_thresh_ns
+    }
+
+    pub fn tighten_events(&self) -> u64 {
+        self.tighten_events
+    }
+
+    pub fn fast_promotions(&self) -> u64 {
+        self.fast_promotions
+    }
+
+    // WALL TIME SPENT IN EACH REGIME, BY Regime
+    pub fn regime_ns(&self) -> [u64; 3] {
+        self.regime_ns
+    }
+
+    // CPU-SCALED BASE AND ITS CONTENDED FORM AT THE CURRENT PRESSURE
+    pub fn scale_base(&self) -> ScaleKnobs {
+        tuning::scale_knobs(self.scale_cpus)
+    }
+
+    pub fn scale_knobs(&self) -> ScaleKnobs {
+        tuning::contended_scale_knobs(&self.scale_base(), self.pressure.level)
+    }
+}
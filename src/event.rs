@@ -1,87 +1,359 @@
 // PANDEMONIUM EVENT LOG
-// RECORDS STATS SNAPSHOTS DURING SCHEDULER EXECUTION
+// RECORDS ONE CONTROLLER SNAPSHOT PER CONTROL TICK DURING EXECUTION
 // PRE-ALLOCATED RING BUFFER. NO HEAP ALLOCATION DURING MONITORING.
-// WRAPS AROUND AT CAPACITY -- OLDEST ENTRIES OVERWRITTEN.
+// WRAPS AROUND AT CAPACITY -- OLDEST ENTRIES OVERWRITTEN. OPTIONALLY
+// MIRRORED TO THE ON-DISK FLIGHT RECORDER (flight.rs).
+//
+// ALSO DECODES THE BPF EVENT STREAM (events RINGBUF): EDGE-TRIGGERED
+// STATE CHANGES THAT THE ADAPTIVE LOOP REACTS TO BETWEEN 1S TICKS.
+
+use anyhow::Result;
+
+use crate::controller::{
+    TickInput, DECISION_FAST_PROMOTE, DECISION_REGIME_SWITCH, DECISION_RELAX_DONE, DECISION_RELAX_STEP,
+    DECISION_RESCALE, DECISION_SCALE_PRESSURE, DECISION_TIGHTEN, STATE_BURST, STATE_CONTENTION,
+    STATE_LONGRUN, STATE_TIGHTENED,
+};
+use crate::flight::FlightRecorder;
+use crate::metrics::{N_KNOBS, N_STATS, REGIMES};
+use crate::tuning::HIST_TIERS;
 
 pub const MAX_SNAPSHOTS: usize = 8192;
 
-#[derive(Clone, Copy)]
-pub struct Snapshot {
+// BPF EVENT KINDS: MATCHES EVT_* IN intf.h
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum EventKind {
+    Burst,
+    Longrun,
+    StarvationRescue,
+    SojournCross,
+    TierChange,
+    Hotplug,
+}
+
+impl EventKind {
+    pub fn from_raw(kind: u32) -> Option<Self> {
+        match kind {
+            1 => Some(Self::Burst),
+            2 => Some(Self::Longrun),
+            3 => Some(Self::StarvationRescue),
+            4 => Some(Self::SojournCross),
+            5 => Some(Self::TierChange),
+            6 => Some(Self::Hotplug),
+            _ => None,
+        }
+    }
+}
+
+// MATCHES struct pand_event IN BPF (intf.h)
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct BpfEvent {
     pub ts_ns: u64,
-    pub dispatches: u64,
-    pub idle_hits: u64,
-    pub shared: u64,
-    pub preempt: u64,
-    pub keep_run: u64,
+    pub value: u64,
+    pub kind: u32,
+    pub cpu: i32,
+    pub pid: u32,
+    pub node: u16,
+    pub state: u8,
+    pub prev_state: u8,
+}
+
+impl BpfEvent {
+    // DECODE ONE RINGBUF RECORD. SHORT RECORDS ARE REJECTED.
+    pub fn parse(data: &[u8]) -> Option<Self> {
+        if data.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        Some(unsafe { std::ptr::read_unaligned(data.as_ptr() as *const Self) })
+    }
+
+    pub fn kind(&self) -> Option<EventKind> {
+        EventKind::from_raw(self.kind)
+    }
+}
+
+// PER-TICK EVENT COUNTS: RECONCILED AGAINST THE PERIODIC COUNTERS
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct EventTally {
+    pub burst_on: u64,
+    pub burst_off: u64,
+    pub longrun_on: u64,
+    pub longrun_off: u64,
+    pub rescues: u64,
+    pub sojourn_crossings: u64,
+    pub tier_changes: u64,
+    pub cpus_online: u64,
+    pub cpus_offline: u64,
+    pub unknown: u64,
+}
+
+impl EventTally {
+    pub fn record(&mut self, ev: &BpfEvent) {
+        match ev.kind() {
+            Some(EventKind::Burst) if ev.state != 0 => self.burst_on += 1,
+            Some(EventKind::Burst) => self.burst_off += 1,
+            Some(EventKind::Longrun) if ev.state != 0 => self.longrun_on += 1,
+            Some(EventKind::Longrun) => self.longrun_off += 1,
+            Some(EventKind::StarvationRescue) => self.rescues += 1,
+            Some(EventKind::SojournCross) if ev.state != 0 => self.sojourn_crossings += 1,
+            Some(EventKind::SojournCross) => {}
+            Some(EventKind::TierChange) => self.tier_changes += 1,
+            Some(EventKind::Hotplug) if ev.state != 0 => self.cpus_online += 1,
+            Some(EventKind::Hotplug) => self.cpus_offline += 1,
+            None => self.unknown += 1,
+        }
+    }
+
+    pub fn total(&self) -> u64 {
+        self.burst_on
+            + self.burst_off
+            + self.longrun_on
+            + self.longrun_off
+            + self.rescues
+            + self.sojourn_crossings
+            + self.tier_changes
+            + self.cpus_online
+            + self.cpus_offline
+    }
+}
+
+// Snapshot::regime WHEN NO ADAPTIVE LOOP RUNS (--no-adaptive)
+pub const REGIME_NONE: u8 = 0xff;
+
+// Regime AS u8; REGIME_NONE READS AS BPF
+pub fn regime_label(regime: u8) -> &'static str {
+    REGIMES.get(regime as usize).copied().unwrap_or("BPF")
+}
+
+// ONE LETTER PER DECISION, UPPER CASE; END-OF-TICK STATE IN LOWER CASE
+pub fn decision_label(decisions: u32) -> String {
+    const LETTERS: [(u32, char); 11] = [
+        (DECISION_FAST_PROMOTE, 'P'),
+        (DECISION_REGIME_SWITCH, 'R'),
+        (DECISION_RESCALE, 'H'),
+        (DECISION_TIGHTEN, 'T'),
+        (DECISION_RELAX_STEP, 'X'),
+        (DECISION_RELAX_DONE, 'D'),
+        (DECISION_SCALE_PRESSURE, 'S'),
+        (STATE_TIGHTENED, 't'),
+        (STATE_BURST, 'b'),
+        (STATE_LONGRUN, 'l'),
+        (STATE_CONTENTION, 'c'),
+    ];
+    let label: String = LETTERS
+        .iter()
+        .filter(|(bit, _)| decisions & bit != 0)
+        .map(|(_, c)| *c)
+        .collect();
+    if label.is_empty() {
+        "-".to_string()
+    } else {
+        label
+    }
+}
+
+// MATCHES PandemoniumStats FIELD ORDER (metrics::STAT_NAMES)
+const S_DISPATCHES: usize = 0;
+const S_IDLE_HITS: usize = 1;
+const S_SHARED: usize = 2;
+const S_PREEMPT: usize = 3;
+const S_KEEP_RUNNING: usize = 7;
+const S_HARD_KICKS: usize = 8;
+const S_SOFT_KICKS: usize = 9;
+const S_OVERFLOW_RESCUE: usize = 31;
+const K_SLICE_NS: usize = 0;
+
+// ONE CONTROL TICK: WHAT THE CONTROLLER SAW, WHAT IT DECIDED, WHAT IT LEFT
+// LIVE. repr(C) WITH NO IMPLICIT PADDING: THE FLIGHT RECORDER WRITES IT
+// TO DISK AS-IS.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Snapshot {
+    pub ts_ns: u64,      // CLOCK_MONOTONIC, STAMPED BY EventLog
+    pub elapsed_ns: u64, // WALL TIME THIS TICK COVERS
+    pub tick: u64,
+    pub stats: [u64; N_STATS], // PandemoniumStats DELTAS (LEVELS AS READ)
+    pub knobs: [u64; N_KNOBS], // LIVE KNOBS AFTER THIS TICK'S WRITES
+    pub knob_gen: u64,
     pub wake_avg_us: u64,
-    pub hard_kicks: u64,
-    pub soft_kicks: u64,
     pub lat_idle_us: u64,
     pub lat_kick_us: u64,
+    pub p50_us: u64,
+    pub p90_us: u64,
+    pub p99_us: u64,
+    pub p999_us: u64,
+    pub p99_ns: u64, // AGGREGATE P99 THE CONTROLLER ACTED ON
+    pub tier_p99_ns: [u64; HIST_TIERS],
+    pub tier_samples: [u64; HIST_TIERS], // HISTOGRAM SAMPLES (P99 SAMPLE GATE)
+    pub regime_hold: u32,
+    pub spike_count: u32,
+    pub relax_counter: u32,
+    pub stability: u32,
+    pub decisions: u32, // controller::DECISION_* | STATE_*
+    pub io_pct: u32,
+    pub regime: u8, // Regime AS u8, OR REGIME_NONE
+    pub pending_regime: u8,
+    pub scale_pressure: u8,
+    pub _pad: u8,
+    pub scale_cpus: u32, // CPU COUNT THE KNOBS ARE SCALED FOR, 0 = UNKNOWN
+    pub starvations: u32, // EVT_STARVATION EVENTS FOLDED INTO THIS TICK'S RESCUES
+    pub _pad2: u32,
+}
+
+const _: () = assert!(std::mem::size_of::<Snapshot>() == 640);
+
+impl Default for Snapshot {
+    fn default() -> Self {
+        Self {
+            ts_ns: 0,
+            elapsed_ns: 0,
+            tick: 0,
+            stats: [0; N_STATS],
+            knobs: [0; N_KNOBS],
+            knob_gen: 0,
+            wake_avg_us: 0,
+            lat_idle_us: 0,
+            lat_kick_us: 0,
+            p50_us: 0,
+            p90_us: 0,
+            p99_us: 0,
+            p999_us: 0,
+            p99_ns: 0,
+            tier_p99_ns: [0; HIST_TIERS],
+            tier_samples: [0; HIST_TIERS],
+            regime_hold: 0,
+            spike_count: 0,
+            relax_counter: 0,
+            stability: 0,
+            decisions: 0,
+            io_pct: 0,
+            regime: REGIME_NONE,
+            pending_regime: REGIME_NONE,
+            scale_pressure: 0,
+            _pad: 0,
+            scale_cpus: 0,
+            starvations: 0,
+            _pad2: 0,
+        }
+    }
+}
+
+impl Snapshot {
+    pub fn dispatches(&self) -> u64 {
+        self.stats[S_DISPATCHES]
+    }
+
+    pub fn idle_hits(&self) -> u64 {
+        self.stats[S_IDLE_HITS]
+    }
+
+    pub fn shared(&self) -> u64 {
+        self.stats[S_SHARED]
+    }
+
+    pub fn preempt(&self) -> u64 {
+        self.stats[S_PREEMPT]
+    }
+
+    pub fn keep_run(&self) -> u64 {
+        self.stats[S_KEEP_RUNNING]
+    }
+
+    pub fn hard_kicks(&self) -> u64 {
+        self.stats[S_HARD_KICKS]
+    }
+
+    pub fn soft_kicks(&self) -> u64 {
+        self.stats[S_SOFT_KICKS]
+    }
+
+    // A COUNTER DELTA SCALED TO PER SECOND (TICKS CAN BE 50MS)
+    pub fn per_sec(&self, delta: u64) -> u64 {
+        if self.elapsed_ns == 0 {
+            return delta;
+        }
+        (delta as u128 * 1_000_000_000 / self.elapsed_ns as u128) as u64
+    }
+
+    pub fn regime_label(&self) -> &'static str {
+        regime_label(self.regime)
+    }
+
+    pub fn decision_label(&self) -> String {
+        decision_label(self.decisions)
+    }
+
+    // THE CONTROLLER INPUTS THIS TICK WAS DECIDED ON. STARVATION RESCUES
+    // ARRIVE AS EVENTS, NOT COUNTERS: THE LIVE LOOP RECORDS HOW MANY IT
+    // ADDED TO rescues IN starvations.
+    pub fn tick_input(&self) -> TickInput {
+        TickInput {
+            elapsed_ns: self.elapsed_ns,
+            dispatches: self.stats[S_DISPATCHES],
+            idle_hits: self.stats[S_IDLE_HITS],
+            rescues: self.stats[S_OVERFLOW_RESCUE] + self.starvations as u64,
+            p99_ns: self.p99_ns,
+            samples: self.tier_samples.iter().sum(),
+            p99_i_ns: self.tier_p99_ns[1],
+            samples_i: self.tier_samples[1],
+            io_pct: self.io_pct as u64,
+        }
+    }
+
+    // A BURST OR STARVATION EDGE ARRIVED DURING THE TICK. TRACES FROM
+    // BEFORE STATE_CONTENTION ONLY SHOW THE EDGES THAT PROMOTED.
+    pub fn contended(&self) -> bool {
+        self.decisions & (STATE_CONTENTION | DECISION_FAST_PROMOTE) != 0
+    }
 }
 
 pub struct EventLog {
     snapshots: Vec<Snapshot>,
     head: usize,
     len: usize,
+    flight: Option<FlightRecorder>,
 }
 
 impl EventLog {
     pub fn new() -> Self {
         Self {
-            snapshots: vec![
-                Snapshot {
-                    ts_ns: 0,
-                    dispatches: 0,
-                    idle_hits: 0,
-                    shared: 0,
-                    preempt: 0,
-                    keep_run: 0,
-                    wake_avg_us: 0,
-                    hard_kicks: 0,
-                    soft_kicks: 0,
-                    lat_idle_us: 0,
-                    lat_kick_us: 0
-                };
-                MAX_SNAPSHOTS
-            ],
+            snapshots: vec![Snapshot::default(); MAX_SNAPSHOTS],
             head: 0,
             len: 0,
+            flight: None,
         }
     }
 
-    // RECORD ONE STATS SNAPSHOT. CALLED ONCE PER SECOND FROM THE MONITOR LOOP.
-    // OVERWRITES OLDEST ENTRY WHEN FULL.
-    pub fn snapshot(
-        &mut self,
-        dispatches: u64,
-        idle_hits: u64,
-        shared: u64,
-        preempt: u64,
-        keep_run: u64,
-        wake_avg_us: u64,
-        hard_kicks: u64,
-        soft_kicks: u64,
-        lat_idle_us: u64,
-        lat_kick_us: u64,
-    ) {
-        self.snapshots[self.head] = Snapshot {
-            ts_ns: now_ns(),
-            dispatches,
-            idle_hits,
-            shared,
-            preempt,
-            keep_run,
-            wake_avg_us,
-            hard_kicks,
-            soft_kicks,
-            lat_idle_us,
-            lat_kick_us,
-        };
+    // ALSO APPEND EVERY SNAPSHOT TO AN ON-DISK FLIGHT RECORDER
+    pub fn record_to(&mut self, flight: FlightRecorder) {
+        self.flight = Some(flight);
+    }
+
+    pub fn flight(&self) -> Option<&FlightRecorder> {
+        self.flight.as_ref()
+    }
+
+    // RECORD ONE CONTROL TICK. CALLED FROM THE MONITOR LOOP: A COPY INTO
+    // THE RING (OVERWRITING THE OLDEST WHEN FULL) AND INTO THE FLIGHT
+    // RECORDER'S MAPPING. A FLIGHT RECORDER THAT FAILS TO ROTATE IS
+    // DETACHED AND ITS ERROR RETURNED ONCE.
+    pub fn snapshot(&mut self, snap: &Snapshot) -> Result<()> {
+        let slot = &mut self.snapshots[self.head];
+        *slot = *snap;
+        slot.ts_ns = now_ns();
+        let stamped = *slot;
         self.head = (self.head + 1) % MAX_SNAPSHOTS;
         if self.len < MAX_SNAPSHOTS {
             self.len += 1;
         }
+        if let Some(ref mut f) = self.flight {
+            if let Err(e) = f.append(&stamped) {
+                self.flight = None;
+                return Err(e);
+            }
+        }
+        Ok(())
     }
 
     pub fn len(&self) -> usize {
@@ -111,58 +383,7 @@ impl EventLog {
         if self.len == 0 {
             return;
         }
-
-        let mut iter = self.iter_chronological();
-        let first = iter.next().unwrap();
-        let base_ts = first.ts_ns;
-
-        println!(
-            "\n{:<10} {:<12} {:<10} {:<10} {:<10} {:<10} {:<10} {:<8} {:<8} {:<10} {:<10}",
-            "TIME_S",
-            "DISPATCH/S",
-            "IDLE/S",
-            "SHARED/S",
-            "PREEMPT",
-            "KEEP_RUN",
-            "WAKE_US",
-            "KICK_H",
-            "KICK_S",
-            "LAT_IDLE",
-            "LAT_KICK"
-        );
-        println!(
-            "{:<10.1} {:<12} {:<10} {:<10} {:<10} {:<10} {:<10} {:<8} {:<8} {:<10} {:<10}",
-            0.0,
-            first.dispatches,
-            first.idle_hits,
-            first.shared,
-            first.preempt,
-            first.keep_run,
-            first.wake_avg_us,
-            first.hard_kicks,
-            first.soft_kicks,
-            first.lat_idle_us,
-            first.lat_kick_us
-        );
-
-        for s in iter {
-            let elapsed_s = (s.ts_ns - base_ts) as f64 / 1_000_000_000.0;
-            println!(
-                "{:<10.1} {:<12} {:<10} {:<10} {:<10} {:<10} {:<10} {:<8} {:<8} {:<10} {:<10}",
-                elapsed_s,
-                s.dispatches,
-                s.idle_hits,
-                s.shared,
-                s.preempt,
-                s.keep_run,
-                s.wake_avg_us,
-                s.hard_kicks,
-                s.soft_kicks,
-                s.lat_idle_us,
-                s.lat_kick_us
-            );
-        }
-
+        dump_snapshots(self.iter_chronological());
         if self.len == MAX_SNAPSHOTS {
             println!(
                 "\n(RING BUFFER WRAPPED -- SHOWING MOST RECENT {} SNAPSHOTS)",
@@ -180,13 +401,19 @@ impl EventLog {
 
         let snapshots: Vec<&Snapshot> = self.iter_chronological().collect();
 
-        let total_d: u64 = snapshots.iter().map(|s| s.dispatches).sum();
-        let total_idle: u64 = snapshots.iter().map(|s| s.idle_hits).sum();
-        let total_shared: u64 = snapshots.iter().map(|s| s.shared).sum();
-        let total_preempt: u64 = snapshots.iter().map(|s| s.preempt).sum();
-        let total_keep: u64 = snapshots.iter().map(|s| s.keep_run).sum();
+        let total_d: u64 = snapshots.iter().map(|s| s.dispatches()).sum();
+        let total_idle: u64 = snapshots.iter().map(|s| s.idle_hits()).sum();
+        let total_shared: u64 = snapshots.iter().map(|s| s.shared()).sum();
+        let total_preempt: u64 = snapshots.iter().map(|s| s.preempt()).sum();
+        let total_keep: u64 = snapshots.iter().map(|s| s.keep_run()).sum();
 
-        let peak_d = snapshots.iter().map(|s| s.dispatches).max().unwrap_or(0);
+        let peak_d = snapshots
+            .iter()
+            .map(|s| s.per_sec(s.dispatches()))
+            .max()
+            .unwrap_or(0);
+        let peak_p99 = snapshots.iter().map(|s| s.p99_us).max().unwrap_or(0);
+        let peak_p999 = snapshots.iter().map(|s| s.p999_us).max().unwrap_or(0);
 
         let elapsed_ns = snapshots.last().unwrap().ts_ns - snapshots.first().unwrap().ts_ns;
         let elapsed_s = elapsed_ns as f64 / 1_000_000_000.0;
@@ -198,6 +425,8 @@ impl EventLog {
         println!("  TOTAL PREEMPT:     {}", total_preempt);
         println!("  TOTAL KEEP_RUN:    {}", total_keep);
         println!("  PEAK DISPATCH/S:   {}", peak_d);
+        println!("  PEAK WAKE P99:     {}us", peak_p99);
+        println!("  PEAK WAKE P99.9:   {}us", peak_p999);
         if elapsed_s > 0.0 {
             println!("  AVG DISPATCH/S:    {:.0}", total_d as f64 / elapsed_s);
             let idle_pct = if total_d > 0 {
@@ -212,6 +441,62 @@ impl EventLog {
     }
 }
 
+// PRINT A SNAPSHOT SERIES (EventLog::dump, pandemonium flight). RATES ARE
+// PER SECOND WHATEVER THE CONTROL PERIOD; DECISIONS PER decision_label().
+pub fn dump_snapshots<'a>(snaps: impl Iterator<Item = &'a Snapshot>) {
+    println!(
+        "\n{:<10} {:<12} {:<10} {:<10} {:<10} {:<10} {:<10} {:<8} {:<8} {:<10} {:<10} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8}",
+        "TIME_S",
+        "DISPATCH/S",
+        "IDLE/S",
+        "SHARED/S",
+        "PREEMPT",
+        "KEEP_RUN",
+        "WAKE_US",
+        "KICK_H",
+        "KICK_S",
+        "LAT_IDLE",
+        "LAT_KICK",
+        "P50_US",
+        "P90_US",
+        "P99_US",
+        "P999_US",
+        "P99_I",
+        "REGIME",
+        "SLICE_US",
+        "HOLD",
+        "DECIDE"
+    );
+    let mut base_ts = None;
+    for s in snaps {
+        let base = *base_ts.get_or_insert(s.ts_ns);
+        let elapsed_s = s.ts_ns.saturating_sub(base) as f64 / 1_000_000_000.0;
+        println!(
+            "{:<10.1} {:<12} {:<10} {:<10} {:<10} {:<10} {:<10} {:<8} {:<8} {:<10} {:<10} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8} {:<8}",
+            elapsed_s,
+            s.per_sec(s.dispatches()),
+            s.per_sec(s.idle_hits()),
+            s.per_sec(s.shared()),
+            s.preempt(),
+            s.keep_run(),
+            s.wake_avg_us,
+            s.hard_kicks(),
+            s.soft_kicks(),
+            s.lat_idle_us,
+            s.lat_kick_us,
+            s.p50_us,
+            s.p90_us,
+            s.p99_us,
+            s.p999_us,
+            s.tier_p99_ns[1] / 1000,
+            s.regime_label(),
+            s.knobs[K_SLICE_NS] / 1000,
+            s.regime_hold,
+            s.decision_label()
+        );
+    }
+}
+
 fn now_ns() -> u64 {
     let mut ts = libc::timespec {
         tv_sec: 0,
@@ -0,0 +1,302 @@
+// PANDEMONIUM FLIGHT RECORDER (--flight-recorder FILE)
+// MEMORY-MAPPED, FIXED-RECORD, APPEND-ONLY LOG OF EVERY CONTROL TICK'S
+// Snapshot, FOR POST-MORTEMS OF LATENCY INCIDENTS. append() IS A MEMCPY
+// INTO THE MAPPING: NO ALLOCATION, NO SYSCALL. THE PAGE CACHE KEEPS THE
+// RECORDS IF THE SCHEDULER ITSELF DIES.
+//
+// A FULL FILE ROTATES: FILE -> FILE.1 -> ... -> FILE.{FLIGHT_FILES - 1},
+// THE OLDEST IS DELETED. ROTATION IS THE ONLY PATH THAT MAKES SYSCALLS,
+// ONCE PER FILE. A RESTART REOPENS THE FILE AND APPENDS AFTER THE LAST
+// VALID RECORD; A FILE OF ANOTHER FORMAT OR CAPACITY IS ROTATED AWAY,
+// NOT OVERWRITTEN.
+//
+// LAYOUT (NATIVE ENDIAN): 64-BYTE HEADER, THEN capacity SLOTS.
+//   HEADER  [0..4] MAGIC  [4..8] VERSION  [8..12] RECORD_SIZE
+//           [12..16] CAPACITY  [16..20] CRC32 OF [0..16]
+//   RECORD  [0..8] SEQUENCE (1-BASED, 0 = EMPTY)  [8..8+S] Snapshot
+//           [8+S..12+S] CRC32 OF [0..8+S], PADDED TO 8 BYTES
+
+use std::fs::{File, OpenOptions};
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+
+use anyhow::{bail, Result};
+
+use crate::event::Snapshot;
+use crate::procstore::crc32;
+
+const FLIGHT_MAGIC: &[u8; 4] = b"PFLT";
+const FLIGHT_VERSION: u32 = 1;
+pub const FLIGHT_HEADER_SIZE: usize = 64;
+const SNAPSHOT_SIZE: usize = std::mem::size_of::<Snapshot>();
+const OFF_CRC: usize = 8 + SNAPSHOT_SIZE;
+pub const FLIGHT_RECORD_SIZE: usize = (OFF_CRC + 4 + 7) & !7;
+
+// FILES KEPT, COUNTING THE ONE BEING WRITTEN
+pub const FLIGHT_FILES: usize = 4;
+// ONE HOUR OF TICKS PER FILE, BOUNDED TO ABOUT 10MB AT A 50MS PERIOD
+pub const FLIGHT_MAX_RECORDS: usize = 16384;
+
+pub fn flight_capacity(period_ms: u64) -> usize {
+    ((3_600_000 / period_ms.max(1)) as usize).clamp(64, FLIGHT_MAX_RECORDS)
+}
+
+fn rd_u32(b: &[u8], off: usize) -> u32 {
+    u32::from_ne_bytes(b[off..off + 4].try_into().unwrap())
+}
+
+fn rd_u64(b: &[u8], off: usize) -> u64 {
+    u64::from_ne_bytes(b[off..off + 8].try_into().unwrap())
+}
+
+fn header(capacity: usize) -> [u8; FLIGHT_HEADER_SIZE] {
+    let mut h = [0u8; FLIGHT_HEADER_SIZE];
+    h[0..4].copy_from_slice(FLIGHT_MAGIC);
+    h[4..8].copy_from_slice(&FLIGHT_VERSION.to_ne_bytes());
+    h[8..12].copy_from_slice(&(FLIGHT_RECORD_SIZE as u32).to_ne_bytes());
+    h[12..16].copy_from_slice(&(capacity as u32).to_ne_bytes());
+    let crc = crc32(&h[..16]);
+    h[16..20].copy_from_slice(&crc.to_ne_bytes());
+    h
+}
+
+// CAPACITY OF A VALID HEADER, OR None
+fn parse_header(h: &[u8]) -> Option<usize> {
+    if h.len() < FLIGHT_HEADER_SIZE
+        || &h[0..4] != FLIGHT_MAGIC
+        || rd_u32(h, 4) != FLIGHT_VERSION
+        || rd_u32(h, 8) as usize != FLIGHT_RECORD_SIZE
+        || rd_u32(h, 16) != crc32(&h[..16])
+    {
+        return None;
+    }
+    Some(rd_u32(h, 12) as usize)
+}
+
+fn file_capacity(path: &Path) -> Option<usize> {
+    use std::os::unix::fs::FileExt;
+    let mut hdr = [0u8; FLIGHT_HEADER_SIZE];
+    File::open(path).ok()?.read_exact_at(&mut hdr, 0).ok()?;
+    parse_header(&hdr)
+}
+
+fn encode(rec: &mut [u8], seq: u64, s: &Snapshot) {
+    let body = unsafe {
+        std::slice::from_raw_parts(s as *const Snapshot as *const u8, SNAPSHOT_SIZE)
+    };
+    rec[0..8].copy_from_slice(&seq.to_ne_bytes());
+    rec[8..OFF_CRC].copy_from_slice(body);
+    // CRC LAST: A RECORD IS ONLY VALID ONCE THE BODY IS COMPLETE
+    let crc = crc32(&rec[..OFF_CRC]);
+    rec[OFF_CRC..OFF_CRC + 4].copy_from_slice(&crc.to_ne_bytes());
+}
+
+fn decode(rec: &[u8], seq: u64) -> Option<Snapshot> {
+    if rd_u64(rec, 0) != seq || rd_u32(rec, OFF_CRC) != crc32(&rec[..OFF_CRC]) {
+        return None;
+    }
+    Some(unsafe { std::ptr::read_unaligned(rec[8..].as_ptr() as *const Snapshot) })
+}
+
+fn rotated(path: &Path, n: usize) -> PathBuf {
+    let mut p = path.as_os_str().to_owned();
+    p.push(format!(".{}", n));
+    PathBuf::from(p)
+}
+
+// SHIFT FILE -> FILE.1 -> ..., DROPPING THE OLDEST
+fn rotate_files(path: &Path) -> Result<()> {
+    let _ = std::fs::remove_file(rotated(path, FLIGHT_FILES - 1));
+    for n in (1..FLIGHT_FILES - 1).rev() {
+        let from = rotated(path, n);
+        if from.exists() {
+            std::fs::rename(&from, rotated(path, n + 1))?;
+        }
+    }
+    if FLIGHT_FILES > 1 {
+        std::fs::rename(path, rotated(path, 1))?;
+    } else {
+        std::fs::remove_file(path)?;
+    }
+    Ok(())
+}
+
+pub struct FlightRecorder {
+    path: PathBuf,
+    _file: File, // HOLDS THE flock
+    map: *mut u8,
+    len: usize,
+    capacity: usize,
+    next: usize,
+    rotations: u64,
+}
+
+impl FlightRecorder {
+    // MAP (OR CREATE) THE FILE AND FIND THE APPEND POINT
+    pub fn open(path: &Path, capacity: usize) -> Result<Self> {
+        if capacity == 0 {
+            bail!("FLIGHT RECORDER {}: ZERO CAPACITY", path.display());
+        }
+        if let Some(dir) = path.parent() {
+            if !dir.as_os_str().is_empty() {
+                std::fs::create_dir_all(dir)?;
+            }
+        }
+        if let Ok(meta) = std::fs::metadata(path) {
+            let len = (FLIGHT_HEADER_SIZE + capacity * FLIGHT_RECORD_SIZE) as u64;
+            let reuse = meta.len() == len && file_capacity(path) == Some(capacity);
+            if !reuse && meta.len() > 0 {
+                rotate_files(path)?;
+            }
+        }
+        let mut rec = Self::create(path, capacity)?;
+        rec.next = (0..capacity)
+            .find(|&i| decode(rec.slot(i), i as u64 + 1).is_none())
+            .unwrap_or(capacity);
+        Ok(rec)
+    }
+
+    fn create(path: &Path, capacity: usize) -> Result<Self> {
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(path)?;
+        if unsafe { libc::flock(file.as_raw_fd(), libc::LOCK_EX | libc::LOCK_NB) } != 0 {
+            bail!(
+                "FLIGHT RECORDER {} IN USE: {}",
+                path.display(),
+                std::io::Error::last_os_error()
+            );
+        }
+        let len = FLIGHT_HEADER_SIZE + capacity * FLIGHT_RECORD_SIZE;
+        let fresh = file.metadata()?.len() != len as u64;
+        if fresh {
+            file.set_len(0)?;
+            file.set_len(len as u64)?;
+        }
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            bail!("FLIGHT RECORDER MMAP: {}", std::io::Error::last_os_error());
+        }
+        let mut rec = Self {
+            path: path.to_path_buf(),
+            _file: file,
+            map: ptr as *mut u8,
+            len,
+            capacity,
+            next: 0,
+            rotations: 0,
+        };
+        if fresh {
+            rec.bytes_mut()[..FLIGHT_HEADER_SIZE].copy_from_slice(&header(capacity));
+        }
+        Ok(rec)
+    }
+
+    fn bytes_mut(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.map, self.len) }
+    }
+
+    fn slot(&self, i: usize) -> &[u8] {
+        let off = FLIGHT_HEADER_SIZE + i * FLIGHT_RECORD_SIZE;
+        unsafe { std::slice::from_raw_parts(self.map.add(off), FLIGHT_RECORD_SIZE) }
+    }
+
+    // APPEND ONE RECORD. A FULL FILE ROTATES FIRST.
+    pub fn append(&mut self, s: &Snapshot) -> Result<()> {
+        if self.next == self.capacity {
+            // THE MAPPING AND LOCK FOLLOW THE INODE THROUGH THE RENAME
+            rotate_files(&self.path)?;
+            let mut fresh = Self::create(&self.path, self.capacity)?;
+            fresh.rotations = self.rotations + 1;
+            std::mem::swap(self, &mut fresh);
+            // fresh NOW HOLDS THE ROTATED FILE: DROPPING IT SYNCS AND UNMAPS
+        }
+        let i = self.next;
+        let off = FLIGHT_HEADER_SIZE + i * FLIGHT_RECORD_SIZE;
+        encode(
+            &mut self.bytes_mut()[off..off + FLIGHT_RECORD_SIZE],
+            i as u64 + 1,
+            s,
+        );
+        self.next += 1;
+        Ok(())
+    }
+
+    // RECORDS IN THE CURRENT FILE
+    pub fn len(&self) -> usize {
+        self.next
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.next == 0
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    // FILES ROTATED BY THIS RECORDER
+    pub fn rotations(&self) -> u64 {
+        self.rotations
+    }
+
+    pub fn path(&self) -> &Path {
+        &self.path
+    }
+}
+
+impl Drop for FlightRecorder {
+    fn drop(&mut self) {
+        unsafe {
+            libc::msync(self.map as *mut libc::c_void, self.len, libc::MS_SYNC);
+            libc::munmap(self.map as *mut libc::c_void, self.len);
+        }
+    }
+}
+
+// VALID RECORDS OF ONE FILE IN ORDER. READ, NOT MAPPED OR LOCKED, SO IT
+// WORKS ON A LIVE RECORDER; THE TAIL STOPS AT THE FIRST INVALID RECORD.
+pub fn read_flight_file(path: &Path) -> Result<Vec<Snapshot>> {
+    let data = std::fs::read(path)?;
+    let capacity = match parse_header(&data) {
+        Some(c) => c,
+        None => bail!("{}: NOT A PANDEMONIUM FLIGHT RECORD", path.display()),
+    };
+    let mut out = Vec::new();
+    for (i, rec) in data[FLIGHT_HEADER_SIZE..]
+        .chunks_exact(FLIGHT_RECORD_SIZE)
+        .take(capacity)
+        .enumerate()
+    {
+        match decode(rec, i as u64 + 1) {
+            Some(s) => out.push(s),
+            None => break,
+        }
+    }
+    Ok(out)
+}
+
+// THE WHOLE ROTATED SET, OLDEST FILE FIRST. MISSING OR FOREIGN ROTATED
+// FILES ARE SKIPPED; THE NAMED FILE ITSELF MUST BE READABLE.
+pub fn read_flight_set(path: &Path) -> Result<Vec<Snapshot>> {
+    let mut out = Vec::new();
+    for n in (1..FLIGHT_FILES).rev() {
+        if let Ok(mut recs) = read_flight_file(&rotated(path, n)) {
+            out.append(&mut recs);
+        }
+    }
+    out.append(&mut read_flight_file(path)?);
+    Ok(out)
+}
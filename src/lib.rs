@@ -1,3 +1,10 @@
+pub mod cgroup;
+pub mod controller;
 pub mod event;
+pub mod flight;
+pub mod metrics;
 pub mod procdb;
+pub mod procstore;
+pub mod replay;
+pub mod trace;
 pub mod tuning;
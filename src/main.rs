@@ -14,7 +14,9 @@ mod bpf_skel;
 mod log;
 mod adaptive;
 mod cli;
+mod controller;
 mod procdb;
+mod procstore;
 mod scheduler;
 mod topology;
 mod tuning;
@@ -26,7 +28,7 @@ use std::time::Duration;
 use anyhow::Result;
 use clap::{Parser, Subcommand};
 
-use scheduler::Scheduler;
+use scheduler::{Scheduler, SchedulerOptions};
 
 static SHUTDOWN: AtomicBool = AtomicBool::new(false);
 
@@ -55,6 +57,70 @@ struct Cli {
     /// Additional compositor process names to boost to LAT_CRITICAL
     #[arg(long)]
     compositor: Vec<String>,
+
+    /// Give each CPU's DSQ sojourn state its own cache line (off: packed array)
+    #[arg(long)]
+    pcpu_padded: bool,
+
+    /// Adaptive control period in milliseconds (50-1000)
+    #[arg(long, default_value_t = tuning::DEFAULT_CONTROL_PERIOD_MS)]
+    control_period_ms: u64,
+
+    /// Print the N busiest cgroups each second with --verbose (0 disables)
+    #[arg(long, default_value_t = 3)]
+    cgroup_top: usize,
+
+    /// Key procdb profiles by cgroup too (profiles then match within one boot)
+    #[arg(long)]
+    procdb_cgroup: bool,
+
+    /// Move up to 4 tasks per overflow pull in dispatch() instead of one
+    #[arg(long)]
+    dispatch_batch: bool,
+
+    /// Fully reclassify settled tasks only every N wakeups (0 = every wakeup, max 256)
+    #[arg(long, default_value_t = 0)]
+    reclass_interval: u32,
+
+    /// Give tasks waking on a stable period (frame, audio loops) period-derived deadlines
+    #[arg(long)]
+    periodic_deadline: bool,
+
+    /// Place short-running wakees of a stable waker near the waker's CPU
+    #[arg(long)]
+    pair_affinity: bool,
+
+    /// Place latency-tier wakeups on shallow C-states, batch on high-clocked CPUs
+    #[arg(long)]
+    idle_aware: bool,
+
+    /// Write sampled binary scheduling trace records to FILE
+    #[arg(long, value_name = "FILE")]
+    trace_out: Option<std::path::PathBuf>,
+
+    /// Trace about 1 in N matching events (1 = every event)
+    #[arg(long, default_value_t = pandemonium::trace::DEFAULT_TRACE_SAMPLE)]
+    trace_sample: u32,
+
+    /// Only trace tasks of this process (TGID)
+    #[arg(long)]
+    trace_pid: Option<u32>,
+
+    /// Only trace tasks whose comm starts with this prefix
+    #[arg(long)]
+    trace_comm: Option<String>,
+
+    /// Only trace tasks in this cgroup (path, relative to /sys/fs/cgroup)
+    #[arg(long)]
+    trace_cgroup: Option<std::path::PathBuf>,
+
+    /// Serve OpenMetrics at http://ADDR/metrics (e.g. 127.0.0.1:9469)
+    #[arg(long, value_name = "ADDR")]
+    metrics_listen: Option<String>,
+
+    /// Record every control tick to a memory-mapped, rotating FILE
+    #[arg(long, value_name = "FILE")]
+    flight_recorder: Option<std::path::PathBuf>,
 }
 
 #[derive(Subcommand)]
@@ -82,6 +148,62 @@ enum SubCmd {
 
     /// CPU-pinned stress worker for bench-scale (internal use)
     StressWorker(StressWorkerArgs),
+
+    /// Export, import or merge procdb snapshots (fleet warm start)
+    #[command(subcommand)]
+    Procdb(ProcdbCmd),
+
+    /// Print a flight recording (--flight-recorder FILE, rotated files first)
+    Flight {
+        /// Flight recorder file
+        file: std::path::PathBuf,
+
+        /// Only the last N ticks
+        #[arg(long)]
+        last: Option<usize>,
+    },
+
+    /// Replay the adaptive controller over a flight recording with candidate parameters
+    Replay(ReplayArgs),
+}
+
+#[derive(Subcommand)]
+enum ProcdbCmd {
+    /// Write this host's confident profiles to a portable snapshot
+    Export {
+        /// Output snapshot
+        #[arg(long, short)]
+        out: std::path::PathBuf,
+
+        /// Include executable-keyed profiles (hosts built from one image)
+        #[arg(long)]
+        with_exact: bool,
+    },
+
+    /// Merge a snapshot into this host's store (scheduler must be stopped)
+    Import {
+        /// Snapshot to import
+        file: std::path::PathBuf,
+
+        /// Import even if the snapshot was learned on different hardware
+        #[arg(long)]
+        force: bool,
+    },
+
+    /// Pool several snapshots into one golden snapshot
+    Merge {
+        /// Output snapshot
+        #[arg(long, short)]
+        out: std::path::PathBuf,
+
+        /// Input snapshots
+        #[arg(required = true)]
+        inputs: Vec<std::path::PathBuf>,
+
+        /// Merge even if inputs were learned on different hardware
+        #[arg(long)]
+        force: bool,
+    },
 }
 
 #[derive(Parser)]
@@ -91,6 +213,52 @@ struct ProbeArgs {
     death_pipe_fd: Option<i32>,
 }
 
+#[derive(Parser)]
+struct ReplayArgs {
+    /// Flight recorder file (rotated files are read too)
+    file: std::path::PathBuf,
+
+    /// Control period in ms (default: the trace's)
+    #[arg(long)]
+    period_ms: Option<u64>,
+
+    /// CPU count the knobs scale for (default: the trace's)
+    #[arg(long)]
+    nr_cpus: Option<u64>,
+
+    /// Regime switch hold in ms
+    #[arg(long)]
+    regime_hold_ms: Option<u64>,
+
+    /// P99 spike hold before tightening, in ms
+    #[arg(long)]
+    tighten_hold_ms: Option<u64>,
+
+    /// Good-P99 hold before each relax step, in ms
+    #[arg(long)]
+    relax_hold_ms: Option<u64>,
+
+    /// Slice added per relax step, in us
+    #[arg(long)]
+    relax_step_us: Option<u64>,
+
+    /// Tighten floor for the slice, in us
+    #[arg(long)]
+    min_slice_us: Option<u64>,
+
+    /// Percent of the slice kept per tighten
+    #[arg(long)]
+    tighten_pct: Option<u64>,
+
+    /// Sojourn threshold EWMA time constant, in ms
+    #[arg(long)]
+    sojourn_tau_ms: Option<u64>,
+
+    /// Print every tick, not only ticks with decisions
+    #[arg(long)]
+    all: bool,
+}
+
 #[derive(Parser)]
 struct StressWorkerArgs {
     /// CPU to pin the stress worker to
@@ -158,14 +326,34 @@ struct BenchRunArgs {
 fn main() -> Result<()> {
     let cli = Cli::parse();
 
-    let verbose = cli.verbose;
-    let dump_log = cli.dump_log;
-    let nr_cpus = cli.nr_cpus;
-    let no_adaptive = cli.no_adaptive;
-    let extra_compositors = cli.compositor;
-
     match cli.command {
-        None => run_scheduler(verbose, dump_log, nr_cpus, no_adaptive, &extra_compositors),
+        None => run_scheduler(RunOptions {
+            verbose: cli.verbose,
+            dump_log: cli.dump_log,
+            no_adaptive: cli.no_adaptive,
+            compositors: cli.compositor,
+            control_period_ms: cli.control_period_ms,
+            cgroup_top: cli.cgroup_top,
+            trace: cli.trace_out.map(|path| pandemonium::trace::TraceOptions {
+                path,
+                sample: cli.trace_sample,
+                pid: cli.trace_pid,
+                comm: cli.trace_comm,
+                cgroup: cli.trace_cgroup,
+            }),
+            metrics_listen: cli.metrics_listen,
+            flight_recorder: cli.flight_recorder,
+            sched: SchedulerOptions {
+                nr_cpus_override: cli.nr_cpus,
+                pcpu_padded: cli.pcpu_padded,
+                procdb_cgroup: cli.procdb_cgroup,
+                dispatch_batch: cli.dispatch_batch,
+                reclass_interval: cli.reclass_interval,
+                periodic_deadline: cli.periodic_deadline,
+                pair_affinity: cli.pair_affinity,
+                idle_aware: cli.idle_aware,
+            },
+        }),
         Some(SubCmd::Check) => cli::check::run_check(),
         Some(SubCmd::Probe(args)) => {
             cli::probe::run_probe(args.death_pipe_fd);
@@ -192,6 +380,29 @@ fn main() -> Result<()> {
             cli::stress::run_stress_worker(args.cpu);
             Ok(())
         }
+        Some(SubCmd::Procdb(cmd)) => match cmd {
+            ProcdbCmd::Export { out, with_exact } => cli::procdb::run_export(&out, with_exact),
+            ProcdbCmd::Import { file, force } => cli::procdb::run_import(&file, force),
+            ProcdbCmd::Merge { out, inputs, force } => {
+                cli::procdb::run_merge(&out, &inputs, force)
+            }
+        },
+        Some(SubCmd::Flight { file, last }) => cli::flight::run_flight(&file, last),
+        Some(SubCmd::Replay(args)) => cli::replay::run_replay(
+            &args.file,
+            &cli::replay::ReplayOverrides {
+                period_ms: args.period_ms,
+                nr_cpus: args.nr_cpus,
+                regime_hold_ms: args.regime_hold_ms,
+                tighten_hold_ms: args.tighten_hold_ms,
+                relax_hold_ms: args.relax_hold_ms,
+                relax_step_us: args.relax_step_us,
+                min_slice_us: args.min_slice_us,
+                tighten_pct: args.tighten_pct,
+                sojourn_tau_ms: args.sojourn_tau_ms,
+            },
+            args.all,
+        ),
     }
 }
 
@@ -201,19 +412,40 @@ const DEFAULT_COMPOSITORS: &[&str] = &[
     "picom", "weston", "labwc", "wayfire", "niri", "pandemonium",
 ];
 
-fn run_scheduler(
+// EVERYTHING THE run PATH TAKES FROM THE COMMAND LINE
+struct RunOptions {
     verbose: bool,
     dump_log: bool,
-    nr_cpus: Option<u64>,
     no_adaptive: bool,
-    extra_compositors: &[String],
-) -> Result<()> {
+    compositors: Vec<String>,
+    control_period_ms: u64,
+    cgroup_top: usize,
+    trace: Option<pandemonium::trace::TraceOptions>,
+    metrics_listen: Option<String>,
+    flight_recorder: Option<std::path::PathBuf>,
+    sched: SchedulerOptions,
+}
+
+fn run_scheduler(opts: RunOptions) -> Result<()> {
+    let RunOptions {
+        verbose,
+        dump_log,
+        no_adaptive,
+        compositors,
+        control_period_ms,
+        cgroup_top,
+        trace,
+        metrics_listen,
+        flight_recorder,
+        sched: mut sched_opts,
+    } = opts;
+
     ctrlc::set_handler(move || {
         SHUTDOWN.store(true, Ordering::Relaxed);
     })?;
 
     let nr_cpus_display =
-        nr_cpus.unwrap_or_else(|| libbpf_rs::num_possible_cpus().unwrap_or(1) as u64);
+        sched_opts.nr_cpus_override.unwrap_or_else(|| libbpf_rs::num_possible_cpus().unwrap_or(1) as u64);
     let governor = std::fs::read_to_string("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor")
         .unwrap_or_default()
         .trim()
@@ -230,6 +462,64 @@ fn run_scheduler(
         }
     );
     log_info!("VERBOSE: {}", verbose);
+    if sched_opts.pcpu_padded {
+        log_info!("PER-CPU STATE: PADDED (ONE CACHE LINE PER CPU)");
+    }
+    if sched_opts.procdb_cgroup {
+        log_info!("PROCDB KEY: EXECUTABLE + COMM + CGROUP");
+    }
+    if sched_opts.dispatch_batch {
+        log_info!("DISPATCH: BATCHED (UP TO 4 TASKS PER OVERFLOW PULL)");
+    }
+    sched_opts.reclass_interval = tuning::clamp_reclass_interval(sched_opts.reclass_interval);
+    if sched_opts.reclass_interval > 0 {
+        log_info!("RECLASSIFY: EVERY {} WAKEUPS FOR SETTLED TASKS", sched_opts.reclass_interval);
+    }
+    if sched_opts.periodic_deadline {
+        log_info!("PERIODIC: 2-100MS WAKEUP PERIODS GET LAXITY DEADLINES");
+    }
+    if sched_opts.pair_affinity {
+        log_info!("PAIR AFFINITY: STABLE WAKEES PLACED BY THEIR WAKER'S L2/L3");
+    }
+    if sched_opts.idle_aware {
+        log_info!("IDLE-AWARE: LATENCY TIERS -> SHALLOW C-STATES, BATCH -> HIGH-CLOCKED CPUS");
+    }
+    if let Some(t) = &trace {
+        log_info!(
+            "TRACE: 1/{} SAMPLED -> {} (pid={} comm={} cgroup={})",
+            t.sample.max(1),
+            t.path.display(),
+            t.pid.map_or("any".to_string(), |p| p.to_string()),
+            t.comm.as_deref().unwrap_or("any"),
+            t.cgroup.as_ref().map_or("any".to_string(), |c| c.display().to_string())
+        );
+    }
+    let control_period_ms = tuning::clamp_control_period_ms(control_period_ms);
+    if !no_adaptive {
+        log_info!("CONTROL PERIOD: {}MS", control_period_ms);
+    }
+
+    // LIVE METRICS ENDPOINT: BOUND ONCE, SURVIVES SCHEDULER RESTARTS
+    let metrics = match metrics_listen.as_deref() {
+        Some(addr) => {
+            let m = pandemonium::metrics::MetricsHandle::spawn(addr)?;
+            log_info!("METRICS: http://{}/metrics", m.local_addr());
+            Some(m)
+        }
+        None => None,
+    };
+
+    // ONE RECORD PER CONTROL TICK (PER SECOND WITHOUT THE ADAPTIVE LOOP)
+    let flight_capacity =
+        pandemonium::flight::flight_capacity(if no_adaptive { 1000 } else { control_period_ms });
+    if let Some(path) = &flight_recorder {
+        log_info!(
+            "FLIGHT RECORDER: {} ({} TICKS PER FILE, {} FILES)",
+            path.display(),
+            flight_capacity,
+            pandemonium::flight::FLIGHT_FILES
+        );
+    }
 
     let mut is_restart = false;
     loop {
@@ -240,21 +530,28 @@ fn run_scheduler(
             std::thread::sleep(Duration::from_secs(2));
         }
 
-        let mut open_object = MaybeUninit::uninit();
-        let mut sched = Scheduler::init(&mut open_object, nr_cpus)?;
-
-        // POPULATE CACHE TOPOLOGY MAP AT STARTUP
-        match topology::CpuTopology::detect(nr_cpus_display as usize) {
+        // DETECT CACHE TOPOLOGY BEFORE LOAD: IT SIZES THE TOPOLOGY MAPS
+        let topo = match topology::CpuTopology::detect(nr_cpus_display as usize) {
             Ok(topo) => {
                 topo.log_summary();
-                if let Err(e) = topo.populate_bpf_map(&sched) {
-                    log_warn!("CACHE TOPOLOGY MAP WRITE FAILED: {}", e);
-                }
-                if let Err(e) = topo.populate_l2_siblings_map(&sched) {
-                    log_warn!("L2 SIBLINGS MAP WRITE FAILED: {}", e);
-                }
+                Some(topo)
+            }
+            Err(e) => {
+                log_warn!("CACHE TOPOLOGY DETECT FAILED: {}", e);
+                None
             }
-            Err(e) => log_warn!("CACHE TOPOLOGY DETECT FAILED: {}", e),
+        };
+        let sizing = topo
+            .as_ref()
+            .map(|t| t.map_sizing())
+            .unwrap_or_else(|| topology::MapSizing::fallback(nr_cpus_display as usize));
+
+        let mut open_object = MaybeUninit::uninit();
+        let mut sched = Scheduler::init(&mut open_object, &sched_opts, &sizing)?;
+
+        // POPULATE CACHE TOPOLOGY MAP AT STARTUP
+        if let Some(topo) = &topo {
+            topo.publish(&sched);
         }
 
         // POPULATE COMPOSITOR MAP: DEFAULT + USER-SUPPLIED NAMES
@@ -263,22 +560,94 @@ fn run_scheduler(
                 log_warn!("COMPOSITOR MAP WRITE FAILED: {} ({})", name, e);
             }
         }
-        for name in extra_compositors {
+        for name in &compositors {
             if let Err(e) = sched.write_compositor(name) {
                 log_warn!("COMPOSITOR MAP WRITE FAILED: {} ({})", name, e);
             }
         }
 
+        // CALLBACK RUN STATS ARE READ BY THE METRICS THREAD, PER SCRAPE
+        if let Some(m) = &metrics {
+            m.watch_callbacks(&sched.callback_fds());
+        }
+
+        // FLIGHT RECORDER (NON-FATAL): A RESTART APPENDS TO THE SAME FILE
+        if let Some(path) = &flight_recorder {
+            match pandemonium::flight::FlightRecorder::open(path, flight_capacity) {
+                Ok(rec) => sched.log.record_to(rec),
+                Err(e) => log_warn!("FLIGHT RECORDER DISABLED: {}", e),
+            }
+        }
+
+        // SCHEDULING TRACE (NON-FATAL: THE SCHEDULER RUNS WITHOUT IT)
+        if let Some(t) = &trace {
+            if let Err(e) = sched.start_trace(t) {
+                log_warn!("TRACE DISABLED: {}", e);
+            }
+        }
+
         let should_restart = if no_adaptive {
             // BPF-ONLY MODE: SCHEDULER RUNS WITH DEFAULT KNOBS, NO RUST TUNING
             // STILL PRINTS STATS SO BENCHMARKS GET TELEMETRY FOR BOTH PHASES
             log_info!("PANDEMONIUM IS ACTIVE (BPF ONLY, CTRL+C TO EXIT)");
             let mut prev = scheduler::PandemoniumStats::default();
+            let mut prev_hist = [[0u64; tuning::HIST_BUCKETS]; tuning::HIST_TIERS];
+            let mut cgroups = pandemonium::cgroup::CgroupTracker::new();
+            let mut events = Vec::with_capacity(256);
+            // KNOBS STAY AT THEIR DEFAULTS WITHOUT THE ADAPTIVE LOOP
+            let live_knobs = scheduler::knob_values(&sched.read_tuning_knobs());
+            let mut reports: u64 = 0;
             while !SHUTDOWN.load(Ordering::Relaxed) && !sched.exited() {
-                std::thread::sleep(Duration::from_secs(1));
+                // NO TUNING TO DRIVE: DRAIN THE EVENT RINGBUF SO BPF NEVER
+                // DROPS, AND COUNT WHAT CAME THROUGH FOR THE TELEMETRY LINE
+                let tick_start = std::time::Instant::now();
+                let mut tally = pandemonium::event::EventTally::default();
+                let mut hotplug = false;
+                while tick_start.elapsed() < Duration::from_secs(1)
+                    && !SHUTDOWN.load(Ordering::Relaxed)
+                    && !sched.exited()
+                {
+                    let left = Duration::from_secs(1).saturating_sub(tick_start.elapsed());
+                    sched.poll_events(left, &mut events);
+                    for ev in events.drain(..) {
+                        tally.record(&ev);
+                        if matches!(ev.kind(), Some(pandemonium::event::EventKind::Hotplug)) {
+                            hotplug = true;
+                        }
+                    }
+                }
+
+                // CPU HOTPLUG: BPF ALREADY DRAINED THE DEAD CPU'S DSQ. THE
+                // L2/L3 AND TOPOLOGY MAPS STILL NEED THE NEW ONLINE SET; WITH
+                // NO ADAPTIVE LOOP THERE ARE NO KNOBS TO RESCALE.
+                if hotplug {
+                    let online = adaptive::republish_topology(&sched, nr_cpus_display);
+                    log_info!(
+                        "HOTPLUG: {} CPUS EFFECTIVE, TOPOLOGY REPUBLISHED",
+                        online.map_or_else(|| "?".to_string(), |n| n.to_string())
+                    );
+                }
 
                 let stats = sched.read_stats();
 
+                // WAKEUP LATENCY PERCENTILES OVER THE LAST SECOND (ALL TIERS)
+                let cur_hist = sched.read_wake_lat_hist();
+                let mut delta_hist = [[0u64; tuning::HIST_BUCKETS]; tuning::HIST_TIERS];
+                let mut agg = [0u64; tuning::HIST_BUCKETS];
+                for tier in 0..tuning::HIST_TIERS {
+                    for b in 0..tuning::HIST_BUCKETS {
+                        delta_hist[tier][b] = cur_hist[tier][b].wrapping_sub(prev_hist[tier][b]);
+                        agg[b] += delta_hist[tier][b];
+                    }
+                }
+                let pct = tuning::compute_percentiles(&agg);
+                let pct_us = [
+                    pct.p50_ns / 1000,
+                    pct.p90_ns / 1000,
+                    pct.p99_ns / 1000,
+                    pct.p999_ns / 1000,
+                ];
+
                 let delta_d = stats.nr_dispatches.wrapping_sub(prev.nr_dispatches);
                 let delta_idle = stats.nr_idle_hits.wrapping_sub(prev.nr_idle_hits);
                 let delta_shared = stats.nr_shared.wrapping_sub(prev.nr_shared);
@@ -312,6 +681,20 @@ fn run_scheduler(
                 };
                 let delta_procdb = stats.nr_procdb_hits.wrapping_sub(prev.nr_procdb_hits);
                 let delta_reenq = stats.nr_reenqueue.wrapping_sub(prev.nr_reenqueue);
+                let delta_pair = stats.nr_pair_affine.wrapping_sub(prev.nr_pair_affine);
+                let delta_pair_sync = stats.nr_pair_sync.wrapping_sub(prev.nr_pair_sync);
+                let delta_cst_shallow = stats.nr_idle_shallow.wrapping_sub(prev.nr_idle_shallow);
+                let delta_cst_warm = stats.nr_idle_warm.wrapping_sub(prev.nr_idle_warm);
+                let dx_near = stats.nr_xnode_steal_near.wrapping_sub(prev.nr_xnode_steal_near);
+                let dx_mid = stats.nr_xnode_steal_mid.wrapping_sub(prev.nr_xnode_steal_mid);
+                let dx_far = stats.nr_xnode_steal_far.wrapping_sub(prev.nr_xnode_steal_far);
+                let dx_gated = stats.nr_xnode_steal_gated.wrapping_sub(prev.nr_xnode_steal_gated);
+                let delta_dropped = stats.nr_events_dropped.wrapping_sub(prev.nr_events_dropped);
+                let delta_fill = stats.nr_dispatch_batched.wrapping_sub(prev.nr_dispatch_batched);
+                let reclass_pct = tuning::reclass_pct(
+                    stats.nr_reclassify.wrapping_sub(prev.nr_reclassify),
+                    stats.nr_reclass_skipped.wrapping_sub(prev.nr_reclass_skipped),
+                );
 
                 // L2 CACHE AFFINITY DELTAS
                 let dl2_hb = stats.nr_l2_hit_batch.wrapping_sub(prev.nr_l2_hit_batch);
@@ -344,6 +727,22 @@ fn run_scheduler(
                     0
                 };
 
+                // SMT PLACEMENT DELTAS: % OF ATTEMPTS THAT FOUND AN IDLE CORE / A PACK SLOT
+                let dsmt_ch = stats.nr_smt_core_hit.wrapping_sub(prev.nr_smt_core_hit);
+                let dsmt_cm = stats.nr_smt_core_miss.wrapping_sub(prev.nr_smt_core_miss);
+                let dsmt_ph = stats.nr_smt_pack_hit.wrapping_sub(prev.nr_smt_pack_hit);
+                let dsmt_pm = stats.nr_smt_pack_miss.wrapping_sub(prev.nr_smt_pack_miss);
+                let smt_pct_core = if dsmt_ch + dsmt_cm > 0 {
+                    dsmt_ch * 100 / (dsmt_ch + dsmt_cm)
+                } else {
+                    0
+                };
+                let smt_pct_pack = if dsmt_ph + dsmt_pm > 0 {
+                    dsmt_ph * 100 / (dsmt_ph + dsmt_pm)
+                } else {
+                    0
+                };
+
                 let idle_pct = if delta_d > 0 {
                     delta_idle * 100 / delta_d
                 } else {
@@ -357,29 +756,78 @@ fn run_scheduler(
 
                 if verbose {
                     println!(
-                        "d/s: {:<8} idle: {}% shared: {:<6} preempt: {:<4} keep: {:<4} kick: H={:<4} S={:<4} enq: W={:<4} R={:<4} wake: {}us lat_idle: {}us lat_kick: {}us procdb: {} reenq: {} sjrn: {}ms l2: B={}% I={}% L={}% [BPF{}{}]",
+                        "d/s: {:<8} idle: {}% shared: {:<6} preempt: {:<4} keep: {:<4} kick: H={:<4} S={:<4} enq: W={:<4} R={:<4} wake: {}us p50: {}us p90: {}us p99: {}us p999: {}us lat_idle: {}us lat_kick: {}us procdb: {} reenq: {} sjrn: {}ms fill: {} reclass: {}% pair: A={} S={} cst: S={} W={} xnode: N={} M={} F={} G={} evt: {} D={} l2: B={}% I={}% L={}% smt: C={}% P={}% [BPF{}{}]",
                         delta_d, idle_pct, delta_shared, delta_preempt, delta_keep,
                         delta_hard, delta_soft, delta_enq_wake, delta_enq_requeue,
-                        wake_avg_us, lat_idle_us, lat_kick_us, delta_procdb,
-                        delta_reenq, sojourn_ms, l2_pct_b, l2_pct_i, l2_pct_l,
+                        wake_avg_us, pct_us[0], pct_us[1], pct_us[2], pct_us[3],
+                        lat_idle_us, lat_kick_us, delta_procdb,
+                        delta_reenq, sojourn_ms, delta_fill, reclass_pct, delta_pair, delta_pair_sync,
+                        delta_cst_shallow, delta_cst_warm,
+                        dx_near, dx_mid, dx_far, dx_gated,
+                        tally.total(), delta_dropped,
+                        l2_pct_b, l2_pct_i, l2_pct_l, smt_pct_core, smt_pct_pack,
                         burst_label, longrun_label,
                     );
                 }
 
-                sched.log.snapshot(
-                    delta_d,
-                    delta_idle,
-                    delta_shared,
-                    delta_preempt,
-                    delta_keep,
+                adaptive::report_cgroups(&sched, &mut cgroups, cgroup_top, verbose);
+
+                reports += 1;
+                let mut bpf_state = 0;
+                if delta_burst > 0 {
+                    bpf_state |= controller::STATE_BURST;
+                }
+                if stats.longrun_mode_active > 0 {
+                    bpf_state |= controller::STATE_LONGRUN;
+                }
+                let mut tier_p99_ns = [0u64; tuning::HIST_TIERS];
+                let mut tier_samples = [0u64; tuning::HIST_TIERS];
+                for t in 0..tuning::HIST_TIERS {
+                    tier_p99_ns[t] = tuning::compute_p99_from_histogram(&delta_hist[t]);
+                    tier_samples[t] = delta_hist[t].iter().sum();
+                }
+                let snap = pandemonium::event::Snapshot {
+                    elapsed_ns: tick_start.elapsed().as_nanos() as u64,
+                    tick: reports,
+                    stats: pandemonium::metrics::stat_deltas(&stats.counters(), &prev.counters()),
+                    knobs: live_knobs,
+                    knob_gen: sched.knob_gen(),
                     wake_avg_us,
-                    delta_hard,
-                    delta_soft,
                     lat_idle_us,
                     lat_kick_us,
-                );
+                    p50_us: pct_us[0],
+                    p90_us: pct_us[1],
+                    p99_us: pct_us[2],
+                    p999_us: pct_us[3],
+                    p99_ns: pct.p99_ns,
+                    tier_p99_ns,
+                    tier_samples,
+                    decisions: bpf_state,
+                    ..Default::default()
+                };
+                if let Err(e) = sched.log.snapshot(&snap) {
+                    log_warn!("FLIGHT RECORDER DISABLED: {}", e);
+                }
+                if let Some(ref m) = metrics {
+                    let mut tier_pct_ns = [[0u64; 4]; tuning::HIST_TIERS];
+                    for (t, row) in tier_pct_ns.iter_mut().enumerate() {
+                        let p = tuning::compute_percentiles(&delta_hist[t]);
+                        *row = [p.p50_ns, p.p90_ns, p.p99_ns, p.p999_ns];
+                    }
+                    m.publish(&pandemonium::metrics::MetricsSnapshot {
+                        reports,
+                        stats: stats.counters(),
+                        tier_pct_ns,
+                        all_pct_ns: [pct.p50_ns, pct.p90_ns, pct.p99_ns, pct.p999_ns],
+                        burst: delta_burst > 0,
+                        longrun: stats.longrun_mode_active > 0,
+                        knobs: live_knobs,
+                        ..Default::default()
+                    });
+                }
 
                 prev = stats;
+                prev_hist = cur_hist;
             }
 
             // KNOBS SUMMARY: CAPTURED BY TEST HARNESS FOR ARCHIVE
@@ -414,10 +862,22 @@ fn run_scheduler(
         } else {
             // ADAPTIVE MODE: BPF + SINGLE-THREAD MONITOR LOOP
             log_info!("PANDEMONIUM IS ACTIVE (CTRL+C TO EXIT)");
-            adaptive::monitor_loop(&mut sched, &SHUTDOWN, verbose, nr_cpus_display)?
+            adaptive::monitor_loop(
+                &mut sched,
+                &SHUTDOWN,
+                verbose,
+                nr_cpus_display,
+                sched_opts.nr_cpus_override.is_none(),
+                Duration::from_millis(control_period_ms),
+                cgroup_top,
+                metrics.as_ref(),
+            )?
         };
 
         log_info!("PANDEMONIUM IS SHUTTING DOWN");
+        if let Some(m) = &metrics {
+            m.unwatch_callbacks();
+        }
 
         if dump_log {
             sched.log.dump();
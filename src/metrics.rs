@@ -0,0 +1,463 @@
+// PANDEMONIUM LIVE METRICS (--metrics-listen)
+// OPENMETRICS TEXT OVER HTTP, SERVED FROM ITS OWN THREAD.
+//
+// THE MONITOR LOOP FILLS A FIXED-SIZE MetricsSnapshot ONCE PER REPORT
+// PERIOD FROM VALUES IT ALREADY COMPUTED AND HANDS IT OFF WITH A try_lock
+// COPY: NO ALLOCATION, NO SYSCALL. A REPORT THAT FINDS THE SLOT BUSY SKIPS
+// ITS PUBLISH INSTEAD OF WAITING. THE SERVER COPIES THE SLOT OUT THE SAME
+// WAY AND RENDERS OUTSIDE THE LOCK, SO NEITHER SIDE EVER SLEEPS ON IT.
+// PER-CALLBACK RUN STATS NEED AN fdinfo READ PER PROGRAM, SO THE SERVER
+// THREAD DOES THOSE ITSELF WHEN A SCRAPE ARRIVES, OFF THE CONTROL TICK.
+
+use std::fmt::Write as _;
+use std::io::{Read, Write};
+use std::net::{SocketAddr, TcpListener, TcpStream};
+use std::sync::atomic::{AtomicI32, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, TryLockError};
+use std::time::Duration;
+
+use anyhow::{Context, Result};
+
+// MATCHES PandemoniumStats FIELD ORDER (scheduler.rs / intf.h)
+pub const STAT_NAMES: [&str; 46] = [
+    "nr_dispatches",
+    "nr_idle_hits",
+    "nr_shared",
+    "nr_preempt",
+    "wake_lat_sum",
+    "wake_lat_max",
+    "wake_lat_samples",
+    "nr_keep_running",
+    "nr_hard_kicks",
+    "nr_soft_kicks",
+    "nr_enq_wakeup",
+    "nr_enq_requeue",
+    "wake_lat_idle_sum",
+    "wake_lat_idle_cnt",
+    "wake_lat_kick_sum",
+    "wake_lat_kick_cnt",
+    "nr_procdb_hits",
+    "nr_l2_hit_batch",
+    "nr_l2_miss_batch",
+    "nr_l2_hit_interactive",
+    "nr_l2_miss_interactive",
+    "nr_l2_hit_lat_crit",
+    "nr_l2_miss_lat_crit",
+    "nr_smt_core_hit",
+    "nr_smt_core_miss",
+    "nr_smt_pack_hit",
+    "nr_smt_pack_miss",
+    "nr_reenqueue",
+    "batch_sojourn_ns",
+    "burst_mode_active",
+    "longrun_mode_active",
+    "nr_overflow_rescue",
+    "nr_xnode_steal_near",
+    "nr_xnode_steal_mid",
+    "nr_xnode_steal_far",
+    "nr_xnode_steal_gated",
+    "nr_events_dropped",
+    "nr_hotplug_drained",
+    "nr_dispatch_batched",
+    "nr_reclassify",
+    "nr_reclass_skipped",
+    "nr_trace_dropped",
+    "nr_pair_affine",
+    "nr_pair_sync",
+    "nr_idle_shallow",
+    "nr_idle_warm",
+];
+pub const N_STATS: usize = STAT_NAMES.len();
+
+// LEVELS, NOT RUNNING TOTALS: wake_lat_max, batch_sojourn_ns,
+// longrun_mode_active (burst_mode_active COUNTS BURST TICKS). read_stats()
+// TAKES THE MAX OVER CPUs FOR EACH, NOT THE SUM.
+const STAT_GAUGES: [(usize, &str); 3] = [
+    (5, "Largest wakeup-to-run latency in ns (max over CPUs)"),
+    (28, "Age in ns of the oldest waiting batch task (max over CPUs)"),
+    (30, "1 while any node is in longrun mode (max over CPUs)"),
+];
+
+pub fn is_gauge(stat: usize) -> bool {
+    STAT_GAUGES.iter().any(|&(i, _)| i == stat)
+}
+
+fn gauge_help(stat: usize) -> Option<&'static str> {
+    STAT_GAUGES.iter().find(|&&(i, _)| i == stat).map(|&(_, help)| help)
+}
+
+// ONE WINDOW OF A STATS READ: COUNTERS DIFFERENCED, LEVELS AS READ
+pub fn stat_deltas(cur: &[u64; N_STATS], prev: &[u64; N_STATS]) -> [u64; N_STATS] {
+    let mut d = [0u64; N_STATS];
+    for i in 0..N_STATS {
+        d[i] = if is_gauge(i) {
+            cur[i]
+        } else {
+            cur[i].wrapping_sub(prev[i])
+        };
+    }
+    d
+}
+
+// MATCHES TuningKnobs FIELD ORDER (tuning.rs)
+pub const KNOB_NAMES: [&str; 11] = [
+    "slice_ns",
+    "preempt_thresh_ns",
+    "lag_scale",
+    "batch_slice_ns",
+    "cpu_bound_thresh_ns",
+    "lat_cri_thresh_high",
+    "lat_cri_thresh_low",
+    "affinity_mode",
+    "sojourn_thresh_ns",
+    "burst_slice_ns",
+    "smt_mode",
+];
+pub const N_KNOBS: usize = KNOB_NAMES.len();
+
+// HISTOGRAM TIERS (wake_lat_hist ROWS) AND THE PERCENTILES REPORTED FOR EACH
+pub const TIER_NAMES: [&str; 3] = ["batch", "interactive", "lat_critical"];
+pub const QUANTILES: [&str; 4] = ["0.5", "0.9", "0.99", "0.999"];
+pub const REGIMES: [&str; 3] = ["LIGHT", "MIXED", "HEAVY"];
+
+// STRUCT_OPS CALLBACKS PROFILED PER INVOCATION (kernel.bpf_stats_enabled)
+pub const CALLBACK_NAMES: [&str; 7] = [
+    "select_cpu",
+    "enqueue",
+    "dispatch",
+    "runnable",
+    "running",
+    "stopping",
+    "tick",
+];
+pub const N_CALLBACKS: usize = CALLBACK_NAMES.len();
+
+// (run_time_ns, run_cnt) FROM A BPF PROGRAM FD'S /proc/PID/fdinfo TEXT.
+// THE KERNEL ONLY ADVANCES BOTH WHILE kernel.bpf_stats_enabled IS SET.
+pub fn prog_run_stats(fdinfo: &str) -> (u64, u64) {
+    let mut run_ns = 0;
+    let mut run_cnt = 0;
+    for line in fdinfo.lines() {
+        let (key, val) = match line.split_once(':') {
+            Some(kv) => kv,
+            None => continue,
+        };
+        match key {
+            "run_time_ns" => run_ns = val.trim().parse().unwrap_or(0),
+            "run_cnt" => run_cnt = val.trim().parse().unwrap_or(0),
+            _ => {}
+        }
+    }
+    (run_ns, run_cnt)
+}
+
+// CUMULATIVE PER-CALLBACK BPF RUN TIME AND INVOCATIONS (CALLBACK_NAMES)
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct CallbackStats {
+    pub run_ns: [u64; N_CALLBACKS],
+    pub run_cnt: [u64; N_CALLBACKS],
+}
+
+// ONE fdinfo READ PER PROGRAM FD; A NEGATIVE OR STALE FD READS AS ZERO
+pub fn read_callback_stats(fds: &[i32; N_CALLBACKS]) -> CallbackStats {
+    let mut cb = CallbackStats::default();
+    for (i, &fd) in fds.iter().enumerate() {
+        if fd < 0 {
+            continue;
+        }
+        if let Ok(text) = std::fs::read_to_string(format!("/proc/self/fdinfo/{}", fd)) {
+            (cb.run_ns[i], cb.run_cnt[i]) = prog_run_stats(&text);
+        }
+    }
+    cb
+}
+
+// ONE REPORT PERIOD'S VIEW. FIXED SIZE, Copy: PUBLISHING IS A MEMCPY.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct MetricsSnapshot {
+    pub reports: u64,
+    pub stats: [u64; N_STATS],
+    // WAKEUP LATENCY PERCENTILES (NS) OVER THE REPORT WINDOW, PER TIER + ALL
+    pub tier_pct_ns: [[u64; 4]; 3],
+    pub all_pct_ns: [u64; 4],
+    // REGIME LABEL, OR "" WHEN THE ADAPTIVE LOOP IS OFF (--no-adaptive)
+    pub regime: &'static str,
+    pub burst: bool,
+    pub longrun: bool,
+    pub tightened: bool,
+    pub stability: u32,
+    pub knobs: [u64; N_KNOBS],
+    pub procdb_profiles: u64,
+    pub procdb_confident: u64,
+}
+
+impl Default for MetricsSnapshot {
+    fn default() -> Self {
+        Self {
+            reports: 0,
+            stats: [0; N_STATS],
+            tier_pct_ns: [[0; 4]; 3],
+            all_pct_ns: [0; 4],
+            regime: "",
+            burst: false,
+            longrun: false,
+            tightened: false,
+            stability: 0,
+            knobs: [0; N_KNOBS],
+            procdb_profiles: 0,
+            procdb_confident: 0,
+        }
+    }
+}
+
+fn family(out: &mut String, name: &str, kind: &str, help: &str) {
+    let _ = writeln!(out, "# TYPE pandemonium_{} {}", name, kind);
+    let _ = writeln!(out, "# HELP pandemonium_{} {}", name, help);
+}
+
+// RENDER ONE SNAPSHOT AS AN OPENMETRICS TEXT EXPOSITION (ENDS WITH # EOF)
+pub fn render(s: &MetricsSnapshot, cb: &CallbackStats, out: &mut String) {
+    out.clear();
+
+    family(out, "reports", "counter", "Report periods published by the monitor loop");
+    let _ = writeln!(out, "pandemonium_reports_total {}", s.reports);
+
+    for (i, (name, &v)) in STAT_NAMES.iter().zip(s.stats.iter()).enumerate() {
+        if let Some(help) = gauge_help(i) {
+            family(out, name, "gauge", help);
+            let _ = writeln!(out, "pandemonium_{} {}", name, v);
+        } else {
+            family(out, name, "counter", "BPF stats_map counter (summed over CPUs)");
+            let _ = writeln!(out, "pandemonium_{}_total {}", name, v);
+        }
+    }
+
+    family(
+        out,
+        "wake_latency_ns",
+        "gauge",
+        "Wakeup-to-run latency percentile over the last report period",
+    );
+    for (tier, pct) in TIER_NAMES.iter().zip(s.tier_pct_ns.iter()) {
+        for (q, v) in QUANTILES.iter().zip(pct.iter()) {
+            let _ = writeln!(
+                out,
+                "pandemonium_wake_latency_ns{{tier=\"{}\",quantile=\"{}\"}} {}",
+                tier, q, v
+            );
+        }
+    }
+    for (q, v) in QUANTILES.iter().zip(s.all_pct_ns.iter()) {
+        let _ = writeln!(
+            out,
+            "pandemonium_wake_latency_ns{{tier=\"all\",quantile=\"{}\"}} {}",
+            q, v
+        );
+    }
+
+    family(out, "adaptive", "gauge", "1 when the adaptive control loop drives the knobs");
+    let _ = writeln!(out, "pandemonium_adaptive {}", !s.regime.is_empty() as u8);
+    family(out, "regime", "stateset", "Current workload regime");
+    for r in REGIMES {
+        let _ = writeln!(
+            out,
+            "pandemonium_regime{{pandemonium_regime=\"{}\"}} {}",
+            r,
+            (s.regime == r) as u8
+        );
+    }
+    family(out, "burst", "gauge", "Burst mode active during the last report period");
+    let _ = writeln!(out, "pandemonium_burst {}", s.burst as u8);
+    family(out, "longrun", "gauge", "Sustained batch pressure detected");
+    let _ = writeln!(out, "pandemonium_longrun {}", s.longrun as u8);
+    family(out, "tightened", "gauge", "Slice tightened below the regime baseline");
+    let _ = writeln!(out, "pandemonium_tightened {}", s.tightened as u8);
+    family(out, "stability_score", "gauge", "Consecutive stable report periods (capped)");
+    let _ = writeln!(out, "pandemonium_stability_score {}", s.stability);
+
+    family(out, "knob", "gauge", "Live tuning knob value");
+    for (name, v) in KNOB_NAMES.iter().zip(s.knobs.iter()) {
+        let _ = writeln!(out, "pandemonium_knob{{knob=\"{}\"}} {}", name, v);
+    }
+
+    family(out, "procdb_profiles", "gauge", "Process profiles tracked by procdb");
+    let _ = writeln!(out, "pandemonium_procdb_profiles {}", s.procdb_profiles);
+    family(out, "procdb_confident", "gauge", "procdb profiles confident enough to seed BPF");
+    let _ = writeln!(out, "pandemonium_procdb_confident {}", s.procdb_confident);
+
+    // ZERO UNTIL kernel.bpf_stats_enabled=1; ns/call IS THE RATIO OF DELTAS
+    family(
+        out,
+        "bpf_run_time_ns",
+        "counter",
+        "Time spent in the struct_ops callback (kernel.bpf_stats_enabled)",
+    );
+    for (name, v) in CALLBACK_NAMES.iter().zip(cb.run_ns.iter()) {
+        let _ = writeln!(
+            out,
+            "pandemonium_bpf_run_time_ns_total{{callback=\"{}\"}} {}",
+            name, v
+        );
+    }
+    family(
+        out,
+        "bpf_run",
+        "counter",
+        "Invocations of the struct_ops callback (kernel.bpf_stats_enabled)",
+    );
+    for (name, v) in CALLBACK_NAMES.iter().zip(cb.run_cnt.iter()) {
+        let _ = writeln!(
+            out,
+            "pandemonium_bpf_run_total{{callback=\"{}\"}} {}",
+            name, v
+        );
+    }
+
+    out.push_str("# EOF\n");
+}
+
+// PUBLISHING SIDE, OWNED BY THE MONITOR LOOP
+pub struct MetricsHandle {
+    slot: Arc<Mutex<MetricsSnapshot>>,
+    // STRUCT_OPS PROGRAM FDS, -1 WHILE NO SCHEDULER IS LOADED
+    progs: Arc<[AtomicI32; N_CALLBACKS]>,
+    addr: SocketAddr,
+    skipped: AtomicU64,
+}
+
+impl MetricsHandle {
+    // BIND addr AND START THE SERVER THREAD. THE THREAD LIVES AS LONG AS THE
+    // PROCESS, SO THE ENDPOINT STAYS UP ACROSS SCHEDULER RESTARTS.
+    pub fn spawn(addr: &str) -> Result<Self> {
+        let listener =
+            TcpListener::bind(addr).with_context(|| format!("METRICS LISTEN {}", addr))?;
+        let addr = listener.local_addr()?;
+        let slot = Arc::new(Mutex::new(MetricsSnapshot::default()));
+        let server_slot = Arc::clone(&slot);
+        let progs = Arc::new(std::array::from_fn(|_| AtomicI32::new(-1)));
+        let server_progs = Arc::clone(&progs);
+        std::thread::Builder::new()
+            .name("pand-metrics".into())
+            .spawn(move || serve(listener, server_slot, server_progs))?;
+        Ok(Self {
+            slot,
+            progs,
+            addr,
+            skipped: AtomicU64::new(0),
+        })
+    }
+
+    pub fn local_addr(&self) -> SocketAddr {
+        self.addr
+    }
+
+    // PROGRAM FDS THE SERVER READS RUN STATS FROM ON EACH SCRAPE. SET AFTER
+    // EVERY LOAD; CLEARED (-1) BEFORE THE SCHEDULER DROPS AND CLOSES THEM.
+    pub fn watch_callbacks(&self, fds: &[i32; N_CALLBACKS]) {
+        for (slot, &fd) in self.progs.iter().zip(fds.iter()) {
+            slot.store(fd, Ordering::Relaxed);
+        }
+    }
+
+    pub fn unwatch_callbacks(&self) {
+        self.watch_callbacks(&[-1; N_CALLBACKS]);
+    }
+
+    // COPY snap INTO THE SLOT. NEVER BLOCKS: IF A SCRAPE IS COPYING THE
+    // SLOT RIGHT NOW, THIS PERIOD IS SKIPPED AND THE NEXT ONE LANDS.
+    pub fn publish(&self, snap: &MetricsSnapshot) -> bool {
+        match self.slot.try_lock() {
+            Ok(mut s) => {
+                *s = *snap;
+                true
+            }
+            Err(TryLockError::Poisoned(p)) => {
+                *p.into_inner() = *snap;
+                true
+            }
+            Err(TryLockError::WouldBlock) => {
+                self.skipped.fetch_add(1, Ordering::Relaxed);
+                false
+            }
+        }
+    }
+
+    // PUBLISHES LOST TO A CONCURRENT SCRAPE
+    pub fn skipped(&self) -> u64 {
+        self.skipped.load(Ordering::Relaxed)
+    }
+}
+
+// SPIN ON try_lock SO THE MONITOR'S UNLOCK NEVER HAS A WAITER TO WAKE
+fn take(slot: &Mutex<MetricsSnapshot>) -> MetricsSnapshot {
+    loop {
+        match slot.try_lock() {
+            Ok(s) => return *s,
+            Err(TryLockError::Poisoned(p)) => return *p.into_inner(),
+            Err(TryLockError::WouldBlock) => std::thread::yield_now(),
+        }
+    }
+}
+
+// ONE CONNECTION AT A TIME: A SCRAPER IS ONE CLIENT EVERY FEW SECONDS
+fn serve(
+    listener: TcpListener,
+    slot: Arc<Mutex<MetricsSnapshot>>,
+    progs: Arc<[AtomicI32; N_CALLBACKS]>,
+) {
+    let mut body = String::with_capacity(16 * 1024);
+    for stream in listener.incoming() {
+        if let Ok(stream) = stream {
+            let _ = handle(stream, &slot, &progs, &mut body);
+        }
+    }
+}
+
+fn handle(
+    mut stream: TcpStream,
+    slot: &Mutex<MetricsSnapshot>,
+    progs: &[AtomicI32; N_CALLBACKS],
+    body: &mut String,
+) -> Result<()> {
+    // A STALLED CLIENT MUST NOT WEDGE THE ENDPOINT
+    stream.set_read_timeout(Some(Duration::from_secs(2)))?;
+    stream.set_write_timeout(Some(Duration::from_secs(2)))?;
+
+    let mut req = [0u8; 2048];
+    let mut len = 0;
+    while len < req.len() {
+        let n = stream.read(&mut req[len..])?;
+        if n == 0 {
+            break;
+        }
+        len += n;
+        if req[..len].windows(4).any(|w| w == b"\r\n\r\n") {
+            break;
+        }
+    }
+    let line = std::str::from_utf8(&req[..len])
+        .unwrap_or("")
+        .lines()
+        .next()
+        .unwrap_or("");
+    let mut parts = line.split_whitespace();
+    let method = parts.next().unwrap_or("");
+    let path = parts.next().unwrap_or("").split('?').next().unwrap_or("");
+
+    if method != "GET" || path != "/metrics" {
+        stream.write_all(
+            b"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+        )?;
+        return Ok(());
+    }
+
+    let fds = std::array::from_fn(|i| progs[i].load(Ordering::Relaxed));
+    render(&take(slot), &read_callback_stats(&fds), body);
+    let header = format!(
+        "HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+        body.len()
+    );
+    stream.write_all(header.as_bytes())?;
+    stream.write_all(body.as_bytes())?;
+    Ok(())
+}
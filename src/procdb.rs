@@ -10,16 +10,43 @@
 // SOLUTION: BPF WRITES OBSERVATIONS TO AN LRU MAP WHEN A TASK'S EWMA
 // MATURES (ewma_age == 8). RUST DRAINS OBSERVATIONS EVERY SECOND,
 // MERGES INTO A HASHMAP WITH EWMA DECAY, AND WRITES CONFIDENT
-// PREDICTIONS BACK TO A BPF HASH MAP. NEW TASKS WITH MATCHING comm
+// PREDICTIONS BACK TO A BPF HASH MAP. NEW TASKS WITH A MATCHING KEY
 // START WITH THE CORRECT TIER AND avg_runtime FROM enable().
+//
+// KEY: (EXECUTABLE, comm[, CGROUP]). comm ALONE MERGES EVERY JVM THREAD
+// POOL INTO "java" AND EVERY WORKER INTO "python3". EACH OBSERVATION ALSO
+// FEEDS A comm-ONLY FALLBACK PROFILE, WHICH enable() USES ON AN EXACT MISS
+// AND WHICH ONLY BECOMES CONFIDENT WHEN THE EXECUTABLES BEHIND A comm AGREE.
+//
+// PERSISTENCE: PROFILES LIVE IN A MEMORY-MAPPED RECORD FILE (procstore.rs).
+// ingest() WRITES ONLY THE PROFILES IT TOUCHED, tick() msyncS EVERY
+// SYNC_TICKS, AND flush_predictions() PUSHES ONLY PROFILES THAT CHANGED
+// SINCE THE LAST FLUSH. procdb.bin REMAINS THE PORTABLE SNAPSHOT FORMAT.
+// EVERY OBSERVED, RESTORED OR IMPORTED PROFILE CARRIES ITS WALL-CLOCK
+// UPDATE TIME. A PROFILE OBSERVED IN THIS RUN AGES OUT AFTER STALE_TICKS;
+// ONE RESTORED OR IMPORTED AND NOT YET SEEN AGAIN IS ONLY EVICTED PAST
+// STALE_SECS, SO A RESTART DOES NOT AGE THE DATABASE BY ITS TICK COUNT.
+//
+// FLEET SHARING: procdb.bin CARRIES A HostTag (CPU COUNT, LLCS, NODES,
+// HYBRID/SMT) AND FULL TIER VOTES, SO `pandemonium procdb merge` CAN SUM
+// SNAPSHOTS FROM SIMILAR HOSTS AND LET confidence() RE-SCORE THE RESULT.
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::io::Write;
 use std::path::{Path, PathBuf};
 
 use anyhow::Result;
 use libbpf_rs::MapCore;
 
+use crate::procstore::ProfileStore;
+
+pub fn now_secs() -> u64 {
+    std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map(|d| d.as_secs())
+        .unwrap_or(0)
+}
+
 fn _timestamp() -> String {
     unsafe {
         let mut t: libc::time_t = 0;
@@ -42,21 +69,139 @@ const INIT_PIN: &str = "/sys/fs/bpf/pandemonium/task_class_init";
 
 pub const MIN_OBSERVATIONS: u32 = 3;
 pub const MIN_CONFIDENCE: f64 = 0.6;
-pub const MAX_PROFILES: usize = 512;
+pub const MAX_PROFILES: usize = 16384; // MATCHES PROCDB_MAX_ENTRIES IN intf.h
 pub const STALE_TICKS: u64 = 60;
+pub const STALE_SECS: u64 = 30 * 24 * 3600; // 30 DAYS SINCE THE LAST UPDATE
+pub const SYNC_TICKS: u64 = 10;
 
 const PROCDB_MAGIC: &[u8; 4] = b"PDDB";
-const PROCDB_VERSION: u32 = 2;
+const PROCDB_VERSION: u32 = 5;
 const PROCDB_PATH: &str = ".cache/pandemonium/procdb.bin";
-const ENTRY_SIZE: usize = 64;
+const STORE_PATH: &str = ".cache/pandemonium/procdb.map";
+const HEADER_SIZE: usize = 12;
+const TAG_SIZE: usize = 16;
+const ENTRY_SIZE: usize = 88;
+const V4_ENTRY_SIZE: usize = 80;
+const V3_ENTRY_SIZE: usize = 80;
+const V2_ENTRY_SIZE: usize = 64;
 const V1_ENTRY_SIZE: usize = 40;
 
+// MATCHES struct task_class_key IN intf.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct ProfileKey {
+    pub exe_id: u64,
+    pub cgid: u64,
+    pub comm: [u8; 16],
+}
+
+const _: () = assert!(std::mem::size_of::<ProfileKey>() == 32);
+
+impl ProfileKey {
+    pub fn comm_only(comm: [u8; 16]) -> Self {
+        Self {
+            exe_id: 0,
+            cgid: 0,
+            comm,
+        }
+    }
+
+    pub fn is_fallback(&self) -> bool {
+        self.exe_id == 0 && self.cgid == 0
+    }
+
+    pub fn fallback(&self) -> Self {
+        Self::comm_only(self.comm)
+    }
+
+    pub fn from_bytes(bytes: &[u8]) -> Option<Self> {
+        if bytes.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        Some(unsafe { std::ptr::read_unaligned(bytes.as_ptr() as *const Self) })
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        unsafe {
+            std::slice::from_raw_parts(
+                self as *const Self as *const u8,
+                std::mem::size_of::<Self>(),
+            )
+        }
+    }
+}
+
+// HARDWARE A SNAPSHOT WAS LEARNED ON. nr_cpus == 0: UNTAGGED (PRE-V4 FILE)
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct HostTag {
+    pub nr_cpus: u32,
+    pub nr_llcs: u32,
+    pub nr_nodes: u32,
+    pub flags: u32,
+}
+
+pub const TAG_HYBRID: u32 = 1 << 0;
+pub const TAG_SMT: u32 = 1 << 1;
+
+impl HostTag {
+    pub fn is_untagged(&self) -> bool {
+        self.nr_cpus == 0
+    }
+
+    // SIMILAR HARDWARE: SAME HYBRID/SMT SHAPE, CPU COUNT WITHIN 2X. RUNTIMES
+    // AND TIERS TRANSFER BETWEEN SUCH HOSTS; ACROSS A P/E SPLIT THEY DO NOT.
+    // UNTAGGED SNAPSHOTS ARE ACCEPTED: THERE IS NOTHING TO CHECK.
+    pub fn compatible(&self, other: &HostTag) -> bool {
+        if self.is_untagged() || other.is_untagged() {
+            return true;
+        }
+        let lo = self.nr_cpus.min(other.nr_cpus) as u64;
+        let hi = self.nr_cpus.max(other.nr_cpus) as u64;
+        self.flags == other.flags && hi <= lo * 2
+    }
+
+    fn write(&self, f: &mut impl Write) -> std::io::Result<()> {
+        f.write_all(&self.nr_cpus.to_le_bytes())?;
+        f.write_all(&self.nr_llcs.to_le_bytes())?;
+        f.write_all(&self.nr_nodes.to_le_bytes())?;
+        f.write_all(&self.flags.to_le_bytes())
+    }
+
+    fn read(b: &[u8]) -> Self {
+        let rd = |o: usize| u32::from_le_bytes(b[o..o + 4].try_into().unwrap());
+        Self {
+            nr_cpus: rd(0),
+            nr_llcs: rd(4),
+            nr_nodes: rd(8),
+            flags: rd(12),
+        }
+    }
+}
+
+impl std::fmt::Display for HostTag {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        if self.is_untagged() {
+            return write!(f, "untagged");
+        }
+        write!(
+            f,
+            "{} cpus, {} llc, {} node{}{}",
+            self.nr_cpus,
+            self.nr_llcs,
+            self.nr_nodes,
+            if self.flags & TAG_HYBRID != 0 { ", hybrid" } else { "" },
+            if self.flags & TAG_SMT != 0 { ", smt" } else { "" },
+        )
+    }
+}
+
 // MATCHES struct task_class_entry IN intf.h
 #[repr(C)]
 #[derive(Clone, Copy)]
 pub struct TaskClassEntry {
     pub tier: u8,
-    pub _pad: [u8; 7],
+    pub _pad: [u8; 3],
+    pub period_us: u32, // DETECTED WAKEUP PERIOD, 0 = NOT PERIODIC
     pub avg_runtime: u64,
     pub runtime_dev: u64,
     pub wakeup_freq: u64,
@@ -73,8 +218,11 @@ pub struct TaskProfile {
     pub runtime_dev_ns: u64,
     pub wakeup_freq: u64,
     pub csw_rate: u64,
+    pub period_ns: u64, // WAKEUP PERIOD WHILE EVERY OBSERVATION FOUND ONE, ELSE 0
     pub observations: u32,
     pub last_seen_tick: u64,
+    pub updated: u64, // UNIX SECONDS OF THE LAST OBSERVATION OR MERGE, 0 = UNSTAMPED
+    pub seen: bool,   // OBSERVED IN THIS RUN: AGES BY TICKS, NOT BY updated
 }
 
 impl TaskProfile {
@@ -96,6 +244,35 @@ impl TaskProfile {
             .unwrap_or(1) // INTERACTIVE DEFAULT
     }
 
+    // MERGE ONE BPF OBSERVATION: TIER VOTE + 7/8 EWMA ON THE BEHAVIOR
+    pub fn observe(&mut self, entry: &TaskClassEntry, tick: u64) {
+        let tier_idx = (entry.tier as usize).min(2);
+        self.tier_votes[tier_idx] += 1;
+        if self.observations == 0 {
+            self.avg_runtime_ns = entry.avg_runtime;
+            self.runtime_dev_ns = entry.runtime_dev;
+            self.wakeup_freq = entry.wakeup_freq;
+            self.csw_rate = entry.csw_rate;
+            self.period_ns = entry.period_us as u64 * 1000;
+        } else {
+            // EWMA: 7/8 OLD + 1/8 NEW
+            self.avg_runtime_ns = (self.avg_runtime_ns * 7 + entry.avg_runtime) / 8;
+            self.runtime_dev_ns = (self.runtime_dev_ns * 7 + entry.runtime_dev) / 8;
+            self.wakeup_freq = (self.wakeup_freq * 7 + entry.wakeup_freq) / 8;
+            self.csw_rate = (self.csw_rate * 7 + entry.csw_rate) / 8;
+            // ONE APERIODIC RUN DROPS THE PERIOD: THE SEED MUST NOT PROMISE ONE
+            let period = entry.period_us as u64 * 1000;
+            self.period_ns = if period == 0 || self.period_ns == 0 {
+                period
+            } else {
+                (self.period_ns * 7 + period) / 8
+            };
+        }
+        self.observations += 1;
+        self.last_seen_tick = tick;
+        self.seen = true;
+    }
+
     // MULTI-DIMENSIONAL CONFIDENCE: TIER AGREEMENT * BEHAVIORAL STABILITY
     // HIGH RUNTIME VARIANCE REDUCES CONFIDENCE EVEN WITH STRONG TIER AGREEMENT
     pub fn behavioral_confidence(&self) -> f64 {
@@ -111,13 +288,58 @@ impl TaskProfile {
         let stability = (1.0 - dev_ratio.min(1.0)).max(0.0);
         tier_conf * (0.5 + 0.5 * stability)
     }
+
+    // COMBINE TWO INDEPENDENTLY LEARNED PROFILES: VOTES AND OBSERVATIONS
+    // ADD, SO confidence() SCORES THE POOLED VOTES; BEHAVIOR IS THE
+    // OBSERVATION-WEIGHTED MEAN. DISAGREEING HOSTS DILUTE CONFIDENCE.
+    pub fn merge(&mut self, other: &TaskProfile) {
+        let a = self.observations as u128;
+        let b = other.observations as u128;
+        if a + b > 0 {
+            let mix = |x: u64, y: u64| ((x as u128 * a + y as u128 * b) / (a + b)) as u64;
+            self.avg_runtime_ns = mix(self.avg_runtime_ns, other.avg_runtime_ns);
+            self.runtime_dev_ns = mix(self.runtime_dev_ns, other.runtime_dev_ns);
+            self.wakeup_freq = mix(self.wakeup_freq, other.wakeup_freq);
+            self.csw_rate = mix(self.csw_rate, other.csw_rate);
+            // PERIODIC ONLY IF EVERY SIDE THAT SAW THE TASK FOUND A PERIOD
+            self.period_ns = if a > 0 && b > 0 && (self.period_ns == 0 || other.period_ns == 0) {
+                0
+            } else {
+                mix(self.period_ns, other.period_ns)
+            };
+        }
+        for i in 0..3 {
+            self.tier_votes[i] = self.tier_votes[i].saturating_add(other.tier_votes[i]);
+        }
+        self.observations = self.observations.saturating_add(other.observations);
+        self.last_seen_tick = self.last_seen_tick.max(other.last_seen_tick);
+        self.updated = self.updated.max(other.updated);
+        self.seen |= other.seen;
+    }
+
+    pub fn prediction(&self) -> TaskClassEntry {
+        TaskClassEntry {
+            tier: self.dominant_tier(),
+            _pad: [0; 3],
+            period_us: (self.period_ns / 1000).min(u32::MAX as u64) as u32,
+            avg_runtime: self.avg_runtime_ns,
+            runtime_dev: self.runtime_dev_ns,
+            wakeup_freq: self.wakeup_freq,
+            csw_rate: self.csw_rate,
+        }
+    }
 }
 
 pub struct ProcessDb {
     pub observe: Option<libbpf_rs::MapHandle>,
     pub init: Option<libbpf_rs::MapHandle>,
-    pub profiles: HashMap<[u8; 16], TaskProfile>,
+    pub profiles: HashMap<ProfileKey, TaskProfile>,
     pub tick: u64,
+    pub tag: HostTag,
+    store: Option<ProfileStore>,
+    dirty: HashSet<ProfileKey>,     // CHANGED SINCE THE LAST STORE WRITE
+    unflushed: HashSet<ProfileKey>, // CHANGED SINCE THE LAST flush_predictions()
+    published: HashSet<ProfileKey>, // CURRENTLY IN task_class_init
 }
 
 impl ProcessDb {
@@ -126,34 +348,85 @@ impl ProcessDb {
         PathBuf::from(home).join(PROCDB_PATH)
     }
 
+    pub fn store_path() -> PathBuf {
+        let home = std::env::var("HOME").unwrap_or_else(|_| "/root".into());
+        PathBuf::from(home).join(STORE_PATH)
+    }
+
+    // NO BPF MAPS: TESTS AND OFFLINE TOOLS. store = None KEEPS IT IN MEMORY.
+    pub fn detached(store: Option<ProfileStore>) -> Self {
+        let profiles: HashMap<ProfileKey, TaskProfile> = match &store {
+            Some(s) if !s.is_empty() => s.profiles().into_iter().collect(),
+            _ => HashMap::new(),
+        };
+        let unflushed = profiles.keys().copied().collect();
+        Self {
+            observe: None,
+            init: None,
+            profiles,
+            tick: 0,
+            tag: HostTag::default(),
+            store,
+            dirty: HashSet::new(),
+            unflushed,
+            published: HashSet::new(),
+        }
+    }
+
     pub fn new() -> Result<Self> {
         let observe = libbpf_rs::MapHandle::from_pinned_path(OBSERVE_PIN)?;
         let init = libbpf_rs::MapHandle::from_pinned_path(INIT_PIN)?;
 
-        let db_path = Self::default_path();
-        let profiles = match Self::load_from_disk(&db_path) {
-            Ok(p) => {
-                if !p.is_empty() {
-                    procdb_info!(
-                        "PROCDB: LOADED {} PROFILES FROM {}",
-                        p.len(),
-                        db_path.display()
-                    );
+        let store_path = Self::store_path();
+        let store = match ProfileStore::open(&store_path) {
+            Ok(s) => {
+                if s.dropped() > 0 {
+                    procdb_warn!("PROCDB: DROPPED {} CORRUPT RECORDS", s.dropped());
                 }
-                p
+                Some(s)
             }
             Err(e) => {
-                procdb_warn!("PROCDB LOAD: {}", e);
-                HashMap::new()
+                procdb_warn!("PROCDB STORE: {} (FALLING BACK TO SNAPSHOT)", e);
+                None
             }
         };
 
-        let db = Self {
-            observe: Some(observe),
-            init: Some(init),
-            profiles,
-            tick: 0,
-        };
+        let mut db = Self::detached(store);
+        db.observe = Some(observe);
+        db.init = Some(init);
+
+        if db.profiles.is_empty() {
+            // FIRST RUN ON THE MAPPED STORE (OR NO STORE): IMPORT THE SNAPSHOT
+            let db_path = Self::default_path();
+            match Self::load_from_disk(&db_path) {
+                Ok(mut p) => {
+                    if !p.is_empty() {
+                        procdb_info!(
+                            "PROCDB: LOADED {} PROFILES FROM {}",
+                            p.len(),
+                            db_path.display()
+                        );
+                    }
+                    // THE SNAPSHOT CARRIES NO UPDATE TIME: STAMP THE MIGRATION
+                    let now = now_secs();
+                    for (key, profile) in p.iter_mut() {
+                        profile.updated = now;
+                        db.dirty.insert(*key);
+                        db.unflushed.insert(*key);
+                    }
+                    db.profiles = p;
+                    db.persist();
+                }
+                Err(e) => procdb_warn!("PROCDB LOAD: {}", e),
+            }
+        } else {
+            procdb_info!(
+                "PROCDB: MAPPED {} PROFILES ({} SLOTS) FROM {}",
+                db.profiles.len(),
+                db.store.as_ref().map(|s| s.capacity()).unwrap_or(0),
+                store_path.display()
+            );
+        }
 
         db.flush_predictions();
         Ok(db)
@@ -166,68 +439,148 @@ impl ProcessDb {
             None => return,
         };
         let keys: Vec<Vec<u8>> = observe.keys().collect();
+        let mut drained = Vec::with_capacity(keys.len());
         for key in &keys {
             if let Ok(Some(val)) = observe.lookup(key, libbpf_rs::MapFlags::ANY) {
-                if val.len() >= std::mem::size_of::<TaskClassEntry>() {
-                    let entry: TaskClassEntry =
-                        unsafe { std::ptr::read_unaligned(val.as_ptr() as *const TaskClassEntry) };
-
-                    let mut comm = [0u8; 16];
-                    let copy_len = key.len().min(16);
-                    comm[..copy_len].copy_from_slice(&key[..copy_len]);
-
-                    let profile = self.profiles.entry(comm).or_insert(TaskProfile {
-                        ..Default::default()
-                    });
-
-                    let tier_idx = (entry.tier as usize).min(2);
-                    profile.tier_votes[tier_idx] += 1;
-                    if profile.observations == 0 {
-                        profile.avg_runtime_ns = entry.avg_runtime;
-                        profile.runtime_dev_ns = entry.runtime_dev;
-                        profile.wakeup_freq = entry.wakeup_freq;
-                        profile.csw_rate = entry.csw_rate;
-                    } else {
-                        // EWMA: 7/8 OLD + 1/8 NEW
-                        profile.avg_runtime_ns =
-                            (profile.avg_runtime_ns * 7 + entry.avg_runtime) / 8;
-                        profile.runtime_dev_ns =
-                            (profile.runtime_dev_ns * 7 + entry.runtime_dev) / 8;
-                        profile.wakeup_freq = (profile.wakeup_freq * 7 + entry.wakeup_freq) / 8;
-                        profile.csw_rate = (profile.csw_rate * 7 + entry.csw_rate) / 8;
+                if let Some(pkey) = ProfileKey::from_bytes(key) {
+                    if val.len() >= std::mem::size_of::<TaskClassEntry>() {
+                        let entry: TaskClassEntry = unsafe {
+                            std::ptr::read_unaligned(val.as_ptr() as *const TaskClassEntry)
+                        };
+                        drained.push((pkey, entry));
                     }
-                    profile.observations += 1;
-                    profile.last_seen_tick = self.tick;
                 }
             }
             let _ = observe.delete(key);
         }
+        for (key, entry) in &drained {
+            self.record(*key, entry);
+        }
+        self.persist();
     }
 
-    // WRITE CONFIDENT PREDICTIONS TO BPF INIT MAP
-    pub fn flush_predictions(&self) {
-        let init = match &self.init {
-            Some(m) => m,
-            None => return,
+    // MERGE INTO THE EXACT PROFILE AND ITS comm-ONLY FALLBACK
+    pub fn record(&mut self, key: ProfileKey, entry: &TaskClassEntry) {
+        let tick = self.tick;
+        let now = now_secs();
+        let p = self.profiles.entry(key).or_default();
+        p.observe(entry, tick);
+        p.updated = now;
+        self.touch(key);
+        if !key.is_fallback() {
+            let fb = key.fallback();
+            let p = self.profiles.entry(fb).or_default();
+            p.observe(entry, tick);
+            p.updated = now;
+            self.touch(fb);
+        }
+    }
+
+    // FOLD IN A PROFILE LEARNED ELSEWHERE (IMPORT / MERGE). STAMPED WITH
+    // THE WALL CLOCK: SNAPSHOTS CARRY NO UPDATE TIME, AND AN UNSTAMPED
+    // PRE-SEED WOULD AGE OUT STALE_TICKS AFTER THE SCHEDULER STARTS.
+    pub fn merge_profile(&mut self, key: ProfileKey, profile: &TaskProfile) {
+        let tick = self.tick;
+        let p = self.profiles.entry(key).or_default();
+        p.merge(profile);
+        p.last_seen_tick = tick;
+        p.updated = now_secs();
+        self.touch(key);
+    }
+
+    fn touch(&mut self, key: ProfileKey) {
+        self.dirty.insert(key);
+        self.unflushed.insert(key);
+    }
+
+    fn forget(&mut self, key: &ProfileKey) {
+        self.profiles.remove(key);
+        self.dirty.insert(*key);
+        self.unflushed.remove(key);
+        if self.published.remove(key) {
+            if let Some(ref init) = self.init {
+                let _ = init.delete(key.as_bytes());
+            }
+        }
+    }
+
+    // WRITE CHANGED PROFILES INTO THE MAPPED STORE (NO-OP WITHOUT ONE)
+    pub fn persist(&mut self) {
+        let store = match self.store.as_mut() {
+            Some(s) => s,
+            None => {
+                self.dirty.clear();
+                return;
+            }
         };
-        for (comm, profile) in &self.profiles {
-            if profile.behavioral_confidence() >= MIN_CONFIDENCE {
-                let entry = TaskClassEntry {
-                    tier: profile.dominant_tier(),
-                    _pad: [0; 7],
-                    avg_runtime: profile.avg_runtime_ns,
-                    runtime_dev: profile.runtime_dev_ns,
-                    wakeup_freq: profile.wakeup_freq,
-                    csw_rate: profile.csw_rate,
-                };
+        for key in self.dirty.drain() {
+            match self.profiles.get(&key) {
+                Some(p) => {
+                    if let Err(e) = store.put(&key, p) {
+                        procdb_warn!("PROCDB STORE: {}", e);
+                    }
+                }
+                None => store.remove(&key),
+            }
+        }
+    }
 
-                let val = unsafe {
-                    std::slice::from_raw_parts(
-                        &entry as *const TaskClassEntry as *const u8,
-                        std::mem::size_of::<TaskClassEntry>(),
-                    )
-                };
-                let _ = init.update(comm.as_slice(), val, libbpf_rs::MapFlags::ANY);
+    pub fn stored(&self) -> usize {
+        self.store.as_ref().map(|s| s.len()).unwrap_or(0)
+    }
+
+    // PERSIST AND BLOCK UNTIL WRITTEN. WITHOUT A STORE, WRITE THE SNAPSHOT.
+    pub fn sync(&mut self) -> Result<()> {
+        self.persist();
+        match &self.store {
+            Some(s) => s.sync(true),
+            None => self.save(&Self::default_path()),
+        }
+    }
+
+    // CHANGES SINCE THE LAST FLUSH, SORTED BY KEY: Some(ENTRY) TO PUBLISH,
+    // None TO WITHDRAW A PREDICTION THAT IS NO LONGER CONFIDENT.
+    pub fn take_flush_batch(&mut self) -> Vec<(ProfileKey, Option<TaskClassEntry>)> {
+        let mut keys: Vec<ProfileKey> = self.unflushed.drain().collect();
+        keys.sort_unstable();
+        let mut batch = Vec::with_capacity(keys.len());
+        for key in keys {
+            match self.profiles.get(&key) {
+                Some(p) if p.behavioral_confidence() >= MIN_CONFIDENCE => {
+                    self.published.insert(key);
+                    batch.push((key, Some(p.prediction())));
+                }
+                _ => {
+                    if self.published.remove(&key) {
+                        batch.push((key, None));
+                    }
+                }
+            }
+        }
+        batch
+    }
+
+    // WRITE CHANGED PREDICTIONS TO BPF INIT MAP
+    pub fn flush_predictions(&mut self) {
+        if self.init.is_none() {
+            return;
+        }
+        let batch = self.take_flush_batch();
+        let init = self.init.as_ref().unwrap();
+        for (key, entry) in &batch {
+            match entry {
+                Some(entry) => {
+                    let val = unsafe {
+                        std::slice::from_raw_parts(
+                            entry as *const TaskClassEntry as *const u8,
+                            std::mem::size_of::<TaskClassEntry>(),
+                        )
+                    };
+                    let _ = init.update(key.as_bytes(), val, libbpf_rs::MapFlags::ANY);
+                }
+                None => {
+                    let _ = init.delete(key.as_bytes());
+                }
             }
         }
     }
@@ -236,34 +589,45 @@ impl ProcessDb {
     pub fn tick(&mut self) {
         self.tick += 1;
 
-        // REMOVE PROFILES NOT SEEN IN 60 SECONDS
+        // REMOVE PROFILES NOT SEEN IN 60 SECONDS. ONE RESTORED FROM THE STORE
+        // OR IMPORTED AND NOT SEEN SINCE ALSO HAS TO BE STALE BY THE WALL
+        // CLOCK: IT IS NOT "UNSEEN" JUST BECAUSE THIS RUN HASN'T RUN IT YET.
         let tick = self.tick;
-        let stale: Vec<[u8; 16]> = self
+        let now = now_secs();
+        let stale: Vec<ProfileKey> = self
             .profiles
             .iter()
-            .filter(|(_, p)| tick - p.last_seen_tick > STALE_TICKS)
+            .filter(|(_, p)| {
+                tick - p.last_seen_tick > STALE_TICKS
+                    && (p.seen || p.updated == 0 || now.saturating_sub(p.updated) > STALE_SECS)
+            })
             .map(|(k, _)| *k)
             .collect();
-        for comm in &stale {
-            self.profiles.remove(comm);
-            if let Some(ref init) = self.init {
-                let _ = init.delete(comm.as_slice());
-            }
+        for key in &stale {
+            self.forget(key);
         }
 
-        // CAP ENTRIES: EVICT OLDEST FIRST, TIE-BREAK BY OBSERVATIONS THEN COMM
+        // CAP ENTRIES: EVICT OLDEST FIRST BY WALL CLOCK (RESTORED PROFILES ALL
+        // HAVE last_seen_tick 0), THEN BY TICK, OBSERVATIONS AND KEY
         if self.profiles.len() > MAX_PROFILES {
-            let mut entries: Vec<([u8; 16], u64, u32)> = self
+            let mut entries: Vec<(ProfileKey, u64, u64, u32)> = self
                 .profiles
                 .iter()
-                .map(|(k, v)| (*k, v.last_seen_tick, v.observations))
+                .map(|(k, v)| (*k, v.updated, v.last_seen_tick, v.observations))
                 .collect();
-            entries.sort_by(|a, b| (a.1, a.2, a.0).cmp(&(b.1, b.2, b.0)));
+            entries.sort_by(|a, b| (a.1, a.2, a.3, a.0).cmp(&(b.1, b.2, b.3, b.0)));
             let to_remove = self.profiles.len() - MAX_PROFILES;
-            for (k, _, _) in entries.into_iter().take(to_remove) {
-                self.profiles.remove(&k);
-                if let Some(ref init) = self.init {
-                    let _ = init.delete(k.as_slice());
+            for (k, _, _, _) in entries.into_iter().take(to_remove) {
+                self.forget(&k);
+            }
+        }
+
+        // PERIODIC WRITEBACK: BOUNDS WHAT A CRASH CAN LOSE
+        if self.tick % SYNC_TICKS == 0 {
+            self.persist();
+            if let Some(ref s) = self.store {
+                if let Err(e) = s.sync(false) {
+                    procdb_warn!("{}", e);
                 }
             }
         }
@@ -282,93 +646,154 @@ impl ProcessDb {
 
     // SERIALIZE CONFIDENT PROFILES TO DISK (ATOMIC WRITE)
     pub fn save(&self, path: &Path) -> Result<()> {
-        let entries: Vec<_> = self
+        self.save_filtered(path, |_| true)
+    }
+
+    pub fn save_filtered(&self, path: &Path, keep: impl Fn(&ProfileKey) -> bool) -> Result<()> {
+        let mut entries: Vec<_> = self
             .profiles
             .iter()
-            .filter(|(_, p)| p.behavioral_confidence() >= MIN_CONFIDENCE)
+            .filter(|(k, p)| keep(k) && p.behavioral_confidence() >= MIN_CONFIDENCE)
             .collect();
+        entries.sort_by_key(|(k, _)| **k);
 
         if let Some(parent) = path.parent() {
             std::fs::create_dir_all(parent)?;
         }
 
         let tmp_path = path.with_extension("bin.tmp");
-        let mut f = std::fs::File::create(&tmp_path)?;
+        let mut f = std::io::BufWriter::new(std::fs::File::create(&tmp_path)?);
 
-        // HEADER: MAGIC + VERSION + COUNT
+        // HEADER: MAGIC + VERSION + COUNT + HOST TAG
         f.write_all(PROCDB_MAGIC)?;
         f.write_all(&PROCDB_VERSION.to_le_bytes())?;
         f.write_all(&(entries.len() as u32).to_le_bytes())?;
-
-        // ENTRIES: 64 BYTES EACH (V2)
-        for (comm, profile) in &entries {
-            let tier = profile.dominant_tier();
-            let total_votes: u32 = profile.tier_votes.iter().sum();
-
-            f.write_all(comm.as_slice())?; // 16 bytes
-            f.write_all(&[tier])?; // 1 byte
-            f.write_all(&[0u8; 7])?; // 7 bytes pad
+        self.tag.write(&mut f)?;
+
+        // ENTRIES: 88 BYTES EACH (V5)
+        for (key, profile) in &entries {
+            f.write_all(&key.exe_id.to_le_bytes())?; // 8 bytes
+            f.write_all(&key.cgid.to_le_bytes())?; // 8 bytes
+            f.write_all(key.comm.as_slice())?; // 16 bytes
+            for v in &profile.tier_votes {
+                f.write_all(&v.to_le_bytes())?; // 3 x 4 bytes
+            }
+            f.write_all(&profile.observations.to_le_bytes())?; // 4 bytes
             f.write_all(&profile.avg_runtime_ns.to_le_bytes())?; // 8 bytes
             f.write_all(&profile.runtime_dev_ns.to_le_bytes())?; // 8 bytes
             f.write_all(&profile.wakeup_freq.to_le_bytes())?; // 8 bytes
             f.write_all(&profile.csw_rate.to_le_bytes())?; // 8 bytes
-            f.write_all(&profile.observations.to_le_bytes())?; // 4 bytes
-            f.write_all(&total_votes.to_le_bytes())?; // 4 bytes
+            f.write_all(&profile.period_ns.to_le_bytes())?; // 8 bytes
         }
 
-        drop(f);
+        f.into_inner().map_err(|e| e.into_error())?.sync_all()?;
         std::fs::rename(&tmp_path, path)?;
         Ok(())
     }
 
+    pub fn load_from_disk(path: &Path) -> Result<HashMap<ProfileKey, TaskProfile>> {
+        Self::load_snapshot(path).map(|(_, p)| p)
+    }
+
     // DESERIALIZE PROFILES FROM DISK (RETURNS EMPTY ON CORRUPTION)
-    pub fn load_from_disk(path: &Path) -> Result<HashMap<[u8; 16], TaskProfile>> {
+    // V1/V2 FILES ARE comm-KEYED: THEY MIGRATE TO comm-ONLY FALLBACK
+    // PROFILES, SO WARM STARTS KEEP HITTING WHILE EXACT PROFILES ARE LEARNED.
+    // PRE-V4 FILES STORE ONLY THE DOMINANT TIER AND COME BACK UNTAGGED.
+    // PRE-V5 FILES CARRY NO PERIOD: THEIR PROFILES LOAD APERIODIC.
+    pub fn load_snapshot(path: &Path) -> Result<(HostTag, HashMap<ProfileKey, TaskProfile>)> {
+        let empty = || (HostTag::default(), HashMap::new());
         let data = match std::fs::read(path) {
             Ok(d) => d,
             Err(e) if e.kind() == std::io::ErrorKind::NotFound => {
-                return Ok(HashMap::new());
+                return Ok(empty());
             }
             Err(e) => return Err(e.into()),
         };
 
-        if data.len() < 12 {
+        if data.len() < HEADER_SIZE {
             procdb_warn!("PROCDB: FILE TOO SHORT ({} BYTES)", data.len());
-            return Ok(HashMap::new());
+            return Ok(empty());
         }
 
         // VALIDATE MAGIC
         if &data[0..4] != PROCDB_MAGIC {
             procdb_warn!("PROCDB: BAD MAGIC {:?}", &data[0..4]);
-            return Ok(HashMap::new());
+            return Ok(empty());
         }
 
         // VALIDATE VERSION
         let version = u32::from_le_bytes([data[4], data[5], data[6], data[7]]);
-        let entry_size = match version {
-            1 => V1_ENTRY_SIZE,
-            2 => ENTRY_SIZE,
+        let (entry_size, header_size) = match version {
+            1 => (V1_ENTRY_SIZE, HEADER_SIZE),
+            2 => (V2_ENTRY_SIZE, HEADER_SIZE),
+            3 => (V3_ENTRY_SIZE, HEADER_SIZE),
+            4 => (V4_ENTRY_SIZE, HEADER_SIZE + TAG_SIZE),
+            5 => (ENTRY_SIZE, HEADER_SIZE + TAG_SIZE),
             _ => {
                 procdb_warn!("PROCDB: UNKNOWN VERSION {}", version);
-                return Ok(HashMap::new());
+                return Ok(empty());
             }
         };
 
         // VALIDATE COUNT VS FILE SIZE
         let count = u32::from_le_bytes([data[8], data[9], data[10], data[11]]) as usize;
-        let expected_size = 12 + count * entry_size;
+        let expected_size = header_size + count * entry_size;
         if data.len() < expected_size {
             procdb_warn!(
                 "PROCDB: TRUNCATED (EXPECTED {} BYTES, GOT {})",
                 expected_size,
                 data.len()
             );
-            return Ok(HashMap::new());
+            return Ok(empty());
         }
 
+        let tag = if version >= 4 {
+            HostTag::read(&data[HEADER_SIZE..HEADER_SIZE + TAG_SIZE])
+        } else {
+            HostTag::default()
+        };
+
         let mut profiles = HashMap::new();
-        let mut offset = 12;
+        let mut offset = header_size;
+        let rd32 = |o: usize| u32::from_le_bytes(data[o..o + 4].try_into().unwrap());
+        let rd64 = |o: usize| u64::from_le_bytes(data[o..o + 8].try_into().unwrap());
 
         for _ in 0..count {
+            if version >= 4 {
+                let mut comm = [0u8; 16];
+                comm.copy_from_slice(&data[offset + 16..offset + 32]);
+                let key = ProfileKey {
+                    exe_id: rd64(offset),
+                    cgid: rd64(offset + 8),
+                    comm,
+                };
+                let profile = TaskProfile {
+                    tier_votes: [rd32(offset + 32), rd32(offset + 36), rd32(offset + 40)],
+                    observations: rd32(offset + 44),
+                    avg_runtime_ns: rd64(offset + 48),
+                    runtime_dev_ns: rd64(offset + 56),
+                    wakeup_freq: rd64(offset + 64),
+                    csw_rate: rd64(offset + 72),
+                    period_ns: if version >= 5 { rd64(offset + 80) } else { 0 },
+                    last_seen_tick: 0,
+                    updated: 0,
+                    seen: false,
+                };
+                offset += entry_size;
+                profiles.insert(key, profile);
+                continue;
+            }
+
+            // V3: EXECUTABLE + CGROUP AHEAD OF comm
+            let (exe_id, cgid) = if version >= 3 {
+                let e = rd64(offset);
+                let c = rd64(offset + 8);
+                offset += 16;
+                (e, c)
+            } else {
+                (0, 0)
+            };
+
             let mut comm = [0u8; 16];
             comm.copy_from_slice(&data[offset..offset + 16]);
             offset += 16;
@@ -376,26 +801,24 @@ impl ProcessDb {
             let tier = data[offset] as usize;
             offset += 8; // tier + 7 pad
 
-            let avg_runtime = u64::from_le_bytes(data[offset..offset + 8].try_into().unwrap());
+            let avg_runtime = rd64(offset);
             offset += 8;
 
             // V2: READ EXTRA BEHAVIORAL FIELDS
             let (runtime_dev, wakeup_freq, csw_rate) = if version >= 2 {
-                let rd = u64::from_le_bytes(data[offset..offset + 8].try_into().unwrap());
-                offset += 8;
-                let wf = u64::from_le_bytes(data[offset..offset + 8].try_into().unwrap());
-                offset += 8;
-                let cr = u64::from_le_bytes(data[offset..offset + 8].try_into().unwrap());
-                offset += 8;
+                let rd = rd64(offset);
+                let wf = rd64(offset + 8);
+                let cr = rd64(offset + 16);
+                offset += 24;
                 (rd, wf, cr)
             } else {
                 (0, 0, 0)
             };
 
-            let observations = u32::from_le_bytes(data[offset..offset + 4].try_into().unwrap());
+            let observations = rd32(offset);
             offset += 4;
 
-            let total_votes = u32::from_le_bytes(data[offset..offset + 4].try_into().unwrap());
+            let total_votes = rd32(offset);
             offset += 4;
 
             // RECONSTRUCT: ALL VOTES GO TO DOMINANT TIER (CONFIDENCE = 1.0)
@@ -403,19 +826,22 @@ impl ProcessDb {
             tier_votes[tier.min(2)] = total_votes;
 
             profiles.insert(
-                comm,
+                ProfileKey { exe_id, cgid, comm },
                 TaskProfile {
                     tier_votes,
                     avg_runtime_ns: avg_runtime,
                     runtime_dev_ns: runtime_dev,
                     wakeup_freq,
                     csw_rate,
+                    period_ns: 0,
                     observations,
                     last_seen_tick: 0,
+                    updated: 0,
+                    seen: false,
                 },
             );
         }
 
-        Ok(profiles)
+        Ok((tag, profiles))
     }
 }
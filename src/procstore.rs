@@ -0,0 +1,375 @@
+// PANDEMONIUM PROCDB STORE
+// MEMORY-MAPPED, FIXED-RECORD PROFILE FILE. ingest() WRITES CHANGED
+// PROFILES STRAIGHT INTO THE MAPPING, tick() msyncS PERIODICALLY, SO A
+// CRASH, OOM KILL OR WATCHDOG EXIT LOSES AT MOST ONE SYNC INTERVAL.
+// STARTUP MAPS THE FILE AND INDEXES VALID SLOTS INSTEAD OF PARSING IT.
+//
+// LAYOUT: 64-BYTE HEADER, THEN capacity SLOTS OF RECORD_SIZE BYTES.
+// EVERY RECORD CARRIES A CRC32: A TORN WRITE DROPS THAT ONE PROFILE.
+// ONE WRITER: open() TAKES AN EXCLUSIVE flock FOR THE STORE'S LIFETIME.
+// read_records() DECODES A COPY WITHOUT THE LOCK (EXPORT FROM A LIVE HOST).
+//
+//   HEADER  [0..4] MAGIC  [4..8] VERSION  [8..12] RECORD_SIZE
+//           [12..16] CAPACITY  [16..20] CRC32 OF [0..16]
+//   RECORD  [0..32] ProfileKey  [32..44] TIER VOTES  [44..48] OBSERVATIONS
+//           [48..80] avg_runtime, runtime_dev, wakeup_freq, csw_rate
+//           [80..84] UPDATED (UNIX SECONDS)  [84..88] PERIOD (US, 0 = NONE)
+//           [88..92] FLAGS  [92..96] CRC32
+// PERIOD TOOK THE HIGH HALF OF A u64 UPDATED FIELD, ZERO IN EVERY OLDER
+// RECORD, SO THOSE DECODE APERIODIC WITHOUT A VERSION BUMP.
+
+use std::collections::HashMap;
+use std::fs::{File, OpenOptions};
+use std::os::unix::io::AsRawFd;
+use std::path::Path;
+
+use anyhow::{bail, Result};
+
+use crate::procdb::{now_secs, ProfileKey, TaskProfile, MAX_PROFILES};
+
+const STORE_MAGIC: &[u8; 4] = b"PDMP";
+const STORE_VERSION: u32 = 1;
+pub const HEADER_SIZE: usize = 64;
+pub const RECORD_SIZE: usize = 96;
+pub const INITIAL_CAPACITY: usize = 1024;
+// HEADROOM OVER MAX_PROFILES: ingest() CAN OVERSHOOT UNTIL tick() EVICTS
+pub const MAX_CAPACITY: usize = MAX_PROFILES * 2;
+
+const FLAG_LIVE: u32 = 1;
+const OFF_FLAGS: usize = 88;
+const OFF_CRC: usize = 92;
+
+pub fn crc32(data: &[u8]) -> u32 {
+    let mut crc = !0u32;
+    for &b in data {
+        crc ^= b as u32;
+        for _ in 0..8 {
+            let mask = (crc & 1).wrapping_neg();
+            crc = (crc >> 1) ^ (0xEDB8_8320 & mask);
+        }
+    }
+    !crc
+}
+
+fn rd_u32(b: &[u8], off: usize) -> u32 {
+    u32::from_le_bytes(b[off..off + 4].try_into().unwrap())
+}
+
+fn rd_u64(b: &[u8], off: usize) -> u64 {
+    u64::from_le_bytes(b[off..off + 8].try_into().unwrap())
+}
+
+fn encode(rec: &mut [u8], key: &ProfileKey, p: &TaskProfile) {
+    rec[0..8].copy_from_slice(&key.exe_id.to_le_bytes());
+    rec[8..16].copy_from_slice(&key.cgid.to_le_bytes());
+    rec[16..32].copy_from_slice(&key.comm);
+    for (i, v) in p.tier_votes.iter().enumerate() {
+        rec[32 + i * 4..36 + i * 4].copy_from_slice(&v.to_le_bytes());
+    }
+    rec[44..48].copy_from_slice(&p.observations.to_le_bytes());
+    rec[48..56].copy_from_slice(&p.avg_runtime_ns.to_le_bytes());
+    rec[56..64].copy_from_slice(&p.runtime_dev_ns.to_le_bytes());
+    rec[64..72].copy_from_slice(&p.wakeup_freq.to_le_bytes());
+    rec[72..80].copy_from_slice(&p.csw_rate.to_le_bytes());
+    let updated = if p.updated > 0 { p.updated } else { now_secs() };
+    rec[80..84].copy_from_slice(&(updated.min(u32::MAX as u64) as u32).to_le_bytes());
+    let period_us = (p.period_ns / 1000).min(u32::MAX as u64) as u32;
+    rec[84..88].copy_from_slice(&period_us.to_le_bytes());
+    rec[OFF_FLAGS..OFF_CRC].copy_from_slice(&FLAG_LIVE.to_le_bytes());
+    // CRC LAST: A RECORD IS ONLY VALID ONCE THE BODY IS COMPLETE
+    let crc = crc32(&rec[..OFF_CRC]);
+    rec[OFF_CRC..RECORD_SIZE].copy_from_slice(&crc.to_le_bytes());
+}
+
+fn decode(rec: &[u8]) -> Option<(ProfileKey, TaskProfile)> {
+    if rd_u32(rec, OFF_FLAGS) != FLAG_LIVE || rd_u32(rec, OFF_CRC) != crc32(&rec[..OFF_CRC]) {
+        return None;
+    }
+    let mut comm = [0u8; 16];
+    comm.copy_from_slice(&rec[16..32]);
+    let key = ProfileKey {
+        exe_id: rd_u64(rec, 0),
+        cgid: rd_u64(rec, 8),
+        comm,
+    };
+    let profile = TaskProfile {
+        tier_votes: [rd_u32(rec, 32), rd_u32(rec, 36), rd_u32(rec, 40)],
+        observations: rd_u32(rec, 44),
+        avg_runtime_ns: rd_u64(rec, 48),
+        runtime_dev_ns: rd_u64(rec, 56),
+        wakeup_freq: rd_u64(rec, 64),
+        csw_rate: rd_u64(rec, 72),
+        period_ns: rd_u32(rec, 84) as u64 * 1000,
+        last_seen_tick: 0,
+        updated: rd_u32(rec, 80) as u64,
+        seen: false,
+    };
+    Some((key, profile))
+}
+
+pub struct ProfileStore {
+    file: File,
+    map: *mut u8,
+    len: usize,
+    capacity: usize,
+    index: HashMap<ProfileKey, usize>,
+    free: Vec<usize>, // STACK, LOWEST SLOT ON TOP
+    dropped: usize,
+}
+
+impl ProfileStore {
+    // MAP (OR CREATE) THE STORE. A BAD HEADER OR SIZE RE-INITIALIZES THE
+    // FILE; BAD RECORDS ARE COUNTED IN dropped() AND THEIR SLOTS REUSED.
+    pub fn open(path: &Path) -> Result<Self> {
+        if let Some(parent) = path.parent() {
+            std::fs::create_dir_all(parent)?;
+        }
+        let file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(path)?;
+        if unsafe { libc::flock(file.as_raw_fd(), libc::LOCK_EX | libc::LOCK_NB) } != 0 {
+            bail!(
+                "PROCDB STORE {} IN USE: {}",
+                path.display(),
+                std::io::Error::last_os_error()
+            );
+        }
+
+        let file_len = file.metadata()?.len() as usize;
+        let mut capacity = 0;
+        if file_len >= HEADER_SIZE {
+            let mut hdr = [0u8; HEADER_SIZE];
+            use std::os::unix::fs::FileExt;
+            file.read_exact_at(&mut hdr, 0)?;
+            let cap = rd_u32(&hdr, 12) as usize;
+            if &hdr[0..4] == STORE_MAGIC
+                && rd_u32(&hdr, 4) == STORE_VERSION
+                && rd_u32(&hdr, 8) as usize == RECORD_SIZE
+                && rd_u32(&hdr, 16) == crc32(&hdr[..16])
+                && cap > 0
+                && cap <= MAX_CAPACITY
+                && file_len >= HEADER_SIZE + cap * RECORD_SIZE
+            {
+                capacity = cap;
+            }
+        }
+        let fresh = capacity == 0;
+        if fresh {
+            capacity = INITIAL_CAPACITY;
+            file.set_len(0)?;
+            file.set_len((HEADER_SIZE + capacity * RECORD_SIZE) as u64)?;
+        }
+
+        let len = HEADER_SIZE + capacity * RECORD_SIZE;
+        let map = Self::map(&file, len)?;
+        let mut store = Self {
+            file,
+            map,
+            len,
+            capacity,
+            index: HashMap::new(),
+            free: Vec::new(),
+            dropped: 0,
+        };
+        if fresh {
+            store.write_header();
+        }
+        store.build_index();
+        Ok(store)
+    }
+
+    // VALID RECORDS OF A STORE FILE, READ (NOT MAPPED) AND NOT LOCKED.
+    // A RECORD BEING REWRITTEN CONCURRENTLY FAILS ITS CRC AND IS SKIPPED.
+    pub fn read_records(path: &Path) -> Result<Vec<(ProfileKey, TaskProfile)>> {
+        let data = match std::fs::read(path) {
+            Ok(d) => d,
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => return Ok(Vec::new()),
+            Err(e) => return Err(e.into()),
+        };
+        if data.len() < HEADER_SIZE
+            || &data[0..4] != STORE_MAGIC
+            || rd_u32(&data, 16) != crc32(&data[..16])
+        {
+            bail!("PROCDB STORE {}: BAD HEADER", path.display());
+        }
+        let mut seen = HashMap::new();
+        for rec in data[HEADER_SIZE..].chunks_exact(RECORD_SIZE) {
+            if let Some((key, profile)) = decode(rec) {
+                seen.entry(key).or_insert(profile);
+            }
+        }
+        Ok(seen.into_iter().collect())
+    }
+
+    fn map(file: &File, len: usize) -> Result<*mut u8> {
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            bail!("PROCDB STORE MMAP: {}", std::io::Error::last_os_error());
+        }
+        Ok(ptr as *mut u8)
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.map, self.len) }
+    }
+
+    fn bytes_mut(&mut self) -> &mut [u8] {
+        unsafe { std::slice::from_raw_parts_mut(self.map, self.len) }
+    }
+
+    fn slot(&self, i: usize) -> &[u8] {
+        let off = HEADER_SIZE + i * RECORD_SIZE;
+        &self.bytes()[off..off + RECORD_SIZE]
+    }
+
+    fn slot_mut(&mut self, i: usize) -> &mut [u8] {
+        let off = HEADER_SIZE + i * RECORD_SIZE;
+        &mut self.bytes_mut()[off..off + RECORD_SIZE]
+    }
+
+    fn write_header(&mut self) {
+        let capacity = self.capacity as u32;
+        let hdr = &mut self.bytes_mut()[..HEADER_SIZE];
+        hdr.fill(0);
+        hdr[0..4].copy_from_slice(STORE_MAGIC);
+        hdr[4..8].copy_from_slice(&STORE_VERSION.to_le_bytes());
+        hdr[8..12].copy_from_slice(&(RECORD_SIZE as u32).to_le_bytes());
+        hdr[12..16].copy_from_slice(&capacity.to_le_bytes());
+        let crc = crc32(&hdr[..16]);
+        hdr[16..20].copy_from_slice(&crc.to_le_bytes());
+    }
+
+    fn build_index(&mut self) {
+        let mut free = Vec::new();
+        for i in (0..self.capacity).rev() {
+            let rec = self.slot(i);
+            let live = rd_u32(rec, OFF_FLAGS) == FLAG_LIVE;
+            match decode(rec) {
+                Some((key, _)) if !self.index.contains_key(&key) => {
+                    self.index.insert(key, i);
+                }
+                _ => {
+                    if live {
+                        self.dropped += 1;
+                    }
+                    free.push(i);
+                }
+            }
+        }
+        // DUPLICATE KEYS (SCANNED HIGH TO LOW, LOWEST SLOT KEPT ABOVE) AND
+        // CORRUPT SLOTS ARE CLEARED SO THEY CANNOT RESURFACE ON THE NEXT OPEN
+        for &i in &free {
+            self.slot_mut(i)[OFF_FLAGS..RECORD_SIZE].fill(0);
+        }
+        self.free = free;
+    }
+
+    // DOUBLE THE SLOT COUNT: EXTEND THE FILE, MAP THE NEW LENGTH, THEN SWAP.
+    // ANY FAILURE LEAVES THE OLD MAPPING AND CAPACITY IN PLACE.
+    fn grow(&mut self) -> Result<()> {
+        let new_cap = (self.capacity * 2).min(MAX_CAPACITY);
+        if new_cap <= self.capacity {
+            bail!("PROCDB STORE FULL ({} RECORDS)", self.capacity);
+        }
+        let new_len = HEADER_SIZE + new_cap * RECORD_SIZE;
+        self.file.set_len(new_len as u64)?;
+        let map = match Self::map(&self.file, new_len) {
+            Ok(m) => m,
+            Err(e) => {
+                let _ = self.file.set_len(self.len as u64);
+                return Err(e);
+            }
+        };
+        unsafe {
+            libc::msync(self.map as *mut libc::c_void, self.len, libc::MS_SYNC);
+            libc::munmap(self.map as *mut libc::c_void, self.len);
+        }
+        self.map = map;
+        self.len = new_len;
+        for i in (self.capacity..new_cap).rev() {
+            self.free.push(i);
+        }
+        self.free.sort_unstable_by(|a, b| b.cmp(a));
+        self.capacity = new_cap;
+        self.write_header();
+        Ok(())
+    }
+
+    pub fn len(&self) -> usize {
+        self.index.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.index.is_empty()
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    // RECORDS DISCARDED AT OPEN (CRC MISMATCH OR DUPLICATE KEY)
+    pub fn dropped(&self) -> usize {
+        self.dropped
+    }
+
+    pub fn profiles(&self) -> Vec<(ProfileKey, TaskProfile)> {
+        self.index
+            .values()
+            .filter_map(|&i| decode(self.slot(i)))
+            .collect()
+    }
+
+    pub fn put(&mut self, key: &ProfileKey, profile: &TaskProfile) -> Result<()> {
+        let slot = match self.index.get(key) {
+            Some(&i) => i,
+            None => {
+                if self.free.is_empty() {
+                    self.grow()?;
+                }
+                let i = self.free.pop().unwrap();
+                self.index.insert(*key, i);
+                i
+            }
+        };
+        encode(self.slot_mut(slot), key, profile);
+        Ok(())
+    }
+
+    pub fn remove(&mut self, key: &ProfileKey) {
+        if let Some(i) = self.index.remove(key) {
+            self.slot_mut(i)[OFF_FLAGS..RECORD_SIZE].fill(0);
+            self.free.push(i);
+        }
+    }
+
+    // wait = false: SCHEDULE WRITEBACK (PERIODIC). true: BLOCK (SHUTDOWN).
+    pub fn sync(&self, wait: bool) -> Result<()> {
+        let flags = if wait { libc::MS_SYNC } else { libc::MS_ASYNC };
+        let rc = unsafe { libc::msync(self.map as *mut libc::c_void, self.len, flags) };
+        if rc != 0 {
+            bail!("PROCDB STORE MSYNC: {}", std::io::Error::last_os_error());
+        }
+        Ok(())
+    }
+}
+
+impl Drop for ProfileStore {
+    fn drop(&mut self) {
+        unsafe {
+            libc::msync(self.map as *mut libc::c_void, self.len, libc::MS_SYNC);
+            libc::munmap(self.map as *mut libc::c_void, self.len);
+        }
+    }
+}
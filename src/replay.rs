@@ -0,0 +1,180 @@
+// PANDEMONIUM CONTROLLER REPLAY
+// RUNS THE controller.rs STATE MACHINE OVER A RECORDED FLIGHT TRACE
+// INSTEAD OF THE LIVE BPF MAPS: RECORDED WINDOW INPUTS, CANDIDATE
+// PARAMETERS, PREDICTED KNOBS AND DECISIONS. A POLICY CHANGE IS CHECKED
+// IN SECONDS INSTEAD OF A HOTPLUG BENCHMARK SWEEP.
+//
+// OPEN LOOP: THE RECORDED WORKLOAD DOES NOT REACT TO THE REPLAYED KNOBS,
+// SO A REPLAY PREDICTS DECISIONS ON THE SAME INPUTS, NOT THEIR EFFECT.
+// CONTENTION EDGES ARE KNOWN PER TICK, LONGRUN AS THE RECORDED LEVEL,
+// HOTPLUG AS A CHANGE IN THE RECORDED CPU COUNT. WITH THE DEFAULT
+// PARAMETERS A TRACE REPLAYS TO ITS OWN RECORDED KNOBS.
+
+use crate::controller::{ControlParams, Controller, DECISION_MASK, STATE_LONGRUN};
+use crate::event::{Snapshot, REGIME_NONE};
+use crate::tuning::{self, TuningKnobs};
+
+// THE KNOBS THE CONTROLLER OWNS, AS COMPARED AND PRINTED
+pub const REPLAY_KNOBS: [&str; 5] = [
+    "slice_ns",
+    "preempt_thresh_ns",
+    "batch_slice_ns",
+    "affinity_mode",
+    "sojourn_thresh_ns",
+];
+// THEIR INDICES IN Snapshot::knobs (metrics::KNOB_NAMES)
+const KNOB_INDEX: [usize; 5] = [0, 1, 3, 7, 8];
+
+fn owned_knobs(k: &TuningKnobs) -> [u64; 5] {
+    [
+        k.slice_ns,
+        k.preempt_thresh_ns,
+        k.batch_slice_ns,
+        k.affinity_mode,
+        k.sojourn_thresh_ns,
+    ]
+}
+
+fn recorded_knobs(s: &Snapshot) -> [u64; 5] {
+    KNOB_INDEX.map(|i| s.knobs[i])
+}
+
+// ONE TICK: THE RECORDING NEXT TO THE REPLAY
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct ReplayTick {
+    pub tick: u64,
+    pub at_ns: u64, // SINCE THE FIRST RECORD
+    pub p99_ns: u64,
+    pub rec_regime: u8,
+    pub rec_decisions: u32,
+    pub rec_knobs: [u64; 5],
+    pub regime: u8,
+    pub decisions: u32,
+    pub knobs: [u64; 5],
+}
+
+impl ReplayTick {
+    // A BPF-ONLY RECORD (REGIME_NONE) HAS NO REGIME TO DISAGREE WITH
+    pub fn diverged(&self) -> bool {
+        self.knobs != self.rec_knobs
+            || (self.rec_regime != REGIME_NONE && self.regime != self.rec_regime)
+    }
+
+    pub fn decided(&self) -> bool {
+        (self.decisions | self.rec_decisions) & DECISION_MASK != 0
+    }
+}
+
+pub struct Replay {
+    pub params: ControlParams,
+    pub nr_cpus: u64,
+    pub restarts: u32,
+    pub ticks: Vec<ReplayTick>,
+    pub regime_ns: [u64; 3], // REPLAYED, BY Regime
+}
+
+impl Replay {
+    // (RECORDED, PREDICTED) TICKS WITH THIS DECISION OR STATE BIT
+    pub fn count(&self, bit: u32) -> (usize, usize) {
+        let rec = self.ticks.iter().filter(|t| t.rec_decisions & bit != 0).count();
+        let pred = self.ticks.iter().filter(|t| t.decisions & bit != 0).count();
+        (rec, pred)
+    }
+
+    pub fn first_divergence(&self) -> Option<&ReplayTick> {
+        self.ticks.iter().find(|t| t.diverged())
+    }
+
+    pub fn diverged_ticks(&self) -> usize {
+        self.ticks.iter().filter(|t| t.diverged()).count()
+    }
+
+    // (RECORDED, PREDICTED) SMALLEST SLICE
+    pub fn min_slice_ns(&self) -> (u64, u64) {
+        let rec = self.ticks.iter().map(|t| t.rec_knobs[0]).min().unwrap_or(0);
+        let pred = self.ticks.iter().map(|t| t.knobs[0]).min().unwrap_or(0);
+        (rec, pred)
+    }
+}
+
+// THE CONTROL PERIOD A TRACE WAS RECORDED AT: A TICK RUNS AT LEAST ONE
+// PERIOD, SO THE MEDIAN TICK LENGTH ROUNDED DOWN TO THE MILLISECOND
+pub fn trace_period_ns(trace: &[Snapshot]) -> u64 {
+    let mut elapsed: Vec<u64> = trace
+        .iter()
+        .map(|s| s.elapsed_ns)
+        .filter(|&e| e > 0)
+        .collect();
+    if elapsed.is_empty() {
+        return tuning::DEFAULT_CONTROL_PERIOD_MS * 1_000_000;
+    }
+    elapsed.sort_unstable();
+    tuning::clamp_control_period_ms(elapsed[elapsed.len() / 2] / 1_000_000) * 1_000_000
+}
+
+// THE CPU COUNT THE FIRST RECORDED KNOBS WERE SCALED FOR
+pub fn trace_cpus(trace: &[Snapshot]) -> Option<u64> {
+    trace
+        .iter()
+        .map(|s| s.scale_cpus as u64)
+        .find(|&n| n > 0)
+}
+
+// DRIVE A FRESH CONTROLLER THROUGH THE TRACE. A TICK NUMBER THAT DOES
+// NOT ADVANCE IS A SCHEDULER RESTART: THE CONTROLLER STARTS OVER TOO.
+pub fn replay(trace: &[Snapshot], params: ControlParams, nr_cpus: u64) -> Replay {
+    let mut ctl = Controller::new(params, nr_cpus);
+    let mut out = Replay {
+        params,
+        nr_cpus,
+        restarts: 0,
+        ticks: Vec::with_capacity(trace.len()),
+        regime_ns: [0; 3],
+    };
+    let base_ts = trace.first().map_or(0, |s| s.ts_ns);
+    let mut prev_tick = 0;
+    let mut prev_cpus = 0;
+
+    for s in trace {
+        if s.tick <= prev_tick {
+            for (total, ns) in out.regime_ns.iter_mut().zip(ctl.regime_ns()) {
+                *total += ns;
+            }
+            ctl = Controller::new(params, nr_cpus);
+            out.restarts += 1;
+            prev_cpus = 0;
+        }
+        prev_tick = s.tick;
+
+        // RECORDED HOTPLUG: FOLLOW THE NEW COUNT
+        let cpus = s.scale_cpus as u64;
+        if cpus > 0 && prev_cpus > 0 && cpus != prev_cpus {
+            ctl.rescale(cpus);
+        }
+        if cpus > 0 {
+            prev_cpus = cpus;
+        }
+
+        if s.contended() {
+            ctl.contention();
+        }
+        ctl.resync_longrun(s.decisions & STATE_LONGRUN != 0);
+        let decisions = ctl.tick(&s.tick_input());
+
+        out.ticks.push(ReplayTick {
+            tick: s.tick,
+            at_ns: s.ts_ns.saturating_sub(base_ts),
+            p99_ns: s.p99_ns,
+            rec_regime: s.regime,
+            rec_decisions: s.decisions,
+            rec_knobs: recorded_knobs(s),
+            regime: ctl.regime() as u8,
+            decisions,
+            knobs: owned_knobs(ctl.knobs()),
+        });
+    }
+    for (total, ns) in out.regime_ns.iter_mut().zip(ctl.regime_ns()) {
+        *total += ns;
+    }
+    out
+}
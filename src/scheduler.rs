@@ -2,15 +2,45 @@
 // WRAPS THE BPF SKELETON: OPEN, CONFIGURE, LOAD, ATTACH, SHUTDOWN
 // MONITORING AND ADAPTIVE CONTROL LIVE IN adaptive.rs
 
+use std::cell::RefCell;
+use std::collections::VecDeque;
 use std::mem::MaybeUninit;
+use std::os::fd::{AsFd, AsRawFd};
+use std::rc::Rc;
+use std::time::{Duration, Instant};
 
-use anyhow::Result;
+use anyhow::{bail, Result};
 use libbpf_rs::skel::{OpenSkel, SkelBuilder};
 use libbpf_rs::MapCore;
 
 use crate::bpf_skel::*;
-use crate::tuning::TuningKnobs;
-use pandemonium::event::EventLog;
+use crate::topology::MapSizing;
+use crate::tuning::{
+    knob_slot, KnobGenStats, PcpuDepth, RetiredKnobGen, ScaleKnobs, TuningKnobs, HIST_BUCKETS,
+    HIST_TIERS, KNOB_SLOTS, SCALE_OWNER_RUST,
+};
+use pandemonium::cgroup::CgroupStats;
+use pandemonium::event::{BpfEvent, EventLog};
+use pandemonium::metrics::{N_CALLBACKS, N_KNOBS, N_STATS};
+use pandemonium::trace::{TraceOptions, TraceRecord, TraceWriter};
+
+// USERSPACE __COMPAT_ENUM_OR_ZERO: AN ENUM CONSTANT'S VALUE IN THE RUNNING
+// KERNEL'S BTF, 0 WHERE THAT KERNEL DOES NOT DEFINE IT
+fn compat_enum_or_zero(ty: &str, name: &str) -> u64 {
+    use libbpf_rs::btf::{types, Btf};
+    let btf = match Btf::from_vmlinux() {
+        Ok(btf) => btf,
+        Err(_) => return 0,
+    };
+    let name = std::ffi::OsStr::new(name);
+    if let Some(e) = btf.type_by_name::<types::Enum64>(ty) {
+        return e.iter().find(|m| m.name == Some(name)).map_or(0, |m| m.value);
+    }
+    if let Some(e) = btf.type_by_name::<types::Enum>(ty) {
+        return e.iter().find(|m| m.name == Some(name)).map_or(0, |m| m.value as u64);
+    }
+    0
+}
 
 // SCX EXIT CODES (FROM KERNEL)
 const SCX_EXIT_NONE: i32 = 0;
@@ -47,31 +77,125 @@ pub struct PandemoniumStats {
     pub nr_l2_miss_interactive: u64,
     pub nr_l2_hit_lat_crit: u64,
     pub nr_l2_miss_lat_crit: u64,
+    pub nr_smt_core_hit: u64,
+    pub nr_smt_core_miss: u64,
+    pub nr_smt_pack_hit: u64,
+    pub nr_smt_pack_miss: u64,
     pub nr_reenqueue: u64,
     pub batch_sojourn_ns: u64,
     pub burst_mode_active: u64,
     pub longrun_mode_active: u64,
     pub nr_overflow_rescue: u64,
+    pub nr_xnode_steal_near: u64,
+    pub nr_xnode_steal_mid: u64,
+    pub nr_xnode_steal_far: u64,
+    pub nr_xnode_steal_gated: u64,
+    pub nr_events_dropped: u64,
+    pub nr_hotplug_drained: u64,
+    pub nr_dispatch_batched: u64,
+    pub nr_reclassify: u64,
+    pub nr_reclass_skipped: u64,
+    pub nr_trace_dropped: u64,
+    pub nr_pair_affine: u64,
+    pub nr_pair_sync: u64,
+    pub nr_idle_shallow: u64,
+    pub nr_idle_warm: u64,
+}
+
+// MATCHES MAX_CPUS IN intf.h: THE CEILING FOR BPF .bss PER-CPU STATE.
+// CPU-INDEXED MAPS ARE SIZED AT LOAD FROM MapSizing INSTEAD.
+pub const MAX_CPUS: usize = 4096;
+
+// MATCHES struct cpu_topo IN BPF (intf.h)
+#[repr(C)]
+#[derive(Default, Clone, Copy)]
+pub struct CpuTopoEntry {
+    pub l2_group: u32,
+    pub l3_group: u32,
+    pub capacity: u32,
+    pub core_type: u8,
+    pub nr_smt: u8,
+    pub nr_cstates: u8,
+    pub _pad: u8,
+    pub smt: [u32; 4],
+    pub cst_target_ns: [u32; 8],
+    pub cst_exit_ns: [u32; 8],
 }
 
 // COMPILE-TIME ABI SAFETY: MUST MATCH STRUCT LAYOUTS IN intf.h
-const _: () = assert!(std::mem::size_of::<PandemoniumStats>() == 224);
-const _: () = assert!(std::mem::size_of::<TuningKnobs>() == 80);
+const _: () = assert!(std::mem::size_of::<PandemoniumStats>() == 368);
+const _: () = assert!(std::mem::size_of::<TuningKnobs>() == 88);
+const _: () = assert!(std::mem::size_of::<KnobGenStats>() == 5 * 8 + HIST_BUCKETS * 8);
+const _: () = assert!(std::mem::size_of::<CpuTopoEntry>() == 96);
+const _: () = assert!(std::mem::size_of::<ScaleKnobs>() == 48);
+const _: () = assert!(std::mem::size_of::<PcpuDepth>() == 64);
+const _: () = assert!(std::mem::size_of::<PandemoniumStats>() == N_STATS * 8);
+const _: () = assert!(std::mem::size_of::<TuningKnobs>() == N_KNOBS * 8);
+
+impl PandemoniumStats {
+    // EVERY COUNTER IN FIELD ORDER (pandemonium::metrics::STAT_NAMES)
+    pub fn counters(&self) -> [u64; N_STATS] {
+        unsafe { std::mem::transmute_copy(self) }
+    }
+}
+
+// EVERY KNOB IN FIELD ORDER (pandemonium::metrics::KNOB_NAMES)
+pub fn knob_values(k: &TuningKnobs) -> [u64; N_KNOBS] {
+    unsafe { std::mem::transmute_copy(k) }
+}
 
 // TuningKnobs lives in tuning.rs (zero BPF dependencies, testable offline)
 
 const KNOBS_PIN: &str = "/sys/fs/bpf/pandemonium/tuning_knobs";
 
+// A SLOT IS REWRITTEN KNOB_SLOTS PUBLISHES AFTER IT WENT LIVE. BPF HOLDS A
+// KNOBS POINTER FOR ONE CALLBACK (MICROSECONDS); WAITING THIS LONG BEFORE
+// REUSING A SLOT GUARANTEES NO READER IS STILL INSIDE IT.
+const KNOB_REUSE_GRACE: Duration = Duration::from_millis(1);
+
+// BPF EVENT STREAM: CALLBACK QUEUE CAPACITY (MATCHES 64KB RINGBUF / 32B EVENT)
+const EVENT_QUEUE_CAP: usize = 2048;
+
+// SCHEDULING TRACE CONSUMER (--trace-out): DRAINED, NEVER EPOLLED
+struct TraceSink {
+    rb: libbpf_rs::RingBuffer<'static>,
+    writer: Rc<RefCell<TraceWriter>>,
+    path: std::path::PathBuf,
+}
+
+// LOAD-TIME OPTIONS: EACH ONE LANDS IN A rodata FIELD BEFORE LOAD
+#[derive(Clone, Copy, Debug, Default)]
+pub struct SchedulerOptions {
+    pub nr_cpus_override: Option<u64>,
+    pub pcpu_padded: bool,
+    pub procdb_cgroup: bool,
+    pub dispatch_batch: bool,
+    pub reclass_interval: u32,
+    pub periodic_deadline: bool,
+    pub pair_affinity: bool,
+    pub idle_aware: bool,
+}
+
 pub struct Scheduler<'a> {
+    // DECLARED BEFORE skel: THE RINGBUF MANAGERS MUST DROP BEFORE THE MAPS
+    events: Option<libbpf_rs::RingBuffer<'static>>,
+    event_queue: Rc<RefCell<VecDeque<BpfEvent>>>,
+    trace: Option<TraceSink>,
     skel: MainSkel<'a>,
     _link: libbpf_rs::Link,
     pub log: EventLog,
+    knob_gen: u64,
+    // LIVE GENERATIONS, OLDEST FIRST: (KNOBS, PUBLISHED AT)
+    knob_live: VecDeque<(TuningKnobs, Instant)>,
+    knob_retired: Vec<RetiredKnobGen>,
+    sizing: MapSizing,
 }
 
 impl<'a> Scheduler<'a> {
     pub fn init(
         open_object: &'a mut MaybeUninit<libbpf_rs::OpenObject>,
-        nr_cpus_override: Option<u64>,
+        opts: &SchedulerOptions,
+        sizing: &MapSizing,
     ) -> Result<Self> {
         // OPEN
         let builder = MainSkelBuilder::default();
@@ -81,7 +205,49 @@ impl<'a> Scheduler<'a> {
         let rodata = open_skel.maps.rodata_data.as_mut().unwrap();
 
         let possible = libbpf_rs::num_possible_cpus()? as u64;
-        rodata.nr_cpu_ids = nr_cpus_override.unwrap_or(possible);
+        rodata.nr_cpu_ids = opts.nr_cpus_override.unwrap_or(possible);
+        if rodata.nr_cpu_ids > MAX_CPUS as u64 {
+            bail!(
+                "{} CPUS EXCEEDS THE BPF PER-CPU CEILING OF {} (MAX_CPUS IN intf.h)",
+                rodata.nr_cpu_ids,
+                MAX_CPUS
+            );
+        }
+
+        // PER-CPU HOT-STATE LAYOUT: PACKED (DEFAULT) OR CACHE-LINE PADDED
+        rodata.pcpu_padded = opts.pcpu_padded;
+
+        // PROCDB KEY: ADD THE CGROUP ID TO (EXECUTABLE, comm)
+        rodata.procdb_cgroup_key = opts.procdb_cgroup;
+
+        // BATCHED DISPATCH: OVERFLOW PULLS MAY MOVE A FEW TASKS AT ONCE
+        rodata.dispatch_batch = opts.dispatch_batch;
+
+        // AMORTIZED RECLASSIFICATION: SETTLED TASKS KEEP THEIR TIER FOR N WAKEUPS
+        rodata.reclass_interval = opts.reclass_interval;
+
+        // PERIODIC DEADLINES: STABLE WAKEUP PERIODS ORDER BY LAXITY, NOT LAG
+        rodata.periodic_deadline = opts.periodic_deadline;
+
+        // PAIR AFFINITY: STABLE WAKER/WAKEE PAIRS SHARE A CACHE DOMAIN
+        rodata.pair_affinity = opts.pair_affinity;
+
+        // IDLE-STATE PLACEMENT: SHALLOW C-STATES FOR LATENCY, HIGH CLOCKS FOR BATCH
+        rodata.idle_aware = opts.idle_aware;
+
+        // TOPOLOGY MAP GEOMETRY: CPU- AND DOMAIN-INDEXED MAPS SIZED TO THIS HOST
+        let sizing = MapSizing {
+            nr_cpus: rodata.nr_cpu_ids as u32,
+            ..*sizing
+        };
+        rodata.l2_stride = sizing.l2_stride;
+        rodata.l3_stride = sizing.l3_stride;
+        rodata.nr_l3_rows = sizing.l3_rows;
+        open_skel.maps.cache_domain.set_max_entries(sizing.nr_cpus)?;
+        open_skel.maps.cpu_topo_map.set_max_entries(sizing.nr_cpus)?;
+        open_skel.maps.core_type_cpus.set_max_entries(2 * sizing.nr_cpus)?;
+        open_skel.maps.l2_siblings.set_max_entries(sizing.l2_entries())?;
+        open_skel.maps.l3_siblings.set_max_entries(sizing.l3_entries())?;
 
         // POPULATE SCX ENUM VALUES
         rodata.__SCX_DSQ_FLAG_BUILTIN = SCX_DSQ_FLAG_BUILTIN;
@@ -97,6 +263,12 @@ impl<'a> Scheduler<'a> {
         rodata.__SCX_KICK_PREEMPT = 2;
         rodata.__SCX_KICK_WAIT = 4;
 
+        // CGROUP cpu.weight: OPT IN ONLY WHERE THE RUNNING KERNEL STILL
+        // DEFINES THE FLAG. LATER KERNELS ALWAYS DELIVER WEIGHTS AND WARN
+        // ABOUT (OR REJECT) THE FLAG INSTEAD.
+        open_skel.struct_ops.pandemonium_ops_mut().flags |=
+            compat_enum_or_zero("scx_ops_flags", "SCX_OPS_HAS_CGROUP_WEIGHT");
+
         // LOAD (VALIDATES BPF WITH KERNEL)
         let mut skel = open_skel.load()?;
 
@@ -129,13 +301,133 @@ impl<'a> Scheduler<'a> {
             log_warn!("BPFFS NOT AVAILABLE: map pinning skipped (scheduler still functional)");
         }
 
+        // EVENT STREAM (NON-FATAL: WITHOUT IT THE MONITOR LOOP FALLS BACK
+        // TO PLAIN 1S POLLING OF stats_map)
+        let event_queue = Rc::new(RefCell::new(VecDeque::with_capacity(EVENT_QUEUE_CAP)));
+        let events = {
+            let queue = Rc::clone(&event_queue);
+            let mut builder = libbpf_rs::RingBufferBuilder::new();
+            let added = builder.add(&skel.maps.events, move |data: &[u8]| {
+                if let Some(ev) = BpfEvent::parse(data) {
+                    let mut q = queue.borrow_mut();
+                    if q.len() < EVENT_QUEUE_CAP {
+                        q.push_back(ev);
+                    }
+                }
+                0
+            });
+            let built = match added {
+                Ok(_) => builder.build(),
+                Err(e) => Err(e),
+            };
+            match built {
+                Ok(rb) => Some(rb),
+                Err(e) => {
+                    log_warn!("EVENT RINGBUF UNAVAILABLE ({}): FALLING BACK TO 1S POLLING", e);
+                    None
+                }
+            }
+        };
+
         Ok(Self {
+            events,
+            event_queue,
+            trace: None,
             skel,
             _link: link,
             log: EventLog::new(),
+            knob_gen: 0,
+            knob_live: VecDeque::from([(TuningKnobs::default(), Instant::now())]),
+            knob_retired: Vec::new(),
+            sizing,
         })
     }
 
+    // GEOMETRY THE TOPOLOGY MAPS WERE LOADED WITH
+    pub fn map_sizing(&self) -> MapSizing {
+        self.sizing
+    }
+
+    // BLOCK UP TO timeout FOR BPF EVENTS, APPEND THEM TO out.
+    // WITHOUT A RINGBUF THIS IS A PLAIN SLEEP.
+    pub fn poll_events(&self, timeout: Duration, out: &mut Vec<BpfEvent>) -> usize {
+        match self.events {
+            Some(ref rb) => {
+                let _ = rb.poll(timeout);
+            }
+            None => std::thread::sleep(timeout),
+        }
+        // TRACE RECORDS NEVER WAKE US: PICK THEM UP ON EVERY POLL AND
+        // FLUSH, SO THE FILE IS AT MOST ONE CONTROL PERIOD BEHIND
+        if let Some(ref t) = self.trace {
+            let _ = t.rb.consume();
+            let _ = t.writer.borrow_mut().flush();
+        }
+        let mut q = self.event_queue.borrow_mut();
+        let n = q.len();
+        out.extend(q.drain(..));
+        n
+    }
+
+    pub fn has_event_stream(&self) -> bool {
+        self.events.is_some()
+    }
+
+    // SCHEDULING TRACE: OPEN THE FILE, ATTACH A CONSUMER TO trace_rb, THEN
+    // ARM BPF BY PUBLISHING trace_ctl (FILTERS FIRST, sample LAST)
+    pub fn start_trace(&mut self, opts: &TraceOptions) -> Result<()> {
+        let ctl = opts.ctl()?;
+        let writer = Rc::new(RefCell::new(TraceWriter::open(&opts.path)?));
+        let rb = {
+            let sink = Rc::clone(&writer);
+            let mut builder = libbpf_rs::RingBufferBuilder::new();
+            builder.add(&self.skel.maps.trace_rb, move |data: &[u8]| {
+                if let Some(rec) = TraceRecord::parse(data) {
+                    let _ = sink.borrow_mut().push(&rec);
+                }
+                0
+            })?;
+            builder.build()?
+        };
+        self.trace = Some(TraceSink {
+            rb,
+            writer,
+            path: opts.path.clone(),
+        });
+
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            bss.trace_ctl.pid = ctl.pid;
+            bss.trace_ctl.cgid = ctl.cgid;
+            for (dst, src) in bss.trace_ctl.comm.iter_mut().zip(ctl.comm.iter()) {
+                *dst = *src as _;
+            }
+            std::sync::atomic::fence(std::sync::atomic::Ordering::SeqCst);
+            unsafe { std::ptr::write_volatile(&mut bss.trace_ctl.sample, ctl.sample) };
+        }
+        Ok(())
+    }
+
+    // DISARM, DRAIN WHAT BPF ALREADY SUBMITTED, FLUSH THE FILE
+    fn stop_trace(&mut self) {
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            unsafe { std::ptr::write_volatile(&mut bss.trace_ctl.sample, 0) };
+        }
+        let Some(t) = self.trace.take() else {
+            return;
+        };
+        let _ = t.rb.consume();
+        let mut w = t.writer.borrow_mut();
+        if let Err(e) = w.flush() {
+            log_warn!("TRACE FLUSH FAILED ({}): {}", t.path.display(), e);
+        }
+        log_info!(
+            "TRACE: {} RECORDS -> {} ({} DROPPED)",
+            w.written(),
+            t.path.display(),
+            self.read_stats().nr_trace_dropped
+        );
+    }
+
     // SUM PER-CPU STATS INTO A SINGLE TOTAL
     pub fn read_stats(&self) -> PandemoniumStats {
         let key = 0u32.to_ne_bytes();
@@ -181,6 +473,10 @@ impl<'a> Scheduler<'a> {
                 total.nr_l2_miss_interactive += stats.nr_l2_miss_interactive;
                 total.nr_l2_hit_lat_crit += stats.nr_l2_hit_lat_crit;
                 total.nr_l2_miss_lat_crit += stats.nr_l2_miss_lat_crit;
+                total.nr_smt_core_hit += stats.nr_smt_core_hit;
+                total.nr_smt_core_miss += stats.nr_smt_core_miss;
+                total.nr_smt_pack_hit += stats.nr_smt_pack_hit;
+                total.nr_smt_pack_miss += stats.nr_smt_pack_miss;
                 total.nr_reenqueue += stats.nr_reenqueue;
                 if stats.batch_sojourn_ns > total.batch_sojourn_ns {
                     total.batch_sojourn_ns = stats.batch_sojourn_ns;
@@ -189,15 +485,72 @@ impl<'a> Scheduler<'a> {
                 if stats.longrun_mode_active > total.longrun_mode_active {
                     total.longrun_mode_active = stats.longrun_mode_active;
                 }
+                total.nr_overflow_rescue += stats.nr_overflow_rescue;
+                total.nr_xnode_steal_near += stats.nr_xnode_steal_near;
+                total.nr_xnode_steal_mid += stats.nr_xnode_steal_mid;
+                total.nr_xnode_steal_far += stats.nr_xnode_steal_far;
+                total.nr_xnode_steal_gated += stats.nr_xnode_steal_gated;
+                total.nr_events_dropped += stats.nr_events_dropped;
+                total.nr_hotplug_drained += stats.nr_hotplug_drained;
+                total.nr_dispatch_batched += stats.nr_dispatch_batched;
+                total.nr_reclassify += stats.nr_reclassify;
+                total.nr_reclass_skipped += stats.nr_reclass_skipped;
+                total.nr_trace_dropped += stats.nr_trace_dropped;
+                total.nr_pair_affine += stats.nr_pair_affine;
+                total.nr_pair_sync += stats.nr_pair_sync;
+                total.nr_idle_shallow += stats.nr_idle_shallow;
+                total.nr_idle_warm += stats.nr_idle_warm;
             }
         }
 
         total
     }
 
-    // WRITE TUNING KNOBS TO BPF MAP -- CALLED BY MONITOR THREAD
-    pub fn write_tuning_knobs(&self, knobs: &TuningKnobs) -> Result<()> {
-        let key = 0u32.to_ne_bytes();
+    // STRUCT_OPS PROGRAM FDS IN metrics::CALLBACK_NAMES ORDER. THE METRICS
+    // SERVER THREAD READS THEIR fdinfo RUN STATS PER SCRAPE.
+    pub fn callback_fds(&self) -> [i32; N_CALLBACKS] {
+        let progs = &self.skel.progs;
+        [
+            progs.pandemonium_select_cpu.as_fd().as_raw_fd(),
+            progs.pandemonium_enqueue.as_fd().as_raw_fd(),
+            progs.pandemonium_dispatch.as_fd().as_raw_fd(),
+            progs.pandemonium_runnable.as_fd().as_raw_fd(),
+            progs.pandemonium_running.as_fd().as_raw_fd(),
+            progs.pandemonium_stopping.as_fd().as_raw_fd(),
+            progs.pandemonium_tick.as_fd().as_raw_fd(),
+        ]
+    }
+
+    // PUBLISH KNOBS: FILL THE SLOT NO CPU IS READING, THEN BUMP knob_gen.
+    // THE SLOT'S PREVIOUS GENERATION IS FINALIZED INTO knob_retired FIRST.
+    pub fn write_tuning_knobs(&mut self, knobs: &TuningKnobs) -> Result<()> {
+        let next = self.knob_gen + 1;
+        let slot = knob_slot(next);
+
+        // THE SLOT'S LAST OCCUPANT (next - KNOB_SLOTS) STOPPED BEING LIVE
+        // WHEN knob_gen LAST MOVED; GIVE IN-FLIGHT READERS THE GRACE PERIOD
+        if let Some((_, published)) = self.knob_live.back() {
+            let since = published.elapsed();
+            if since < KNOB_REUSE_GRACE {
+                std::thread::sleep(KNOB_REUSE_GRACE - since);
+            }
+        }
+        if self.knob_live.len() as u64 >= KNOB_SLOTS {
+            let (old_knobs, old_at) = self.knob_live.pop_front().unwrap();
+            let old_gen = next - KNOB_SLOTS;
+            let live_ns = self
+                .knob_live
+                .front()
+                .map(|(_, at)| at.duration_since(old_at).as_nanos() as u64)
+                .unwrap_or(0);
+            self.knob_retired.push(RetiredKnobGen {
+                knobs: old_knobs,
+                live_ns,
+                stats: self.read_knob_gen_stats(old_gen),
+            });
+        }
+
+        let key = slot.to_ne_bytes();
         let value = unsafe {
             std::slice::from_raw_parts(
                 knobs as *const TuningKnobs as *const u8,
@@ -208,12 +561,20 @@ impl<'a> Scheduler<'a> {
             .maps
             .tuning_knobs_map
             .update(&key, value, libbpf_rs::MapFlags::ANY)?;
+
+        // THE SLOT IS COMPLETE BEFORE ANY CPU CAN SELECT IT
+        std::sync::atomic::fence(std::sync::atomic::Ordering::SeqCst);
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            unsafe { std::ptr::write_volatile(&mut bss.knob_gen, next) };
+        }
+        self.knob_gen = next;
+        self.knob_live.push_back((*knobs, Instant::now()));
         Ok(())
     }
 
-    // READ CURRENT TUNING KNOBS FROM BPF MAP
+    // READ THE LIVE GENERATION'S KNOBS FROM BPF MAP
     pub fn read_tuning_knobs(&self) -> TuningKnobs {
-        let key = 0u32.to_ne_bytes();
+        let key = knob_slot(self.knob_gen).to_ne_bytes();
         match self
             .skel
             .maps
@@ -227,32 +588,155 @@ impl<'a> Scheduler<'a> {
         }
     }
 
-    // READ WAKEUP LATENCY HISTOGRAM: 3 TIERS x 12 BUCKETS
-    // SUMS ACROSS ALL CPUs (PERCPU_ARRAY). RETURNS CUMULATIVE COUNTS.
-    pub fn read_wake_lat_hist(&self) -> [[u64; 12]; 3] {
-        let mut result = [[0u64; 12]; 3];
-        for key_idx in 0u32..36 {
-            let key = key_idx.to_ne_bytes();
-            if let Ok(Some(percpu_vals)) = self
-                .skel
-                .maps
-                .wake_lat_hist
-                .lookup_percpu(&key, libbpf_rs::MapFlags::ANY)
-            {
-                let tier = (key_idx / 12) as usize;
-                let bucket = (key_idx % 12) as usize;
-                for cpu_val in &percpu_vals {
-                    if cpu_val.len() >= std::mem::size_of::<u64>() {
-                        let val: u64 =
-                            unsafe { std::ptr::read_unaligned(cpu_val.as_ptr() as *const u64) };
-                        result[tier][bucket] += val;
+    // THE KNOBS LAST PUBLISHED, WITHOUT A MAP LOOKUP
+    pub fn live_knobs(&self) -> TuningKnobs {
+        match self.knob_live.back() {
+            Some((k, _)) => *k,
+            None => self.read_tuning_knobs(),
+        }
+    }
+
+    pub fn knob_gen(&self) -> u64 {
+        self.knob_gen
+    }
+
+    // PUBLISH CORE-COUNT SCALING INTO .bss (scale_knobs). OWNER GOES FIRST
+    // SO A CONCURRENT HOTPLUG CALLBACK STOPS RESCALING BEFORE WE WRITE;
+    // EACH FIELD IS ONE ALIGNED STORE THAT BPF READS INDEPENDENTLY.
+    pub fn write_scale_knobs(&mut self, k: &ScaleKnobs) {
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            let sk = &mut bss.scale_knobs;
+            unsafe {
+                std::ptr::write_volatile(&mut sk.owner, SCALE_OWNER_RUST);
+                std::sync::atomic::fence(std::sync::atomic::Ordering::SeqCst);
+                std::ptr::write_volatile(&mut sk.interactive_budget, k.interactive_budget);
+                std::ptr::write_volatile(&mut sk.starvation_rescue_ns, k.starvation_rescue_ns);
+                std::ptr::write_volatile(
+                    &mut sk.overflow_sojourn_rescue_ns,
+                    k.overflow_sojourn_rescue_ns,
+                );
+                std::ptr::write_volatile(&mut sk.pcpu_depth_base, k.pcpu_depth_base);
+                std::ptr::write_volatile(&mut sk.nr_cpus, k.nr_cpus);
+            }
+        }
+    }
+
+    // PER-CPU DEPTH COUNTERS FOR CPUs 0..nr, STRAIGHT FROM .bss (NO SYSCALLS)
+    pub fn read_pcpu_depth(&self, nr: usize) -> Vec<PcpuDepth> {
+        let bss = match self.skel.maps.bss_data.as_deref() {
+            Some(bss) => bss,
+            None => return Vec::new(),
+        };
+        bss.pcpu_depth_ctl
+            .iter()
+            .take(nr.min(MAX_CPUS))
+            .map(|pd| unsafe {
+                PcpuDepth {
+                    depth: std::ptr::read_volatile(&pd.depth),
+                    idle_hits: std::ptr::read_volatile(&pd.idle_hits),
+                    spills: std::ptr::read_volatile(&pd.spills),
+                    steals: std::ptr::read_volatile(&pd.steals),
+                    sojourn_kicks: std::ptr::read_volatile(&pd.sojourn_kicks),
+                    ..PcpuDepth::default()
+                }
+            })
+            .collect()
+    }
+
+    // SET ONE CPU'S DEPTH GATE (0 = FOLLOW scale_knobs.pcpu_depth_base)
+    pub fn write_pcpu_depth(&mut self, cpu: usize, depth: u32) {
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            if let Some(pd) = bss.pcpu_depth_ctl.get_mut(cpu) {
+                unsafe { std::ptr::write_volatile(&mut pd.depth, depth) };
+            }
+        }
+    }
+
+    pub fn read_scale_knobs(&self) -> ScaleKnobs {
+        match self.skel.maps.bss_data.as_deref() {
+            Some(bss) => {
+                let sk = &bss.scale_knobs;
+                unsafe {
+                    ScaleKnobs {
+                        interactive_budget: std::ptr::read_volatile(&sk.interactive_budget),
+                        starvation_rescue_ns: std::ptr::read_volatile(&sk.starvation_rescue_ns),
+                        overflow_sojourn_rescue_ns: std::ptr::read_volatile(
+                            &sk.overflow_sojourn_rescue_ns,
+                        ),
+                        pcpu_depth_base: std::ptr::read_volatile(&sk.pcpu_depth_base),
+                        nr_cpus: std::ptr::read_volatile(&sk.nr_cpus),
+                        owner: std::ptr::read_volatile(&sk.owner),
                     }
                 }
             }
+            None => ScaleKnobs::default(),
+        }
+    }
+
+    // ONE GENERATION'S COUNTERS, SUMMED OVER CPUS. VALID WHILE gen IS ONE
+    // OF THE LAST KNOB_SLOTS GENERATIONS (ITS SLOT NOT YET REUSED).
+    pub fn read_knob_gen_stats(&self, gen: u64) -> KnobGenStats {
+        let key = knob_slot(gen).to_ne_bytes();
+        let per_cpu: Vec<KnobGenStats> = match self
+            .skel
+            .maps
+            .knob_gen_stats
+            .lookup_percpu(&key, libbpf_rs::MapFlags::ANY)
+        {
+            Ok(Some(vals)) => vals.iter().filter_map(|v| KnobGenStats::parse(v)).collect(),
+            _ => Vec::new(),
+        };
+        KnobGenStats::sum_for_gen(&per_cpu, gen)
+    }
+
+    // GENERATIONS SUPERSEDED SINCE THE LAST CALL, OLDEST FIRST
+    pub fn take_retired_knob_gens(&mut self) -> Vec<RetiredKnobGen> {
+        std::mem::take(&mut self.knob_retired)
+    }
+
+    // READ WAKEUP LATENCY HISTOGRAM: 3 TIERS x HIST_BUCKETS (ONE struct lat_hist)
+    // SUMS ACROSS ALL CPUs (PERCPU_ARRAY). RETURNS CUMULATIVE COUNTS.
+    pub fn read_wake_lat_hist(&self) -> [[u64; HIST_BUCKETS]; HIST_TIERS] {
+        let mut result = [[0u64; HIST_BUCKETS]; HIST_TIERS];
+        let key = 0u32.to_ne_bytes();
+        if let Ok(Some(percpu_vals)) = self
+            .skel
+            .maps
+            .wake_lat_hist
+            .lookup_percpu(&key, libbpf_rs::MapFlags::ANY)
+        {
+            const REC: usize = HIST_TIERS * HIST_BUCKETS * std::mem::size_of::<u64>();
+            for cpu_val in &percpu_vals {
+                if cpu_val.len() < REC {
+                    continue;
+                }
+                for (i, word) in cpu_val[..REC].chunks_exact(8).enumerate() {
+                    let val = u64::from_ne_bytes(word.try_into().unwrap());
+                    result[i / HIST_BUCKETS][i % HIST_BUCKETS] += val;
+                }
+            }
         }
         result
     }
 
+    // READ PER-CGROUP ACCOUNTING: ONE CUMULATIVE RECORD PER LIVE CGROUP ID
+    pub fn read_cgroup_stats(&self) -> Vec<(u64, CgroupStats)> {
+        let map = &self.skel.maps.cgrp_stats_map;
+        let mut out = Vec::new();
+        for key in map.keys() {
+            if key.len() < std::mem::size_of::<u64>() {
+                continue;
+            }
+            let id = u64::from_ne_bytes(key[..8].try_into().unwrap());
+            if let Ok(Some(val)) = map.lookup(&key, libbpf_rs::MapFlags::ANY) {
+                if let Some(cs) = CgroupStats::parse(&val) {
+                    out.push((id, cs));
+                }
+            }
+        }
+        out
+    }
+
     // READ SLEEP DURATION HISTOGRAM: 4 BUCKETS
     // SUMS ACROSS ALL CPUs (PERCPU_ARRAY). RETURNS CUMULATIVE COUNTS.
     pub fn read_sleep_hist(&self) -> [u64; 4] {
@@ -290,7 +774,7 @@ impl<'a> Scheduler<'a> {
 
     // POPULATE L2 SIBLINGS MAP ENTRY
     pub fn write_l2_sibling(&self, group_id: u32, slot: u32, cpu: u32) -> Result<()> {
-        let key = (group_id * 8 + slot).to_ne_bytes();
+        let key = (group_id * self.sizing.l2_stride + slot).to_ne_bytes();
         let val = cpu.to_ne_bytes();
         self.skel
             .maps
@@ -299,8 +783,60 @@ impl<'a> Scheduler<'a> {
         Ok(())
     }
 
-    // POPULATE COMPOSITOR MAP ENTRY
-    pub fn write_compositor(&self, name: &str) -> Result<()> {
+    // POPULATE PER-CPU TOPOLOGY RECORD (L3 GROUP, CAPACITY, CORE TYPE, SMT)
+    pub fn write_cpu_topo(&self, cpu: u32, entry: &CpuTopoEntry) -> Result<()> {
+        let key = cpu.to_ne_bytes();
+        let value = unsafe {
+            std::slice::from_raw_parts(
+                entry as *const CpuTopoEntry as *const u8,
+                std::mem::size_of::<CpuTopoEntry>(),
+            )
+        };
+        self.skel
+            .maps
+            .cpu_topo_map
+            .update(&key, value, libbpf_rs::MapFlags::ANY)?;
+        Ok(())
+    }
+
+    // POPULATE L3 SIBLINGS MAP ENTRY
+    pub fn write_l3_sibling(&self, group_id: u32, slot: u32, cpu: u32) -> Result<()> {
+        let key = (group_id * self.sizing.l3_stride + slot).to_ne_bytes();
+        let val = cpu.to_ne_bytes();
+        self.skel
+            .maps
+            .l3_siblings
+            .update(&key, &val, libbpf_rs::MapFlags::ANY)?;
+        Ok(())
+    }
+
+    // POPULATE CORE-TYPE CPU LIST ENTRY (0 = PERFORMANCE, 1 = EFFICIENCY)
+    pub fn write_core_type_cpu(&self, type_idx: u32, slot: u32, cpu: u32) -> Result<()> {
+        let key = (type_idx * self.sizing.nr_cpus + slot).to_ne_bytes();
+        let val = cpu.to_ne_bytes();
+        self.skel
+            .maps
+            .core_type_cpus
+            .update(&key, &val, libbpf_rs::MapFlags::ANY)?;
+        Ok(())
+    }
+
+    // POPULATE NUMA STEAL ORDER ENTRY: (REMOTE NODE, SLIT DISTANCE)
+    pub fn write_node_steal(&self, node: u32, slot: u32, remote: u32, distance: u32) -> Result<()> {
+        let key = (node * crate::topology::MAX_NODES as u32 + slot).to_ne_bytes();
+        let mut val = [0u8; 8];
+        val[..4].copy_from_slice(&remote.to_ne_bytes());
+        val[4..].copy_from_slice(&distance.to_ne_bytes());
+        self.skel
+            .maps
+            .node_steal_order
+            .update(&key, &val, libbpf_rs::MapFlags::ANY)?;
+        Ok(())
+    }
+
+    // POPULATE COMPOSITOR MAP ENTRY, THEN BUMP policy_gen SO TASKS ALREADY
+    // ENABLED RE-RESOLVE THEIR CACHED COMPOSITOR FLAG
+    pub fn write_compositor(&mut self, name: &str) -> Result<()> {
         let mut key = [0u8; 16];
         let bytes = name.as_bytes();
         let len = bytes.len().min(15);
@@ -310,6 +846,9 @@ impl<'a> Scheduler<'a> {
             .maps
             .compositor_map
             .update(&key, &val, libbpf_rs::MapFlags::ANY)?;
+        if let Some(bss) = self.skel.maps.bss_data.as_deref_mut() {
+            unsafe { std::ptr::write_volatile(&mut bss.policy_gen, bss.policy_gen + 1) };
+        }
         Ok(())
     }
 
@@ -351,6 +890,7 @@ impl<'a> Scheduler<'a> {
 
 impl Drop for Scheduler<'_> {
     fn drop(&mut self) {
+        self.stop_trace();
         let _ = self.skel.maps.tuning_knobs_map.unpin(KNOBS_PIN);
         let _ = self
             .skel
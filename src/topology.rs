@@ -4,82 +4,389 @@
 // BPF dispatch() USES THE CACHE DOMAIN MAP TO PREFER TASKS THAT LAST
 // RAN ON THE SAME CPU OR AN L2 SIBLING. THIS PRESERVES CACHE WARMTH
 // AND REDUCES THE THROUGHPUT GAP CAUSED BY BLIND NODE-DSQ CONSUMPTION.
+//
+// LOCALITY HIERARCHY FOR PLACEMENT AND STEALING: L2 -> L3/CCX -> NODE ->
+// REMOTE NODE, PLUS SMT SIBLINGS PER CPU. HYBRID PARTS ALSO GET A PER-CPU
+// CORE TYPE AND CAPACITY SO BPF CAN STEER LAT_CRITICAL TO P-CORES AND
+// BATCH TO E-CORES.
+//
+// NUMA: SLIT DISTANCES FROM /sys/devices/system/node BECOME A PER-NODE
+// NEAREST-FIRST STEAL ORDER FOR THE CROSS-NODE STEAL IN dispatch().
+//
+// IDLE STATES: EACH CPU'S ENABLED cpuidle STATES (TARGET RESIDENCY, EXIT
+// LATENCY) RIDE IN ITS cpu_topo RECORD SO --idle-aware CAN TELL A CPU IN
+// C1 FROM ONE IN A DEEP PACKAGE STATE.
 
 use anyhow::Result;
 
-use crate::scheduler::Scheduler;
+use crate::procdb::{HostTag, TAG_HYBRID, TAG_SMT};
+use crate::scheduler::{CpuTopoEntry, Scheduler};
+pub use crate::tuning::MAX_NODES;
+
+// MATCHES main.bpf.c / intf.h SCAN CAPS. THE MAP STRIDES THEMSELVES ARE
+// SIZED AT LOAD FROM THE LARGEST DETECTED GROUP (SEE MapSizing).
+pub const MAX_L2_SIBLINGS: usize = 32;
+pub const MAX_L3_SIBLINGS: usize = 128;
+pub const MAX_SMT_SIBLINGS: usize = 4;
+pub const MAX_CSTATES: usize = 8;
+
+// CORE TYPE: MATCHES CORE_TYPE_* IN intf.h
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+#[repr(u8)]
+pub enum CoreType {
+    Uniform = 0,
+    Performance = 1,
+    Efficiency = 2,
+}
+
+// ONE ENABLED cpuidle STATE (stateN/residency, stateN/latency), IN NS
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct CState {
+    pub target_ns: u32,
+    pub exit_ns: u32,
+}
+
+// LOAD-TIME GEOMETRY OF THE CPU- AND DOMAIN-INDEXED BPF MAPS.
+// Scheduler::init() APPLIES IT WITH set_max_entries AND THE MATCHING
+// RODATA (l2_stride, l3_stride, nr_l3_rows) BEFORE LOAD.
+// *_rows COVERS EVERY GROUP ID IN USE: A CPU WITHOUT CACHE INFO GETS ITS
+// CPU ID AS GROUP ID, SO ROWS CAN EXCEED THE NUMBER OF REAL GROUPS.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct MapSizing {
+    pub nr_cpus: u32,
+    pub l2_rows: u32,
+    pub l2_stride: u32,
+    pub l3_rows: u32,
+    pub l3_stride: u32,
+}
+
+impl MapSizing {
+    // NO TOPOLOGY: ONE ROW PER CPU AT THE OLD FIXED STRIDES
+    pub fn fallback(nr_cpus: usize) -> Self {
+        let rows = nr_cpus.max(1) as u32;
+        Self {
+            nr_cpus: rows,
+            l2_rows: rows,
+            l2_stride: 8,
+            l3_rows: rows,
+            l3_stride: 32,
+        }
+    }
+
+    pub fn l2_entries(&self) -> u32 {
+        self.l2_rows.saturating_mul(self.l2_stride)
+    }
+
+    pub fn l3_entries(&self) -> u32 {
+        self.l3_rows.saturating_mul(self.l3_stride)
+    }
+}
+
+// ROWS AND STRIDE FOR ONE CACHE LEVEL: ENOUGH ROWS FOR THE HIGHEST GROUP ID,
+// STRIDE = LARGEST GROUP CLAMPED TO 1..=cap
+pub fn domain_sizing(domain: &[u32], groups: &[Vec<u32>], cap: usize) -> (u32, u32) {
+    let rows = domain
+        .iter()
+        .map(|&g| g as usize + 1)
+        .chain(std::iter::once(groups.len()))
+        .max()
+        .unwrap_or(0)
+        .max(1);
+    let stride = groups.iter().map(|g| g.len()).max().unwrap_or(1).clamp(1, cap);
+    (rows as u32, stride as u32)
+}
 
 pub struct CpuTopology {
     pub nr_cpus: usize,
     pub l2_domain: Vec<u32>,      // l2_domain[cpu] = group_id
     pub l2_groups: Vec<Vec<u32>>, // l2_groups[group_id] = [cpu, ...]
+    pub l3_domain: Vec<u32>,      // l3_domain[cpu] = group_id (CCX ON ZEN)
+    pub l3_groups: Vec<Vec<u32>>, // l3_groups[group_id] = [cpu, ...]
+    pub smt_siblings: Vec<Vec<u32>>, // smt_siblings[cpu] = OTHER THREADS OF THE SAME CORE
+    pub capacity: Vec<u32>,       // capacity[cpu] = 0..=1024, 1024 = FASTEST CORE
+    pub max_freq_khz: Vec<u32>,   // cpuinfo_max_freq, 0 = NO cpufreq
+    pub cstates: Vec<Vec<CState>>, // cstates[cpu] = ENABLED IDLE STATES, SHALLOWEST FIRST
+    pub core_type: Vec<CoreType>, // Uniform EVERYWHERE UNLESS HYBRID
+    pub node_ids: Vec<u32>,       // ONLINE NUMA NODE IDS, ASCENDING
+    pub node_distance: Vec<Vec<u32>>, // node_distance[i][j] = SLIT(node_ids[i], node_ids[j])
 }
 
 impl CpuTopology {
     pub fn detect(nr_cpus: usize) -> Result<Self> {
-        let mut l2_domain = vec![0u32; nr_cpus];
-        let mut seen_groups: Vec<Vec<u32>> = Vec::new();
+        let (l2_domain, l2_groups) = detect_cache_level(nr_cpus, 2);
+        let (l3_domain, l3_groups) = detect_cache_level(nr_cpus, 3);
+
+        let smt_siblings = (0..nr_cpus)
+            .map(|cpu| {
+                let path = format!(
+                    "/sys/devices/system/cpu/cpu{}/topology/thread_siblings_list",
+                    cpu
+                );
+                std::fs::read_to_string(path)
+                    .map(|s| parse_cpu_list(s.trim()))
+                    .unwrap_or_default()
+                    .into_iter()
+                    .filter(|&c| c != cpu as u32)
+                    .collect()
+            })
+            .collect();
+
+        let max_freq_khz = detect_max_freq(nr_cpus);
+        let capacity = detect_capacity(nr_cpus, &max_freq_khz);
+        let cstates = (0..nr_cpus).map(detect_cstates).collect();
+        let core_type = detect_core_types(nr_cpus, &capacity);
+        let (node_ids, node_distance) = detect_numa();
+
+        Ok(Self {
+            nr_cpus,
+            l2_domain,
+            l2_groups,
+            l3_domain,
+            l3_groups,
+            smt_siblings,
+            capacity,
+            max_freq_khz,
+            cstates,
+            core_type,
+            node_ids,
+            node_distance,
+        })
+    }
+
+    pub fn map_sizing(&self) -> MapSizing {
+        let (l2_rows, l2_stride) =
+            domain_sizing(&self.l2_domain, &self.l2_groups, MAX_L2_SIBLINGS);
+        let (l3_rows, l3_stride) =
+            domain_sizing(&self.l3_domain, &self.l3_groups, MAX_L3_SIBLINGS);
+        MapSizing {
+            nr_cpus: self.nr_cpus.max(1) as u32,
+            l2_rows,
+            l2_stride,
+            l3_rows,
+            l3_stride,
+        }
+    }
+
+    // EVERYTHING THE BPF SIDE CANNOT REPRESENT, ONE LINE EACH. THE
+    // SCHEDULER STILL RUNS: A TRUNCATED GROUP JUST SCANS ITS FIRST CPUs.
+    pub fn truncations(&self) -> Vec<String> {
+        let mut out = Vec::new();
+        if self.nr_cpus > crate::scheduler::MAX_CPUS {
+            out.push(format!(
+                "{} CPUS, BPF PER-CPU STATE HOLDS {}",
+                self.nr_cpus,
+                crate::scheduler::MAX_CPUS
+            ));
+        }
+        for (gid, members) in self.l2_groups.iter().enumerate() {
+            if members.len() > MAX_L2_SIBLINGS {
+                out.push(format!(
+                    "L2 GROUP {}: {} CPUS, SIBLING SCAN COVERS {}",
+                    gid,
+                    members.len(),
+                    MAX_L2_SIBLINGS
+                ));
+            }
+        }
+        for (gid, members) in self.l3_groups.iter().enumerate() {
+            if members.len() > MAX_L3_SIBLINGS {
+                out.push(format!(
+                    "L3 GROUP {}: {} CPUS, SIBLING SCAN COVERS {}",
+                    gid,
+                    members.len(),
+                    MAX_L3_SIBLINGS
+                ));
+            }
+        }
+        let smt_max = self.smt_siblings.iter().map(|s| s.len()).max().unwrap_or(0);
+        if smt_max > MAX_SMT_SIBLINGS {
+            out.push(format!(
+                "{} SMT SIBLINGS PER CORE, cpu_topo HOLDS {}",
+                smt_max, MAX_SMT_SIBLINGS
+            ));
+        }
+        let big_nodes = self
+            .node_ids
+            .iter()
+            .filter(|&&n| n as usize >= MAX_NODES)
+            .count();
+        if big_nodes > 0 {
+            out.push(format!(
+                "{} NUMA NODE IDS >= {}, NO STEAL ORDER PUBLISHED FOR THEM",
+                big_nodes, MAX_NODES
+            ));
+        }
+        out
+    }
 
+    pub fn is_hybrid(&self) -> bool {
+        self.core_type.iter().any(|&t| t != CoreType::Uniform)
+    }
+
+    // HARDWARE TAG STAMPED ON procdb SNAPSHOTS: IMPORT CHECKS IT
+    pub fn host_tag(&self) -> HostTag {
+        let mut flags = 0;
+        if self.is_hybrid() {
+            flags |= TAG_HYBRID;
+        }
+        if self.smt_siblings.iter().any(|s| !s.is_empty()) {
+            flags |= TAG_SMT;
+        }
+        HostTag {
+            nr_cpus: self.nr_cpus as u32,
+            nr_llcs: self.l3_groups.len() as u32,
+            nr_nodes: self.node_ids.len().max(1) as u32,
+            flags,
+        }
+    }
+
+    // WRITE PER-CPU TOPOLOGY RECORDS, L3 SIBLINGS AND CORE-TYPE LISTS
+    // cpu_topo[cpu] = { L2/L3 GROUP, CAPACITY, CORE TYPE, SMT SIBLINGS, IDLE STATES }
+    // l3_siblings[group_id * l3_stride + slot] = cpu_id, SENTINEL u32::MAX
+    // core_type_cpus[type * nr_cpus + slot] = cpu_id (HYBRID ONLY), SENTINEL u32::MAX
+    // ROWS AND SLOTS PAST THE LOADED SIZING (A LARGER GROUP AFTER HOTPLUG)
+    // ARE DROPPED; THE MAPS CANNOT GROW ONCE LOADED.
+    pub fn populate_topology_maps(&self, sched: &Scheduler) -> Result<()> {
+        let sizing = sched.map_sizing();
+        let nr_cpus = self.nr_cpus.min(sizing.nr_cpus as usize);
         for cpu in 0..nr_cpus {
-            let path = format!(
-                "/sys/devices/system/cpu/cpu{}/cache/index2/shared_cpu_list",
-                cpu
-            );
-            let content = match std::fs::read_to_string(&path) {
-                Ok(s) => s,
-                Err(_) => {
-                    // CPU MIGHT BE OFFLINE OR HAVE NO L2 INFO -- ASSIGN OWN GROUP
-                    l2_domain[cpu] = cpu as u32;
-                    continue;
-                }
+            let mut entry = CpuTopoEntry {
+                l2_group: self.l2_domain[cpu],
+                l3_group: self.l3_domain[cpu],
+                capacity: self.capacity[cpu],
+                core_type: self.core_type[cpu] as u8,
+                nr_smt: 0,
+                nr_cstates: 0,
+                _pad: 0,
+                smt: [u32::MAX; MAX_SMT_SIBLINGS],
+                cst_target_ns: [0; MAX_CSTATES],
+                cst_exit_ns: [0; MAX_CSTATES],
             };
+            for (slot, &sib) in self.smt_siblings[cpu]
+                .iter()
+                .take(MAX_SMT_SIBLINGS)
+                .enumerate()
+            {
+                entry.smt[slot] = sib;
+                entry.nr_smt += 1;
+            }
+            for (slot, st) in self.cstates[cpu].iter().take(MAX_CSTATES).enumerate() {
+                entry.cst_target_ns[slot] = st.target_ns;
+                entry.cst_exit_ns[slot] = st.exit_ns;
+                entry.nr_cstates += 1;
+            }
+            sched.write_cpu_topo(cpu as u32, &entry)?;
+        }
 
-            let members = parse_cpu_list(content.trim());
+        let stride = sizing.l3_stride as usize;
+        for (gid, members) in self.l3_groups.iter().enumerate().take(sizing.l3_rows as usize) {
+            for (slot, &cpu) in members.iter().enumerate().take(stride) {
+                sched.write_l3_sibling(gid as u32, slot as u32, cpu)?;
+            }
+            if members.len() < stride {
+                sched.write_l3_sibling(gid as u32, members.len() as u32, u32::MAX)?;
+            }
+        }
+        // ROWS OF CPUs WITHOUT AN L3 (GROUP ID = CPU ID) STAY EMPTY
+        for gid in self.l3_groups.len()..sizing.l3_rows as usize {
+            sched.write_l3_sibling(gid as u32, 0, u32::MAX)?;
+        }
 
-            // CHECK IF THIS GROUP ALREADY EXISTS
-            let group_id = match seen_groups.iter().position(|g| *g == members) {
-                Some(id) => id as u32,
-                None => {
-                    let id = seen_groups.len() as u32;
-                    seen_groups.push(members.clone());
-                    id
+        if self.is_hybrid() {
+            for (idx, kind) in [CoreType::Performance, CoreType::Efficiency]
+                .iter()
+                .enumerate()
+            {
+                let cpus: Vec<u32> = (0..nr_cpus)
+                    .filter(|&c| self.core_type[c] == *kind)
+                    .map(|c| c as u32)
+                    .collect();
+                for (slot, &cpu) in cpus.iter().enumerate() {
+                    sched.write_core_type_cpu(idx as u32, slot as u32, cpu)?;
                 }
-            };
-
-            l2_domain[cpu] = group_id;
+                if cpus.len() < nr_cpus {
+                    sched.write_core_type_cpu(idx as u32, cpus.len() as u32, u32::MAX)?;
+                }
+            }
         }
+        Ok(())
+    }
 
-        Ok(Self {
-            nr_cpus,
-            l2_domain,
-            l2_groups: seen_groups,
-        })
+    // WRITE NEAREST-FIRST STEAL ORDER PER NODE TO BPF MAP
+    // node_steal_order[node * MAX_NODES + slot] = (remote, distance),
+    // SENTINEL u32::MAX MARKS END. SINGLE-NODE HOSTS KEEP THE BPF DEFAULT.
+    pub fn populate_node_steal_map(&self, sched: &Scheduler) -> Result<()> {
+        if self.node_ids.len() < 2 {
+            return Ok(());
+        }
+        let order = node_steal_order(&self.node_ids, &self.node_distance);
+        for (i, remotes) in order.iter().enumerate() {
+            let node = self.node_ids[i];
+            if node as usize >= MAX_NODES {
+                continue;
+            }
+            let remotes = &remotes[..remotes.len().min(MAX_NODES - 1)];
+            for (slot, &(remote, dist)) in remotes.iter().enumerate() {
+                sched.write_node_steal(node, slot as u32, remote, dist)?;
+            }
+            sched.write_node_steal(node, remotes.len() as u32, u32::MAX, 0)?;
+        }
+        Ok(())
     }
 
     // WRITE L2 DOMAIN MAP TO BPF ARRAY VIA SCHEDULER
     pub fn populate_bpf_map(&self, sched: &Scheduler) -> Result<()> {
-        for cpu in 0..self.nr_cpus {
+        for cpu in 0..self.nr_cpus.min(sched.map_sizing().nr_cpus as usize) {
             sched.write_cache_domain(cpu as u32, self.l2_domain[cpu])?;
         }
         Ok(())
     }
 
     // WRITE L2 SIBLINGS FLAT ARRAY TO BPF MAP
-    // l2_siblings[group_id * 8 + slot] = cpu_id, SENTINEL u32::MAX MARKS END
+    // l2_siblings[group_id * l2_stride + slot] = cpu_id, SENTINEL u32::MAX MARKS END
     pub fn populate_l2_siblings_map(&self, sched: &Scheduler) -> Result<()> {
-        const MAX_L2_SIBLINGS: usize = 8;
-        for (gid, members) in self.l2_groups.iter().enumerate() {
-            for (slot, &cpu) in members.iter().enumerate().take(MAX_L2_SIBLINGS) {
+        let sizing = sched.map_sizing();
+        let stride = sizing.l2_stride as usize;
+        for (gid, members) in self.l2_groups.iter().enumerate().take(sizing.l2_rows as usize) {
+            for (slot, &cpu) in members.iter().enumerate().take(stride) {
                 sched.write_l2_sibling(gid as u32, slot as u32, cpu)?;
             }
-            if members.len() < MAX_L2_SIBLINGS {
+            if members.len() < stride {
                 sched.write_l2_sibling(gid as u32, members.len() as u32, u32::MAX)?;
             }
         }
         Ok(())
     }
 
+    // WRITE EVERY TOPOLOGY MAP: AT STARTUP AND AGAIN AFTER CPU HOTPLUG
+    pub fn publish(&self, sched: &Scheduler) {
+        if let Err(e) = self.populate_bpf_map(sched) {
+            log_warn!("CACHE TOPOLOGY MAP WRITE FAILED: {}", e);
+        }
+        if let Err(e) = self.populate_l2_siblings_map(sched) {
+            log_warn!("L2 SIBLINGS MAP WRITE FAILED: {}", e);
+        }
+        if let Err(e) = self.populate_topology_maps(sched) {
+            log_warn!("CPU TOPOLOGY MAP WRITE FAILED: {}", e);
+        }
+        if let Err(e) = self.populate_node_steal_map(sched) {
+            log_warn!("NUMA STEAL ORDER MAP WRITE FAILED: {}", e);
+        }
+    }
+
     pub fn log_summary(&self) {
+        let sizing = self.map_sizing();
+        log_info!(
+            "BPF MAPS: {} CPUS, L2 {}x{}, L3 {}x{}",
+            sizing.nr_cpus,
+            sizing.l2_rows,
+            sizing.l2_stride,
+            sizing.l3_rows,
+            sizing.l3_stride
+        );
+        for t in self.truncations() {
+            log_warn!("TOPOLOGY TRUNCATED: {}", t);
+        }
         for (gid, members) in self.l2_groups.iter().enumerate() {
             let cpus: Vec<String> = members.iter().map(|c| c.to_string()).collect();
             log_info!("L2 GROUP {}: [{}]", gid, cpus.join(","));
@@ -89,6 +396,317 @@ impl CpuTopology {
             self.l2_groups.len(),
             self.nr_cpus
         );
+        for (gid, members) in self.l3_groups.iter().enumerate() {
+            let cpus: Vec<String> = members.iter().map(|c| c.to_string()).collect();
+            log_info!("L3 GROUP {}: [{}]", gid, cpus.join(","));
+        }
+        let smt_cpus = self.smt_siblings.iter().filter(|s| !s.is_empty()).count();
+        log_info!(
+            "L3 GROUPS: {}, SMT CPUS: {}/{}",
+            self.l3_groups.len(),
+            smt_cpus,
+            self.nr_cpus
+        );
+        if self.is_hybrid() {
+            let p = self.core_type.iter().filter(|&&t| t == CoreType::Performance).count();
+            let e = self.core_type.iter().filter(|&&t| t == CoreType::Efficiency).count();
+            log_info!("HYBRID: {} P-CORE CPUS, {} E-CORE CPUS", p, e);
+        }
+        let idle_cpus = self.cstates.iter().filter(|s| !s.is_empty()).count();
+        let deepest = self
+            .cstates
+            .iter()
+            .filter_map(|s| s.last())
+            .max_by_key(|s| s.exit_ns);
+        if let Some(deepest) = deepest {
+            log_info!(
+                "CPUIDLE: {}/{} CPUS, DEEPEST EXIT {}us (TARGET {}us)",
+                idle_cpus,
+                self.nr_cpus,
+                deepest.exit_ns / 1000,
+                deepest.target_ns / 1000
+            );
+        }
+        let freqs: Vec<u32> = self.max_freq_khz.iter().copied().filter(|&f| f > 0).collect();
+        if let (Some(lo), Some(hi)) = (freqs.iter().min(), freqs.iter().max()) {
+            log_info!("MAX FREQ: {}-{} MHZ", lo / 1000, hi / 1000);
+        }
+        if self.node_ids.len() > 1 {
+            let order = node_steal_order(&self.node_ids, &self.node_distance);
+            for (i, remotes) in order.iter().enumerate() {
+                let hops: Vec<String> = remotes
+                    .iter()
+                    .map(|(n, d)| format!("{}({})", n, d))
+                    .collect();
+                log_info!("NODE {} STEAL ORDER: {}", self.node_ids[i], hops.join(" "));
+            }
+        }
+    }
+}
+
+// GROUP CPUs BY SHARED CACHE AT A GIVEN LEVEL (2 = L2, 3 = L3/CCX).
+// THE cache/indexN NUMBERING IS NOT FIXED, SO MATCH ON indexN/level AND
+// SKIP INSTRUCTION CACHES. CPUs WITH NO SUCH CACHE (OFFLINE, OR NO L3 ON
+// SOME ARM PARTS) GET THEIR OWN GROUP ID (= CPU ID).
+fn detect_cache_level(nr_cpus: usize, level: u32) -> (Vec<u32>, Vec<Vec<u32>>) {
+    let mut domain = vec![0u32; nr_cpus];
+    let mut seen_groups: Vec<Vec<u32>> = Vec::new();
+
+    for cpu in 0..nr_cpus {
+        let members = match cache_shared_list(cpu, level) {
+            Some(m) => m,
+            None => {
+                // CPU MIGHT BE OFFLINE OR HAVE NO CACHE INFO -- ASSIGN OWN GROUP
+                domain[cpu] = cpu as u32;
+                continue;
+            }
+        };
+
+        // CHECK IF THIS GROUP ALREADY EXISTS
+        let group_id = match seen_groups.iter().position(|g| *g == members) {
+            Some(id) => id as u32,
+            None => {
+                let id = seen_groups.len() as u32;
+                seen_groups.push(members);
+                id
+            }
+        };
+
+        domain[cpu] = group_id;
+    }
+
+    (domain, seen_groups)
+}
+
+fn cache_shared_list(cpu: usize, level: u32) -> Option<Vec<u32>> {
+    for idx in 0..8 {
+        let base = format!("/sys/devices/system/cpu/cpu{}/cache/index{}", cpu, idx);
+        let lvl = match std::fs::read_to_string(format!("{}/level", base)) {
+            Ok(s) => s.trim().parse::<u32>().unwrap_or(0),
+            Err(_) => break,
+        };
+        if lvl != level {
+            continue;
+        }
+        let kind = std::fs::read_to_string(format!("{}/type", base)).unwrap_or_default();
+        if kind.trim() == "Instruction" {
+            continue;
+        }
+        let list = std::fs::read_to_string(format!("{}/shared_cpu_list", base)).ok()?;
+        return Some(parse_cpu_list(list.trim()));
+    }
+    None
+}
+
+fn read_u64(path: &str) -> Option<u64> {
+    std::fs::read_to_string(path).ok()?.trim().parse::<u64>().ok()
+}
+
+// PER-CPU cpuinfo_max_freq IN KHZ, 0 WHERE cpufreq IS ABSENT (VMs)
+fn detect_max_freq(nr_cpus: usize) -> Vec<u32> {
+    (0..nr_cpus)
+        .map(|c| {
+            read_u64(&format!(
+                "/sys/devices/system/cpu/cpu{}/cpufreq/cpuinfo_max_freq",
+                c
+            ))
+            .unwrap_or(0) as u32
+        })
+        .collect()
+}
+
+// PER-CPU CAPACITY ON A 0..=1024 SCALE.
+// cpu_capacity (ARM, EAS-ENABLED x86) WHEN PRESENT, ELSE cpuinfo_max_freq
+// NORMALIZED TO THE FASTEST CPU, ELSE EVERYTHING 1024.
+fn detect_capacity(nr_cpus: usize, max_freq_khz: &[u32]) -> Vec<u32> {
+    let caps: Vec<u64> = (0..nr_cpus)
+        .map(|c| read_u64(&format!("/sys/devices/system/cpu/cpu{}/cpu_capacity", c)).unwrap_or(0))
+        .collect();
+    if caps.iter().any(|&c| c > 0) {
+        return normalize_capacity(&caps);
+    }
+
+    let freqs: Vec<u64> = max_freq_khz.iter().map(|&f| f as u64).collect();
+    normalize_capacity(&freqs)
+}
+
+// ENABLED cpuidle STATES OF ONE CPU. sysfs GIVES residency AND latency IN
+// US; A STATE WITH disable = 1 IS NEVER ENTERED, SO IT IS DROPPED.
+fn detect_cstates(cpu: usize) -> Vec<CState> {
+    let mut raw = Vec::new();
+    for idx in 0.. {
+        let base = format!("/sys/devices/system/cpu/cpu{}/cpuidle/state{}", cpu, idx);
+        let (Some(residency), Some(latency)) = (
+            read_u64(&format!("{}/residency", base)),
+            read_u64(&format!("{}/latency", base)),
+        ) else {
+            break;
+        };
+        if read_u64(&format!("{}/disable", base)).unwrap_or(0) != 0 {
+            continue;
+        }
+        raw.push(CState {
+            target_ns: residency.saturating_mul(1000).min(u32::MAX as u64) as u32,
+            exit_ns: latency.saturating_mul(1000).min(u32::MAX as u64) as u32,
+        });
+    }
+    cstate_table(raw)
+}
+
+// ORDER BY TARGET RESIDENCY (SHALLOWEST FIRST) AND FIT MAX_CSTATES.
+// PARTS WITH MORE STATES (INTEL C1..C10) KEEP THE SHALLOW ONES AND THE
+// DEEPEST: PLACEMENT ONLY NEEDS TO SEPARATE CHEAP FROM EXPENSIVE EXITS.
+pub fn cstate_table(mut states: Vec<CState>) -> Vec<CState> {
+    states.sort_by_key(|s| (s.target_ns, s.exit_ns));
+    if states.len() > MAX_CSTATES {
+        let deepest = states[states.len() - 1];
+        states.truncate(MAX_CSTATES - 1);
+        states.push(deepest);
+    }
+    states
+}
+
+// SCALE RAW PER-CPU VALUES SO THE LARGEST BECOMES 1024.
+// MISSING VALUES (0) ARE TREATED AS FULL CAPACITY.
+pub fn normalize_capacity(raw: &[u64]) -> Vec<u32> {
+    let max = raw.iter().copied().max().unwrap_or(0);
+    if max == 0 {
+        return vec![1024; raw.len()];
+    }
+    raw.iter()
+        .map(|&v| if v == 0 { 1024 } else { ((v * 1024) / max) as u32 })
+        .collect()
+}
+
+// HYBRID DETECTION: INTEL EXPOSES cpu_core / cpu_atom PMUs WITH CPU LISTS.
+// OTHERWISE FALL BACK TO CAPACITY ASYMMETRY (ARM big.LITTLE).
+fn detect_core_types(nr_cpus: usize, capacity: &[u32]) -> Vec<CoreType> {
+    let read_list = |path: &str| -> Option<Vec<u32>> {
+        std::fs::read_to_string(path)
+            .ok()
+            .map(|s| parse_cpu_list(s.trim()))
+    };
+
+    if let (Some(p), Some(e)) = (
+        read_list("/sys/devices/cpu_core/cpus"),
+        read_list("/sys/devices/cpu_atom/cpus"),
+    ) {
+        if !p.is_empty() && !e.is_empty() {
+            return (0..nr_cpus as u32)
+                .map(|c| {
+                    if p.contains(&c) {
+                        CoreType::Performance
+                    } else if e.contains(&c) {
+                        CoreType::Efficiency
+                    } else {
+                        CoreType::Uniform
+                    }
+                })
+                .collect();
+        }
+    }
+
+    core_types_from_capacity(capacity)
+}
+
+// CPUs WITHIN 80% OF THE FASTEST ARE PERFORMANCE, THE REST EFFICIENCY.
+// NO ASYMMETRY (EVERY CPU ABOVE THE CUTOFF) MEANS A UNIFORM SYSTEM.
+pub fn core_types_from_capacity(capacity: &[u32]) -> Vec<CoreType> {
+    let max = capacity.iter().copied().max().unwrap_or(0);
+    let cutoff = max * 4 / 5;
+    if capacity.iter().all(|&c| c >= cutoff) {
+        return vec![CoreType::Uniform; capacity.len()];
+    }
+    capacity
+        .iter()
+        .map(|&c| {
+            if c >= cutoff {
+                CoreType::Performance
+            } else {
+                CoreType::Efficiency
+            }
+        })
+        .collect()
+}
+
+// READ ONLINE NUMA NODES AND THEIR SLIT DISTANCE ROWS.
+// nodeN/distance LISTS ONE VALUE PER ONLINE NODE, IN node/online ORDER.
+// NO NUMA SYSFS (OR A MALFORMED ROW) FALLS BACK TO A SINGLE NODE 0.
+fn detect_numa() -> (Vec<u32>, Vec<Vec<u32>>) {
+    let single = (vec![0], vec![vec![10]]);
+    let online = match std::fs::read_to_string("/sys/devices/system/node/online") {
+        Ok(s) => parse_cpu_list(s.trim()),
+        Err(_) => return single,
+    };
+    if online.is_empty() {
+        return single;
+    }
+
+    let mut rows = Vec::with_capacity(online.len());
+    for &node in &online {
+        let path = format!("/sys/devices/system/node/node{}/distance", node);
+        let row = match std::fs::read_to_string(&path) {
+            Ok(s) => parse_distance_row(&s),
+            Err(_) => return single,
+        };
+        if row.len() != online.len() {
+            return single;
+        }
+        rows.push(row);
+    }
+    (online, rows)
+}
+
+// PARSE A SLIT DISTANCE ROW: "10 21 21 32"
+fn parse_distance_row(s: &str) -> Vec<u32> {
+    s.split_whitespace()
+        .filter_map(|v| v.parse::<u32>().ok())
+        .collect()
+}
+
+// NEAREST-FIRST REMOTE ORDER PER NODE: order[i] = [(remote_node, distance), ...]
+// TIES BREAK BY NODE ID SO EVERY NODE SEES A STABLE ORDER.
+pub fn node_steal_order(node_ids: &[u32], distance: &[Vec<u32>]) -> Vec<Vec<(u32, u32)>> {
+    let mut order = Vec::with_capacity(node_ids.len());
+    for (i, row) in distance.iter().enumerate() {
+        let mut remotes: Vec<(u32, u32)> = node_ids
+            .iter()
+            .enumerate()
+            .filter(|&(j, _)| j != i)
+            .map(|(j, &n)| (n, row.get(j).copied().unwrap_or(u32::MAX)))
+            .collect();
+        remotes.sort_by_key(|&(n, d)| (d, n));
+        order.push(remotes);
+    }
+    order
+}
+
+// ONLINE CPU COUNT. THE CPU-SCALED THRESHOLDS FOLLOW IT ACROSS HOTPLUG;
+// MAP SIZING AND TOPOLOGY DETECTION STAY ON THE POSSIBLE COUNT.
+pub fn online_cpus() -> Option<u64> {
+    let s = std::fs::read_to_string("/sys/devices/system/cpu/online").ok()?;
+    cpu_list_len(s.trim())
+}
+
+// EFFECTIVE CPU COUNT: ONLINE CPUs THIS PROCESS MAY RUN ON. A cpuset OR
+// CONTAINER LIMIT ON THE SCHEDULER'S CGROUP SHRINKS IT BELOW THE ONLINE COUNT.
+pub fn effective_cpus() -> Option<u64> {
+    let online = online_cpus()?;
+    let mut set: libc::cpu_set_t = unsafe { std::mem::zeroed() };
+    let ret = unsafe { libc::sched_getaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &mut set) };
+    if ret != 0 {
+        return Some(online);
+    }
+    match unsafe { libc::CPU_COUNT(&set) } {
+        n if n > 0 => Some(online.min(n as u64)),
+        _ => Some(online),
+    }
+}
+
+fn cpu_list_len(s: &str) -> Option<u64> {
+    match parse_cpu_list(s).len() {
+        0 => None,
+        n => Some(n as u64),
     }
 }
 
@@ -144,6 +762,117 @@ mod tests {
         assert_eq!(parse_cpu_list(""), Vec::<u32>::new());
     }
 
+    #[test]
+    fn online_count_after_hotplug() {
+        // CPUS 2-3 OFFLINED OUT OF 0-7
+        assert_eq!(cpu_list_len("0-1,4-7"), Some(6));
+        assert_eq!(cpu_list_len("0"), Some(1));
+        assert_eq!(cpu_list_len(""), None);
+    }
+
+    #[test]
+    fn parse_distance() {
+        assert_eq!(parse_distance_row("10 21 21 32\n"), vec![10, 21, 21, 32]);
+    }
+
+    #[test]
+    fn steal_order_nearest_first() {
+        // 4 NODES: 0-1 SAME PACKAGE (12), 2 ONE HOP (21), 3 TWO HOPS (32)
+        let ids = vec![0, 1, 2, 3];
+        let dist = vec![
+            vec![10, 12, 21, 32],
+            vec![12, 10, 32, 21],
+            vec![21, 32, 10, 12],
+            vec![32, 21, 12, 10],
+        ];
+        let order = node_steal_order(&ids, &dist);
+        assert_eq!(order[0], vec![(1, 12), (2, 21), (3, 32)]);
+        assert_eq!(order[1], vec![(0, 12), (3, 21), (2, 32)]);
+        assert_eq!(order[3], vec![(2, 12), (1, 21), (0, 32)]);
+    }
+
+    #[test]
+    fn steal_order_ties_by_node_id() {
+        let ids = vec![0, 2, 5];
+        let dist = vec![vec![10, 21, 21], vec![21, 10, 21], vec![21, 21, 10]];
+        let order = node_steal_order(&ids, &dist);
+        assert_eq!(order[0], vec![(2, 21), (5, 21)]);
+        assert_eq!(order[2], vec![(0, 21), (2, 21)]);
+    }
+
+    #[test]
+    fn capacity_normalized_to_fastest() {
+        assert_eq!(normalize_capacity(&[5000, 2500, 5000]), vec![1024, 512, 1024]);
+        assert_eq!(normalize_capacity(&[0, 0]), vec![1024, 1024]);
+    }
+
+    #[test]
+    fn sizing_from_largest_group() {
+        // 2 CCXs OF 16 THREADS, L2 SHARED BY 4 (ZEN 5c-STYLE)
+        let l3_groups: Vec<Vec<u32>> = vec![(0..16).collect(), (16..32).collect()];
+        let l3_domain: Vec<u32> = (0..32).map(|c| c / 16).collect();
+        assert_eq!(domain_sizing(&l3_domain, &l3_groups, MAX_L3_SIBLINGS), (2, 16));
+
+        let l2_groups: Vec<Vec<u32>> = (0..8).map(|g| (g * 4..g * 4 + 4).collect()).collect();
+        let l2_domain: Vec<u32> = (0..32).map(|c| c / 4).collect();
+        assert_eq!(domain_sizing(&l2_domain, &l2_groups, MAX_L2_SIBLINGS), (8, 4));
+    }
+
+    #[test]
+    fn sizing_caps_stride_and_covers_fallback_ids() {
+        // ONE 40-THREAD L2 GROUP, CPU 47 WITHOUT CACHE INFO (GROUP ID 47)
+        let groups: Vec<Vec<u32>> = vec![(0..40).collect()];
+        let mut domain = vec![0u32; 48];
+        domain[47] = 47;
+        assert_eq!(
+            domain_sizing(&domain, &groups, MAX_L2_SIBLINGS),
+            (48, MAX_L2_SIBLINGS as u32)
+        );
+        // NOTHING DETECTED: ONE EMPTY ROW, STRIDE 1
+        assert_eq!(domain_sizing(&[], &[], MAX_L2_SIBLINGS), (1, 1));
+    }
+
+    #[test]
+    fn cstates_sorted_shallowest_first() {
+        let st = |t: u32, e: u32| CState { target_ns: t, exit_ns: e };
+        assert_eq!(
+            cstate_table(vec![st(600_000, 170_000), st(0, 0), st(2_000, 2_000)]),
+            vec![st(0, 0), st(2_000, 2_000), st(600_000, 170_000)]
+        );
+    }
+
+    #[test]
+    fn cstates_truncation_keeps_deepest() {
+        let states: Vec<CState> = (0..10u32)
+            .map(|i| CState { target_ns: i * 1000, exit_ns: i * 100 })
+            .collect();
+        let table = cstate_table(states);
+        assert_eq!(table.len(), MAX_CSTATES);
+        assert_eq!(table[MAX_CSTATES - 2].target_ns, 6000);
+        assert_eq!(table[MAX_CSTATES - 1].target_ns, 9000);
+    }
+
+    #[test]
+    fn core_types_uniform_without_asymmetry() {
+        assert_eq!(
+            core_types_from_capacity(&[1024, 1000, 1024]),
+            vec![CoreType::Uniform; 3]
+        );
+    }
+
+    #[test]
+    fn core_types_split_big_little() {
+        assert_eq!(
+            core_types_from_capacity(&[1024, 1024, 400, 400]),
+            vec![
+                CoreType::Performance,
+                CoreType::Performance,
+                CoreType::Efficiency,
+                CoreType::Efficiency,
+            ]
+        );
+    }
+
     #[test]
     fn detect_topology() {
         // RUNS ON ANY MACHINE -- VERIFIES SANE OUTPUT
@@ -180,5 +909,31 @@ mod tests {
 
         // AT LEAST ONE GROUP MUST EXIST
         assert!(!topo.l2_groups.is_empty());
+
+        // EVERY GROUP ID FITS THE LOAD-TIME MAP GEOMETRY
+        let sizing = topo.map_sizing();
+        assert!(topo.l2_domain.iter().all(|&g| g < sizing.l2_rows));
+        assert!(topo.l3_domain.iter().all(|&g| g < sizing.l3_rows));
+        assert!(sizing.l2_stride as usize <= MAX_L2_SIBLINGS);
+        assert!(sizing.l3_stride as usize <= MAX_L3_SIBLINGS);
+
+        // PER-CPU VECTORS COVER EVERY CPU; NO CPU IS ITS OWN SMT SIBLING
+        assert_eq!(topo.l3_domain.len(), nr_cpus);
+        assert_eq!(topo.capacity.len(), nr_cpus);
+        assert_eq!(topo.core_type.len(), nr_cpus);
+        assert_eq!(topo.max_freq_khz.len(), nr_cpus);
+        assert_eq!(topo.cstates.len(), nr_cpus);
+        for cpu in 0..nr_cpus {
+            assert!(!topo.smt_siblings[cpu].contains(&(cpu as u32)));
+            assert!(topo.capacity[cpu] <= 1024);
+            assert!(topo.cstates[cpu].len() <= MAX_CSTATES);
+        }
+
+        // SQUARE DISTANCE MATRIX, ONE ROW PER NODE
+        assert!(!topo.node_ids.is_empty());
+        assert_eq!(topo.node_distance.len(), topo.node_ids.len());
+        for row in &topo.node_distance {
+            assert_eq!(row.len(), topo.node_ids.len());
+        }
     }
 }
@@ -0,0 +1,237 @@
+// PANDEMONIUM SCHEDULING TRACE
+// SAMPLED BINARY RECORDS FROM THE BPF trace_rb RINGBUF (--trace-out).
+// REPLACES THE COMPILED-IN bpf_printk FIREHOSE: OFF COSTS ONE .bss LOAD
+// PER TRACE POINT, ON COSTS ONE RINGBUF RECORD PER SAMPLED EVENT.
+//
+// FILE LAYOUT (NATIVE ENDIAN, READ BY tests/pandemonium-tests.py):
+//   HEADER: "PTRC" | VERSION u32 | RECORD SIZE u32 | RESERVED u32
+//   BODY:   FIXED-SIZE TraceRecord, NO FRAMING
+// A RESTARTED SCHEDULER APPENDS TO A FILE WITH A MATCHING HEADER.
+
+use std::fs::{File, OpenOptions};
+use std::io::{BufWriter, Read, Seek, SeekFrom, Write};
+use std::path::{Path, PathBuf};
+
+use anyhow::{bail, Result};
+
+pub const TRACE_MAGIC: [u8; 4] = *b"PTRC";
+pub const TRACE_VERSION: u32 = 1;
+pub const TRACE_HEADER_SIZE: usize = 16;
+pub const DEFAULT_TRACE_SAMPLE: u32 = 64;
+
+// TRACE POINTS: MATCHES TRACE_* IN intf.h
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum TracePath {
+    SelectIdle,
+    EnqSibling,
+    EnqPreempt,
+    EnqOverflow,
+    Running,
+}
+
+impl TracePath {
+    pub fn from_raw(path: u8) -> Option<Self> {
+        match path {
+            1 => Some(Self::SelectIdle),
+            2 => Some(Self::EnqSibling),
+            3 => Some(Self::EnqPreempt),
+            4 => Some(Self::EnqOverflow),
+            5 => Some(Self::Running),
+            _ => None,
+        }
+    }
+
+    // SAME NAMES THE OLD bpf_printk LINES USED, SO REPORTS READ THE SAME
+    pub fn label(&self) -> &'static str {
+        match self {
+            Self::SelectIdle => "select_cpu",
+            Self::EnqSibling => "enq tier1",
+            Self::EnqPreempt => "enq tier2",
+            Self::EnqOverflow => "enq tier3",
+            Self::Running => "running",
+        }
+    }
+}
+
+// MATCHES struct pand_trace IN intf.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TraceRecord {
+    pub ts_ns: u64,
+    pub lat_ns: u64,
+    pub dsq: u64,
+    pub pid: u32,
+    pub cpu: i32,
+    pub path: u8,
+    pub tier: u8,
+    pub wake_path: u8,
+    pub _pad: [u8; 5],
+}
+
+pub const TRACE_RECORD_SIZE: usize = std::mem::size_of::<TraceRecord>();
+const _: () = assert!(TRACE_RECORD_SIZE == 40);
+
+impl TraceRecord {
+    // DECODE ONE RINGBUF RECORD. SHORT RECORDS ARE REJECTED.
+    pub fn parse(data: &[u8]) -> Option<Self> {
+        if data.len() < TRACE_RECORD_SIZE {
+            return None;
+        }
+        Some(unsafe { std::ptr::read_unaligned(data.as_ptr() as *const Self) })
+    }
+
+    pub fn path(&self) -> Option<TracePath> {
+        TracePath::from_raw(self.path)
+    }
+
+    fn as_bytes(&self) -> &[u8] {
+        unsafe {
+            std::slice::from_raw_parts(self as *const Self as *const u8, TRACE_RECORD_SIZE)
+        }
+    }
+}
+
+// MATCHES struct trace_ctl IN intf.h
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct TraceCtl {
+    pub sample: u32,
+    pub pid: u32,
+    pub cgid: u64,
+    pub comm: [u8; 16],
+}
+
+const _: () = assert!(std::mem::size_of::<TraceCtl>() == 32);
+
+// WHAT TO TRACE, FROM THE --trace-* FLAGS
+#[derive(Clone, Debug)]
+pub struct TraceOptions {
+    pub path: PathBuf,
+    pub sample: u32,
+    pub pid: Option<u32>,
+    pub comm: Option<String>,
+    pub cgroup: Option<PathBuf>,
+}
+
+impl TraceOptions {
+    // RESOLVE THE FILTERS INTO THE BPF CONTROL BLOCK. A CGROUP IS NAMED BY
+    // ITS PATH (ABSOLUTE, OR RELATIVE TO /sys/fs/cgroup); ITS ID IS THE
+    // DIRECTORY'S INODE NUMBER ON cgroup2.
+    pub fn ctl(&self) -> Result<TraceCtl> {
+        use std::os::unix::fs::MetadataExt;
+
+        let mut ctl = TraceCtl {
+            sample: self.sample.max(1),
+            pid: self.pid.unwrap_or(0),
+            ..Default::default()
+        };
+        if let Some(ref name) = self.comm {
+            let bytes = name.as_bytes();
+            let len = bytes.len().min(15);
+            ctl.comm[..len].copy_from_slice(&bytes[..len]);
+        }
+        if let Some(ref cg) = self.cgroup {
+            let full = if cg.is_absolute() {
+                cg.clone()
+            } else {
+                Path::new("/sys/fs/cgroup").join(cg)
+            };
+            match std::fs::metadata(&full) {
+                Ok(meta) if meta.is_dir() => ctl.cgid = meta.ino(),
+                Ok(_) => bail!("{}: NOT A CGROUP DIRECTORY", full.display()),
+                Err(e) => bail!("{}: {}", full.display(), e),
+            }
+        }
+        Ok(ctl)
+    }
+}
+
+pub struct TraceWriter {
+    out: BufWriter<File>,
+    written: u64,
+}
+
+impl TraceWriter {
+    // APPEND WHEN THE FILE ALREADY CARRIES THIS FORMAT, ELSE START FRESH
+    pub fn open(path: &Path) -> Result<Self> {
+        if let Some(dir) = path.parent() {
+            if !dir.as_os_str().is_empty() {
+                std::fs::create_dir_all(dir)?;
+            }
+        }
+        let mut file = OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create(true)
+            .truncate(false)
+            .open(path)?;
+        let mut header = [0u8; TRACE_HEADER_SIZE];
+        let len = file.metadata()?.len();
+        let reuse = len >= TRACE_HEADER_SIZE as u64
+            && file.read_exact(&mut header).is_ok()
+            && header == Self::header();
+        if reuse {
+            // DROP A TORN TAIL RECORD FROM A CRASHED RUN
+            let body = (len - TRACE_HEADER_SIZE as u64) / TRACE_RECORD_SIZE as u64;
+            let end = TRACE_HEADER_SIZE as u64 + body * TRACE_RECORD_SIZE as u64;
+            file.set_len(end)?;
+            file.seek(SeekFrom::Start(end))?;
+        } else {
+            file.set_len(0)?;
+            file.seek(SeekFrom::Start(0))?;
+            file.write_all(&Self::header())?;
+        }
+        Ok(Self {
+            out: BufWriter::with_capacity(256 * 1024, file),
+            written: 0,
+        })
+    }
+
+    fn header() -> [u8; TRACE_HEADER_SIZE] {
+        let mut h = [0u8; TRACE_HEADER_SIZE];
+        h[0..4].copy_from_slice(&TRACE_MAGIC);
+        h[4..8].copy_from_slice(&TRACE_VERSION.to_ne_bytes());
+        h[8..12].copy_from_slice(&(TRACE_RECORD_SIZE as u32).to_ne_bytes());
+        h
+    }
+
+    pub fn push(&mut self, rec: &TraceRecord) -> Result<()> {
+        self.out.write_all(rec.as_bytes())?;
+        self.written += 1;
+        Ok(())
+    }
+
+    pub fn flush(&mut self) -> Result<()> {
+        self.out.flush()?;
+        Ok(())
+    }
+
+    // RECORDS WRITTEN BY THIS WRITER (NOT COUNTING AN APPENDED-TO PREFIX)
+    pub fn written(&self) -> u64 {
+        self.written
+    }
+}
+
+// READ A WHOLE TRACE FILE. A TORN TAIL RECORD IS IGNORED.
+pub fn read_trace_file(path: &Path) -> Result<Vec<TraceRecord>> {
+    let data = std::fs::read(path)?;
+    if data.len() < TRACE_HEADER_SIZE || data[0..4] != TRACE_MAGIC {
+        bail!("{}: NOT A PANDEMONIUM TRACE FILE", path.display());
+    }
+    let version = u32::from_ne_bytes(data[4..8].try_into().unwrap());
+    let rec_size = u32::from_ne_bytes(data[8..12].try_into().unwrap()) as usize;
+    if version != TRACE_VERSION || rec_size != TRACE_RECORD_SIZE {
+        bail!(
+            "{}: TRACE VERSION {} / RECORD SIZE {} (EXPECTED {} / {})",
+            path.display(),
+            version,
+            rec_size,
+            TRACE_VERSION,
+            TRACE_RECORD_SIZE
+        );
+    }
+    Ok(data[TRACE_HEADER_SIZE..]
+        .chunks_exact(TRACE_RECORD_SIZE)
+        .filter_map(TraceRecord::parse)
+        .collect())
+}
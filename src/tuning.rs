@@ -15,6 +15,9 @@ pub const LIGHT_EXIT_PCT: u64 = 30; // LEAVE LIGHT: IDLE < 30%
 // PREEMPT_THRESH CONTROLS WHEN TICK PREEMPTS BATCH TASKS (IF INTERACTIVE WAITING).
 // BATCH_SLICE_NS CONTROLS MAX UNINTERRUPTED BATCH RUN WHEN NO INTERACTIVE WAITING.
 // CPU_BOUND_THRESH_NS CONTROLS DEMOTION THRESHOLD PER REGIME (FEATURE 5).
+// SMT_MODE: LIGHT SPREADS NON-BATCH ONTO WHOLE CORES; MIXED ALSO PACKS BATCH
+// ONTO SHARED CORES SO COMPOSITORS KEEP FULL-CORE IPC; HEAVY HAS NO IDLE CORES
+// TO FIND, SO THE SCAN IS SKIPPED.
 
 const LIGHT_SLICE_NS: u64 = 2_000_000; // 2MS
 const LIGHT_PREEMPT_NS: u64 = 1_000_000; // 1MS: AGGRESSIVE
@@ -51,6 +54,10 @@ pub const HEAVY_DEMOTION_NS: u64 = 2_000_000; // 2.0MS: AGGRESSIVE
 pub const DEFAULT_LAT_CRI_THRESH_HIGH: u64 = 32; // >= THIS: LAT_CRITICAL
 pub const DEFAULT_LAT_CRI_THRESH_LOW: u64 = 8; // >= THIS: INTERACTIVE, BELOW: BATCH
 
+// MATCHES MAX_NODES IN intf.h: PER-NODE BPF STATE AND node_steal_order
+// ROW STRIDE. NODE INDICES AT OR ABOVE IT NEVER REACH BPF.
+pub const MAX_NODES: usize = 32;
+
 // TUNING KNOBS
 // MATCHES struct tuning_knobs IN BPF (intf.h)
 
@@ -59,8 +66,15 @@ pub const AFFINITY_OFF: u64 = 0;
 pub const AFFINITY_WEAK: u64 = 1;
 pub const AFFINITY_STRONG: u64 = 2;
 
+// SMT MODE: BITMASK, MATCHES SMT_* IN intf.h
+// IDLE_CORE: INTERACTIVE/LAT_CRITICAL TAKE A FULLY IDLE CORE BEFORE A SIBLING THREAD
+// BATCH_PACK: BATCH TAKES AN IDLE THREAD BESIDE A BUSY SIBLING, KEEPING CORES FREE
+pub const SMT_OFF: u64 = 0;
+pub const SMT_IDLE_CORE: u64 = 1 << 0;
+pub const SMT_BATCH_PACK: u64 = 1 << 1;
+
 #[repr(C)]
-#[derive(Clone, Copy)]
+#[derive(Clone, Copy, PartialEq, Eq)]
 pub struct TuningKnobs {
     pub slice_ns: u64,
     pub preempt_thresh_ns: u64,
@@ -72,6 +86,7 @@ pub struct TuningKnobs {
     pub affinity_mode: u64,
     pub sojourn_thresh_ns: u64,
     pub burst_slice_ns: u64,
+    pub smt_mode: u64,
 }
 
 impl Default for TuningKnobs {
@@ -87,8 +102,97 @@ impl Default for TuningKnobs {
             affinity_mode: AFFINITY_OFF,
             sojourn_thresh_ns: 5_000_000,
             burst_slice_ns: 1_000_000,
+            smt_mode: SMT_OFF,
+        }
+    }
+}
+
+// KNOB GENERATIONS: MATCHES KNOB_SLOTS IN intf.h. GENERATION g LIVES IN
+// SLOT g % KNOB_SLOTS; PUBLISHING g REUSES THE SLOT OF g - KNOB_SLOTS.
+pub const KNOB_SLOTS: u64 = 2;
+
+pub fn knob_slot(gen: u64) -> u32 {
+    (gen % KNOB_SLOTS) as u32
+}
+
+// MATCHES struct knob_gen_stats IN intf.h (ONE CPU'S SHARE OF ONE GENERATION)
+#[repr(C)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct KnobGenStats {
+    pub gen: u64,
+    pub nr_runs: u64,
+    pub wake_lat_sum: u64,
+    pub wake_lat_cnt: u64,
+    pub wake_lat_max: u64,
+    pub lat_hist: [u64; HIST_BUCKETS],
+}
+
+impl KnobGenStats {
+    pub fn empty(gen: u64) -> Self {
+        Self {
+            gen,
+            nr_runs: 0,
+            wake_lat_sum: 0,
+            wake_lat_cnt: 0,
+            wake_lat_max: 0,
+            lat_hist: [0; HIST_BUCKETS],
+        }
+    }
+
+    pub fn parse(bytes: &[u8]) -> Option<Self> {
+        if bytes.len() < std::mem::size_of::<Self>() {
+            return None;
+        }
+        Some(unsafe { std::ptr::read_unaligned(bytes.as_ptr() as *const Self) })
+    }
+
+    // SUM ONE SLOT ACROSS CPUS. A CPU STILL HOLDING AN OLDER gen HAS NOT
+    // RUN ANYTHING UNDER THIS ONE YET, SO IT CONTRIBUTES NOTHING.
+    pub fn sum_for_gen(per_cpu: &[KnobGenStats], gen: u64) -> Self {
+        let mut out = Self::empty(gen);
+        for s in per_cpu.iter().filter(|s| s.gen == gen) {
+            out.nr_runs += s.nr_runs;
+            out.wake_lat_sum += s.wake_lat_sum;
+            out.wake_lat_cnt += s.wake_lat_cnt;
+            out.wake_lat_max = out.wake_lat_max.max(s.wake_lat_max);
+            for b in 0..HIST_BUCKETS {
+                out.lat_hist[b] += s.lat_hist[b];
+            }
         }
+        out
     }
+
+    pub fn wake_avg_ns(&self) -> u64 {
+        if self.wake_lat_cnt > 0 {
+            self.wake_lat_sum / self.wake_lat_cnt
+        } else {
+            0
+        }
+    }
+}
+
+// A GENERATION THAT HAS BEEN SUPERSEDED: ITS KNOBS, HOW LONG IT WAS LIVE,
+// AND WHAT THE SCHEDULER DID UNDER IT
+#[derive(Clone, Copy)]
+pub struct RetiredKnobGen {
+    pub knobs: TuningKnobs,
+    pub live_ns: u64,
+    pub stats: KnobGenStats,
+}
+
+// ONE TELEMETRY LINE: knob: g=N live=MS runs=N wake=US p99=US max=US slice=US batch=US
+pub fn format_knob_gen(r: &RetiredKnobGen) -> String {
+    format!(
+        "knob: g={} live={}ms runs={} wake={}us p99={}us max={}us slice={}us batch={}us",
+        r.stats.gen,
+        r.live_ns / 1_000_000,
+        r.stats.nr_runs,
+        r.stats.wake_avg_ns() / 1000,
+        compute_p99_from_histogram(&r.stats.lat_hist) / 1000,
+        r.stats.wake_lat_max / 1000,
+        r.knobs.slice_ns / 1000,
+        r.knobs.batch_slice_ns / 1000,
+    )
 }
 
 // REGIME
@@ -134,6 +238,7 @@ pub fn regime_knobs(r: Regime) -> TuningKnobs {
             affinity_mode: AFFINITY_WEAK,
             sojourn_thresh_ns: 5_000_000,
             burst_slice_ns: 1_000_000,
+            smt_mode: SMT_IDLE_CORE,
         },
         Regime::Mixed => TuningKnobs {
             slice_ns: MIXED_SLICE_NS,
@@ -146,6 +251,7 @@ pub fn regime_knobs(r: Regime) -> TuningKnobs {
             affinity_mode: AFFINITY_STRONG,
             sojourn_thresh_ns: 5_000_000,
             burst_slice_ns: 1_000_000,
+            smt_mode: SMT_IDLE_CORE | SMT_BATCH_PACK,
         },
         Regime::Heavy => TuningKnobs {
             slice_ns: HEAVY_SLICE_NS,
@@ -158,6 +264,7 @@ pub fn regime_knobs(r: Regime) -> TuningKnobs {
             affinity_mode: AFFINITY_WEAK,
             sojourn_thresh_ns: 5_000_000,
             burst_slice_ns: 1_000_000,
+            smt_mode: SMT_OFF,
         },
     }
 }
@@ -190,6 +297,190 @@ pub fn scaled_regime_knobs(r: Regime, nr_cpus: u64) -> TuningKnobs {
     knobs
 }
 
+// CORE-COUNT SCALING
+// MATCHES struct scale_knobs IN intf.h. BPF DERIVES IT ONCE FROM THE ONLINE
+// COUNT; RUST CLAIMS IT (owner = SCALE_OWNER_RUST) AND RE-DERIVES IT FROM THE
+// EFFECTIVE CPU COUNT (--nr-cpus, cpuset, HOTPLUG), THEN BENDS IT UNDER
+// RESCUE PRESSURE. interactive_budget IS MACHINE-WIDE: THE DEFICIT COUNTER
+// IS PER NODE, SO BPF's node_budget() CUTS IT TO EACH NODE'S SHARE OF THE
+// ONLINE CPUs AT THE POINT OF USE.
+
+pub const SCALE_OWNER_BPF: u64 = 0;
+pub const SCALE_OWNER_RUST: u64 = 1;
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ScaleKnobs {
+    pub interactive_budget: u64,
+    pub starvation_rescue_ns: u64,
+    pub overflow_sojourn_rescue_ns: u64,
+    pub pcpu_depth_base: u64,
+    pub nr_cpus: u64,
+    pub owner: u64,
+}
+
+const STARVATION_RESCUE_MIN_NS: u64 = 20_000_000; // 20MS
+const STARVATION_RESCUE_MAX_NS: u64 = 500_000_000; // 500MS
+const OVERFLOW_RESCUE_MIN_NS: u64 = 4_000_000; // 4MS
+const OVERFLOW_RESCUE_MAX_NS: u64 = 10_000_000; // 10MS
+const CONTENDED_OVERFLOW_MIN_NS: u64 = 2_000_000; // 2MS
+
+// SAME FORMULAS AS scale_for_cpus() IN main.bpf.c
+pub fn scale_knobs(nr_cpus: u64) -> ScaleKnobs {
+    let n = nr_cpus.max(1);
+    let ratio = (2 + (n >> 1)).min(4);
+    let linear_up = n * 25_000_000;
+    let linear_down = 500_000_000 / (n / 4).max(1);
+    ScaleKnobs {
+        interactive_budget: (n * ratio).max(2),
+        starvation_rescue_ns: linear_up
+            .min(linear_down)
+            .clamp(STARVATION_RESCUE_MIN_NS, STARVATION_RESCUE_MAX_NS),
+        overflow_sojourn_rescue_ns: (n * 2_000_000)
+            .clamp(OVERFLOW_RESCUE_MIN_NS, OVERFLOW_RESCUE_MAX_NS),
+        pcpu_depth_base: if n < 4 { 1 } else { 2 },
+        nr_cpus: n,
+        owner: SCALE_OWNER_RUST,
+    }
+}
+
+// RESCUE PRESSURE: OVERFLOW AND STARVATION RESCUES FIRING FASTER THAN
+// SCALE_PRESSURE_RESCUES_PER_CPU PER CPU-SECOND MEAN THE SHARED DSQs ARE
+// LOSING TO PER-CPU DSQ DOMINANCE (THE 64-128C FAILURE MODE). EACH LEVEL
+// HALVES THE DRR BUDGET, TAKES 1/4 OFF BOTH RESCUE AGES, AND FROM LEVEL 1
+// DROPS THE DEPTH GATE TO 1 SO LESS WORK HIDES IN PER-CPU DSQs.
+pub const SCALE_PRESSURE_MAX: u32 = 3;
+pub const SCALE_PRESSURE_RESCUES_PER_CPU: u64 = 50;
+
+pub fn rescue_pressure(rescues: u64, elapsed_ns: u64, nr_cpus: u64) -> bool {
+    if elapsed_ns == 0 {
+        return false;
+    }
+    rescues * 1_000_000_000 / elapsed_ns > nr_cpus.max(1) * SCALE_PRESSURE_RESCUES_PER_CPU
+}
+
+pub fn contended_scale_knobs(base: &ScaleKnobs, level: u32) -> ScaleKnobs {
+    let level = level.min(SCALE_PRESSURE_MAX);
+    if level == 0 {
+        return *base;
+    }
+    let mut k = *base;
+    for _ in 0..level {
+        k.interactive_budget = (k.interactive_budget / 2).max(2);
+        k.starvation_rescue_ns = (k.starvation_rescue_ns * 3 / 4).max(STARVATION_RESCUE_MIN_NS);
+        k.overflow_sojourn_rescue_ns =
+            (k.overflow_sojourn_rescue_ns * 3 / 4).max(CONTENDED_OVERFLOW_MIN_NS);
+    }
+    k.pcpu_depth_base = 1;
+    k
+}
+
+// PRESSURE LEVEL WITH THE LOOP'S USUAL HYSTERESIS: STEP UP AFTER hold
+// CONSECUTIVE PRESSURED WINDOWS, STEP DOWN AFTER relax CALM ONES.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ScalePressure {
+    pub level: u32,
+    hot: u32,
+    calm: u32,
+}
+
+impl ScalePressure {
+    // RETURNS TRUE WHEN THE LEVEL CHANGED
+    pub fn update(&mut self, pressured: bool, hold: u32, relax: u32) -> bool {
+        let before = self.level;
+        if pressured {
+            self.calm = 0;
+            self.hot += 1;
+            if self.hot >= hold.max(1) && self.level < SCALE_PRESSURE_MAX {
+                self.level += 1;
+                self.hot = 0;
+            }
+        } else {
+            self.hot = 0;
+            if self.level > 0 {
+                self.calm += 1;
+                if self.calm >= relax.max(1) {
+                    self.level -= 1;
+                    self.calm = 0;
+                }
+            }
+        }
+        self.level != before
+    }
+}
+
+// ADAPTIVE PER-CPU DSQ DEPTH
+// MATCHES struct pcpu_depth AND PCPU_DEPTH_MAX IN intf.h. BPF COUNTS PER
+// DSQ-OWNING CPU; ONCE PER REPORT WINDOW RUST STEPS EACH CPU'S DEPTH GATE
+// BY AT MOST ONE FROM THE DELTAS.
+
+pub const PCPU_DEPTH_MAX: u32 = 4;
+pub const PCPU_DEPTH_MIN_SAMPLES: u64 = 64; // FAST-PATH ATTEMPTS PER WINDOW
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct PcpuDepth {
+    pub depth: u32,
+    pub _pad0: u32,
+    pub idle_hits: u64,
+    pub spills: u64,
+    pub steals: u64,
+    pub sojourn_kicks: u64,
+    pub _pad: [u64; 3],
+}
+
+impl PcpuDepth {
+    pub fn delta(&self, prev: &Self) -> Self {
+        Self {
+            depth: self.depth,
+            idle_hits: self.idle_hits.wrapping_sub(prev.idle_hits),
+            spills: self.spills.wrapping_sub(prev.spills),
+            steals: self.steals.wrapping_sub(prev.steals),
+            sojourn_kicks: self.sojourn_kicks.wrapping_sub(prev.sojourn_kicks),
+            ..Self::default()
+        }
+    }
+}
+
+// SHALLOWER WHEN THE QUEUE HIDES WORK: A SOJOURN KICK (A TASK WENT STALE
+// IN IT) OR SIBLINGS STEALING MORE THAN 1/4 OF WHAT LANDED IN IT.
+// DEEPER WHEN SHORT TASKS DRAIN UNAIDED: MORE THAN 1/4 OF FAST-PATH
+// WAKEUPS SPILLED TO THE NODE DSQ WHILE ALMOST NOTHING WAS STOLEN.
+pub fn next_pcpu_depth(cur: u32, d: &PcpuDepth) -> u32 {
+    let cur = cur.clamp(1, PCPU_DEPTH_MAX);
+    if d.sojourn_kicks > 0 {
+        return (cur - 1).max(1);
+    }
+    let attempts = d.idle_hits + d.spills;
+    if attempts < PCPU_DEPTH_MIN_SAMPLES {
+        return cur;
+    }
+    if d.steals * 4 > d.idle_hits {
+        return (cur - 1).max(1);
+    }
+    if d.spills * 4 > attempts && d.steals * 16 <= d.idle_hits {
+        return (cur + 1).min(PCPU_DEPTH_MAX);
+    }
+    cur
+}
+
+// CPUs AT EACH DEPTH 1..=PCPU_DEPTH_MAX
+pub fn depth_histogram(depths: &[u32]) -> [u64; PCPU_DEPTH_MAX as usize] {
+    let mut hist = [0u64; PCPU_DEPTH_MAX as usize];
+    for &d in depths {
+        hist[(d.clamp(1, PCPU_DEPTH_MAX) - 1) as usize] += 1;
+    }
+    hist
+}
+
+pub fn format_depth_hist(hist: &[u64; PCPU_DEPTH_MAX as usize]) -> String {
+    hist.iter()
+        .enumerate()
+        .map(|(i, n)| format!("{}:{}", i + 1, n))
+        .collect::<Vec<_>>()
+        .join("/")
+}
+
 // REGIME DETECTION (SCHMITT TRIGGER)
 // DIRECTION-AWARE: CURRENT REGIME DETERMINES WHICH THRESHOLDS APPLY.
 // DEAD ZONES PREVENT OSCILLATION THAT SINGLE-BOUNDARY DETECTION CAUSED.
@@ -222,6 +513,18 @@ pub fn detect_regime(current: Regime, idle_pct: u64) -> Regime {
     }
 }
 
+// EVENT-DRIVEN REGIME PROMOTION
+// A BURST OR HARD STARVATION RESCUE IN LIGHT MEANS CONTENTION ARRIVED
+// BETWEEN TICKS. PROMOTE TO MIXED IMMEDIATELY -- THE SAFE DIRECTION, NO
+// 2-TICK HOLD. THE SCHMITT TRIGGER DEMOTES AGAIN IF THE SYSTEM STAYS IDLE.
+
+pub fn promote_on_contention(current: Regime) -> Option<Regime> {
+    match current {
+        Regime::Light => Some(Regime::Mixed),
+        Regime::Mixed | Regime::Heavy => None,
+    }
+}
+
 // STABILITY MODE
 
 pub const STABILITY_THRESHOLD: u32 = 10; // CONSECUTIVE STABLE TICKS BEFORE HIBERNATE
@@ -249,40 +552,100 @@ pub fn should_print_telemetry(tick_counter: u64, stability_score: u32) -> bool {
     }
 }
 
-// P99 HISTOGRAM
+// WAKEUP LATENCY HISTOGRAM (LOG-LINEAR)
+// MATCHES LAT_HIST_* AND lat_bucket() IN BPF. UNIT = 1024NS. UNITS 0-3 ARE
+// LINEAR, EACH HIGHER POWER OF TWO SPLITS INTO 4 SUB-BUCKETS, SO A BUCKET IS
+// AT MOST 25% OF ITS LOWER EDGE WIDE. 64 BUCKETS REACH ~117MS; THE LAST ONE
+// IS OVERFLOW.
+
+pub const HIST_UNIT_SHIFT: u32 = 10;
+pub const HIST_SUB_BITS: u32 = 2;
+pub const HIST_SUB: usize = 1 << HIST_SUB_BITS;
+pub const HIST_BUCKETS: usize = 64;
+pub const HIST_TIERS: usize = 3;
+
+// LOWER EDGE OF BUCKET b IN NS
+pub const fn hist_bucket_lower_ns(b: usize) -> u64 {
+    let units = if b < HIST_SUB {
+        b as u64
+    } else {
+        let msb = (b >> HIST_SUB_BITS) as u32 + HIST_SUB_BITS - 1;
+        ((HIST_SUB + (b & (HIST_SUB - 1))) as u64) << (msb - HIST_SUB_BITS)
+    };
+    units << HIST_UNIT_SHIFT
+}
 
-pub const HIST_BUCKETS: usize = 12;
-pub const HIST_EDGES_NS: [u64; HIST_BUCKETS] = [
-    10_000,     // 10us
-    25_000,     // 25us
-    50_000,     // 50us
-    100_000,    // 100us
-    250_000,    // 250us
-    500_000,    // 500us
-    1_000_000,  // 1ms
-    2_000_000,  // 2ms
-    5_000_000,  // 5ms
-    10_000_000, // 10ms
-    20_000_000, // 20ms
-    u64::MAX,   // +inf
-];
+// UPPER EDGE (EXCLUSIVE) OF EACH BUCKET. OVERFLOW BUCKET IS +INF.
+pub const HIST_EDGES_NS: [u64; HIST_BUCKETS] = {
+    let mut edges = [u64::MAX; HIST_BUCKETS];
+    let mut b = 0;
+    while b < HIST_BUCKETS - 1 {
+        edges[b] = hist_bucket_lower_ns(b + 1);
+        b += 1;
+    }
+    edges
+};
+
+// PERCENTILES CAP AT THE OVERFLOW BUCKET'S LOWER EDGE -- +INF WOULD POISON
+// EVERY COMPARISON.
+pub const HIST_CAP_NS: u64 = hist_bucket_lower_ns(HIST_BUCKETS - 1);
+
+// RUST MIRROR OF BPF lat_bucket() (LAYOUT TESTS ONLY)
+#[allow(dead_code)]
+pub fn lat_bucket(lat_ns: u64) -> usize {
+    let units = lat_ns >> HIST_UNIT_SHIFT;
+    if units < HIST_SUB as u64 {
+        return units as usize;
+    }
+    let msb = 63 - units.leading_zeros();
+    let b = (((msb - HIST_SUB_BITS + 1) as usize) << HIST_SUB_BITS)
+        + ((units >> (msb - HIST_SUB_BITS)) as usize & (HIST_SUB - 1));
+    b.min(HIST_BUCKETS - 1)
+}
 
-// COMPUTE P99 FROM DRAINED HISTOGRAM COUNTS. PURE FUNCTION.
-// CAP AT 20MS (LAST REAL BUCKET) -- +INF WOULD POISON EVERY COMPARISON.
-pub fn compute_p99_from_histogram(counts: &[u64; HIST_BUCKETS]) -> u64 {
+// PERCENTILE BY LINEAR INTERPOLATION INSIDE THE BUCKET HOLDING THE RANK:
+// THE BUCKET'S c SAMPLES ARE SPREAD EVENLY, EACH AT THE CENTER OF ITS 1/c
+// SLICE, SO THE RESULT ALWAYS LIES INSIDE THE BUCKET.
+// per_mille: 500 = P50, 990 = P99, 999 = P99.9. PURE FUNCTION.
+pub fn compute_percentile_from_histogram(counts: &[u64; HIST_BUCKETS], per_mille: u64) -> u64 {
     let total: u64 = counts.iter().sum();
     if total == 0 {
         return 0;
     }
-    let threshold = (total * 99 + 99) / 100;
+    let rank = ((total as u128 * per_mille as u128).div_ceil(1000) as u64).max(1);
     let mut cumulative = 0u64;
-    for i in 0..HIST_BUCKETS {
-        cumulative += counts[i];
-        if cumulative >= threshold {
-            return HIST_EDGES_NS[i].min(HIST_EDGES_NS[HIST_BUCKETS - 2]);
+    for b in 0..HIST_BUCKETS - 1 {
+        let c = counts[b];
+        if cumulative + c >= rank {
+            let lo = hist_bucket_lower_ns(b);
+            let width = HIST_EDGES_NS[b] - lo;
+            let pos = (rank - cumulative) as u128;
+            return lo + (width as u128 * (2 * pos - 1) / (2 * c as u128)) as u64;
         }
+        cumulative += c;
+    }
+    HIST_CAP_NS
+}
+
+pub fn compute_p99_from_histogram(counts: &[u64; HIST_BUCKETS]) -> u64 {
+    compute_percentile_from_histogram(counts, 990)
+}
+
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct Percentiles {
+    pub p50_ns: u64,
+    pub p90_ns: u64,
+    pub p99_ns: u64,
+    pub p999_ns: u64,
+}
+
+pub fn compute_percentiles(counts: &[u64; HIST_BUCKETS]) -> Percentiles {
+    Percentiles {
+        p50_ns: compute_percentile_from_histogram(counts, 500),
+        p90_ns: compute_percentile_from_histogram(counts, 900),
+        p99_ns: compute_percentile_from_histogram(counts, 990),
+        p999_ns: compute_percentile_from_histogram(counts, 999),
     }
-    HIST_EDGES_NS[HIST_BUCKETS - 2]
 }
 
 // REFLEX TIGHTEN DECISION: USES BOTH AGGREGATE AND INTERACTIVE P99.
@@ -291,6 +654,27 @@ pub fn should_reflex_tighten(aggregate_p99: u64, interactive_p99: u64, ceiling:
     aggregate_p99 > ceiling || interactive_p99 > ceiling
 }
 
+// P99 SAMPLE GATE
+// WITH FEWER THAN 100 SAMPLES THE 99TH PERCENTILE IS JUST THE MAXIMUM, SO A
+// SINGLE SLOW WAKEUP IN A SHORT QUIET WINDOW WOULD READ AS A SPIKE. SUCH A
+// WINDOW MAY NOT DRIVE TIGHTENING.
+
+pub const MIN_P99_SAMPLES: u64 = 100;
+
+// A WINDOW'S P99 AND SAMPLE COUNT, AS THE CONTROLLER AND FLIGHT TRACES CARRY THEM
+pub fn gated_p99(p99_ns: u64, samples: u64) -> Option<u64> {
+    if samples < MIN_P99_SAMPLES {
+        return None;
+    }
+    Some(p99_ns)
+}
+
+// THE SAME GATE OVER A RAW HISTOGRAM (LAYOUT TESTS ONLY)
+#[allow(dead_code)]
+pub fn sampled_p99(counts: &[u64; HIST_BUCKETS]) -> Option<u64> {
+    gated_p99(compute_p99_from_histogram(counts), counts.iter().sum())
+}
+
 // SLEEP-INFORMED BATCH TUNING
 // IO-HEAVY: EXTEND BATCH SLICES (+25%) -- IO-BOUND TASKS BATCH BETWEEN FREQUENT SHORT SLEEPS
 // IDLE-HEAVY: TIGHTEN BATCH SLICES (-25%) -- SPORADIC USER INPUT NEEDS FASTER PREEMPTION
@@ -309,3 +693,62 @@ pub fn sleep_adjust_batch_ns(base_batch_ns: u64, io_pct: u64) -> u64 {
     }
 }
 
+// CONTROL PERIOD
+// THE MONITOR LOOP RUNS EVERY 50MS-1S. HOLDS AND SMOOTHING ARE SPECIFIED IN
+// WALL-CLOCK TIME AND CONVERTED TO WINDOW COUNTS HERE, SO A SHORTER PERIOD
+// SEES A CONDITION SOONER WITHOUT SHORTENING HOW LONG IT MUST PERSIST.
+
+pub const CONTROL_PERIOD_MIN_MS: u64 = 50;
+pub const CONTROL_PERIOD_MAX_MS: u64 = 1000;
+pub const DEFAULT_CONTROL_PERIOD_MS: u64 = 1000;
+
+pub fn clamp_control_period_ms(ms: u64) -> u64 {
+    ms.clamp(CONTROL_PERIOD_MIN_MS, CONTROL_PERIOD_MAX_MS)
+}
+
+// AMORTIZED RECLASSIFICATION
+// 0 RECLASSIFIES EVERY WAKEUP. 1 IS THE SAME THING, SO IT MAPS TO 0. THE
+// BPF COUNTDOWN IS A u8, WHICH CAPS THE INTERVAL AT 256 WAKEUPS.
+
+pub const RECLASS_INTERVAL_MAX: u32 = 256;
+
+pub fn clamp_reclass_interval(n: u32) -> u32 {
+    if n <= 1 {
+        0
+    } else {
+        n.min(RECLASS_INTERVAL_MAX)
+    }
+}
+
+// % OF CLASSIFIABLE WAKEUPS THAT RAN THE FULL CLASSIFIER (100 WHEN IDLE)
+pub fn reclass_pct(full: u64, skipped: u64) -> u64 {
+    let total = full + skipped;
+    if total == 0 {
+        return 100;
+    }
+    full * 100 / total
+}
+
+// WINDOWS OF period_ns NEEDED TO COVER span_ns (ROUNDED UP, AT LEAST 1)
+pub fn windows_for(span_ns: u64, period_ns: u64) -> u32 {
+    if period_ns == 0 {
+        return 1;
+    }
+    span_ns.div_ceil(period_ns).clamp(1, u32::MAX as u64) as u32
+}
+
+// HYSTERESIS HOLD: AT LEAST 2 CONSECUTIVE WINDOWS AND AT LEAST span_ns.
+// AT 1S THIS IS THE ORIGINAL 2-TICK HOLD.
+pub fn hold_windows(span_ns: u64, period_ns: u64) -> u32 {
+    windows_for(span_ns, period_ns).max(2)
+}
+
+// TIME-SCALED EWMA: MOVE old TOWARD target BY dt/tau.
+// dt = 1S, tau = 8S IS THE ORIGINAL 7/8 OLD + 1/8 NEW PER TICK.
+pub fn ewma_step(old: u64, target: u64, dt_ns: u64, tau_ns: u64) -> u64 {
+    if dt_ns >= tau_ns {
+        return target;
+    }
+    let (old, target, dt, tau) = (old as u128, target as u128, dt_ns as u128, tau_ns as u128);
+    ((old * (tau - dt) + target * dt) / tau) as u64
+}
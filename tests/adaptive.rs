@@ -5,13 +5,21 @@
 // ZERO BPF DEPENDENCIES. RUN OFFLINE.
 
 use pandemonium::tuning::{
-    compute_p99_from_histogram, compute_stability_score, detect_regime, regime_knobs,
+    clamp_control_period_ms, compute_p99_from_histogram, compute_stability_score, detect_regime,
+    ewma_step, hold_windows, lat_bucket, promote_on_contention, regime_knobs, sampled_p99,
     should_print_telemetry, should_reflex_tighten, sleep_adjust_batch_ns, Regime, TuningKnobs,
+    format_knob_gen, knob_slot, KnobGenStats, RetiredKnobGen, KNOB_SLOTS,
+    contended_scale_knobs, rescue_pressure, scale_knobs, ScaleKnobs, ScalePressure,
+    SCALE_OWNER_RUST, SCALE_PRESSURE_MAX,
+    depth_histogram, format_depth_hist, next_pcpu_depth, PcpuDepth, PCPU_DEPTH_MAX,
+    PCPU_DEPTH_MIN_SAMPLES,
     AFFINITY_OFF, AFFINITY_STRONG, AFFINITY_WEAK, BATCH_MAX_NS,
     DEFAULT_LAT_CRI_THRESH_HIGH, DEFAULT_LAT_CRI_THRESH_LOW,
     HEAVY_DEMOTION_NS, HEAVY_ENTER_PCT, HEAVY_EXIT_PCT,
     HIST_BUCKETS, LIGHT_DEMOTION_NS, LIGHT_ENTER_PCT, LIGHT_EXIT_PCT, MIXED_DEMOTION_NS,
-    STABILITY_THRESHOLD,
+    MIN_P99_SAMPLES, SMT_BATCH_PACK, SMT_IDLE_CORE, SMT_OFF, STABILITY_THRESHOLD,
+    windows_for, CONTROL_PERIOD_MAX_MS, CONTROL_PERIOD_MIN_MS,
+    clamp_reclass_interval, reclass_pct, RECLASS_INTERVAL_MAX,
 };
 
 // REGIME DETECTION (SCHMITT TRIGGER)
@@ -58,6 +66,15 @@ fn detect_regime_heavy_stays_in_dead_zone() {
     assert_eq!(result, Regime::Heavy);
 }
 
+// EVENT-DRIVEN PROMOTION
+
+#[test]
+fn contention_event_promotes_light_only() {
+    assert_eq!(promote_on_contention(Regime::Light), Some(Regime::Mixed));
+    assert_eq!(promote_on_contention(Regime::Mixed), None);
+    assert_eq!(promote_on_contention(Regime::Heavy), None);
+}
+
 // KNOB COMPUTATION
 
 #[test]
@@ -71,6 +88,7 @@ fn regime_knobs_light_values() {
     assert_eq!(k.lat_cri_thresh_high, DEFAULT_LAT_CRI_THRESH_HIGH);
     assert_eq!(k.lat_cri_thresh_low, DEFAULT_LAT_CRI_THRESH_LOW);
     assert_eq!(k.affinity_mode, AFFINITY_WEAK);
+    assert_eq!(k.smt_mode, SMT_IDLE_CORE);
 }
 
 #[test]
@@ -84,6 +102,7 @@ fn regime_knobs_mixed_values() {
     assert_eq!(k.lat_cri_thresh_high, DEFAULT_LAT_CRI_THRESH_HIGH);
     assert_eq!(k.lat_cri_thresh_low, DEFAULT_LAT_CRI_THRESH_LOW);
     assert_eq!(k.affinity_mode, AFFINITY_STRONG);
+    assert_eq!(k.smt_mode, SMT_IDLE_CORE | SMT_BATCH_PACK);
 }
 
 #[test]
@@ -97,6 +116,7 @@ fn regime_knobs_heavy_values() {
     assert_eq!(k.lat_cri_thresh_high, DEFAULT_LAT_CRI_THRESH_HIGH);
     assert_eq!(k.lat_cri_thresh_low, DEFAULT_LAT_CRI_THRESH_LOW);
     assert_eq!(k.affinity_mode, AFFINITY_WEAK);
+    assert_eq!(k.smt_mode, SMT_OFF);
 }
 
 // DEMOTION THRESHOLD (FEATURE 5)
@@ -120,8 +140,77 @@ fn demotion_threshold_in_knobs() {
 
 #[test]
 fn tuning_knobs_size_is_8_u64() {
-    // MUST MATCH struct tuning_knobs IN intf.h (10 x u64 = 80 BYTES)
-    assert_eq!(std::mem::size_of::<TuningKnobs>(), 80);
+    // MUST MATCH struct tuning_knobs IN intf.h (11 x u64 = 88 BYTES)
+    assert_eq!(std::mem::size_of::<TuningKnobs>(), 88);
+}
+
+// KNOB GENERATIONS (DOUBLE-BUFFERED PUBLISH)
+
+#[test]
+fn knob_gen_stats_abi_size() {
+    // MUST MATCH struct knob_gen_stats IN intf.h (5 u64 + 64-BUCKET HISTOGRAM)
+    assert_eq!(std::mem::size_of::<KnobGenStats>(), 5 * 8 + HIST_BUCKETS * 8);
+}
+
+#[test]
+fn knob_slots_alternate() {
+    // CONSECUTIVE GENERATIONS NEVER SHARE A SLOT: THE LIVE ONE IS NEVER WRITTEN
+    for gen in 0..16u64 {
+        assert_ne!(knob_slot(gen), knob_slot(gen + 1));
+        assert_eq!(knob_slot(gen), knob_slot(gen + KNOB_SLOTS));
+        assert!((knob_slot(gen) as u64) < KNOB_SLOTS);
+    }
+}
+
+#[test]
+fn knob_gen_sum_skips_stale_cpus() {
+    let mut cur = KnobGenStats::empty(7);
+    cur.nr_runs = 100;
+    cur.wake_lat_sum = 400_000;
+    cur.wake_lat_cnt = 40;
+    cur.wake_lat_max = 50_000;
+    cur.lat_hist[10] = 40;
+    let mut other = cur;
+    other.wake_lat_max = 90_000;
+    // A CPU THAT HAS NOT RUN SINCE GEN 5 STILL HOLDS GEN 5'S COUNTERS
+    let mut stale = KnobGenStats::empty(5);
+    stale.nr_runs = 1_000_000;
+    stale.wake_lat_cnt = 1_000_000;
+
+    let sum = KnobGenStats::sum_for_gen(&[cur, stale, other], 7);
+    assert_eq!(sum.gen, 7);
+    assert_eq!(sum.nr_runs, 200);
+    assert_eq!(sum.wake_lat_cnt, 80);
+    assert_eq!(sum.wake_avg_ns(), 10_000);
+    assert_eq!(sum.wake_lat_max, 90_000);
+    assert_eq!(sum.lat_hist[10], 80);
+}
+
+#[test]
+fn knob_gen_parse_and_format() {
+    let mut s = KnobGenStats::empty(3);
+    s.nr_runs = 12;
+    s.wake_lat_sum = 60_000;
+    s.wake_lat_cnt = 6;
+    s.wake_lat_max = 25_000;
+    let bytes = unsafe {
+        std::slice::from_raw_parts(
+            &s as *const KnobGenStats as *const u8,
+            std::mem::size_of::<KnobGenStats>(),
+        )
+    };
+    assert_eq!(KnobGenStats::parse(bytes), Some(s));
+    assert_eq!(KnobGenStats::parse(&bytes[..8]), None);
+
+    let r = RetiredKnobGen {
+        knobs: TuningKnobs::default(),
+        live_ns: 1_500_000_000,
+        stats: s,
+    };
+    assert_eq!(
+        format_knob_gen(&r),
+        "knob: g=3 live=1500ms runs=12 wake=10us p99=0us max=25us slice=1000us batch=20000us"
+    );
 }
 
 #[test]
@@ -135,6 +224,7 @@ fn tuning_knobs_default() {
     assert_eq!(k.lat_cri_thresh_high, DEFAULT_LAT_CRI_THRESH_HIGH);
     assert_eq!(k.lat_cri_thresh_low, DEFAULT_LAT_CRI_THRESH_LOW);
     assert_eq!(k.affinity_mode, AFFINITY_OFF);
+    assert_eq!(k.smt_mode, SMT_OFF);
 }
 
 // STABILITY MODE
@@ -193,26 +283,26 @@ fn should_print_telemetry_alternates_when_stable() {
 fn per_tier_p99_isolates_tiers() {
     // BATCH SAMPLES AT 50US DON'T AFFECT INTERACTIVE P99
     let mut batch_counts = [0u64; HIST_BUCKETS];
-    batch_counts[2] = 100; // 50US BUCKET
+    batch_counts[lat_bucket(50_000)] = 100; // 50US BUCKET
 
     let mut interactive_counts = [0u64; HIST_BUCKETS];
-    interactive_counts[6] = 100; // 1MS BUCKET
+    interactive_counts[lat_bucket(1_000_000)] = 100; // 1MS BUCKET
 
     let batch_p99 = compute_p99_from_histogram(&batch_counts);
     let interactive_p99 = compute_p99_from_histogram(&interactive_counts);
 
-    assert_eq!(batch_p99, 50_000); // 50US
-    assert_eq!(interactive_p99, 1_000_000); // 1MS
+    assert_eq!(lat_bucket(batch_p99), lat_bucket(50_000)); // ~50US
+    assert_eq!(lat_bucket(interactive_p99), lat_bucket(1_000_000)); // ~1MS
 }
 
 #[test]
 fn per_tier_p99_reset_clears_all() {
     // AFTER DRAINING A HISTOGRAM, EMPTY COUNTS PRODUCE ZERO P99
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[4] = 50; // 250US BUCKET
+    counts[lat_bucket(250_000)] = 50; // 250US BUCKET
 
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, 250_000);
+    assert_eq!(lat_bucket(p99), lat_bucket(250_000));
 
     // EMPTY HISTOGRAM: P99 = 0 (SIMULATES POST-DRAIN STATE)
     let empty = [0u64; HIST_BUCKETS];
@@ -292,3 +382,194 @@ fn sleep_adjust_caps_at_max() {
     assert_eq!(result, BATCH_MAX_NS);
 }
 
+// CONTROL PERIOD (WALL-CLOCK HOLDS AND SMOOTHING)
+
+#[test]
+fn control_period_clamped() {
+    assert_eq!(clamp_control_period_ms(10), CONTROL_PERIOD_MIN_MS);
+    assert_eq!(clamp_control_period_ms(100), 100);
+    assert_eq!(clamp_control_period_ms(5000), CONTROL_PERIOD_MAX_MS);
+}
+
+// AMORTIZED RECLASSIFICATION
+
+#[test]
+fn reclass_interval_clamped_and_rate() {
+    // 0 AND 1 BOTH MEAN "EVERY WAKEUP"; THE u8 COUNTDOWN CAPS AT 256
+    assert_eq!(clamp_reclass_interval(0), 0);
+    assert_eq!(clamp_reclass_interval(1), 0);
+    assert_eq!(clamp_reclass_interval(16), 16);
+    assert_eq!(clamp_reclass_interval(100_000), RECLASS_INTERVAL_MAX);
+    assert!(RECLASS_INTERVAL_MAX - 1 <= u8::MAX as u32);
+
+    assert_eq!(reclass_pct(0, 0), 100);
+    assert_eq!(reclass_pct(50, 0), 100);
+    assert_eq!(reclass_pct(1, 15), 6);
+}
+
+#[test]
+fn hold_windows_wall_clock() {
+    // 1S PERIOD: ORIGINAL 2-TICK HOLD. 50MS: 200MS HOLD = 4 WINDOWS.
+    assert_eq!(hold_windows(200_000_000, 1_000_000_000), 2);
+    assert_eq!(hold_windows(200_000_000, 100_000_000), 2);
+    assert_eq!(hold_windows(200_000_000, 50_000_000), 4);
+    // RELAX HOLD: 2S OF GOOD P99 REGARDLESS OF PERIOD
+    assert_eq!(windows_for(2_000_000_000, 1_000_000_000), 2);
+    assert_eq!(windows_for(2_000_000_000, 50_000_000), 40);
+    assert_eq!(windows_for(0, 50_000_000), 1);
+}
+
+#[test]
+fn ewma_step_matches_eighth_at_one_second() {
+    // dt = 1S, tau = 8S: 7/8 OLD + 1/8 NEW
+    assert_eq!(ewma_step(8_000_000, 16_000_000, 1_000_000_000, 8_000_000_000), 9_000_000);
+    // TEN 100MS STEPS MOVE ROUGHLY AS FAR AS ONE 1S STEP
+    let mut v = 8_000_000u64;
+    for _ in 0..10 {
+        v = ewma_step(v, 16_000_000, 100_000_000, 8_000_000_000);
+    }
+    assert!(v > 8_900_000 && v < 9_000_000, "v = {}", v);
+    // dt >= tau JUMPS TO TARGET
+    assert_eq!(ewma_step(1, 42, 9_000_000_000, 8_000_000_000), 42);
+}
+
+#[test]
+fn sampled_p99_needs_min_samples() {
+    // ONE SLOW WAKEUP IN A SPARSE WINDOW IS NOT A P99 SPIKE
+    let mut h = [0u64; HIST_BUCKETS];
+    h[0] = MIN_P99_SAMPLES - 2;
+    h[lat_bucket(8_000_000)] = 1;
+    assert_eq!(sampled_p99(&h), None);
+    h[0] += 1;
+    assert_eq!(sampled_p99(&h), Some(compute_p99_from_histogram(&h)));
+}
+
+// CORE-COUNT SCALING (scale_knobs)
+
+#[test]
+fn scale_knobs_size_matches_intf() {
+    // MUST MATCH struct scale_knobs IN intf.h (6 x u64)
+    assert_eq!(std::mem::size_of::<ScaleKnobs>(), 48);
+}
+
+#[test]
+fn scale_knobs_match_bpf_formulas() {
+    // (CPUS, BUDGET, STARVATION MS, OVERFLOW MS, DEPTH): THE README TABLE
+    let table = [
+        (2, 6, 50, 4, 1),
+        (4, 16, 100, 8, 2),
+        (8, 32, 200, 10, 2),
+        (12, 48, 166, 10, 2),
+        (128, 512, 20, 10, 2),
+    ];
+    for (n, budget, starve_ms, overflow_ms, depth) in table {
+        let k = scale_knobs(n);
+        assert_eq!(k.interactive_budget, budget, "{}C budget", n);
+        assert_eq!(k.starvation_rescue_ns / 1_000_000, starve_ms, "{}C starvation", n);
+        assert_eq!(k.overflow_sojourn_rescue_ns / 1_000_000, overflow_ms, "{}C overflow", n);
+        assert_eq!(k.pcpu_depth_base, depth, "{}C depth", n);
+        assert_eq!(k.nr_cpus, n);
+        assert_eq!(k.owner, SCALE_OWNER_RUST);
+    }
+    // ZERO NEVER DIVIDES OR COLLAPSES THE BUDGET
+    assert_eq!(scale_knobs(0).interactive_budget, 2);
+}
+
+#[test]
+fn contended_scale_steps_down_with_floors() {
+    let base = scale_knobs(128);
+    assert_eq!(contended_scale_knobs(&base, 0), base);
+    let l1 = contended_scale_knobs(&base, 1);
+    assert_eq!(l1.interactive_budget, 256);
+    assert_eq!(l1.overflow_sojourn_rescue_ns, 7_500_000);
+    assert_eq!(l1.starvation_rescue_ns, 20_000_000); // ALREADY AT THE FLOOR
+    assert_eq!(l1.pcpu_depth_base, 1);
+    let max = contended_scale_knobs(&base, SCALE_PRESSURE_MAX + 5);
+    assert_eq!(max, contended_scale_knobs(&base, SCALE_PRESSURE_MAX));
+    assert_eq!(max.interactive_budget, 64);
+    assert!(max.overflow_sojourn_rescue_ns >= 2_000_000);
+    assert_eq!(max.nr_cpus, 128);
+}
+
+#[test]
+fn rescue_pressure_scales_with_cpus() {
+    // 50 RESCUES PER CPU-SECOND IS THE LINE
+    assert!(!rescue_pressure(800, 1_000_000_000, 16));
+    assert!(rescue_pressure(801, 1_000_000_000, 16));
+    assert!(rescue_pressure(80, 100_000_000, 8)); // 800/S AT 100MS PERIOD
+    assert!(!rescue_pressure(10_000, 0, 4));
+}
+
+#[test]
+fn scale_pressure_hysteresis() {
+    let mut p = ScalePressure::default();
+    assert!(!p.update(true, 2, 3));
+    assert!(p.update(true, 2, 3));
+    assert_eq!(p.level, 1);
+    // ONE CALM WINDOW BREAKS THE HOT STREAK
+    assert!(!p.update(true, 2, 3));
+    assert!(!p.update(false, 2, 3));
+    assert!(!p.update(true, 2, 3));
+    assert_eq!(p.level, 1);
+    for _ in 0..20 {
+        p.update(true, 2, 3);
+    }
+    assert_eq!(p.level, SCALE_PRESSURE_MAX);
+    // RELAX ONE LEVEL PER relax CALM WINDOWS
+    p.update(false, 2, 3);
+    p.update(false, 2, 3);
+    assert!(p.update(false, 2, 3));
+    assert_eq!(p.level, SCALE_PRESSURE_MAX - 1);
+}
+
+// ADAPTIVE PER-CPU DSQ DEPTH
+
+fn depth_window(idle_hits: u64, spills: u64, steals: u64, sojourn_kicks: u64) -> PcpuDepth {
+    PcpuDepth {
+        idle_hits,
+        spills,
+        steals,
+        sojourn_kicks,
+        ..PcpuDepth::default()
+    }
+}
+
+#[test]
+fn pcpu_depth_size_matches_intf() {
+    // MUST MATCH struct pcpu_depth IN intf.h (ONE CACHE LINE)
+    assert_eq!(std::mem::size_of::<PcpuDepth>(), 64);
+}
+
+#[test]
+fn pcpu_depth_deepens_for_short_tasks() {
+    // RPC FAN-OUT: HALF THE FAST-PATH WAKEUPS SPILL, NOTHING STOLEN
+    let d = depth_window(500, 500, 0, 0);
+    assert_eq!(next_pcpu_depth(2, &d), 3);
+    assert_eq!(next_pcpu_depth(PCPU_DEPTH_MAX, &d), PCPU_DEPTH_MAX);
+    // TOO FEW SAMPLES: HOLD
+    let quiet = depth_window(PCPU_DEPTH_MIN_SAMPLES / 4, PCPU_DEPTH_MIN_SAMPLES / 4, 0, 0);
+    assert_eq!(next_pcpu_depth(2, &quiet), 2);
+}
+
+#[test]
+fn pcpu_depth_shrinks_when_hiding_work() {
+    // LONG TASKS: SIBLINGS STEAL A THIRD OF WHAT LANDS HERE
+    assert_eq!(next_pcpu_depth(3, &depth_window(300, 300, 100, 0)), 2);
+    // ANY SOJOURN KICK WINS, EVEN BELOW THE SAMPLE FLOOR
+    assert_eq!(next_pcpu_depth(2, &depth_window(1, 0, 0, 1)), 1);
+    assert_eq!(next_pcpu_depth(1, &depth_window(1, 0, 0, 1)), 1);
+    // STEADY: FEW SPILLS, FEW STEALS
+    assert_eq!(next_pcpu_depth(2, &depth_window(1000, 50, 10, 0)), 2);
+}
+
+#[test]
+fn pcpu_depth_delta_and_histogram() {
+    let prev = depth_window(100, 10, 5, 1);
+    let now = PcpuDepth { depth: 3, ..depth_window(250, 30, 5, 1) };
+    let d = now.delta(&prev);
+    assert_eq!((d.depth, d.idle_hits, d.spills, d.steals, d.sojourn_kicks), (3, 150, 20, 0, 0));
+
+    let hist = depth_histogram(&[1, 2, 2, 4, 0, 9]);
+    assert_eq!(hist, [2, 2, 0, 2]); // OUT-OF-RANGE CLAMPED INTO 1 AND 4
+    assert_eq!(format_depth_hist(&hist), "1:2/2:2/3:0/4:2");
+}
@@ -0,0 +1,109 @@
+// PANDEMONIUM PER-CGROUP ACCOUNTING TESTS
+// SNAPSHOT DIFFING, LRU RE-INSERT HANDLING, TOP-N RANKING, ABI LAYOUT
+
+use pandemonium::cgroup::{
+    format_usage, rank_top_n, CgroupStats, CgroupTracker, CgroupUsage, HWEIGHT_ONE,
+};
+use pandemonium::tuning::{lat_bucket, HIST_BUCKETS};
+
+fn stats(runtime_ns: u64, runs: u64, lat_ns: u64, lat_cnt: u64) -> CgroupStats {
+    let mut s = CgroupStats {
+        runtime_ns,
+        nr_runs: runs,
+        wake_lat_sum: lat_ns * lat_cnt,
+        wake_lat_cnt: lat_cnt,
+        ..Default::default()
+    };
+    s.lat_hist[lat_bucket(lat_ns)] = lat_cnt;
+    s
+}
+
+#[test]
+fn cgroup_stats_abi_size() {
+    // 7 COUNTERS + hweight + 64-BUCKET HISTOGRAM, MATCHES struct cgrp_stats
+    assert_eq!(std::mem::size_of::<CgroupStats>(), 8 * 8 + HIST_BUCKETS * 8);
+}
+
+#[test]
+fn tracker_reports_window_deltas() {
+    let mut t = CgroupTracker::new();
+    let first = t.update(vec![(42, stats(10_000_000, 100, 50_000, 200))]);
+    assert_eq!(first[0].runtime_ns, 10_000_000);
+
+    // SECOND WINDOW: ONLY THE GROWTH IS REPORTED
+    let mut cur = stats(25_000_000, 160, 50_000, 200);
+    cur.wake_lat_sum += 300 * 2_000_000;
+    cur.wake_lat_cnt += 300;
+    cur.lat_hist[lat_bucket(2_000_000)] += 300;
+    let second = t.update(vec![(42, cur)]);
+    assert_eq!(second[0].runtime_ns, 15_000_000);
+    assert_eq!(second[0].runs, 60);
+    assert_eq!(second[0].wake_avg_ns, 2_000_000);
+    assert_eq!(lat_bucket(second[0].p99_ns), lat_bucket(2_000_000));
+}
+
+#[test]
+fn tracker_handles_lru_reinsert() {
+    // EVICTED AND RE-CREATED: COUNTERS RESTART BELOW THE OLD SNAPSHOT
+    let mut t = CgroupTracker::new();
+    t.update(vec![(7, stats(90_000_000, 900, 10_000, 10))]);
+    let after = t.update(vec![(7, stats(3_000_000, 30, 10_000, 10))]);
+    assert_eq!(after[0].runtime_ns, 3_000_000);
+    assert_eq!(after[0].runs, 30);
+}
+
+#[test]
+fn rank_top_n_orders_by_runtime_then_p99() {
+    let u = |id, runtime_ns, p99_ns| CgroupUsage {
+        id,
+        runtime_ns,
+        runs: 1,
+        p99_ns,
+        ..Default::default()
+    };
+    let idle = CgroupUsage { id: 9, ..Default::default() };
+    let ranked = rank_top_n(
+        vec![u(1, 5, 100), u(2, 50, 100), idle, u(3, 50, 900), u(4, 1, 0)],
+        3,
+    );
+    let ids: Vec<u64> = ranked.iter().map(|r| r.id).collect();
+    assert_eq!(ids, vec![3, 2, 1]);
+}
+
+#[test]
+fn format_usage_units() {
+    let u = CgroupUsage {
+        id: 1,
+        runtime_ns: 250_000_000,
+        runs: 1200,
+        rescues: 2,
+        wake_avg_ns: 40_000,
+        batch_wait_avg_ns: 3_000_000,
+        p99_ns: 900_000,
+        share_pct: None,
+    };
+    assert_eq!(
+        format_usage("/system.slice/db.service", &u),
+        "/system.slice/db.service run=250ms d=1200 wake=40us p99=900us bwait=3000us rescue=2"
+    );
+    let shared = CgroupUsage { share_pct: Some(25), ..u };
+    assert!(format_usage("/db", &shared).ends_with(" rescue=2 share=25%"));
+}
+
+#[test]
+fn hweight_is_a_gauge() {
+    // COUNTERS DIFF, THE cpu.weight SHARE REPORTS ITS LATEST VALUE
+    let mut t = CgroupTracker::new();
+    let mut a = stats(10_000_000, 10, 1_000, 1);
+    a.hweight = HWEIGHT_ONE / 2;
+    t.update(vec![(3, a)]);
+    let mut b = stats(20_000_000, 20, 1_000, 2);
+    b.hweight = HWEIGHT_ONE / 4;
+    let u = t.update(vec![(3, b)]);
+    assert_eq!(u[0].runtime_ns, 10_000_000);
+    assert_eq!(u[0].share_pct, Some(25));
+
+    // FLAT (NO cgrp_ctx ENTRY): NO SHARE
+    let flat = t.update(vec![(3, stats(30_000_000, 30, 1_000, 3))]);
+    assert_eq!(flat[0].share_pct, None);
+}
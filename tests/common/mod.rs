@@ -0,0 +1,10 @@
+// SHARED INTEGRATION TEST HELPERS
+
+// FRESH SCRATCH FILE UNDER $TMPDIR/pandemonium-test: ANY LEFTOVER IS REMOVED
+pub fn tmp_path(name: &str) -> std::path::PathBuf {
+    let dir = std::env::temp_dir().join("pandemonium-test");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = dir.join(name);
+    let _ = std::fs::remove_file(&path);
+    path
+}
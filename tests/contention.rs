@@ -5,14 +5,15 @@
 // ZERO BPF DEPENDENCIES. RUN OFFLINE.
 
 use pandemonium::tuning::{
-    compute_p99_from_histogram, compute_stability_score, detect_regime, regime_knobs,
+    compute_p99_from_histogram, compute_percentiles, compute_stability_score, detect_regime,
+    hist_bucket_lower_ns, lat_bucket, regime_knobs,
     should_reflex_tighten, sleep_adjust_batch_ns, Regime, TuningKnobs,
     AFFINITY_STRONG, AFFINITY_WEAK,
-    BATCH_MAX_NS, HIST_BUCKETS, HIST_EDGES_NS,
+    BATCH_MAX_NS, HIST_BUCKETS, HIST_CAP_NS, HIST_EDGES_NS, HIST_SUB,
 };
 
 // SOJOURN THRESHOLD ADAPTATION
-// THE EWMA LIVES IN adaptive.rs (INLINE IN monitor_loop), SO WE REPLICATE
+// THE EWMA LIVES IN controller.rs (Controller::tick), SO WE REPLICATE
 // THE EXACT ARITHMETIC HERE TO VERIFY IT IN ISOLATION.
 
 fn sojourn_floor(nr_cpus: u64) -> u64 {
@@ -133,7 +134,7 @@ fn sojourn_ewma_stability_identical_targets() {
 }
 
 // GRADUATED RELAX STATE MACHINE
-// SIMULATE THE EXACT LOGIC FROM adaptive.rs
+// SIMULATE THE EXACT LOGIC FROM controller.rs
 
 const MIN_SLICE_NS: u64 = 500_000;
 const RELAX_STEP_NS: u64 = 500_000;
@@ -560,59 +561,121 @@ fn regime_hold_resets_on_new_pending() {
 
 #[test]
 fn p99_all_in_one_bucket() {
+    let b = lat_bucket(100_000);
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[3] = 1000; // ALL IN 100US BUCKET
+    counts[b] = 1000; // ALL IN THE 100US BUCKET
+    // RANK 990 OF 1000: CENTER OF THE 990TH 1/1000 SLICE OF THE BUCKET
+    let lo = hist_bucket_lower_ns(b);
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, HIST_EDGES_NS[3]); // 100_000
+    assert_eq!(p99, lo + (HIST_EDGES_NS[b] - lo) * 1979 / 2000);
 }
 
 #[test]
 fn p99_split_99_1() {
+    let b50 = lat_bucket(50_000);
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[2] = 99; // 50US: 99%
-    counts[6] = 1;  // 1MS: 1%
-    // THRESHOLD = (100*99+99)/100 = 99. CUMULATIVE HITS 99 AT BUCKET 2.
-    // P99 = 50US (THE 99TH PERCENTILE FALLS WITHIN THE 99-SAMPLE BUCKET)
+    counts[b50] = 99; // 50US: 99%
+    counts[lat_bucket(1_000_000)] = 1; // 1MS: 1%
+    // RANK = CEIL(100 * 0.99) = 99: THE LAST SAMPLE OF THE 50US BUCKET
+    let lo = hist_bucket_lower_ns(b50);
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, HIST_EDGES_NS[2]); // 50_000
+    assert_eq!(p99, lo + (HIST_EDGES_NS[b50] - lo) * 197 / 198);
 }
 
 #[test]
 fn p99_split_98_2() {
+    let b1ms = lat_bucket(1_000_000);
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[2] = 98; // 50US: 98%
-    counts[6] = 2;  // 1MS: 2%
-    // THRESHOLD = (100*99+99)/100 = 99. CUMULATIVE=98 AT BUCKET 2 (NOT ENOUGH).
-    // P99 FALLS IN BUCKET 6 (1MS)
+    counts[lat_bucket(50_000)] = 98; // 50US: 98%
+    counts[b1ms] = 2; // 1MS: 2%
+    // RANK 99 IS THE FIRST OF 2 SAMPLES IN THE 1MS BUCKET: A QUARTER ACROSS
+    let lo = hist_bucket_lower_ns(b1ms);
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, HIST_EDGES_NS[6]); // 1_000_000
+    assert_eq!(p99, lo + (HIST_EDGES_NS[b1ms] - lo) / 4);
 }
 
 #[test]
 fn p99_all_in_inf_bucket_capped() {
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[HIST_BUCKETS - 1] = 500; // ALL IN +INF
+    counts[HIST_BUCKETS - 1] = 500; // ALL IN OVERFLOW
     let p99 = compute_p99_from_histogram(&counts);
-    // CAPPED AT 20MS, NOT U64::MAX
-    assert_eq!(p99, HIST_EDGES_NS[HIST_BUCKETS - 2]); // 20_000_000
+    // CAPPED AT THE OVERFLOW LOWER EDGE (~117MS), NOT U64::MAX
+    assert_eq!(p99, HIST_CAP_NS);
+    assert!(HIST_CAP_NS > 100_000_000);
 }
 
 #[test]
 fn p99_single_sample() {
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[0] = 1; // SINGLE SAMPLE IN 10US
+    counts[0] = 1; // SINGLE SAMPLE BELOW 1US
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, HIST_EDGES_NS[0]); // 10_000
+    assert_eq!(p99, HIST_EDGES_NS[0] / 2); // BUCKET CENTER: 512NS
 }
 
 #[test]
 fn p99_exactly_100_samples() {
+    let b500 = lat_bucket(500_000);
     let mut counts = [0u64; HIST_BUCKETS];
-    counts[1] = 98; // 25US: 98 SAMPLES
-    counts[5] = 2;  // 500US: 2 SAMPLES
-    // THRESHOLD = (100*99+99)/100 = 99. BUCKET 1 HAS 98, NEED 99 -> BUCKET 5
+    counts[lat_bucket(25_000)] = 98; // 25US: 98 SAMPLES
+    counts[b500] = 2; // 500US: 2 SAMPLES
+    // RANK 99 -> FIRST OF 2 IN THE 500US BUCKET
+    let lo = hist_bucket_lower_ns(b500);
     let p99 = compute_p99_from_histogram(&counts);
-    assert_eq!(p99, HIST_EDGES_NS[5]); // 500_000
+    assert_eq!(p99, lo + (HIST_EDGES_NS[b500] - lo) / 4);
+}
+
+// LOG-LINEAR HISTOGRAM LAYOUT
+
+#[test]
+fn lat_bucket_matches_edges() {
+    // EVERY BUCKET'S LOWER EDGE MAPS TO ITSELF, THE NS BELOW ITS UPPER EDGE TOO
+    for b in 0..HIST_BUCKETS - 1 {
+        assert_eq!(lat_bucket(hist_bucket_lower_ns(b)), b, "lower edge of {}", b);
+        assert_eq!(lat_bucket(HIST_EDGES_NS[b] - 1), b, "upper edge of {}", b);
+        assert!(HIST_EDGES_NS[b] > hist_bucket_lower_ns(b));
+    }
+    assert_eq!(lat_bucket(u64::MAX), HIST_BUCKETS - 1);
+}
+
+#[test]
+fn lat_bucket_sub_bucket_width_bounded() {
+    // LOG-LINEAR: ABOVE THE LINEAR RANGE NO BUCKET IS WIDER THAN 1/HIST_SUB
+    // OF ITS LOWER EDGE, AND THE RANGE COVERS 1US TO 100MS
+    for b in HIST_SUB..HIST_BUCKETS - 1 {
+        let lo = hist_bucket_lower_ns(b);
+        assert!((HIST_EDGES_NS[b] - lo) * HIST_SUB as u64 <= lo, "bucket {}", b);
+    }
+    assert!(lat_bucket(1_000) < lat_bucket(2_000));
+    assert!(lat_bucket(100_000_000) < HIST_BUCKETS - 1);
+}
+
+#[test]
+fn p99_resolves_sub_millisecond_steps() {
+    // 1.1MS AND 1.9MS USED TO SHARE THE 1-2MS BUCKET; NOW THEY DIFFER
+    let mut a = [0u64; HIST_BUCKETS];
+    let mut b = [0u64; HIST_BUCKETS];
+    a[lat_bucket(1_100_000)] = 100;
+    b[lat_bucket(1_900_000)] = 100;
+    let pa = compute_p99_from_histogram(&a);
+    let pb = compute_p99_from_histogram(&b);
+    assert!(pb > pa + 500_000, "pa={} pb={}", pa, pb);
+}
+
+#[test]
+fn percentiles_ordered_and_interpolated() {
+    let mut counts = [0u64; HIST_BUCKETS];
+    counts[lat_bucket(20_000)] = 900;
+    counts[lat_bucket(400_000)] = 90;
+    counts[lat_bucket(3_000_000)] = 9;
+    counts[lat_bucket(40_000_000)] = 1;
+    let p = compute_percentiles(&counts);
+    assert!(p.p50_ns <= p.p90_ns && p.p90_ns <= p.p99_ns && p.p99_ns <= p.p999_ns);
+    assert_eq!(lat_bucket(p.p50_ns), lat_bucket(20_000));
+    // RANK 990: LAST OF THE 400US SAMPLES. RANK 999: LAST OF THE 3MS SAMPLES.
+    assert_eq!(lat_bucket(p.p90_ns), lat_bucket(20_000));
+    assert_eq!(lat_bucket(p.p99_ns), lat_bucket(400_000));
+    assert_eq!(lat_bucket(p.p999_ns), lat_bucket(3_000_000));
+    assert!(p.p99_ns > hist_bucket_lower_ns(lat_bucket(400_000)));
 }
 
 // STABILITY SCORE INTEGRATION
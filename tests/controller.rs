@@ -0,0 +1,172 @@
+// PANDEMONIUM CONTROLLER STATE MACHINE TESTS
+// THE ADAPTIVE LOOP'S POLICY DRIVEN WITH SYNTHETIC WINDOWS: TIGHTEN HOLD,
+// SAMPLE GATE, GRADUATED RELAX, REGIME HOLD, FAST PROMOTION, LONGRUN,
+// HOTPLUG RESCALE AND RESCUE PRESSURE. ZERO BPF DEPENDENCIES.
+
+use pandemonium::controller::{
+    ControlParams, Controller, TickInput, DECISION_FAST_PROMOTE, DECISION_REGIME_SWITCH,
+    DECISION_RELAX_DONE, DECISION_RELAX_STEP, DECISION_RESCALE, DECISION_SCALE_PRESSURE,
+    DECISION_TIGHTEN, STATE_CONTENTION, STATE_LONGRUN, STATE_TIGHTENED,
+};
+use pandemonium::tuning::{scaled_regime_knobs, Regime, AFFINITY_WEAK, MAX_NODES};
+
+const SEC: u64 = 1_000_000_000;
+
+// ONE 1S WINDOW: idle_pct OF 10K DISPATCHES HIT AN IDLE CPU
+fn window(idle_pct: u64, p99_us: u64, samples: u64) -> TickInput {
+    TickInput {
+        elapsed_ns: SEC,
+        dispatches: 10_000,
+        idle_hits: 100 * idle_pct,
+        p99_ns: p99_us * 1000,
+        samples,
+        io_pct: 30,
+        ..Default::default()
+    }
+}
+
+fn controller() -> Controller {
+    Controller::new(ControlParams::new(SEC), 8)
+}
+
+#[test]
+fn tighten_holds_then_relaxes_to_baseline() {
+    let mut ctl = controller();
+    let base = scaled_regime_knobs(Regime::Mixed, 8);
+    assert_eq!(ctl.knobs().slice_ns, base.slice_ns);
+
+    // MIXED CEILING IS 5MS: ONE SPIKE WINDOW IS NOT ENOUGH
+    assert_eq!(ctl.tick(&window(30, 8000, 500)) & DECISION_TIGHTEN, 0);
+    assert_eq!(ctl.spike_count(), 1);
+    let d = ctl.tick(&window(30, 8000, 500));
+    assert_ne!(d & DECISION_TIGHTEN, 0);
+    assert_ne!(d & STATE_TIGHTENED, 0);
+    assert_eq!(ctl.knobs().slice_ns, base.slice_ns * 3 / 4);
+    assert_eq!(ctl.knobs().preempt_thresh_ns, base.slice_ns * 3 / 4);
+    assert_eq!(ctl.tighten_events(), 1);
+
+    // 2S OF GOOD P99, THEN ONE 500US STEP BACK TO THE 1MS BASELINE
+    assert_eq!(ctl.tick(&window(30, 1000, 500)) & DECISION_RELAX_STEP, 0);
+    let d = ctl.tick(&window(30, 1000, 500));
+    assert_ne!(d & DECISION_RELAX_STEP, 0);
+    assert_ne!(d & DECISION_RELAX_DONE, 0);
+    assert_eq!(d & STATE_TIGHTENED, 0);
+    assert!(!ctl.tightened());
+    assert_eq!(ctl.knobs().slice_ns, base.slice_ns);
+}
+
+#[test]
+fn sample_gate_neither_counts_nor_resets() {
+    let mut ctl = controller();
+    ctl.tick(&window(30, 8000, 500));
+    assert_eq!(ctl.spike_count(), 1);
+    // 50 SAMPLES: THE P99 IS JUST THE MAX, IGNORED
+    assert_eq!(ctl.tick(&window(30, 8000, 50)) & DECISION_TIGHTEN, 0);
+    assert_eq!(ctl.spike_count(), 1);
+    assert_ne!(ctl.tick(&window(30, 8000, 500)) & DECISION_TIGHTEN, 0);
+
+    // THE INTERACTIVE TIER ALONE CAN DRIVE IT
+    let mut ctl = controller();
+    let spike_i = TickInput {
+        p99_i_ns: 8_000_000,
+        samples_i: 200,
+        ..window(30, 1000, 50)
+    };
+    ctl.tick(&spike_i);
+    assert_ne!(ctl.tick(&spike_i) & DECISION_TIGHTEN, 0);
+}
+
+#[test]
+fn regime_hold_and_fast_promotion() {
+    let mut ctl = controller();
+    // 90% IDLE: LIGHT AFTER THE 2-WINDOW HOLD
+    assert_eq!(ctl.tick(&window(90, 100, 500)) & DECISION_REGIME_SWITCH, 0);
+    assert_eq!(ctl.pending_regime(), Regime::Light);
+    assert_eq!(ctl.regime_hold(), 1);
+    assert_ne!(ctl.tick(&window(90, 100, 500)) & DECISION_REGIME_SWITCH, 0);
+    assert_eq!(ctl.regime(), Regime::Light);
+    assert_eq!(ctl.knobs().slice_ns, scaled_regime_knobs(Regime::Light, 8).slice_ns);
+
+    // A BURST EDGE PROMOTES AT ONCE; A SPIKE ON THAT TICK DOES NOT TIGHTEN
+    assert!(ctl.contention());
+    assert_eq!(ctl.regime(), Regime::Mixed);
+    assert!(!ctl.contention());
+    let d = ctl.tick(&window(30, 8000, 500));
+    assert_ne!(d & DECISION_FAST_PROMOTE, 0);
+    assert_ne!(d & STATE_CONTENTION, 0);
+    assert_eq!(ctl.spike_count(), 0);
+    assert_eq!(ctl.fast_promotions(), 1);
+    assert_eq!(ctl.tick(&window(30, 8000, 500)) & (DECISION_FAST_PROMOTE | STATE_CONTENTION), 0);
+
+    // REGIME TIME IS WALL TIME, BY Regime
+    let ns = ctl.regime_ns();
+    assert_eq!(ns[Regime::Mixed as usize], 3 * SEC);
+    assert_eq!(ns[Regime::Light as usize], SEC);
+}
+
+#[test]
+fn holds_scale_with_control_period() {
+    // 50MS PERIOD: THE 200MS TIGHTEN HOLD IS 4 WINDOWS
+    let mut ctl = Controller::new(ControlParams::new(50_000_000), 8);
+    let spike = TickInput {
+        elapsed_ns: 50_000_000,
+        ..window(30, 8000, 500)
+    };
+    for _ in 0..3 {
+        assert_eq!(ctl.tick(&spike) & DECISION_TIGHTEN, 0);
+    }
+    assert_ne!(ctl.tick(&spike) & DECISION_TIGHTEN, 0);
+
+    // CANDIDATE PARAMETERS: A 3S HOLD, A SHALLOWER CUT AND A HIGHER FLOOR
+    let mut params = ControlParams::new(SEC);
+    params.tighten_hold_ns = 3 * SEC;
+    params.tighten_pct = 90;
+    params.min_slice_ns = 950_000;
+    let mut ctl = Controller::new(params, 8);
+    ctl.tick(&window(30, 8000, 500));
+    ctl.tick(&window(30, 8000, 500));
+    assert_ne!(ctl.tick(&window(30, 8000, 500)) & DECISION_TIGHTEN, 0);
+    assert_eq!(ctl.knobs().slice_ns, 950_000);
+}
+
+#[test]
+fn longrun_rescale_and_pressure() {
+    let mut ctl = controller();
+    let base = scaled_regime_knobs(Regime::Mixed, 8);
+
+    // A NODE INDEX PAST MAX_NODES IS NOT A LONGRUN EDGE
+    ctl.longrun(MAX_NODES as u32, true);
+    assert!(!ctl.longrun_active());
+
+    // LONGRUN EDGE: BASE BATCH, WEAK AFFINITY, HELD THROUGH THE TICK
+    ctl.longrun(1, true);
+    assert!(ctl.longrun_override());
+    assert!(!ctl.longrun_override());
+    assert_eq!(ctl.knobs().affinity_mode, AFFINITY_WEAK);
+    let d = ctl.tick(&window(30, 1000, 500));
+    assert_ne!(d & STATE_LONGRUN, 0);
+    assert_eq!(ctl.knobs().batch_slice_ns, base.batch_slice_ns);
+    ctl.longrun(1, false);
+    ctl.longrun_override();
+    assert_eq!(ctl.knobs().affinity_mode, base.affinity_mode);
+    ctl.resync_longrun(true);
+    assert!(ctl.longrun_active());
+
+    // HOTPLUG DOWN TO ONE CPU: SLICE CAP 500US, SOJOURN CLAMPED TO 2-4MS
+    assert!(!ctl.rescale(8));
+    assert!(ctl.rescale(1));
+    assert_eq!(ctl.knobs().slice_ns, 500_000);
+    assert!((2_000_000..=4_000_000).contains(&ctl.sojourn_thresh_ns()));
+    assert_ne!(ctl.tick(&window(30, 1000, 500)) & DECISION_RESCALE, 0);
+
+    // RESCUES OUTPACING 50/CPU/S STEP THE PRESSURE UP AFTER THE HOLD
+    let hot = TickInput {
+        rescues: 1000,
+        ..window(30, 1000, 500)
+    };
+    assert_eq!(ctl.tick(&hot) & DECISION_SCALE_PRESSURE, 0);
+    assert_ne!(ctl.tick(&hot) & DECISION_SCALE_PRESSURE, 0);
+    assert_eq!(ctl.pressure(), 1);
+    assert_eq!(ctl.scale_knobs().pcpu_depth_base, 1);
+    assert_eq!(ctl.scale_base(), pandemonium::tuning::scale_knobs(1));
+}
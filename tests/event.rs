@@ -1,26 +1,61 @@
 // PANDEMONIUM EVENT LOG TESTS
-// UNIT TESTS FOR THE PRE-ALLOCATED RING BUFFER
+// UNIT TESTS FOR THE PRE-ALLOCATED RING BUFFER AND BPF EVENT DECODING
 
-use pandemonium::event::{EventLog, MAX_SNAPSHOTS};
+use pandemonium::controller::{DECISION_TIGHTEN, STATE_LONGRUN};
+use pandemonium::event::{
+    BpfEvent, EventKind, EventLog, EventTally, Snapshot, MAX_SNAPSHOTS, REGIME_NONE,
+};
+
+fn snap(dispatches: u64) -> Snapshot {
+    let mut s = Snapshot::default();
+    s.stats[0] = dispatches;
+    s
+}
 
 #[test]
 fn snapshot_records() {
     let mut log = EventLog::new();
     assert_eq!(log.len(), 0);
 
-    log.snapshot(100, 90, 10, 5, 30, 65, 20, 10, 40, 50);
+    let mut s = snap(100);
+    s.stats[1] = 90; // nr_idle_hits
+    s.stats[2] = 10; // nr_shared
+    s.stats[3] = 5; // nr_preempt
+    s.stats[7] = 30; // nr_keep_running
+    s.stats[8] = 20; // nr_hard_kicks
+    s.stats[9] = 10; // nr_soft_kicks
+    s.wake_avg_us = 65;
+    s.p99_us = 900;
+    s.knobs[0] = 1_000_000;
+    s.regime = 1;
+    s.decisions = DECISION_TIGHTEN | STATE_LONGRUN;
+    log.snapshot(&s).unwrap();
     assert_eq!(log.len(), 1);
-    assert_eq!(log.get(0).dispatches, 100);
-    assert_eq!(log.get(0).idle_hits, 90);
-    assert_eq!(log.get(0).shared, 10);
-    assert_eq!(log.get(0).preempt, 5);
-    assert_eq!(log.get(0).keep_run, 30);
-    assert_eq!(log.get(0).wake_avg_us, 65);
-    assert_eq!(log.get(0).hard_kicks, 20);
-    assert_eq!(log.get(0).soft_kicks, 10);
-    assert_eq!(log.get(0).lat_idle_us, 40);
-    assert_eq!(log.get(0).lat_kick_us, 50);
-    assert!(log.get(0).ts_ns > 0);
+    let got = log.get(0);
+    assert_eq!(got.dispatches(), 100);
+    assert_eq!(got.idle_hits(), 90);
+    assert_eq!(got.shared(), 10);
+    assert_eq!(got.preempt(), 5);
+    assert_eq!(got.keep_run(), 30);
+    assert_eq!(got.hard_kicks(), 20);
+    assert_eq!(got.soft_kicks(), 10);
+    assert_eq!(got.wake_avg_us, 65);
+    assert_eq!(got.p99_us, 900);
+    assert_eq!(got.regime_label(), "MIXED");
+    assert_eq!(got.decision_label(), "Tl");
+    assert!(got.ts_ns > 0); // STAMPED BY THE LOG
+}
+
+#[test]
+fn snapshot_rates_and_labels() {
+    let mut s = snap(500);
+    s.elapsed_ns = 50_000_000; // A 50MS CONTROL TICK
+    assert_eq!(s.per_sec(s.dispatches()), 10_000);
+    s.elapsed_ns = 0;
+    assert_eq!(s.per_sec(s.dispatches()), 500);
+    assert_eq!(s.regime, REGIME_NONE);
+    assert_eq!(s.regime_label(), "BPF");
+    assert_eq!(s.decision_label(), "-");
 }
 
 #[test]
@@ -29,19 +64,19 @@ fn ring_buffer_wraps() {
 
     // FILL TO CAPACITY
     for i in 0..MAX_SNAPSHOTS {
-        log.snapshot(i as u64, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        log.snapshot(&snap(i as u64)).unwrap();
     }
     assert_eq!(log.len(), MAX_SNAPSHOTS);
     assert_eq!(log.head(), 0); // WRAPPED BACK TO START
 
     // WRITE ONE MORE -- OVERWRITES OLDEST
-    log.snapshot(9999, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    log.snapshot(&snap(9999)).unwrap();
     assert_eq!(log.len(), MAX_SNAPSHOTS);
     assert_eq!(log.head(), 1);
-    assert_eq!(log.get(0).dispatches, 9999);
+    assert_eq!(log.get(0).dispatches(), 9999);
 
     // CHRONOLOGICAL ITERATION STARTS FROM OLDEST (INDEX 1)
-    let ordered: Vec<u64> = log.iter_chronological().map(|s| s.dispatches).collect();
+    let ordered: Vec<u64> = log.iter_chronological().map(|s| s.dispatches()).collect();
     assert_eq!(ordered[0], 1); // OLDEST SURVIVING ENTRY
     assert_eq!(*ordered.last().unwrap(), 9999); // NEWEST
     assert_eq!(ordered.len(), MAX_SNAPSHOTS);
@@ -56,14 +91,83 @@ fn summary_no_panic_empty() {
 #[test]
 fn summary_no_panic_one() {
     let mut log = EventLog::new();
-    log.snapshot(100, 50, 50, 10, 20, 70, 0, 0, 0, 0);
+    log.snapshot(&snap(100)).unwrap();
     log.summary(); // SHOULD NOT PANIC WITH 1 SNAPSHOT
 }
 
 #[test]
 fn dump_no_panic() {
     let mut log = EventLog::new();
-    log.snapshot(100, 50, 50, 5, 25, 70, 0, 0, 0, 0);
-    log.snapshot(200, 150, 50, 10, 40, 150, 0, 0, 0, 0);
+    log.snapshot(&snap(100)).unwrap();
+    log.snapshot(&snap(200)).unwrap();
     log.dump(); // SHOULD NOT PANIC
 }
+
+// BPF EVENT STREAM
+
+fn raw_event(kind: u32, state: u8) -> Vec<u8> {
+    let mut raw = vec![0u8; 32];
+    raw[0..8].copy_from_slice(&123u64.to_ne_bytes());
+    raw[8..16].copy_from_slice(&7_000_000u64.to_ne_bytes());
+    raw[16..20].copy_from_slice(&kind.to_ne_bytes());
+    raw[20..24].copy_from_slice(&3i32.to_ne_bytes());
+    raw[24..28].copy_from_slice(&4242u32.to_ne_bytes());
+    raw[28..30].copy_from_slice(&1u16.to_ne_bytes());
+    raw[30] = state;
+    raw[31] = 1 - state.min(1);
+    raw
+}
+
+#[test]
+fn bpf_event_size_matches_intf() {
+    // MUST MATCH struct pand_event IN intf.h (32 BYTES)
+    assert_eq!(std::mem::size_of::<BpfEvent>(), 32);
+}
+
+#[test]
+fn bpf_event_parse_fields() {
+    let ev = BpfEvent::parse(&raw_event(2, 1)).unwrap();
+    assert_eq!(ev.ts_ns, 123);
+    assert_eq!(ev.value, 7_000_000);
+    assert_eq!(ev.kind(), Some(EventKind::Longrun));
+    assert_eq!(ev.cpu, 3);
+    assert_eq!(ev.pid, 4242);
+    assert_eq!(ev.node, 1);
+    assert_eq!(ev.state, 1);
+    assert_eq!(ev.prev_state, 0);
+}
+
+#[test]
+fn bpf_event_parse_rejects_short() {
+    assert!(BpfEvent::parse(&[0u8; 16]).is_none());
+}
+
+#[test]
+fn event_tally_counts_edges() {
+    let mut t = EventTally::default();
+    for (kind, state) in [(1, 1), (1, 0), (2, 1), (3, 0), (4, 1), (4, 0), (5, 2), (9, 0)] {
+        t.record(&BpfEvent::parse(&raw_event(kind, state)).unwrap());
+    }
+    assert_eq!(t.burst_on, 1);
+    assert_eq!(t.burst_off, 1);
+    assert_eq!(t.longrun_on, 1);
+    assert_eq!(t.rescues, 1);
+    assert_eq!(t.sojourn_crossings, 1);
+    assert_eq!(t.tier_changes, 1);
+    assert_eq!(t.unknown, 1);
+    assert_eq!(t.total(), 6);
+}
+
+#[test]
+fn event_tally_counts_hotplug() {
+    let mut t = EventTally::default();
+    // ONE CPU OFFLINED, THEN BROUGHT BACK
+    for state in [0, 1] {
+        let ev = BpfEvent::parse(&raw_event(6, state)).unwrap();
+        assert_eq!(ev.kind(), Some(EventKind::Hotplug));
+        t.record(&ev);
+    }
+    assert_eq!(t.cpus_offline, 1);
+    assert_eq!(t.cpus_online, 1);
+    assert_eq!(t.total(), 2);
+}
@@ -0,0 +1,137 @@
+// PANDEMONIUM FLIGHT RECORDER TESTS
+// APPEND AND REOPEN, TORN RECORDS, ROTATION, EVENT LOG MIRRORING
+
+mod common;
+
+use pandemonium::controller::DECISION_RELAX_STEP;
+use pandemonium::event::{EventLog, Snapshot};
+use pandemonium::flight::{
+    flight_capacity, read_flight_file, read_flight_set, FlightRecorder, FLIGHT_FILES,
+    FLIGHT_HEADER_SIZE, FLIGHT_MAX_RECORDS, FLIGHT_RECORD_SIZE,
+};
+
+// ALSO CLEARS THE ROTATED SIBLINGS A PREVIOUS RUN LEFT BEHIND
+fn tmp_path(name: &str) -> std::path::PathBuf {
+    let path = common::tmp_path(name);
+    for n in 1..FLIGHT_FILES {
+        let _ = std::fs::remove_file(format!("{}.{}", path.display(), n));
+    }
+    path
+}
+
+fn snap(tick: u64) -> Snapshot {
+    let mut s = Snapshot {
+        ts_ns: tick * 1_000_000_000,
+        elapsed_ns: 1_000_000_000,
+        tick,
+        regime: 2,
+        decisions: DECISION_RELAX_STEP,
+        ..Default::default()
+    };
+    s.stats[0] = tick * 100;
+    s.knobs[0] = 750_000;
+    s
+}
+
+fn ticks(snaps: &[Snapshot]) -> Vec<u64> {
+    snaps.iter().map(|s| s.tick).collect()
+}
+
+#[test]
+fn capacity_tracks_control_period() {
+    assert_eq!(flight_capacity(1000), 3600); // ONE HOUR AT 1S
+    assert_eq!(flight_capacity(50), FLIGHT_MAX_RECORDS);
+    assert_eq!(FLIGHT_RECORD_SIZE % 8, 0);
+    assert!(FLIGHT_RECORD_SIZE >= std::mem::size_of::<Snapshot>() + 12);
+}
+
+#[test]
+fn append_reopen_round_trip() {
+    let path = tmp_path("flight_round_trip.bin");
+    {
+        let mut rec = FlightRecorder::open(&path, 8).unwrap();
+        assert!(rec.is_empty());
+        rec.append(&snap(1)).unwrap();
+        rec.append(&snap(2)).unwrap();
+        // SINGLE WRITER
+        assert!(FlightRecorder::open(&path, 8).is_err());
+        // READABLE WHILE LIVE
+        assert_eq!(ticks(&read_flight_file(&path).unwrap()), vec![1, 2]);
+    }
+    // A RESTARTED SCHEDULER APPENDS
+    {
+        let mut rec = FlightRecorder::open(&path, 8).unwrap();
+        assert_eq!(rec.len(), 2);
+        rec.append(&snap(3)).unwrap();
+    }
+    let got = read_flight_file(&path).unwrap();
+    assert_eq!(got, vec![snap(1), snap(2), snap(3)]);
+    let len = std::fs::metadata(&path).unwrap().len() as usize;
+    assert_eq!(len, FLIGHT_HEADER_SIZE + 8 * FLIGHT_RECORD_SIZE);
+}
+
+#[test]
+fn torn_record_is_overwritten() {
+    let path = tmp_path("flight_torn.bin");
+    {
+        let mut rec = FlightRecorder::open(&path, 8).unwrap();
+        for t in 1..=3 {
+            rec.append(&snap(t)).unwrap();
+        }
+    }
+    // CORRUPT THE LAST RECORD: A CRASH MID-WRITE
+    let mut data = std::fs::read(&path).unwrap();
+    data[FLIGHT_HEADER_SIZE + 2 * FLIGHT_RECORD_SIZE + 40] ^= 0xff;
+    std::fs::write(&path, &data).unwrap();
+    assert_eq!(ticks(&read_flight_file(&path).unwrap()), vec![1, 2]);
+
+    let mut rec = FlightRecorder::open(&path, 8).unwrap();
+    assert_eq!(rec.len(), 2);
+    rec.append(&snap(9)).unwrap();
+    drop(rec);
+    assert_eq!(ticks(&read_flight_file(&path).unwrap()), vec![1, 2, 9]);
+}
+
+#[test]
+fn rotation_keeps_newest_files() {
+    let path = tmp_path("flight_rotate.bin");
+    let mut rec = FlightRecorder::open(&path, 4).unwrap();
+    let total = 4 * (FLIGHT_FILES as u64 + 1) + 2;
+    for t in 1..=total {
+        rec.append(&snap(t)).unwrap();
+    }
+    assert_eq!(rec.len(), 2);
+    assert_eq!(rec.rotations(), FLIGHT_FILES as u64 + 1);
+    drop(rec);
+
+    // OLDEST FILES DROPPED; THE SET READS BACK IN ORDER
+    let all = ticks(&read_flight_set(&path).unwrap());
+    let kept = 4 * (FLIGHT_FILES as u64 - 1) + 2;
+    assert_eq!(all, ((total - kept + 1)..=total).collect::<Vec<_>>());
+
+    // A DIFFERENT CAPACITY ROTATES THE OLD FILE AWAY, NOT OVER IT
+    let rec = FlightRecorder::open(&path, 16).unwrap();
+    assert!(rec.is_empty());
+    drop(rec);
+    let after = ticks(&read_flight_set(&path).unwrap());
+    assert_eq!(after.last(), Some(&total));
+}
+
+#[test]
+fn event_log_mirrors_to_disk() {
+    let path = tmp_path("flight_event_log.bin");
+    let mut log = EventLog::new();
+    log.record_to(FlightRecorder::open(&path, 8).unwrap());
+    log.snapshot(&snap(1)).unwrap();
+    log.snapshot(&snap(2)).unwrap();
+    assert_eq!(log.flight().unwrap().len(), 2);
+    drop(log);
+    let got = read_flight_file(&path).unwrap();
+    assert_eq!(ticks(&got), vec![1, 2]);
+    // THE LOG STAMPS ts_ns, THE REST IS AS RECORDED
+    assert!(got[0].ts_ns > 0);
+    assert_eq!(got[1].stats[0], 200);
+    assert_eq!(got[1].knobs[0], 750_000);
+    assert_eq!(got[1].regime_label(), "HEAVY");
+    assert_eq!(got[1].decision_label(), "X");
+}
@@ -1,12 +1,14 @@
 // PANDEMONIUM TEST GATE
 // INTEGRATION TESTS FOR THE SCHED_EXT SCHEDULER
 //
-// LAYERS 2-4 REQUIRE ROOT AND A COMPATIBLE KERNEL.
+// LAYERS 2-6 REQUIRE ROOT AND A COMPATIBLE KERNEL.
 // RUN: sudo cargo test --test gate --release -- --ignored --test-threads=1
 //
 // LAYER 2: LOAD, CLASSIFY, UNLOAD (BPF END-TO-END)
 // LAYER 3: LATENCY GATE (CYCLICTEST)
 // LAYER 4: INTERACTIVE RESPONSIVENESS (WAKEUP LATENCY)
+// LAYER 5: CONTENTION LATENCY (INTERACTIVE UNDER BATCH PRESSURE)
+// LAYER 6: PERIODIC FAIRNESS (NORMAL WORK RUNS BESIDE PERIODIC TASKS)
 
 use std::fs;
 use std::os::unix::process::CommandExt;
@@ -413,6 +415,96 @@ fn layer5_contention_latency() {
     );
 }
 
+// LAYER 6: PERIODIC FAIRNESS (NORMAL WORK RUNS BESIDE PERIODIC TASKS)
+
+// PIN THE CALLING THREAD TO CPU 0: EVERY WORKER COMPETES FOR ONE DSQ SLOT
+fn pin_to_cpu0() {
+    unsafe {
+        let mut set: libc::cpu_set_t = std::mem::zeroed();
+        libc::CPU_SET(0, &mut set);
+        libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &set);
+    }
+}
+
+fn thread_cpu_ns() -> u64 {
+    let mut ts = libc::timespec { tv_sec: 0, tv_nsec: 0 };
+    unsafe {
+        libc::clock_gettime(libc::CLOCK_THREAD_CPUTIME_ID, &mut ts);
+    }
+    ts.tv_sec as u64 * 1_000_000_000 + ts.tv_nsec as u64
+}
+
+#[test]
+#[ignore]
+fn layer6_periodic_fairness() {
+    assert!(!is_scx_active(), "SCHED_EXT ALREADY ACTIVE");
+
+    let mut child = start_pandemonium(&["--periodic-deadline"]);
+    assert!(wait_for_activation(), "DID NOT ACTIVATE WITHIN 10S");
+
+    // SIX 4MS LOOPS RUNNING 0.9MS EACH: EVERY ONE IS PERIODIC (RUNTIME
+    // UNDER 1/4 OF THE PERIOD), TOGETHER THEY ASK FOR 135% OF CPU 0
+    let running = std::sync::Arc::new(std::sync::atomic::AtomicBool::new(true));
+    let mut periodic = Vec::new();
+    for _ in 0..6 {
+        let flag = running.clone();
+        periodic.push(thread::spawn(move || {
+            pin_to_cpu0();
+            let period = Duration::from_millis(4);
+            let mut next = Instant::now();
+            while flag.load(std::sync::atomic::Ordering::Relaxed) {
+                let t0 = Instant::now();
+                while t0.elapsed() < Duration::from_micros(900) {
+                    std::hint::spin_loop();
+                }
+                next += period;
+                let now = Instant::now();
+                if next > now {
+                    thread::sleep(next - now);
+                } else {
+                    next = now;
+                }
+            }
+        }));
+    }
+
+    // ONE ORDINARY CPU-BOUND TASK ON THE SAME CPU
+    let flag = running.clone();
+    let normal = thread::spawn(move || {
+        pin_to_cpu0();
+        let mut mark = None;
+        let start = Instant::now();
+        while flag.load(std::sync::atomic::Ordering::Relaxed) {
+            // WARMUP: LET THE PERIOD EWMAs MATURE BEFORE MEASURING
+            if mark.is_none() && start.elapsed() >= Duration::from_secs(3) {
+                mark = Some((Instant::now(), thread_cpu_ns()));
+            }
+            std::hint::spin_loop();
+        }
+        mark.map(|(t, cpu)| (thread_cpu_ns() - cpu) as f64 / t.elapsed().as_nanos() as f64)
+    });
+
+    thread::sleep(Duration::from_secs(8));
+    running.store(false, std::sync::atomic::Ordering::Relaxed);
+    for t in periodic {
+        t.join().ok();
+    }
+    let share = normal.join().unwrap();
+
+    let output = stop_pandemonium(&mut child);
+    let _ = output;
+
+    let share = share.expect("NORMAL TASK NEVER RAN PAST WARMUP");
+    eprintln!("LAYER 6: PERIODIC FAIRNESS (normal task share={:.1}%)", share * 100.0);
+
+    // WITHOUT A BOUNDED CREDIT THE PERIODIC SET TAKES ALL OF CPU 0
+    assert!(
+        share >= 0.05,
+        "NORMAL TASK STARVED BY PERIODIC TASKS: {:.1}% OF CPU 0 (LIMIT: 5%)",
+        share * 100.0
+    );
+}
+
 // FULL TEST GATE (RUN ALL LAYERS, PRODUCE REPORT)
 
 #[test]
@@ -545,6 +637,31 @@ fn full_gate() {
         }
     }
 
+    // LAYER 6: PERIODIC FAIRNESS
+    if !any_fail {
+        let l6 = std::panic::catch_unwind(|| {
+            layer6_periodic_fairness();
+        });
+        let (l6_pass, l6_detail) = match l6 {
+            Ok(()) => (true, String::new()),
+            Err(e) => {
+                let msg = if let Some(s) = e.downcast_ref::<String>() {
+                    s.clone()
+                } else {
+                    "UNKNOWN ERROR".to_string()
+                };
+                let short = if msg.len() > 100 { &msg[..100] } else { &msg };
+                (false, short.to_string())
+            }
+        };
+        let status = if l6_pass { "PASS" } else { "FAIL" };
+        eprintln!("LAYER 6: PERIODIC FAIRNESS ... {}", status);
+        results.push(("LAYER 6: PERIODIC FAIRNESS".to_string(), Some(l6_pass), l6_detail));
+        if !l6_pass {
+            any_fail = true;
+        }
+    }
+
     let verdict = if any_fail { "FAIL" } else { "PASS" };
     eprintln!("{}", "=".repeat(60));
     eprintln!("VERDICT: {}", verdict);
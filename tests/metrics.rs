@@ -0,0 +1,145 @@
+// PANDEMONIUM LIVE METRICS TESTS
+// OPENMETRICS RENDERING, STATS LAYOUT, SNAPSHOT HANDOFF AND HTTP SERVING
+
+use std::io::{Read, Write};
+use std::net::TcpStream;
+
+use pandemonium::metrics::{
+    prog_run_stats, read_callback_stats, render, CallbackStats, MetricsHandle, MetricsSnapshot,
+    CALLBACK_NAMES, KNOB_NAMES, N_CALLBACKS, N_STATS, STAT_NAMES,
+};
+
+fn snapshot() -> MetricsSnapshot {
+    let mut s = MetricsSnapshot {
+        reports: 7,
+        regime: "MIXED",
+        burst: true,
+        stability: 4,
+        procdb_profiles: 42,
+        procdb_confident: 5,
+        ..Default::default()
+    };
+    s.stats[0] = 251_000; // nr_dispatches
+    s.stats[28] = 3_000_000; // batch_sojourn_ns
+    s.tier_pct_ns[1] = [4_000, 9_000, 22_000, 310_000];
+    s.all_pct_ns = [3_000, 8_000, 20_000, 300_000];
+    s.knobs[0] = 1_000_000; // slice_ns
+    s
+}
+
+fn callbacks() -> CallbackStats {
+    let mut cb = CallbackStats::default();
+    cb.run_ns[2] = 4_500_000; // dispatch
+    cb.run_cnt[2] = 30_000;
+    cb
+}
+
+fn get(addr: std::net::SocketAddr, path: &str) -> String {
+    let mut c = TcpStream::connect(addr).unwrap();
+    write!(c, "GET {} HTTP/1.1\r\nHost: x\r\n\r\n", path).unwrap();
+    let mut resp = String::new();
+    c.read_to_string(&mut resp).unwrap();
+    resp
+}
+
+#[test]
+fn names_match_abi_layout() {
+    // PandemoniumStats IS 368 BYTES OF u64, TuningKnobs 88
+    assert_eq!(N_STATS * 8, 368);
+    assert_eq!(KNOB_NAMES.len() * 8, 88);
+    assert_eq!(STAT_NAMES[0], "nr_dispatches");
+    assert_eq!(STAT_NAMES[N_STATS - 1], "nr_idle_warm");
+    let mut sorted = STAT_NAMES.to_vec();
+    sorted.sort();
+    sorted.dedup();
+    assert_eq!(sorted.len(), N_STATS);
+}
+
+#[test]
+fn render_exposition() {
+    let mut out = String::from("stale");
+    render(&snapshot(), &callbacks(), &mut out);
+    assert!(!out.contains("stale"));
+    assert!(out.ends_with("# EOF\n"));
+    assert!(out.contains("# TYPE pandemonium_nr_dispatches counter\n"));
+    assert!(out.contains("pandemonium_nr_dispatches_total 251000\n"));
+    // LEVELS ARE GAUGES WITHOUT _total
+    assert!(out.contains("# TYPE pandemonium_batch_sojourn_ns gauge\n"));
+    assert!(out.contains("pandemonium_batch_sojourn_ns 3000000\n"));
+    // MAX-AGGREGATED LEVELS DO NOT CLAIM TO BE SUMS
+    assert!(out.contains(
+        "# HELP pandemonium_wake_lat_max Largest wakeup-to-run latency in ns (max over CPUs)\n"
+    ));
+    assert!(out.contains(
+        "# HELP pandemonium_nr_dispatches BPF stats_map counter (summed over CPUs)\n"
+    ));
+    assert!(out.contains(
+        "pandemonium_wake_latency_ns{tier=\"interactive\",quantile=\"0.99\"} 22000\n"
+    ));
+    assert!(out.contains("pandemonium_wake_latency_ns{tier=\"all\",quantile=\"0.999\"} 300000\n"));
+    assert!(out.contains("pandemonium_regime{pandemonium_regime=\"MIXED\"} 1\n"));
+    assert!(out.contains("pandemonium_regime{pandemonium_regime=\"HEAVY\"} 0\n"));
+    assert!(out.contains("pandemonium_adaptive 1\n"));
+    assert!(out.contains("pandemonium_burst 1\n"));
+    assert!(out.contains("pandemonium_knob{knob=\"slice_ns\"} 1000000\n"));
+    assert!(out.contains("pandemonium_procdb_confident 5\n"));
+    assert!(out.contains("# TYPE pandemonium_bpf_run_time_ns counter\n"));
+    assert!(out.contains("pandemonium_bpf_run_time_ns_total{callback=\"dispatch\"} 4500000\n"));
+    assert!(out.contains("pandemonium_bpf_run_total{callback=\"dispatch\"} 30000\n"));
+    for name in CALLBACK_NAMES {
+        assert!(out.contains(&format!("pandemonium_bpf_run_total{{callback=\"{}\"}} ", name)));
+    }
+    // EVERY COUNTER IS EXPOSED
+    for name in STAT_NAMES {
+        assert!(out.contains(&format!("# TYPE pandemonium_{} ", name)), "{}", name);
+    }
+}
+
+#[test]
+fn render_bpf_only_has_no_regime() {
+    let mut out = String::new();
+    render(&MetricsSnapshot::default(), &CallbackStats::default(), &mut out);
+    assert!(out.contains("pandemonium_adaptive 0\n"));
+    assert!(!out.contains("pandemonium_regime{pandemonium_regime=\"LIGHT\"} 1"));
+    assert!(!out.contains("pandemonium_regime{pandemonium_regime=\"MIXED\"} 1"));
+    assert!(!out.contains("pandemonium_regime{pandemonium_regime=\"HEAVY\"} 1"));
+}
+
+#[test]
+fn parses_prog_fdinfo_run_stats() {
+    // /proc/PID/fdinfo OF A BPF PROGRAM FD WITH kernel.bpf_stats_enabled=1
+    let fdinfo = "pos:\t0\nflags:\t02000002\nmnt_id:\t15\nino:\t2061\n\
+                  prog_type:\t27\nprog_jited:\t1\nprog_tag:\t5e0f84d3bb4e0a4f\n\
+                  memlock:\t8192\nprog_id:\t412\nrun_time_ns:\t81234567\n\
+                  run_cnt:\t275000\nrecursion_misses:\t0\nverified_insns:\t3120\n";
+    assert_eq!(prog_run_stats(fdinfo), (81_234_567, 275_000));
+    // STATS OFF: THE KERNEL STILL PRINTS BOTH, AS 0; OLD KERNELS OMIT THEM
+    assert_eq!(prog_run_stats("prog_id:\t412\nrun_time_ns:\t0\nrun_cnt:\t0\n"), (0, 0));
+    assert_eq!(prog_run_stats("prog_id:\t412\n"), (0, 0));
+    // UNWATCHED SLOTS AND NON-PROGRAM FDS READ AS ZERO, NOT AS AN ERROR
+    assert_eq!(read_callback_stats(&[-1; N_CALLBACKS]), CallbackStats::default());
+    assert_eq!(read_callback_stats(&[0; N_CALLBACKS]), CallbackStats::default());
+}
+
+#[test]
+fn serves_published_snapshot() {
+    let m = MetricsHandle::spawn("127.0.0.1:0").unwrap();
+    assert!(get(m.local_addr(), "/metrics").contains("pandemonium_reports_total 0\n"));
+
+    assert!(m.publish(&snapshot()));
+    let resp = get(m.local_addr(), "/metrics?x=1");
+    assert!(resp.starts_with("HTTP/1.1 200 OK\r\n"));
+    assert!(resp.contains("Content-Type: application/openmetrics-text"));
+    assert!(resp.contains("pandemonium_reports_total 7\n"));
+    assert!(resp.ends_with("# EOF\n"));
+    assert_eq!(m.skipped(), 0);
+    // NO SCHEDULER LOADED: RUN STATS ARE READ PER SCRAPE AND COME BACK 0
+    assert!(resp.contains("pandemonium_bpf_run_total{callback=\"tick\"} 0\n"));
+    m.watch_callbacks(&[0; N_CALLBACKS]);
+    assert!(get(m.local_addr(), "/metrics").contains("callback=\"dispatch\"} 0\n"));
+    m.unwatch_callbacks();
+
+    assert!(get(m.local_addr(), "/").starts_with("HTTP/1.1 404"));
+    // A TAKEN PORT IS AN ERROR, NOT A SILENT NO-OP
+    assert!(MetricsHandle::spawn(&m.local_addr().to_string()).is_err());
+}
@@ -8,6 +8,7 @@ Usage:
     ./tests/pandemonium-tests.py bench-scale
     ./tests/pandemonium-tests.py bench-scale --iterations 3
     ./tests/pandemonium-tests.py bench-scale --schedulers scx_rusty,scx_bpfland
+    ./tests/pandemonium-tests.py bench-scale --burst --dispatch-batch
 """
 
 import argparse
@@ -17,9 +18,11 @@ import traceback
 import re
 import signal
 import shutil
+import struct
 import subprocess
 import sys
 import time
+import urllib.request
 from datetime import datetime
 from pathlib import Path
 
@@ -34,7 +37,6 @@ from pandemonium_common import (
     set_cpu_online, restrict_cpus, restore_all_cpus, CpuGuard,
     get_possible_cpus, get_online_cpus, compute_core_counts,
     mean_stdev, percentile,
-    find_trace_pipe,
 )
 
 
@@ -128,145 +130,89 @@ class DmesgMonitor:
 
 
 # TRACE CAPTURE
+# THE SCHEDULER WRITES SAMPLED BINARY RECORDS ITSELF (--trace-out). THESE
+# HELPERS BUILD ITS FLAGS AND DECODE THE FILE (LAYOUT: src/trace.rs).
+
+TRACE_MAGIC = b"PTRC"
+TRACE_VERSION = 1
+TRACE_HEADER = struct.Struct("=4sIII")
+TRACE_RECORD = struct.Struct("=QQQIiBBB5x")
+TRACE_PATHS = {1: "select_cpu", 2: "enq tier1", 3: "enq tier2",
+               4: "enq tier3", 5: "running"}
+TRACE_TIERS = {0: "BATCH", 1: "INTERACTIVE", 2: "LAT_CRITICAL"}
+
+
+def trace_args(path: Path, comm: str | None = "pand",
+               sample: int = 1) -> list[str]:
+    """Scheduler flags tracing tasks whose comm starts with `comm` into
+    `path`. The default traces the scheduler's own process."""
+    args = ["--trace-out", str(path), "--trace-sample", str(sample)]
+    if comm:
+        args += ["--trace-comm", comm]
+    return args
+
+
+def read_trace(path: Path) -> list[dict]:
+    """Decode a --trace-out file. Missing or foreign files read as empty."""
+    try:
+        data = path.read_bytes()
+    except OSError:
+        return []
+    if len(data) < TRACE_HEADER.size:
+        return []
+    magic, version, rec_size, _ = TRACE_HEADER.unpack_from(data)
+    if (magic != TRACE_MAGIC or version != TRACE_VERSION
+            or rec_size != TRACE_RECORD.size):
+        log_warn(f"{path}: not a v{TRACE_VERSION} PANDEMONIUM trace")
+        return []
+    records = []
+    # A TORN TAIL RECORD FROM A CRASHED RUN IS IGNORED
+    end = len(data) - (len(data) - TRACE_HEADER.size) % rec_size
+    for off in range(TRACE_HEADER.size, end, rec_size):
+        ts, lat, dsq, pid, cpu, kind, tier, wake_path = \
+            TRACE_RECORD.unpack_from(data, off)
+        records.append({
+            "ts_s": ts / 1e9,
+            "lat_us": lat / 1000,
+            "dsq": dsq,
+            "pid": pid,
+            "cpu": cpu,
+            "type": TRACE_PATHS.get(kind, f"path{kind}"),
+            "tier": TRACE_TIERS.get(tier, "-"),
+            "wake_path": wake_path,
+        })
+    return records
+
+
+def trace_record_count(path: Path) -> int:
+    """Records in a live trace file, from its size (no decode)."""
+    try:
+        size = path.stat().st_size
+    except OSError:
+        return 0
+    return max(0, size - TRACE_HEADER.size) // TRACE_RECORD.size
 
-class TraceCapture:
-    """Background thread reading trace_pipe, filtering for PAND: lines."""
-
-    def __init__(self, path: Path):
-        self.path = path
-        self.proc = None
-        self.outfile = None
-        self.count = 0
-        self.error = None
-
-    def start(self) -> bool:
-        pipe = find_trace_pipe()
-        if not pipe.exists():
-            log_info("tracefs not found, attempting mounts...")
-            subprocess.run(
-                ["mount", "-t", "tracefs", "none", "/sys/kernel/tracing"],
-                capture_output=True, text=True,
-            )
-            subprocess.run(
-                ["mount", "-t", "debugfs", "none", "/sys/kernel/debug"],
-                capture_output=True, text=True,
-            )
-            pipe = find_trace_pipe()
-            if not pipe.exists():
-                self.error = "trace_pipe not found at any known path"
-                log_error(self.error)
-                return False
-            log_info(f"Found trace_pipe at {pipe}")
-
-        try:
-            fd = os.open(str(pipe), os.O_RDONLY | os.O_NONBLOCK)
-            os.close(fd)
-        except OSError as e:
-            self.error = f"trace_pipe not readable: {e}"
-            log_error(self.error)
-            return False
-
-        tracedir = pipe.parent
-
-        tracing_on = tracedir / "tracing_on"
-        try:
-            val = tracing_on.read_text().strip()
-            if val != "1":
-                tracing_on.write_text("1")
-                log_info("tracing_on set to 1")
-        except (PermissionError, OSError) as e:
-            log_warn(f"could not enable tracing_on: {e}")
-
-        buf_size = tracedir / "buffer_size_kb"
-        try:
-            buf_size.write_text("16384")
-        except (PermissionError, OSError) as e:
-            log_warn(f"could not set buffer_size_kb: {e}")
-
-        trace_file = tracedir / "trace"
-        try:
-            trace_file.write_text("")
-        except (PermissionError, OSError):
-            pass
-
-        self.path.parent.mkdir(parents=True, exist_ok=True)
-        self.outfile = open(self.path, "w")
-        self.proc = subprocess.Popen(
-            ["cat", str(pipe)],
-            stdout=subprocess.PIPE,
-            stderr=subprocess.PIPE,
-            text=True,
-        )
-        self._thread = threading.Thread(target=self._reader, daemon=True)
-        self._thread.start()
-        time.sleep(0.3)
-        if self.proc.poll() is not None:
-            err = self.proc.stderr.read()
-            self.error = f"trace_pipe reader exited immediately: {err.strip()}"
-            log_error(self.error)
-            return False
-        log_info(f"Trace capture started -> {self.path}")
-        return True
-
-    def _reader(self):
-        try:
-            for line in self.proc.stdout:
-                if "PAND:" in line:
-                    self.outfile.write(line)
-                    self.outfile.flush()
-                    self.count += 1
-        except (ValueError, OSError):
-            pass
-
-    def stop(self):
-        if self.proc:
-            self.proc.kill()
-            self.proc.wait()
-        if self.outfile:
-            self.outfile.close()
-        log_info(f"Trace capture stopped: {self.count} PAND events")
-
-
-# BUILD HELPERS
-
-BPF_SRC = SCRIPT_DIR / "src" / "bpf" / "main.bpf.c"
-
-
-def patch_bpf_trace_filter(target: str) -> str | None:
-    """Patch is_sched_task() in main.bpf.c to trace `target` instead of 'pand'.
-    Returns the original content for restoration, or None on error."""
-    original = BPF_SRC.read_text()
-
-    # Match the exact two-line return statement in is_sched_task():
-    #   \treturn p->comm[0] == 'p' && p->comm[1] == 'a' &&
-    #   \t       p->comm[2] == 'n' && p->comm[3] == 'd';
-    old_body = ("\treturn p->comm[0] == 'p' && p->comm[1] == 'a' &&\n"
-                "\t       p->comm[2] == 'n' && p->comm[3] == 'd';")
-
-    if old_body not in original:
-        log_error("Could not find is_sched_task() trace filter in main.bpf.c")
-        return None
 
-    checks = [f"p->comm[{i}] == '{c}'" for i, c in enumerate(target)]
-    if len(checks) <= 2:
-        new_body = "\treturn " + " && ".join(checks) + ";"
+def format_trace_record(r: dict) -> str:
+    line = f"{r['ts_s']:.6f} {r['type']} pid={r['pid']} cpu={r['cpu']}"
+    if r["type"] == "running":
+        line += f" lat={r['lat_us']:.0f}us path={r['wake_path']}"
     else:
-        line1 = checks[:2]
-        line2 = checks[2:]
-        new_body = ("\treturn " + " && ".join(line1) + " &&\n"
-                    "\t       " + " && ".join(line2) + ";")
+        line += f" dsq={r['dsq']}"
+    return f"{line} tier={r['tier']}"
 
-    patched = original.replace(old_body, new_body, 1)
-    BPF_SRC.write_text(patched)
-    log_info(f"Patched trace filter: 'pand' -> '{target}'")
-    return original
 
+def log_trace_tail(path: Path, n: int = 20):
+    records = read_trace(path)
+    log_info(f"Trace: {len(records)} records in {path}")
+    if records:
+        tail = records[-n:]
+        log_info(f"Last {len(tail)} trace events:")
+        for r in tail:
+            log_info(f"  {format_trace_record(r)}")
 
-def restore_bpf_source(original: str):
-    """Restore main.bpf.c to its original content."""
-    BPF_SRC.write_text(original)
-    log_info("Restored main.bpf.c")
 
+# BUILD HELPERS
 
 def fix_ownership():
     uid = os.environ.get("SUDO_UID", str(os.getuid()))
@@ -1409,11 +1355,39 @@ def parse_tick_lines(stdout_text: str) -> list[dict]:
         m = re.search(r"lat_kick:\s*(\d+)us", line)
         if m:
             tick["lat_kick_us"] = int(m.group(1))
+        m = re.search(r"fill:\s*(\d+)", line)
+        if m:
+            tick["dispatch_fill"] = int(m.group(1))
+        m = re.search(r"reclass:\s*(\d+)%", line)
+        if m:
+            tick["reclass_pct"] = int(m.group(1))
+        m = re.search(r"pair:\s*A=(\d+)\s*S=(\d+)", line)
+        if m:
+            tick["pair_affine"] = int(m.group(1))
+            tick["pair_sync"] = int(m.group(2))
+        m = re.search(r"cst:\s*S=(\d+)\s*W=(\d+)", line)
+        if m:
+            tick["cst_shallow"] = int(m.group(1))
+            tick["cst_warm"] = int(m.group(2))
+        m = re.search(r"xnode:\s*N=(\d+)\s*M=(\d+)\s*F=(\d+)\s*G=(\d+)", line)
+        if m:
+            tick["xnode_near"] = int(m.group(1))
+            tick["xnode_mid"] = int(m.group(2))
+            tick["xnode_far"] = int(m.group(3))
+            tick["xnode_gated"] = int(m.group(4))
+        m = re.search(r"evt:\s*(\d+)\s*D=(\d+)", line)
+        if m:
+            tick["events"] = int(m.group(1))
+            tick["events_dropped"] = int(m.group(2))
         m = re.search(r"l2:\s*B=(\d+)%\s*I=(\d+)%\s*L=(\d+)%", line)
         if m:
             tick["l2_pct_batch"] = int(m.group(1))
             tick["l2_pct_interactive"] = int(m.group(2))
             tick["l2_pct_latcrit"] = int(m.group(3))
+        m = re.search(r"smt:\s*C=(\d+)%\s*P=(\d+)%", line)
+        if m:
+            tick["smt_pct_core"] = int(m.group(1))
+            tick["smt_pct_pack"] = int(m.group(2))
 
         # REGIME + FLAGS: [BPF], [BPF BURST], [BPF LONGRUN],
         # [BPF BURST LONGRUN], [MIXED], [MIXED BURST], [HEAVY LONGRUN], etc.
@@ -1425,6 +1399,13 @@ def parse_tick_lines(stdout_text: str) -> list[dict]:
             tick["burst_active"] = "BURST" in flags
             tick["longrun_active"] = "LONGRUN" in flags
 
+            m = re.search(r"p50:\s*(\d+)us\s+p90:\s*(\d+)us\s+p99:\s*(\d+)us\s+p999:\s*(\d+)us", line)
+            if m:
+                tick["p50_us"] = int(m.group(1))
+                tick["p90_us"] = int(m.group(2))
+                tick["p99_us"] = int(m.group(3))
+                tick["p999_us"] = int(m.group(4))
+
             if tick["regime"] == "BPF":
                 m = re.search(r"procdb:\s*(\d+)\s", line)
                 if m:
@@ -1785,7 +1766,18 @@ def write_prometheus(data: dict, stamp: str) -> Path:
             if not knobs and not tick_agg:
                 continue
 
-            mode = "BPF" if "BPF" in sched_name else "ADAPTIVE"
+            if "BPF" in sched_name:
+                mode = "BPF"
+            elif "BATCH" in sched_name:
+                mode = "BATCHED"
+            elif "RECLASS" in sched_name:
+                mode = "AMORTIZED"
+            elif "PERIODIC" in sched_name:
+                mode = "PERIODIC"
+            elif "PAIR" in sched_name:
+                mode = "PAIR"
+            else:
+                mode = "ADAPTIVE"
             telem_labels = {"mode": mode, "cores": cores}
 
             if knobs:
@@ -1831,7 +1823,10 @@ def write_prometheus(data: dict, stamp: str) -> Path:
 
             if tick_agg:
                 for field in ["idle_pct", "preempt",
-                              "wake_avg_us", "p99_us"]:
+                              "wake_avg_us", "p99_us",
+                              "dispatches", "dispatch_fill",
+                              "reclass_pct", "pair_affine", "pair_sync",
+                              "cst_shallow", "cst_warm"]:
                     if field in tick_agg:
                         stats = tick_agg[field]
                         gauge(f"pandemonium_bench_{field}_mean",
@@ -1873,6 +1868,12 @@ _SYS_TICK_FIELDS = [
     ("procdb_total", "pandemonium_bench_procdb_total"),
     ("procdb_confident", "pandemonium_bench_procdb_confident"),
     ("procdb_hits", "pandemonium_bench_procdb_total"),
+    ("dispatch_fill", "pandemonium_bench_dispatch_fill"),
+    ("reclass_pct", "pandemonium_bench_reclass_pct"),
+    ("pair_affine", "pandemonium_bench_pair_affine"),
+    ("pair_sync", "pandemonium_bench_pair_sync"),
+    ("cst_shallow", "pandemonium_bench_cst_shallow"),
+    ("cst_warm", "pandemonium_bench_cst_warm"),
 ]
 
 _SYS_TICK_TIERED = [
@@ -2302,6 +2303,66 @@ def format_report(data: dict) -> str:
 
             lines.append("")
 
+        # Dispatch ladder: TASKS MOVED PER dispatch() LADDER WALK
+        # (d/s / (d/s - fill)). 1.00 = ONE WALK PER TASK, BATCHING OFF.
+        # READ NEXT TO BURST P99: A HIGHER RATIO MUST NOT COST LATENCY.
+        has_any_fill = any(
+            results.get(c, {}).get(s, {}).get("telemetry", {})
+            .get("tick_aggregate", {}).get("dispatch_fill", {})
+            .get("mean", 0) > 0
+            for c in sorted_cores for s in all_schedulers)
+        if has_any_fill:
+            lines.append("DISPATCH TASKS PER LADDER WALK (mean d/s)")
+            header = f"{'SCHEDULER':<28}"
+            for c in sorted_cores:
+                header += f" {c + 'C':>14}"
+            lines.append(header)
+
+            for sched in all_schedulers:
+                if "PANDEMONIUM" not in sched:
+                    continue
+                row = f"{sched:<28}"
+                for c in sorted_cores:
+                    agg = (results.get(c, {}).get(sched, {})
+                           .get("telemetry", {}).get("tick_aggregate", {}))
+                    d = agg.get("dispatches", {}).get("mean", 0)
+                    fill = agg.get("dispatch_fill", {}).get("mean", 0)
+                    if d > 0 and d > fill:
+                        cell = f"{d / (d - fill):.2f} ({d:.0f})"
+                        row += f" {cell:>14}"
+                    else:
+                        row += f" {'--':>14}"
+                lines.append(row)
+
+            lines.append("")
+
+        # Reclassification rate: % OF WAKEUPS THAT RAN THE FULL CLASSIFIER.
+        # 100 = EVERY WAKEUP (DEFAULT). ONLY SHOWN WHEN AMORTIZATION SKIPPED SOME.
+        has_any_reclass = any(
+            results.get(c, {}).get(s, {}).get("telemetry", {})
+            .get("tick_aggregate", {}).get("reclass_pct", {})
+            .get("mean", 100) < 100
+            for c in sorted_cores for s in all_schedulers)
+        if has_any_reclass:
+            lines.append("FULL RECLASSIFICATIONS PER WAKEUP (mean %)")
+            header = f"{'SCHEDULER':<28}"
+            for c in sorted_cores:
+                header += f" {c + 'C':>8}"
+            lines.append(header)
+
+            for sched in all_schedulers:
+                if "PANDEMONIUM" not in sched:
+                    continue
+                row = f"{sched:<28}"
+                for c in sorted_cores:
+                    pct = (results.get(c, {}).get(sched, {})
+                           .get("telemetry", {}).get("tick_aggregate", {})
+                           .get("reclass_pct", {}).get("mean"))
+                    row += f" {pct:>8.0f}" if pct is not None else f" {'--':>8}"
+                lines.append(row)
+
+            lines.append("")
+
         # Long-run summary matrix
         has_any_longrun = any(
             results.get(c, {}).get(s, {}).get("longrun", {})
@@ -2478,6 +2539,22 @@ def format_report(data: dict) -> str:
                         row += f" {'--':>8}"
                 lines.append(row)
 
+            # --periodic-deadline A/B: THE SAME ADAPTIVE RUN WITH IT OFF AND ON
+            off_name = "PANDEMONIUM (ADAPTIVE)"
+            on_name = "PANDEMONIUM (ADAPTIVE+PERIODIC)"
+            if on_name in all_schedulers and off_name in all_schedulers:
+                lines.append("")
+                lines.append("PERIODIC DEADLINE A/B (MISS RATIO OFF -> ON)")
+                for c in sorted_cores:
+                    off = results.get(c, {}).get(off_name, {}).get("deadline", {})
+                    on = results.get(c, {}).get(on_name, {}).get("deadline", {})
+                    if not off.get("total_frames") or not on.get("total_frames"):
+                        continue
+                    r_off = off.get("miss_ratio", 0.0)
+                    r_on = on.get("miss_ratio", 0.0)
+                    lines.append(f"  {c + 'C':>4}: {r_off:.1%} -> {r_on:.1%} "
+                                 f"({(r_on - r_off) * 100:+.1f} pts)")
+
             lines.append("")
 
         # IPC round-trip summary matrix
@@ -2505,6 +2582,45 @@ def format_report(data: dict) -> str:
                         row += f" {'--':>8}"
                 lines.append(row)
 
+            # --pair-affinity A/B: THE SAME ADAPTIVE RUN WITH IT OFF AND ON,
+            # WITH THE PAIR PLACEMENTS PER SECOND THAT EXPLAIN THE DIFFERENCE
+            off_name = "PANDEMONIUM (ADAPTIVE)"
+            on_name = "PANDEMONIUM (ADAPTIVE+PAIR)"
+            if on_name in all_schedulers and off_name in all_schedulers:
+                lines.append("")
+                lines.append("PAIR AFFINITY A/B (IPC RTT P99 OFF -> ON, us)")
+                for c in sorted_cores:
+                    off = results.get(c, {}).get(off_name, {})
+                    on = results.get(c, {}).get(on_name, {})
+                    p_off = off.get("ipc", {}).get("rtt_p99_us")
+                    p_on = on.get("ipc", {}).get("rtt_p99_us")
+                    if p_off is None or p_on is None:
+                        continue
+                    agg = on.get("telemetry", {}).get("tick_aggregate", {})
+                    affine = agg.get("pair_affine", {}).get("mean", 0)
+                    sync = agg.get("pair_sync", {}).get("mean", 0)
+                    lines.append(f"  {c + 'C':>4}: {p_off} -> {p_on} "
+                                 f"(pair/s: idle={affine:.0f} sync={sync:.0f})")
+
+            # --idle-aware A/B: WAKEUP LATENCY P99 WITH IT OFF AND ON, WITH
+            # THE SHALLOW/WARM PLACEMENTS PER SECOND BEHIND THE DIFFERENCE
+            on_name = "PANDEMONIUM (ADAPTIVE+IDLE)"
+            if on_name in all_schedulers and off_name in all_schedulers:
+                lines.append("")
+                lines.append("IDLE-AWARE A/B (LATENCY P99 OFF -> ON, us)")
+                for c in sorted_cores:
+                    off = results.get(c, {}).get(off_name, {})
+                    on = results.get(c, {}).get(on_name, {})
+                    p_off = off.get("latency", {}).get("p99_us")
+                    p_on = on.get("latency", {}).get("p99_us")
+                    if p_off is None or p_on is None:
+                        continue
+                    agg = on.get("telemetry", {}).get("tick_aggregate", {})
+                    shallow = agg.get("cst_shallow", {}).get("mean", 0)
+                    warm = agg.get("cst_warm", {}).get("mean", 0)
+                    lines.append(f"  {c + 'C':>4}: {p_off} -> {p_on} "
+                                 f"(cst/s: shallow={shallow:.0f} warm={warm:.0f})")
+
             lines.append("")
 
         # App launch summary matrix
@@ -3193,16 +3309,11 @@ def cmd_bench_scale(args) -> int:
 
     dmesg = DmesgMonitor()
 
-    # Trace capture (optional)
-    trace = None
+    # Trace capture (optional): EVERY PANDEMONIUM RUN APPENDS TO ONE FILE
     trace_path = None
     if getattr(args, "trace", False):
         stamp_early = datetime.now().strftime("%Y%m%d-%H%M%S")
-        trace_path = LOG_DIR / f"trace-{stamp_early}.log"
-        trace = TraceCapture(trace_path)
-        if not trace.start():
-            log_warn("trace capture unavailable, continuing without")
-            trace = None
+        trace_path = LOG_DIR / f"trace-{stamp_early}.bin"
 
     nuke_stale_build()
 
@@ -3242,6 +3353,31 @@ def cmd_bench_scale(args) -> int:
         ("PANDEMONIUM (BPF)", [str(BINARY), "--verbose", "--no-adaptive"]),
         ("PANDEMONIUM (ADAPTIVE)", [str(BINARY), "--verbose"]),
     ]
+    if args.dispatch_batch:
+        # A/B: SAME ADAPTIVE RUN WITH BATCHED OVERFLOW PULLS IN dispatch()
+        base_entries.append(("PANDEMONIUM (ADAPTIVE+BATCH)",
+                             [str(BINARY), "--verbose", "--dispatch-batch"]))
+    if args.reclass_interval:
+        # A/B: SAME ADAPTIVE RUN WITH AMORTIZED RECLASSIFICATION IN runnable()
+        base_entries.append(("PANDEMONIUM (ADAPTIVE+RECLASS)",
+                             [str(BINARY), "--verbose", "--reclass-interval",
+                              str(args.reclass_interval)]))
+    if args.periodic_deadline:
+        # A/B: SAME ADAPTIVE RUN WITH PERIOD-DERIVED DEADLINES FOR PERIODIC TASKS
+        base_entries.append(("PANDEMONIUM (ADAPTIVE+PERIODIC)",
+                             [str(BINARY), "--verbose", "--periodic-deadline"]))
+    if args.pair_affinity:
+        # A/B: SAME ADAPTIVE RUN WITH WAKER/WAKEE PAIR PLACEMENT IN select_cpu()
+        base_entries.append(("PANDEMONIUM (ADAPTIVE+PAIR)",
+                             [str(BINARY), "--verbose", "--pair-affinity"]))
+    if args.idle_aware:
+        # A/B: SAME ADAPTIVE RUN WITH C-STATE/FREQUENCY AWARE IDLE PICKS
+        base_entries.append(("PANDEMONIUM (ADAPTIVE+IDLE)",
+                             [str(BINARY), "--verbose", "--idle-aware"]))
+
+    if trace_path is not None:
+        base_entries = [(n, cmd + trace_args(trace_path) if cmd else cmd)
+                        for n, cmd in base_entries]
 
     for name in args.schedulers:
         path = find_scheduler(name)
@@ -3510,17 +3646,9 @@ def cmd_bench_scale(args) -> int:
     # Dmesg
     dmesg.save(stamp)
 
-    # Trace teardown
-    if trace is not None:
-        trace.stop()
-        log_info(f"Trace log: {trace_path}")
-        if trace_path and trace_path.exists():
-            lines = trace_path.read_text().splitlines()
-            if lines:
-                tail = lines[-20:]
-                log_info(f"Last {len(tail)} trace events:")
-                for line in tail:
-                    log_info(f"  {line.rstrip()}")
+    # Trace summary
+    if trace_path is not None:
+        log_trace_tail(trace_path)
 
     # Restart PANDEMONIUM service if it was running
     ret = subprocess.run(["systemctl", "is-enabled", "pandemonium"],
@@ -4045,7 +4173,7 @@ def _trace_phase_launch(nr_cpus, dmesg, sched_alive_fn, count=100):
 
 # BENCH-TRACE COMMAND
 
-def _trace_start_scheduler(nr_cpus=None):
+def _trace_start_scheduler(nr_cpus=None, extra_args=None):
     """Start PANDEMONIUM with stale detection and settle verification."""
     try:
         stale = SCX_OPS.read_text().strip()
@@ -4061,6 +4189,8 @@ def _trace_start_scheduler(nr_cpus=None):
     cmd = ["sudo", str(BINARY), "--verbose"]
     if nr_cpus is not None:
         cmd.extend(["--nr-cpus", str(nr_cpus)])
+    if extra_args:
+        cmd.extend(extra_args)
     log_info(f"Starting: {' '.join(cmd)}")
     proc = subprocess.Popen(
         cmd,
@@ -4122,14 +4252,15 @@ def _trace_stop_scheduler(proc):
     measure_struct_ops_cleanup()
 
 
-def _trace_run_iteration(iteration, total, nr_cpus):
+def _trace_run_iteration(iteration, total, nr_cpus, trace_path=None):
     """Run one full workload iteration. Returns True if scheduler survived."""
     dmesg = DmesgMonitor()
 
     label = f"[{iteration}/{total}] " if total > 1 else ""
     log_info(f"{label}Starting scheduler")
 
-    sched_proc = _trace_start_scheduler(nr_cpus=nr_cpus)
+    extra = trace_args(trace_path) if trace_path else None
+    sched_proc = _trace_start_scheduler(nr_cpus=nr_cpus, extra_args=extra)
     if sched_proc is None:
         return False
 
@@ -4176,8 +4307,9 @@ def cmd_bench_trace(args) -> int:
     """Crash-detection stress test with trace capture.
 
     Iterates core counts, runs all 7 workload phases per core count,
-    live crash detection via DmesgMonitor between phases, TraceCapture
-    always active. Reports survived/crashed per core count.
+    live crash detection via DmesgMonitor between phases, every scheduler
+    run tracing itself into one binary trace file. Reports survived/crashed
+    per core count.
     """
 
     subprocess.run(["sudo", "true"])
@@ -4201,7 +4333,7 @@ def cmd_bench_trace(args) -> int:
         return 1
 
     stamp = datetime.now().strftime("%Y%m%d-%H%M%S")
-    trace_path = LOG_DIR / f"trace-{stamp}.log"
+    trace_path = LOG_DIR / f"trace-{stamp}.bin"
     LOG_DIR.mkdir(parents=True, exist_ok=True)
 
     ver = get_version()
@@ -4211,14 +4343,9 @@ def cmd_bench_trace(args) -> int:
              f"core_counts={core_counts}, iterations={args.iterations}, "
              f"host_cpus={max_cpus}")
 
-    trace = TraceCapture(trace_path)
     results = {}
 
     try:
-        trace_ok = trace.start()
-        if not trace_ok:
-            log_warn("trace capture unavailable, continuing with dmesg monitoring only")
-
         for nr_cpus in core_counts:
             log_info(f"[{nr_cpus}C] Restricting to {nr_cpus} cores")
             if nr_cpus < max_cpus:
@@ -4235,7 +4362,8 @@ def cmd_bench_trace(args) -> int:
             for i in range(1, args.iterations + 1):
                 if args.iterations > 1:
                     log_info(f"[{nr_cpus}C] ITERATION {i}/{args.iterations}")
-                ok = _trace_run_iteration(i, args.iterations, nr_cpus)
+                ok = _trace_run_iteration(i, args.iterations, nr_cpus,
+                                          trace_path)
                 if ok:
                     survived += 1
                 else:
@@ -4255,7 +4383,6 @@ def cmd_bench_trace(args) -> int:
         log_info("Interrupted")
     finally:
         restore_all_cpus(max_cpus)
-        trace.stop()
 
         total_survived = 0
         total_crashed = 0
@@ -4269,16 +4396,7 @@ def cmd_bench_trace(args) -> int:
                 log_info(f"  {nr_cpus:>3}C: {s}/{s+c} survived  {status}")
             log_info(f"  TOTAL: {total_survived}/{total_survived+total_crashed}")
 
-        log_info(f"Trace events: {trace.count}")
-        log_info(f"Trace log:    {trace_path}")
-
-        if trace_path.exists():
-            lines = trace_path.read_text().splitlines()
-            if lines:
-                tail = lines[-20:]
-                log_info(f"Last {len(tail)} trace events:")
-                for line in tail:
-                    log_info(f"  {line.rstrip()}")
+        log_trace_tail(trace_path)
 
     return 0 if total_crashed == 0 else 1
 
@@ -4644,17 +4762,68 @@ def _contention_phase_mixed_storm(nr_cpus, dmesg, sched_alive_fn, duration=30):
     return result
 
 
+def _contention_phase_pcpu_layout(nr_cpus, dmesg, duration=10):
+    """Packed vs cache-line-padded per-CPU sojourn state: dispatch rate A/B.
+
+    Owns its scheduler lifecycle: restarts PANDEMONIUM once per layout and
+    drives the select_cpu() hot path with ncpu wakeup probes on top of
+    ncpu/2 stress workers. Reports mean d/s for each layout.
+    """
+    log_info(f"PHASE: pcpu-layout (packed vs padded, {duration}s each)")
+    result = {"survived": True}
+
+    for layout, extra in (("packed", None), ("padded", ["--pcpu-padded"])):
+        proc = _trace_start_scheduler(nr_cpus=nr_cpus, extra_args=extra)
+        if proc is None:
+            return {"survived": False}
+
+        stress = _StressWorkers(max(1, nr_cpus // 2))
+        stress.start()
+        probes = [_LatencyProbe(duration) for _ in range(nr_cpus)]
+        for probe in probes:
+            probe.start()
+        for probe in probes:
+            probe.collect()
+        stress.stop()
+
+        alive = proc.poll() is None
+        _trace_stop_scheduler(proc)
+        stdout = proc.stdout.read() if proc.stdout else ""
+        if dmesg.check() or not alive:
+            return {"survived": False}
+
+        # SKIP THE FIRST TICK: IT STRADDLES WORKLOAD STARTUP
+        rates = [t["dispatches"] for t in parse_tick_lines(stdout)[1:]
+                 if "dispatches" in t]
+        rate = sum(rates) / len(rates) if rates else 0
+        result[f"dispatch_rate_{layout}"] = rate
+        log_info(f"  pcpu-layout: {layout} {rate:.0f} d/s ({len(rates)} ticks)")
+
+    packed = result["dispatch_rate_packed"]
+    padded = result["dispatch_rate_padded"]
+    if packed > 0:
+        result["dispatch_rate_delta_pct"] = (padded - packed) * 100.0 / packed
+        log_info(f"  pcpu-layout: padded vs packed "
+                 f"{result['dispatch_rate_delta_pct']:+.1f}%")
+    return result
+
+
 # BENCH-CONTENTION ORCHESTRATOR
 
-def _contention_run_iteration(iteration, total, nr_cpus):
-    """Run one full contention iteration. Returns (survived: bool, phase_results: dict)."""
+def _contention_run_iteration(iteration, total, nr_cpus, flight=None):
+    """Run one full contention iteration. Returns (survived: bool, phase_results: dict).
+
+    With flight set, the scheduler records every control tick there; replay
+    it offline with `pandemonium replay FILE`.
+    """
     dmesg = DmesgMonitor()
     phase_results = {}
 
     label = f"[{iteration}/{total}] " if total > 1 else ""
     log_info(f"{label}Starting scheduler")
 
-    sched_proc = _trace_start_scheduler(nr_cpus=nr_cpus)
+    extra = ["--flight-recorder", str(flight)] if flight else None
+    sched_proc = _trace_start_scheduler(nr_cpus=nr_cpus, extra_args=extra)
     if sched_proc is None:
         return False, phase_results
 
@@ -4688,6 +4857,17 @@ def _contention_run_iteration(iteration, total, nr_cpus):
         log_info(f"{label}ALL PHASES COMPLETE -- scheduler survived")
 
     _trace_stop_scheduler(sched_proc)
+
+    # LAYOUT A/B RESTARTS THE SCHEDULER PER VARIANT, SO IT RUNS LAST
+    if not crashed:
+        result = _contention_phase_pcpu_layout(nr_cpus, dmesg)
+        phase_results["pcpu-layout"] = result
+        if not result.get("survived", False):
+            crashed = True
+            log_error(f"{label}Scheduler died during 'pcpu-layout'")
+        else:
+            log_info(f"  'pcpu-layout' passed, scheduler alive")
+
     dmesg.save()
 
     return not crashed, phase_results
@@ -4771,6 +4951,18 @@ def _write_contention_prometheus(version, git, stamp, max_cpus, iterations,
             if "deadline_miss_ratio" in pd:
                 gauge("pandemonium_contention_phase_deadline_miss_ratio",
                       "Fraction of frames missed", f"{pd['deadline_miss_ratio']:.4f}", pl)
+            if "dispatch_rate_packed" in pd:
+                gauge("pandemonium_contention_phase_dispatch_rate_packed",
+                      "Mean dispatches/s, packed per-CPU state",
+                      f"{pd['dispatch_rate_packed']:.0f}", pl)
+            if "dispatch_rate_padded" in pd:
+                gauge("pandemonium_contention_phase_dispatch_rate_padded",
+                      "Mean dispatches/s, cache-line-padded per-CPU state",
+                      f"{pd['dispatch_rate_padded']:.0f}", pl)
+            if "dispatch_rate_delta_pct" in pd:
+                gauge("pandemonium_contention_phase_dispatch_rate_delta_pct",
+                      "Padded vs packed dispatch rate change (percent)",
+                      f"{pd['dispatch_rate_delta_pct']:.2f}", pl)
 
     ARCHIVE_DIR.mkdir(parents=True, exist_ok=True)
     path = ARCHIVE_DIR / f"contention-{version}-{stamp}.prom"
@@ -4781,9 +4973,10 @@ def _write_contention_prometheus(version, git, stamp, max_cpus, iterations,
 def cmd_bench_contention(args) -> int:
     """Contention stress test targeting v5.4.x adaptive features.
 
-    6 phases per core count: regime-sweep, deficit-storm, sojourn-pressure,
-    longrun-interactive, burst-recovery, mixed-storm. Each phase targets
-    a specific adaptive mechanism.
+    7 phases per core count: regime-sweep, deficit-storm, sojourn-pressure,
+    longrun-interactive, burst-recovery, mixed-storm, pcpu-layout. Each
+    phase targets a specific adaptive mechanism; pcpu-layout A/Bs the
+    packed vs padded per-CPU state layout by dispatch rate.
     """
 
     subprocess.run(["sudo", "true"])
@@ -4845,7 +5038,11 @@ def cmd_bench_contention(args) -> int:
             for i in range(1, args.iterations + 1):
                 if args.iterations > 1:
                     log_info(f"[{nr_cpus}C] ITERATION {i}/{args.iterations}")
-                ok, phase_results = _contention_run_iteration(i, args.iterations, nr_cpus)
+                flight = LOG_DIR / f"bench-contention-{stamp}-{nr_cpus}c-{i}.flight"
+                ok, phase_results = _contention_run_iteration(
+                    i, args.iterations, nr_cpus, flight=flight)
+                if flight.exists():
+                    log_info(f"[{nr_cpus}C] Flight trace: {flight}")
                 if ok:
                     survived += 1
                 else:
@@ -4927,6 +5124,259 @@ def cmd_bench_contention(args) -> int:
     return 0 if total_crashed == 0 else 1
 
 
+# BENCH-OVERHEAD: PER-CALLBACK BPF COST
+
+BPF_STATS_SYSCTL = Path("/proc/sys/kernel/bpf_stats_enabled")
+OVERHEAD_METRICS_ADDR = "127.0.0.1:9469"
+OVERHEAD_CALLBACKS = ["select_cpu", "enqueue", "dispatch", "runnable",
+                      "running", "stopping", "tick"]
+_CALLBACK_RE = re.compile(
+    r'^pandemonium_bpf_(run_time_ns|run)_total\{callback="(\w+)"\} (\d+)$')
+
+
+def _set_bpf_stats(value: str) -> bool:
+    ret = subprocess.run(["sudo", "tee", str(BPF_STATS_SYSCTL)],
+                         input=value, capture_output=True, text=True)
+    return ret.returncode == 0
+
+
+def _scrape_callback_stats(addr: str) -> dict | None:
+    """Cumulative {callback: (run_time_ns, run_cnt)} from --metrics-listen.
+
+    The scheduler republishes once per report period, so a scrape lags
+    the kernel counters by up to 1s at both ends of a phase.
+    """
+    try:
+        with urllib.request.urlopen(f"http://{addr}/metrics", timeout=2) as r:
+            text = r.read().decode()
+    except (OSError, ValueError):
+        return None
+    stats = {cb: [0, 0] for cb in OVERHEAD_CALLBACKS}
+    for line in text.splitlines():
+        m = _CALLBACK_RE.match(line)
+        if m and m.group(2) in stats:
+            stats[m.group(2)][0 if m.group(1) == "run_time_ns" else 1] = int(m.group(3))
+    return {cb: tuple(v) for cb, v in stats.items()}
+
+
+def _callback_deltas(before: dict, after: dict, elapsed: float) -> dict:
+    """Per callback: ns/call, calls/s and raw deltas over one window."""
+    out = {}
+    for cb in OVERHEAD_CALLBACKS:
+        run_ns = after[cb][0] - before[cb][0]
+        run_cnt = after[cb][1] - before[cb][1]
+        out[cb] = {
+            "run_ns": run_ns,
+            "run_cnt": run_cnt,
+            "ns_per_call": run_ns / run_cnt if run_cnt else 0.0,
+            "calls_per_sec": run_cnt / elapsed if elapsed > 0 else 0.0,
+        }
+    return out
+
+
+def _overhead_run(nr_cpus, addr):
+    """Run the bench-trace phases once, sampling BPF run stats around each.
+
+    Returns {phase: {callback: {...}}}, or None if the scheduler died.
+    """
+    dmesg = DmesgMonitor()
+    sched_proc = _trace_start_scheduler(
+        nr_cpus=nr_cpus, extra_args=["--metrics-listen", addr])
+    if sched_proc is None:
+        return None
+
+    def sched_alive():
+        return sched_proc is not None and sched_proc.poll() is None
+
+    # ONE REPORT PERIOD SO THE FIRST SNAPSHOT IS PUBLISHED
+    time.sleep(1.5)
+    stress = _StressWorkers(nr_cpus)
+    stress.start()
+    time.sleep(2)
+
+    phases = [
+        ("latency",  lambda: _trace_phase_latency(nr_cpus, dmesg, sched_alive)),
+        ("burst",    lambda: _trace_phase_burst(nr_cpus, dmesg, sched_alive)),
+        ("longrun",  lambda: _trace_phase_longrun(nr_cpus, dmesg, sched_alive)),
+        ("mixed",    lambda: _trace_phase_mixed(nr_cpus, dmesg, sched_alive)),
+        ("deadline", lambda: _trace_phase_deadline(nr_cpus, dmesg, sched_alive)),
+        ("ipc",      lambda: _trace_phase_ipc(nr_cpus, dmesg, sched_alive)),
+        ("launch",   lambda: _trace_phase_launch(nr_cpus, dmesg, sched_alive)),
+    ]
+
+    results = {}
+    first = _scrape_callback_stats(addr)
+    t_first = time.monotonic()
+    for name, fn in phases:
+        before = _scrape_callback_stats(addr)
+        t0 = time.monotonic()
+        alive = fn()
+        if alive:
+            time.sleep(1.1)
+        after = _scrape_callback_stats(addr)
+        if not alive or before is None or after is None:
+            log_error(f"  '{name}': scheduler died or metrics unreachable")
+            results = None
+            break
+        d = _callback_deltas(before, after, time.monotonic() - t0)
+        results[name] = d
+        log_info("  overhead: " + "  ".join(
+            f"{cb}={d[cb]['ns_per_call']:.0f}ns@{d[cb]['calls_per_sec']:.0f}/s"
+            for cb in OVERHEAD_CALLBACKS))
+
+    if results and first is not None:
+        last = _scrape_callback_stats(addr)
+        if last is not None:
+            results["all"] = _callback_deltas(first, last, time.monotonic() - t_first)
+
+    stress.stop()
+    _trace_stop_scheduler(sched_proc)
+    dmesg.save()
+    return results
+
+
+def _write_overhead_prometheus(version, git, stamp, max_cpus, results):
+    """Write Prometheus exposition format (.prom) for bench-overhead."""
+    lines = []
+    emitted = set()
+
+    def gauge(name, help_text, value, labels=None):
+        if name not in emitted:
+            lines.append(f"# HELP {name} {help_text}")
+            lines.append(f"# TYPE {name} gauge")
+            emitted.add(name)
+        if labels:
+            label_str = ",".join(f'{k}="{v}"' for k, v in labels.items())
+            lines.append(f"{name}{{{label_str}}} {value}")
+        else:
+            lines.append(f"{name} {value}")
+
+    dirty = "true" if git["dirty"] else "false"
+    gauge("pandemonium_overhead_info", "Build and run metadata", 1,
+          {"version": version, "git_commit": git["commit"], "git_dirty": dirty})
+    gauge("pandemonium_overhead_timestamp_seconds", "Test start time",
+          int(datetime.strptime(stamp, "%Y%m%d-%H%M%S").timestamp()))
+    gauge("pandemonium_overhead_max_cpus", "Maximum CPUs available", max_cpus)
+
+    for nr_cpus in sorted(results.keys()):
+        for phase, per_cb in results[nr_cpus].items():
+            for cb, d in per_cb.items():
+                pl = {"cores": str(nr_cpus), "phase": phase, "callback": cb}
+                gauge("pandemonium_overhead_ns_per_call",
+                      "Mean BPF run time per callback invocation",
+                      f"{d['ns_per_call']:.1f}", pl)
+                gauge("pandemonium_overhead_calls_per_sec",
+                      "Callback invocations per second",
+                      f"{d['calls_per_sec']:.0f}", pl)
+                gauge("pandemonium_overhead_run_ns",
+                      "BPF run time summed over the phase", d["run_ns"], pl)
+                gauge("pandemonium_overhead_run_cnt",
+                      "Callback invocations over the phase", d["run_cnt"], pl)
+
+    ARCHIVE_DIR.mkdir(parents=True, exist_ok=True)
+    path = ARCHIVE_DIR / f"overhead-{version}-{stamp}.prom"
+    path.write_text("\n".join(lines) + "\n")
+    return path
+
+
+def cmd_bench_overhead(args) -> int:
+    """Per-callback BPF overhead across core counts.
+
+    Turns on kernel.bpf_stats_enabled for the run (restoring the previous
+    value after), runs the bench-trace workload phases per core count and
+    reads each struct_ops callback's cumulative run_time_ns/run_cnt from
+    the scheduler's --metrics-listen endpoint around every phase. Reports
+    ns/call and calls/s per callback; "all" spans the whole sequence.
+    """
+
+    subprocess.run(["sudo", "true"])
+
+    nuke_stale_build()
+
+    if not build():
+        return 1
+
+    max_cpus = os.cpu_count() or 2
+
+    if args.core_counts:
+        core_counts = [int(c.strip()) for c in args.core_counts.split(",")]
+        core_counts = [c for c in core_counts if 2 <= c <= max_cpus]
+        core_counts = sorted(set(core_counts))
+    else:
+        core_counts = compute_core_counts(max_cpus)
+
+    if not core_counts:
+        log_error(f"no valid core counts (host has {max_cpus} CPUs, minimum is 2)")
+        return 1
+
+    try:
+        prev_stats = BPF_STATS_SYSCTL.read_text().strip()
+    except (FileNotFoundError, PermissionError):
+        log_error(f"{BPF_STATS_SYSCTL} not available")
+        return 1
+    if not _set_bpf_stats("1"):
+        log_error("failed to enable kernel.bpf_stats_enabled")
+        return 1
+
+    stamp = datetime.now().strftime("%Y%m%d-%H%M%S")
+    LOG_DIR.mkdir(parents=True, exist_ok=True)
+
+    ver = get_version()
+    git = get_git_info()
+    dirty = " (dirty)" if git["dirty"] else ""
+    log_info(f"bench-overhead v{ver} [{git['commit']}{dirty}], "
+             f"core_counts={core_counts}, host_cpus={max_cpus}, "
+             f"metrics={args.metrics_addr}")
+
+    results = {}
+    failed = 0
+
+    try:
+        for nr_cpus in core_counts:
+            log_info(f"[{nr_cpus}C] Restricting to {nr_cpus} cores")
+            if nr_cpus < max_cpus:
+                if not restrict_cpus(nr_cpus, max_cpus):
+                    log_error(f"[{nr_cpus}C] failed to offline CPUs, skipping")
+                    failed += 1
+                    restore_all_cpus(max_cpus)
+                    continue
+            time.sleep(1)
+
+            run = _overhead_run(nr_cpus, args.metrics_addr)
+            if run is None:
+                failed += 1
+            else:
+                results[nr_cpus] = run
+
+            if nr_cpus < max_cpus:
+                restore_all_cpus(max_cpus)
+                time.sleep(1)
+
+    except KeyboardInterrupt:
+        log_info("Interrupted")
+    finally:
+        restore_all_cpus(max_cpus)
+        _set_bpf_stats(prev_stats)
+
+        if results:
+            log_info("SUMMARY (whole sequence, ns/call @ calls/s)")
+            header = "".join(f"{f'{n}C':>22}" for n in sorted(results))
+            log_info(f"  {'CALLBACK':<12}{header}")
+            for cb in OVERHEAD_CALLBACKS:
+                cells = ""
+                for nr_cpus in sorted(results):
+                    d = results[nr_cpus].get("all", {}).get(cb)
+                    cell = (f"{d['ns_per_call']:.0f}ns @ {d['calls_per_sec']:.0f}/s"
+                            if d else "-")
+                    cells += f"{cell:>22}"
+                log_info(f"  {cb:<12}{cells}")
+
+            prom_path = _write_overhead_prometheus(ver, git, stamp, max_cpus, results)
+            log_info(f"Prometheus: {prom_path}")
+
+    return 0 if failed == 0 else 1
+
+
 # BENCH-CS2: AUTOMATED GAME WORKLOAD DIAGNOSIS
 
 CS2_CAPTURE_S = 120     # DEFAULT CAPTURE DURATION
@@ -4979,29 +5429,14 @@ def _kill_process(name: str):
 
 
 def _cs2_parse_trace(trace_path: Path) -> dict:
-    """Parse a trace log into structured event data."""
-    events = []       # (timestamp_s, event_type, raw_line)
+    """Decode a binary trace into structured event data."""
+    events = []       # (timestamp_s, event_type, formatted record)
     type_counts = {}  # event_type -> count
 
-    if not trace_path.exists():
-        return {"events": events, "type_counts": type_counts}
-
-    # trace_pipe: "<task>-<pid> [<cpu>] <flags> <timestamp>: ... PAND: <type> <rest>"
-    ts_pattern = re.compile(r"\s+([\d.]+):\s+.*PAND:\s+(.+)")
-
-    for line in trace_path.read_text().splitlines():
-        m = ts_pattern.search(line)
-        if m:
-            ts = float(m.group(1))
-            msg = m.group(2).strip()
-            # Full event type: "enq tier1 cpu=3" -> "enq tier1"
-            parts = msg.split()
-            if len(parts) >= 2 and parts[0] == "enq":
-                etype = f"{parts[0]} {parts[1]}"
-            else:
-                etype = parts[0] if parts else msg
-            events.append((ts, etype, msg))
-            type_counts[etype] = type_counts.get(etype, 0) + 1
+    for r in read_trace(trace_path):
+        etype = r["type"]
+        events.append((r["ts_s"], etype, format_trace_record(r)))
+        type_counts[etype] = type_counts.get(etype, 0) + 1
 
     events.sort(key=lambda e: e[0])
     return {"events": events, "type_counts": type_counts}
@@ -5092,8 +5527,9 @@ def _cs2_write_prometheus(version, git, stamp, target, elapsed,
 def cmd_bench_cs2(args) -> int:
     """Automated game workload diagnosis.
 
-    Patches BPF trace filter at build time, waits for the game to launch,
-    captures trace + latency data, produces Prometheus + human-readable output.
+    Runs the scheduler with a runtime trace filter on the target's comm,
+    waits for the game to launch, captures trace + latency data, produces
+    Prometheus + human-readable output.
     """
     subprocess.run(["sudo", "true"])
     nuke_stale_build()
@@ -5101,16 +5537,9 @@ def cmd_bench_cs2(args) -> int:
     target = args.target
     capture_duration = args.duration or CS2_CAPTURE_S
 
-    # ---- PHASE 1: PATCH + BUILD + RESTORE ----
+    # ---- PHASE 1: BUILD ----
 
-    original = patch_bpf_trace_filter(target)
-    if original is None:
-        return 1
-    try:
-        ok = build(force=True)
-    finally:
-        restore_bpf_source(original)
-    if not ok:
+    if not build():
         return 1
 
     stamp = datetime.now().strftime("%Y%m%d-%H%M%S")
@@ -5126,9 +5555,8 @@ def cmd_bench_cs2(args) -> int:
     # ---- PHASE 2: START SCHEDULER + MONITORING ----
 
     dmesg = DmesgMonitor()
-    trace_path = LOG_DIR / f"cs2-trace-{stamp}.log"
+    trace_path = LOG_DIR / f"cs2-trace-{stamp}.bin"
     sched_proc = None
-    trace = None
     probe = None
     crashed = False
     game_exited = False
@@ -5136,14 +5564,11 @@ def cmd_bench_cs2(args) -> int:
     latency_samples = []
 
     try:
-        sched_proc = _trace_start_scheduler()
+        sched_proc = _trace_start_scheduler(
+            extra_args=trace_args(trace_path, comm=target))
         if sched_proc is None:
             return 1
 
-        trace = TraceCapture(trace_path)
-        if not trace.start():
-            log_warn("Trace capture failed, continuing without trace data")
-
         # ---- PHASE 3: WAIT FOR GAME ----
 
         already_running = _find_process(target) is not None
@@ -5191,7 +5616,8 @@ def cmd_bench_cs2(args) -> int:
                 game_exited = True
                 break
 
-            log_info(f"  [{elapsed:.0f}s] events={trace.count}")
+            log_info(f"  [{elapsed:.0f}s] "
+                     f"events={trace_record_count(trace_path)}")
 
         total_elapsed = time.monotonic() - t0
 
@@ -5207,8 +5633,6 @@ def cmd_bench_cs2(args) -> int:
         if probe:
             latency_samples = probe.collect()
 
-        if trace:
-            trace.stop()
         _trace_stop_scheduler(sched_proc)
 
         if _find_process(target):
@@ -5660,7 +6084,28 @@ def main() -> int:
                        help="Launch-only mode: run only fork+exec latency "
                             "test under load")
     bench.add_argument("--trace", action="store_true",
-                       help="Enable bpf_printk trace capture during benchmark")
+                       help="Trace the scheduler process into a binary "
+                            "trace file (--trace-out) during benchmark")
+    bench.add_argument("--dispatch-batch", action="store_true",
+                       help="Add a PANDEMONIUM (ADAPTIVE+BATCH) entry running "
+                            "--dispatch-batch; reports dispatch ladder walks "
+                            "saved alongside burst P99")
+    bench.add_argument("--reclass-interval", type=int, default=0, metavar="N",
+                       help="Add a PANDEMONIUM (ADAPTIVE+RECLASS) entry running "
+                            "--reclass-interval N; reports the full "
+                            "reclassification rate alongside burst P99")
+    bench.add_argument("--periodic-deadline", action="store_true",
+                       help="Add a PANDEMONIUM (ADAPTIVE+PERIODIC) entry running "
+                            "--periodic-deadline; reports the deadline miss "
+                            "ratio with the feature off and on")
+    bench.add_argument("--pair-affinity", action="store_true",
+                       help="Add a PANDEMONIUM (ADAPTIVE+PAIR) entry running "
+                            "--pair-affinity; reports IPC round-trip P99 with "
+                            "the feature off and on")
+    bench.add_argument("--idle-aware", action="store_true",
+                       help="Add a PANDEMONIUM (ADAPTIVE+IDLE) entry running "
+                            "--idle-aware; reports wakeup latency P99 with "
+                            "the feature off and on")
 
     trace_bench = sub.add_parser("bench-trace",
                                   help="Crash-detection stress test with trace capture")
@@ -5682,6 +6127,16 @@ def main() -> int:
                                        "sojourn-pressure, longrun-interactive, "
                                        "burst-recovery, mixed-storm")
 
+    overhead_bench = sub.add_parser("bench-overhead",
+                                    help="Per-callback BPF overhead (kernel.bpf_stats_enabled)")
+    overhead_bench.add_argument("--core-counts", type=str, default=None,
+                                help="Comma-separated core counts "
+                                     "(default: auto 2,4,8,...,max)")
+    overhead_bench.add_argument("--metrics-addr", type=str,
+                                default=OVERHEAD_METRICS_ADDR,
+                                help="Scheduler --metrics-listen address sampled per phase "
+                                     f"(default: {OVERHEAD_METRICS_ADDR})")
+
     sys_bench = sub.add_parser("bench-sys",
                                help="Live system telemetry capture")
     sys_bench.add_argument("--scheduler", type=str, default="adaptive",
@@ -5735,6 +6190,8 @@ def main() -> int:
         return cmd_bench_trace(args)
     if args.command == "bench-contention":
         return cmd_bench_contention(args)
+    if args.command == "bench-overhead":
+        return cmd_bench_overhead(args)
     if args.command == "bench-sys":
         return cmd_bench_sys(args)
     if args.command == "bench-pcpu":
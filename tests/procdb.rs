@@ -1,17 +1,14 @@
-use std::collections::HashMap;
+mod common;
 
+use common::tmp_path;
 use pandemonium::procdb::{
-    ProcessDb, TaskClassEntry, TaskProfile, MAX_PROFILES, MIN_CONFIDENCE, MIN_OBSERVATIONS,
-    STALE_TICKS,
+    HostTag, ProcessDb, ProfileKey, TaskClassEntry, TaskProfile, MAX_PROFILES, MIN_CONFIDENCE,
+    MIN_OBSERVATIONS, STALE_TICKS, TAG_HYBRID, TAG_SMT,
 };
+use pandemonium::procstore::ProfileStore;
 
 fn offline_db() -> ProcessDb {
-    ProcessDb {
-        observe: None,
-        init: None,
-        profiles: HashMap::new(),
-        tick: 0,
-    }
+    ProcessDb::detached(None)
 }
 
 #[test]
@@ -74,7 +71,7 @@ fn profile_confidence_zero_votes() {
 
 #[test]
 fn task_class_entry_layout() {
-    // VERIFY RUST STRUCT MATCHES BPF: 1 + 7 + 8 + 8 + 8 + 8 = 40 BYTES
+    // VERIFY RUST STRUCT MATCHES BPF: 1 + 3 + 4 + 8 + 8 + 8 + 8 = 40 BYTES
     assert_eq!(std::mem::size_of::<TaskClassEntry>(), 40);
 }
 
@@ -87,6 +84,11 @@ fn make_comm(name: &[u8]) -> [u8; 16] {
     comm
 }
 
+// comm-ONLY (FALLBACK) KEY: THE SHAPE EVERY PRE-V3 PROFILE MIGRATES TO
+fn make_key(name: &[u8]) -> ProfileKey {
+    ProfileKey::comm_only(make_comm(name))
+}
+
 fn confident_profile(last_seen_tick: u64) -> TaskProfile {
     TaskProfile {
         tier_votes: [5, 0, 0],
@@ -100,7 +102,7 @@ fn confident_profile(last_seen_tick: u64) -> TaskProfile {
 #[test]
 fn tick_evicts_stale_profiles() {
     let mut db = offline_db();
-    let comm = make_comm(b"stale_task");
+    let comm = make_key(b"stale_task");
     db.profiles.insert(comm, confident_profile(0));
 
     for _ in 0..=STALE_TICKS {
@@ -114,7 +116,7 @@ fn tick_evicts_stale_profiles() {
 fn tick_preserves_fresh_profiles() {
     let mut db = offline_db();
     db.tick = 55;
-    let comm = make_comm(b"fresh_task");
+    let comm = make_key(b"fresh_task");
     db.profiles.insert(comm, confident_profile(55));
 
     db.tick();
@@ -132,7 +134,7 @@ fn tick_caps_at_max_profiles() {
         let mut comm = [0u8; 16];
         comm[0..8].copy_from_slice(&i.to_le_bytes());
         db.profiles.insert(
-            comm,
+            ProfileKey::comm_only(comm),
             TaskProfile {
                 tier_votes: [5, 0, 0],
                 avg_runtime_ns: 100000,
@@ -144,7 +146,7 @@ fn tick_caps_at_max_profiles() {
     }
 
     // INSERT ONE MORE ENTRY WITH SLIGHTLY OLDER TIMESTAMP (STILL FRESH)
-    let oldest_comm = make_comm(b"oldest_entry");
+    let oldest_comm = make_key(b"oldest_entry");
     db.profiles.insert(
         oldest_comm,
         TaskProfile {
@@ -169,12 +171,12 @@ fn summary_counts_confident() {
     let mut db = offline_db();
 
     // TWO CONFIDENT PROFILES
-    db.profiles.insert(make_comm(b"gcc"), confident_profile(0));
-    db.profiles.insert(make_comm(b"ld"), confident_profile(0));
+    db.profiles.insert(make_key(b"gcc"), confident_profile(0));
+    db.profiles.insert(make_key(b"ld"), confident_profile(0));
 
     // ONE NON-CONFIDENT: TOO FEW OBSERVATIONS
     db.profiles.insert(
-        make_comm(b"new_task"),
+        make_key(b"new_task"),
         TaskProfile {
             tier_votes: [1, 0, 0],
             avg_runtime_ns: 50000,
@@ -196,40 +198,39 @@ fn summary_empty_db() {
 
 // PERSISTENCE TESTS
 
-fn tmp_path(name: &str) -> std::path::PathBuf {
-    let dir = std::env::temp_dir().join("pandemonium-test");
-    std::fs::create_dir_all(&dir).unwrap();
-    dir.join(name)
-}
-
 #[test]
 fn save_load_round_trip() {
     let path = tmp_path("round_trip.bin");
-    let _ = std::fs::remove_file(&path);
 
     let mut db = offline_db();
     db.profiles.insert(
-        make_comm(b"gcc"),
+        make_key(b"gcc"),
         TaskProfile {
             tier_votes: [10, 0, 0],
             avg_runtime_ns: 2500000,
             runtime_dev_ns: 500000,
             wakeup_freq: 5,
             csw_rate: 10,
+            period_ns: 0,
             observations: 10,
             last_seen_tick: 50,
+            updated: 0,
+            seen: false,
         },
     );
     db.profiles.insert(
-        make_comm(b"kwin"),
+        make_key(b"kwin"),
         TaskProfile {
             tier_votes: [0, 0, 8],
             avg_runtime_ns: 50000,
             runtime_dev_ns: 5000,
             wakeup_freq: 40,
             csw_rate: 200,
+            period_ns: 16_666_000,
             observations: 8,
             last_seen_tick: 50,
+            updated: 0,
+            seen: false,
         },
     );
     db.save(&path).unwrap();
@@ -237,7 +238,7 @@ fn save_load_round_trip() {
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
     assert_eq!(loaded.len(), 2);
 
-    let gcc = &loaded[&make_comm(b"gcc")];
+    let gcc = &loaded[&make_key(b"gcc")];
     assert_eq!(gcc.dominant_tier(), 0); // BATCH
     assert_eq!(gcc.avg_runtime_ns, 2500000);
     assert_eq!(gcc.runtime_dev_ns, 500000);
@@ -246,7 +247,7 @@ fn save_load_round_trip() {
     assert_eq!(gcc.observations, 10);
     assert_eq!(gcc.last_seen_tick, 0); // RESET ON LOAD
 
-    let kwin = &loaded[&make_comm(b"kwin")];
+    let kwin = &loaded[&make_key(b"kwin")];
     assert_eq!(kwin.dominant_tier(), 2); // LAT_CRITICAL
     assert_eq!(kwin.avg_runtime_ns, 50000);
     assert_eq!(kwin.runtime_dev_ns, 5000);
@@ -260,7 +261,6 @@ fn save_load_round_trip() {
 #[test]
 fn save_load_empty() {
     let path = tmp_path("empty.bin");
-    let _ = std::fs::remove_file(&path);
 
     let db = offline_db();
     db.save(&path).unwrap();
@@ -274,14 +274,13 @@ fn save_load_empty() {
 #[test]
 fn save_skips_non_confident_profiles() {
     let path = tmp_path("skip_non_confident.bin");
-    let _ = std::fs::remove_file(&path);
 
     let mut db = offline_db();
     // CONFIDENT
-    db.profiles.insert(make_comm(b"gcc"), confident_profile(0));
+    db.profiles.insert(make_key(b"gcc"), confident_profile(0));
     // NOT CONFIDENT: TOO FEW OBSERVATIONS
     db.profiles.insert(
-        make_comm(b"new"),
+        make_key(b"new"),
         TaskProfile {
             tier_votes: [1, 0, 0],
             avg_runtime_ns: 50000,
@@ -293,7 +292,7 @@ fn save_skips_non_confident_profiles() {
     db.save(&path).unwrap();
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
     assert_eq!(loaded.len(), 1);
-    assert!(loaded.contains_key(&make_comm(b"gcc")));
+    assert!(loaded.contains_key(&make_key(b"gcc")));
 
     let _ = std::fs::remove_file(&path);
 }
@@ -343,7 +342,6 @@ fn load_truncated() {
 #[test]
 fn load_file_not_found() {
     let path = tmp_path("nonexistent_file_xyz.bin");
-    let _ = std::fs::remove_file(&path);
 
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
     assert!(loaded.is_empty());
@@ -352,26 +350,21 @@ fn load_file_not_found() {
 #[test]
 fn loaded_profiles_age_out() {
     let path = tmp_path("age_out.bin");
-    let _ = std::fs::remove_file(&path);
 
     let mut db = offline_db();
-    db.profiles.insert(make_comm(b"gcc"), confident_profile(0));
+    db.profiles.insert(make_key(b"gcc"), confident_profile(0));
     db.save(&path).unwrap();
 
     // LOAD INTO FRESH DB -- PROFILES GET LAST_SEEN_TICK=0
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
-    let mut db2 = ProcessDb {
-        observe: None,
-        init: None,
-        profiles: loaded,
-        tick: 0,
-    };
+    let mut db2 = offline_db();
+    db2.profiles = loaded;
 
     // TICK 61 TIMES -- PROFILE SHOULD BE EVICTED
     for _ in 0..=STALE_TICKS {
         db2.tick();
     }
-    assert!(db2.profiles.get(&make_comm(b"gcc")).is_none());
+    assert!(db2.profiles.get(&make_key(b"gcc")).is_none());
 
     let _ = std::fs::remove_file(&path);
 }
@@ -389,7 +382,7 @@ fn eviction_oldest_first() {
         let mut comm = [0u8; 16];
         comm[0..8].copy_from_slice(&(i + 1).to_le_bytes());
         db.profiles.insert(
-            comm,
+            ProfileKey::comm_only(comm),
             TaskProfile {
                 tier_votes: [5, 0, 0],
                 avg_runtime_ns: 100000,
@@ -401,7 +394,7 @@ fn eviction_oldest_first() {
     }
 
     // INSERT ONE MORE WITH OLDER TIMESTAMP
-    let victim = make_comm(b"victim");
+    let victim = make_key(b"victim");
     db.profiles.insert(
         victim,
         TaskProfile {
@@ -430,7 +423,7 @@ fn eviction_tie_break_by_observations() {
         let mut comm = [0u8; 16];
         comm[0..8].copy_from_slice(&(i + 1).to_le_bytes());
         db.profiles.insert(
-            comm,
+            ProfileKey::comm_only(comm),
             TaskProfile {
                 tier_votes: [10, 0, 0],
                 avg_runtime_ns: 100000,
@@ -442,7 +435,7 @@ fn eviction_tie_break_by_observations() {
     }
 
     // INSERT ONE MORE WITH SAME TIMESTAMP BUT FEWER OBSERVATIONS
-    let victim = make_comm(b"low_obs");
+    let victim = make_key(b"low_obs");
     db.profiles.insert(
         victim,
         TaskProfile {
@@ -472,7 +465,7 @@ fn eviction_deterministic() {
             let mut comm = [0u8; 16];
             comm[0..8].copy_from_slice(&i.to_le_bytes());
             db.profiles.insert(
-                comm,
+                ProfileKey::comm_only(comm),
                 TaskProfile {
                     tier_votes: [5, 0, 0],
                     avg_runtime_ns: 100000,
@@ -496,15 +489,50 @@ fn eviction_deterministic() {
     for i in 0..=(MAX_PROFILES as u64) {
         let mut comm = [0u8; 16];
         comm[0..8].copy_from_slice(&i.to_le_bytes());
+        let key = ProfileKey::comm_only(comm);
         assert_eq!(
-            db1.profiles.get(&comm).is_some(),
-            db2.profiles.get(&comm).is_some(),
+            db1.profiles.get(&key).is_some(),
+            db2.profiles.get(&key).is_some(),
             "MISMATCH AT i={}",
             i
         );
     }
 }
 
+#[test]
+fn cap_eviction_orders_restored_profiles_by_wall_clock() {
+    // RESTORED PROFILES ALL CARRY last_seen_tick 0: ONLY updated AGES THEM
+    let mut db = offline_db();
+    let now = pandemonium::procdb::now_secs();
+    for i in 0..=(MAX_PROFILES as u64) {
+        let mut comm = [0u8; 16];
+        comm[0..8].copy_from_slice(&(i + 1).to_le_bytes());
+        db.profiles.insert(
+            ProfileKey::comm_only(comm),
+            TaskProfile {
+                tier_votes: [5, 0, 0],
+                observations: MIN_OBSERVATIONS,
+                updated: now - 1000 + i % 500,
+                ..Default::default()
+            },
+        );
+    }
+    let victim = make_key(b"last_month");
+    db.profiles.insert(
+        victim,
+        TaskProfile {
+            tier_votes: [5, 0, 0],
+            observations: 100,
+            updated: now - 20 * 24 * 3600,
+            ..Default::default()
+        },
+    );
+
+    db.tick();
+    assert_eq!(db.profiles.len(), MAX_PROFILES);
+    assert!(db.profiles.get(&victim).is_none());
+}
+
 // BEHAVIORAL CONFIDENCE (V4.0 PHASE 2)
 
 #[test]
@@ -543,7 +571,6 @@ fn behavioral_confidence_low_stability() {
 fn procdb_v1_load_compat() {
     // V1 FORMAT: 40-BYTE ENTRIES, NO BEHAVIORAL FIELDS
     let path = tmp_path("v1_compat.bin");
-    let _ = std::fs::remove_file(&path);
 
     let mut data = Vec::new();
     data.extend_from_slice(b"PDDB");
@@ -563,7 +590,7 @@ fn procdb_v1_load_compat() {
 
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
     assert_eq!(loaded.len(), 1);
-    let p = &loaded[&comm];
+    let p = &loaded[&ProfileKey::comm_only(comm)];
     assert_eq!(p.avg_runtime_ns, 2_000_000);
     assert_eq!(p.runtime_dev_ns, 0); // ZERO-FILLED
     assert_eq!(p.wakeup_freq, 0); // ZERO-FILLED
@@ -575,32 +602,363 @@ fn procdb_v1_load_compat() {
 
 #[test]
 fn richer_observation_roundtrip() {
-    // ALL 5 FIELDS SURVIVE SAVE -> LOAD
+    // ALL 6 FIELDS SURVIVE SAVE -> LOAD
     let path = tmp_path("richer_roundtrip.bin");
-    let _ = std::fs::remove_file(&path);
 
     let mut db = offline_db();
     db.profiles.insert(
-        make_comm(b"firefox"),
+        make_key(b"firefox"),
         TaskProfile {
             tier_votes: [0, 0, 8],
             avg_runtime_ns: 75000,
             runtime_dev_ns: 12000,
             wakeup_freq: 45,
             csw_rate: 180,
+            period_ns: 16_666_000,
             observations: 8,
             last_seen_tick: 100,
+            updated: 0,
+            seen: false,
         },
     );
     db.save(&path).unwrap();
 
     let loaded = ProcessDb::load_from_disk(&path).unwrap();
-    let p = &loaded[&make_comm(b"firefox")];
+    let p = &loaded[&make_key(b"firefox")];
     assert_eq!(p.avg_runtime_ns, 75000);
     assert_eq!(p.runtime_dev_ns, 12000);
     assert_eq!(p.wakeup_freq, 45);
     assert_eq!(p.csw_rate, 180);
+    assert_eq!(p.period_ns, 16_666_000);
     assert_eq!(p.observations, 8);
 
     let _ = std::fs::remove_file(&path);
 }
+
+// COMPOSITE KEY (V3)
+
+fn exe_key(exe_id: u64, name: &[u8]) -> ProfileKey {
+    ProfileKey {
+        exe_id,
+        cgid: 0,
+        comm: make_comm(name),
+    }
+}
+
+fn observation(tier: u8, avg_runtime: u64) -> TaskClassEntry {
+    TaskClassEntry {
+        tier,
+        _pad: [0; 3],
+        period_us: 0,
+        avg_runtime,
+        runtime_dev: avg_runtime / 20,
+        wakeup_freq: 10,
+        csw_rate: 10,
+    }
+}
+
+#[test]
+fn profile_key_layout() {
+    // MATCHES struct task_class_key IN intf.h: 8 + 8 + 16 = 32 BYTES
+    assert_eq!(std::mem::size_of::<ProfileKey>(), 32);
+    let k = exe_key(0xABCD, b"java");
+    assert_eq!(ProfileKey::from_bytes(k.as_bytes()), Some(k));
+}
+
+#[test]
+fn record_splits_same_comm_by_executable() {
+    // TWO JVMs: gRPC SERVICE (LAT_CRITICAL) AND ETL (BATCH), BOTH "java"
+    let mut db = offline_db();
+    let grpc = exe_key(1, b"java");
+    let etl = exe_key(2, b"java");
+    for _ in 0..5 {
+        db.record(grpc, &observation(2, 50_000));
+        db.record(etl, &observation(0, 5_000_000));
+    }
+
+    assert_eq!(db.profiles[&grpc].dominant_tier(), 2);
+    assert_eq!(db.profiles[&etl].dominant_tier(), 0);
+    assert!(db.profiles[&grpc].behavioral_confidence() >= MIN_CONFIDENCE);
+    assert!(db.profiles[&etl].behavioral_confidence() >= MIN_CONFIDENCE);
+
+    // THE comm-ONLY FALLBACK SAW BOTH AND IS SPLIT 50/50: NOT PUBLISHED
+    let fallback = &db.profiles[&make_key(b"java")];
+    assert_eq!(fallback.observations, 10);
+    assert!(fallback.behavioral_confidence() < MIN_CONFIDENCE);
+}
+
+#[test]
+fn record_fallback_confident_when_executables_agree() {
+    let mut db = offline_db();
+    for _ in 0..4 {
+        db.record(exe_key(7, b"cc1"), &observation(0, 2_000_000));
+    }
+    let fallback = &db.profiles[&make_key(b"cc1")];
+    assert_eq!(fallback.dominant_tier(), 0);
+    assert!(fallback.behavioral_confidence() >= MIN_CONFIDENCE);
+
+    // KERNEL THREADS HAVE NO EXECUTABLE: THEIR KEY IS THE FALLBACK ITSELF
+    db.record(make_key(b"kworker/u8:1"), &observation(1, 30_000));
+    assert_eq!(db.profiles[&make_key(b"kworker/u8:1")].observations, 1);
+    assert_eq!(db.profiles.len(), 3);
+}
+
+#[test]
+fn composite_key_roundtrip() {
+    let path = tmp_path("v3_composite.bin");
+
+    let mut db = offline_db();
+    let a = exe_key(0x1111, b"python3");
+    let b = ProfileKey {
+        exe_id: 0x2222,
+        cgid: 42,
+        comm: make_comm(b"python3"),
+    };
+    db.profiles.insert(a, confident_profile(0));
+    let mut lat = confident_profile(0);
+    lat.tier_votes = [0, 0, 5];
+    db.profiles.insert(b, lat);
+    db.save(&path).unwrap();
+
+    let loaded = ProcessDb::load_from_disk(&path).unwrap();
+    assert_eq!(loaded.len(), 2);
+    assert_eq!(loaded[&a].dominant_tier(), 0);
+    assert_eq!(loaded[&b].dominant_tier(), 2);
+
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn procdb_v2_migrates_to_fallback() {
+    // V2 FORMAT: 64-BYTE comm-KEYED ENTRIES. LOADED AS comm-ONLY FALLBACKS
+    // SO WARM STARTS KEEP HITTING UNTIL EXACT PROFILES ARE LEARNED.
+    let path = tmp_path("v2_migrate.bin");
+
+    let mut data = Vec::new();
+    data.extend_from_slice(b"PDDB");
+    data.extend_from_slice(&2u32.to_le_bytes()); // VERSION 2
+    data.extend_from_slice(&1u32.to_le_bytes()); // 1 ENTRY
+
+    // V2 ENTRY: COMM(16) + TIER+PAD(8) + 4 x U64(32) + OBS(4) + VOTES(4) = 64
+    data.extend_from_slice(&make_comm(b"gcc"));
+    data.push(0); // TIER = BATCH
+    data.extend_from_slice(&[0u8; 7]);
+    data.extend_from_slice(&3_000_000u64.to_le_bytes()); // AVG_RUNTIME
+    data.extend_from_slice(&90_000u64.to_le_bytes()); // RUNTIME_DEV
+    data.extend_from_slice(&4u64.to_le_bytes()); // WAKEUP_FREQ
+    data.extend_from_slice(&8u64.to_le_bytes()); // CSW_RATE
+    data.extend_from_slice(&6u32.to_le_bytes()); // OBSERVATIONS
+    data.extend_from_slice(&6u32.to_le_bytes()); // TOTAL_VOTES
+    assert_eq!(data.len(), 12 + 64);
+    std::fs::write(&path, &data).unwrap();
+
+    let loaded = ProcessDb::load_from_disk(&path).unwrap();
+    let key = make_key(b"gcc");
+    assert!(key.is_fallback());
+    let p = &loaded[&key];
+    assert_eq!(p.avg_runtime_ns, 3_000_000);
+    assert_eq!(p.runtime_dev_ns, 90_000);
+    assert_eq!(p.csw_rate, 8);
+    assert_eq!(p.dominant_tier(), 0);
+
+    let _ = std::fs::remove_file(&path);
+}
+
+// FLEET EXPORT / IMPORT / MERGE
+
+fn tag(nr_cpus: u32, flags: u32) -> HostTag {
+    HostTag {
+        nr_cpus,
+        nr_llcs: 1,
+        nr_nodes: 1,
+        flags,
+    }
+}
+
+#[test]
+fn v4_round_trip_keeps_votes_and_tag() {
+    let path = tmp_path("v4_votes.bin");
+
+    let mut db = offline_db();
+    db.tag = tag(16, TAG_SMT);
+    let mut p = confident_profile(0);
+    p.tier_votes = [8, 2, 0]; // 0.8 TIER AGREEMENT, NOT FLATTENED TO 1.0
+    p.observations = 10;
+    db.profiles.insert(make_key(b"rustc"), p);
+    db.save(&path).unwrap();
+
+    let (loaded_tag, loaded) = ProcessDb::load_snapshot(&path).unwrap();
+    assert_eq!(loaded_tag, tag(16, TAG_SMT));
+    let p = &loaded[&make_key(b"rustc")];
+    assert_eq!(p.tier_votes, [8, 2, 0]);
+    assert_eq!(p.observations, 10);
+    assert!((p.confidence() - 0.8).abs() < 1e-9);
+
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn pre_v4_snapshot_is_untagged() {
+    let path = tmp_path("v2_untagged.bin");
+    let mut data = Vec::new();
+    data.extend_from_slice(b"PDDB");
+    data.extend_from_slice(&2u32.to_le_bytes());
+    data.extend_from_slice(&0u32.to_le_bytes());
+    std::fs::write(&path, &data).unwrap();
+
+    let (t, loaded) = ProcessDb::load_snapshot(&path).unwrap();
+    assert!(t.is_untagged());
+    assert!(loaded.is_empty());
+    assert!(t.compatible(&tag(64, TAG_HYBRID)));
+
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn host_tag_compatibility() {
+    assert!(tag(16, TAG_SMT).compatible(&tag(32, TAG_SMT)));
+    assert!(tag(32, TAG_SMT).compatible(&tag(16, TAG_SMT)));
+    assert!(!tag(16, TAG_SMT).compatible(&tag(64, TAG_SMT))); // 4X APART
+    assert!(!tag(16, TAG_SMT).compatible(&tag(16, TAG_SMT | TAG_HYBRID)));
+    assert!(!tag(16, 0).compatible(&tag(16, TAG_SMT)));
+}
+
+#[test]
+fn merge_pools_votes_and_weights_behavior() {
+    let mut a = TaskProfile {
+        tier_votes: [6, 0, 0],
+        avg_runtime_ns: 1_000_000,
+        runtime_dev_ns: 100_000,
+        observations: 6,
+        ..Default::default()
+    };
+    let b = TaskProfile {
+        tier_votes: [2, 0, 0],
+        avg_runtime_ns: 3_000_000,
+        runtime_dev_ns: 300_000,
+        observations: 2,
+        ..Default::default()
+    };
+    a.merge(&b);
+    assert_eq!(a.tier_votes, [8, 0, 0]);
+    assert_eq!(a.observations, 8);
+    // (1MS * 6 + 3MS * 2) / 8 = 1.5MS
+    assert_eq!(a.avg_runtime_ns, 1_500_000);
+    assert_eq!(a.runtime_dev_ns, 150_000);
+    assert_eq!(a.confidence(), 1.0);
+}
+
+#[test]
+fn merge_disagreement_dilutes_confidence() {
+    // TWO HOSTS, EACH CONFIDENT, IN OPPOSITE TIERS: NEITHER WINS THE MERGE
+    let mut db = offline_db();
+    let key = make_key(b"worker");
+    let mut batch = confident_profile(0);
+    batch.tier_votes = [5, 0, 0];
+    batch.observations = 5;
+    let mut lat = confident_profile(0);
+    lat.tier_votes = [0, 0, 5];
+    lat.observations = 5;
+    assert!(batch.behavioral_confidence() >= MIN_CONFIDENCE);
+    db.merge_profile(key, &batch);
+    db.merge_profile(key, &lat);
+    let p = &db.profiles[&key];
+    assert_eq!(p.tier_votes, [5, 0, 5]);
+    assert!(p.behavioral_confidence() < MIN_CONFIDENCE);
+    assert_eq!(db.summary(), (1, 0));
+}
+
+#[test]
+fn imported_profiles_survive_stale_ticks() {
+    // THE IMPORT PATH: SNAPSHOT -> merge_profile() INTO THE MAPPED STORE
+    let snap = tmp_path("import_seed.bin");
+    let map = tmp_path("import_seed.map");
+    let mut fleet = offline_db();
+    fleet.profiles.insert(make_key(b"nightly_etl"), confident_profile(0));
+    fleet.save(&snap).unwrap();
+
+    let (_, incoming) = ProcessDb::load_snapshot(&snap).unwrap();
+    let mut db = ProcessDb::detached(Some(ProfileStore::open(&map).unwrap()));
+    for (key, profile) in &incoming {
+        db.merge_profile(*key, profile);
+    }
+    db.sync().unwrap();
+
+    // THE WORKLOAD DOES NOT RUN WITHIN STALE_TICKS OF THE IMPORT
+    for _ in 0..=STALE_TICKS {
+        db.tick();
+    }
+    db.persist();
+    assert!(db.profiles.contains_key(&make_key(b"nightly_etl")));
+    drop(db);
+
+    let db = ProcessDb::detached(Some(ProfileStore::open(&map).unwrap()));
+    let p = &db.profiles[&make_key(b"nightly_etl")];
+    assert_eq!(p.observations, MIN_OBSERVATIONS);
+    assert!(p.updated > 0);
+    let _ = std::fs::remove_file(&snap);
+    let _ = std::fs::remove_file(&map);
+}
+
+// PERIODIC TASKS (V5)
+
+#[test]
+fn period_learned_only_while_every_run_is_periodic() {
+    let frame = |period_us| TaskClassEntry {
+        period_us,
+        ..observation(2, 2_000_000)
+    };
+    let mut p = TaskProfile::default();
+    p.observe(&frame(16_666), 1);
+    assert_eq!(p.period_ns, 16_666_000);
+    // 7/8 EWMA TOWARD A 120HZ OBSERVATION
+    p.observe(&frame(8_333), 2);
+    assert_eq!(p.period_ns, (16_666_000 * 7 + 8_333_000) / 8);
+    assert_eq!(p.prediction().period_us, (p.period_ns / 1000) as u32);
+
+    // ONE APERIODIC RUN DROPS IT; THE NEXT PERIODIC ONE RESTARTS IT
+    p.observe(&frame(0), 3);
+    assert_eq!(p.period_ns, 0);
+    assert_eq!(p.prediction().period_us, 0);
+    p.observe(&frame(10_000), 4);
+    assert_eq!(p.period_ns, 10_000_000);
+
+    // MERGE: PERIODIC ONLY WHERE BOTH HOSTS FOUND A PERIOD
+    let mut other = TaskProfile::default();
+    other.observe(&frame(10_000), 1);
+    let mut both = TaskProfile::default();
+    both.merge(&p);
+    both.merge(&other);
+    assert_eq!(both.period_ns, 10_000_000);
+    other.observe(&frame(0), 2);
+    both.merge(&other);
+    assert_eq!(both.period_ns, 0);
+}
+
+#[test]
+fn v4_snapshot_loads_aperiodic() {
+    let path = tmp_path("v4_aperiodic.bin");
+    let mut data = Vec::new();
+    data.extend_from_slice(b"PDDB");
+    data.extend_from_slice(&4u32.to_le_bytes());
+    data.extend_from_slice(&1u32.to_le_bytes());
+    data.extend_from_slice(&[0u8; 16]); // UNTAGGED HOST
+    // V4 ENTRY: KEY(32) + VOTES(12) + OBS(4) + 4 x u64 BEHAVIOR = 80
+    let key = make_key(b"mpv");
+    data.extend_from_slice(key.as_bytes());
+    for v in [0u32, 0, 6, 6] {
+        data.extend_from_slice(&v.to_le_bytes());
+    }
+    for v in [1_000_000u64, 50_000, 60, 60] {
+        data.extend_from_slice(&v.to_le_bytes());
+    }
+    std::fs::write(&path, &data).unwrap();
+
+    let loaded = ProcessDb::load_from_disk(&path).unwrap();
+    let p = &loaded[&key];
+    assert_eq!(p.tier_votes, [0, 0, 6]);
+    assert_eq!(p.csw_rate, 60);
+    assert_eq!(p.period_ns, 0);
+
+    let _ = std::fs::remove_file(&path);
+}
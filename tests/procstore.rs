@@ -0,0 +1,328 @@
+mod common;
+
+use common::tmp_path;
+use pandemonium::procdb::{ProcessDb, ProfileKey, TaskClassEntry, TaskProfile, MIN_OBSERVATIONS};
+use pandemonium::procstore::{
+    crc32, ProfileStore, HEADER_SIZE, INITIAL_CAPACITY, MAX_CAPACITY, RECORD_SIZE,
+};
+
+fn key(exe_id: u64, name: &[u8]) -> ProfileKey {
+    let mut comm = [0u8; 16];
+    comm[..name.len()].copy_from_slice(name);
+    ProfileKey {
+        exe_id,
+        cgid: 0,
+        comm,
+    }
+}
+
+fn profile(avg_runtime_ns: u64) -> TaskProfile {
+    TaskProfile {
+        tier_votes: [4, 1, 0],
+        avg_runtime_ns,
+        runtime_dev_ns: avg_runtime_ns / 10,
+        wakeup_freq: 7,
+        csw_rate: 3,
+        period_ns: 16_666_000,
+        observations: 5,
+        last_seen_tick: 42,
+        updated: 1_700_000_000,
+        seen: false,
+    }
+}
+
+fn observation(tier: u8, avg_runtime: u64) -> TaskClassEntry {
+    TaskClassEntry {
+        tier,
+        _pad: [0; 3],
+        period_us: 0,
+        avg_runtime,
+        runtime_dev: avg_runtime / 20,
+        wakeup_freq: 10,
+        csw_rate: 10,
+    }
+}
+
+#[test]
+fn crc32_reference_vector() {
+    assert_eq!(crc32(b"123456789"), 0xCBF4_3926);
+}
+
+#[test]
+fn store_reopen_round_trip() {
+    let path = tmp_path("store_round_trip.map");
+    {
+        let mut store = ProfileStore::open(&path).unwrap();
+        assert!(store.is_empty());
+        store.put(&key(1, b"gcc"), &profile(100_000)).unwrap();
+        store.put(&key(2, b"gcc"), &profile(200_000)).unwrap();
+        store.put(&key(1, b"gcc"), &profile(150_000)).unwrap(); // UPDATE IN PLACE
+    }
+    let store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), 2);
+    assert_eq!(store.dropped(), 0);
+    let mut got = store.profiles();
+    got.sort_by_key(|(k, _)| *k);
+    assert_eq!(got[0].0, key(1, b"gcc"));
+    assert_eq!(got[0].1.avg_runtime_ns, 150_000);
+    assert_eq!(got[0].1.tier_votes, [4, 1, 0]);
+    assert_eq!(got[0].1.observations, 5);
+    assert_eq!(got[0].1.period_ns, 16_666_000); // 60HZ, STORED IN US
+    assert_eq!(got[0].1.last_seen_tick, 0); // TICKS ARE PER-RUN
+    assert_eq!(got[0].1.updated, 1_700_000_000); // WALL CLOCK SURVIVES
+    assert!(!got[0].1.seen); // NOT YET SEEN BY THE NEW RUN
+    assert_eq!(got[1].1.avg_runtime_ns, 200_000);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn store_drops_corrupt_record() {
+    let path = tmp_path("store_corrupt.map");
+    {
+        let mut store = ProfileStore::open(&path).unwrap();
+        store.put(&key(1, b"cc1"), &profile(100)).unwrap(); // SLOT 0
+        store.put(&key(2, b"ld"), &profile(200)).unwrap(); // SLOT 1
+    }
+    // FLIP ONE BYTE IN SLOT 0'S BODY: A TORN WRITE
+    let mut data = std::fs::read(&path).unwrap();
+    data[HEADER_SIZE + 50] ^= 0xff;
+    std::fs::write(&path, &data).unwrap();
+
+    let mut store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), 1);
+    assert_eq!(store.dropped(), 1);
+    assert_eq!(store.profiles()[0].0, key(2, b"ld"));
+
+    // THE BAD SLOT IS CLEARED AND REUSED FIRST
+    store.put(&key(3, b"as"), &profile(300)).unwrap();
+    drop(store);
+    let store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), 2);
+    assert_eq!(store.dropped(), 0);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn store_bad_header_reinitializes() {
+    let path = tmp_path("store_bad_header.map");
+    std::fs::write(&path, b"PDDB not a mapped store").unwrap();
+    let store = ProfileStore::open(&path).unwrap();
+    assert!(store.is_empty());
+    assert_eq!(store.capacity(), INITIAL_CAPACITY);
+    drop(store);
+    let len = std::fs::metadata(&path).unwrap().len() as usize;
+    assert_eq!(len, HEADER_SIZE + INITIAL_CAPACITY * RECORD_SIZE);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn store_remove_frees_slot() {
+    let path = tmp_path("store_remove.map");
+    let mut store = ProfileStore::open(&path).unwrap();
+    for i in 0..INITIAL_CAPACITY as u64 {
+        store.put(&key(i + 1, b"w"), &profile(i)).unwrap();
+    }
+    store.remove(&key(1, b"w"));
+    store.put(&key(9999, b"w"), &profile(1)).unwrap();
+    assert_eq!(store.capacity(), INITIAL_CAPACITY); // REUSED, NOT GROWN
+    drop(store);
+    let store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), INITIAL_CAPACITY);
+    assert!(store.profiles().iter().all(|(k, _)| *k != key(1, b"w")));
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn store_grows_to_tens_of_thousands() {
+    let path = tmp_path("store_grow.map");
+    let n = 20_000u64;
+    {
+        let mut store = ProfileStore::open(&path).unwrap();
+        for i in 0..n {
+            store.put(&key(i + 1, b"java"), &profile(i)).unwrap();
+        }
+        assert_eq!(store.len(), n as usize);
+        assert!(store.capacity() >= n as usize);
+        assert!(store.capacity() <= MAX_CAPACITY);
+    }
+    let store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), n as usize);
+    assert_eq!(store.dropped(), 0);
+    let _ = std::fs::remove_file(&path);
+}
+
+// RLIMIT_FSIZE IS PROCESS-WIDE: THE FAILING GROW RUNS IN A RE-EXEC OF
+// THIS TEST BINARY, SO THE OTHER TESTS NEVER SEE THE LIMIT
+#[test]
+fn store_grow_failure_keeps_the_old_mapping() {
+    if std::env::var_os("PANDEMONIUM_GROW_FAIL").is_none() {
+        let status = std::process::Command::new(std::env::current_exe().unwrap())
+            .args(["--exact", "store_grow_failure_keeps_the_old_mapping", "--test-threads=1"])
+            .env("PANDEMONIUM_GROW_FAIL", "1")
+            .status()
+            .unwrap();
+        assert!(status.success(), "GROW-FAILURE CHILD: {}", status);
+        return;
+    }
+
+    let path = tmp_path("store_grow_fail.map");
+    let mut store = ProfileStore::open(&path).unwrap();
+    for i in 0..INITIAL_CAPACITY as u64 {
+        store.put(&key(i + 1, b"cc1"), &profile(i)).unwrap();
+    }
+    // THE FILE MAY NOT GROW: set_len FAILS WITH EFBIG INSTEAD OF SIGXFSZ
+    let file_len = std::fs::metadata(&path).unwrap().len();
+    unsafe {
+        libc::signal(libc::SIGXFSZ, libc::SIG_IGN);
+        let lim = libc::rlimit {
+            rlim_cur: file_len,
+            rlim_max: libc::RLIM_INFINITY,
+        };
+        assert_eq!(libc::setrlimit(libc::RLIMIT_FSIZE, &lim), 0);
+    }
+    assert!(store.put(&key(0, b"ld"), &profile(1)).is_err());
+
+    // THE OLD MAPPING IS STILL LIVE: READS, OVERWRITES, SYNC AND DROP
+    assert_eq!(store.capacity(), INITIAL_CAPACITY);
+    assert_eq!(store.len(), INITIAL_CAPACITY);
+    store.put(&key(1, b"cc1"), &profile(77)).unwrap();
+    assert_eq!(store.profiles().len(), INITIAL_CAPACITY);
+    store.sync(true).unwrap();
+    drop(store);
+
+    let store = ProfileStore::open(&path).unwrap();
+    assert_eq!(store.len(), INITIAL_CAPACITY);
+    assert_eq!(store.dropped(), 0);
+    let got = store.profiles();
+    assert!(got.iter().any(|(k, p)| *k == key(1, b"cc1") && p.avg_runtime_ns == 77));
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn db_persists_incrementally_through_store() {
+    let path = tmp_path("store_db.map");
+    {
+        let mut db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+        for _ in 0..MIN_OBSERVATIONS {
+            db.record(key(7, b"rustc"), &observation(0, 5_000_000));
+        }
+        db.persist();
+        // EXACT PROFILE + comm-ONLY FALLBACK
+        assert_eq!(db.stored(), 2);
+        // NO save(), NO sync(): DROPPING THE DB MUST NOT LOSE THEM
+    }
+    let db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+    assert_eq!(db.profiles.len(), 2);
+    let p = db.profiles.get(&key(7, b"rustc")).unwrap();
+    assert_eq!(p.observations, MIN_OBSERVATIONS);
+    assert_eq!(p.dominant_tier(), 0);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn db_eviction_removes_from_store() {
+    let path = tmp_path("store_evict.map");
+    let mut db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+    db.record(key(7, b"make"), &observation(1, 1_000));
+    db.persist();
+    assert_eq!(db.stored(), 2);
+    // SEEN THIS RUN: AGES BY TICKS EVEN THOUGH updated IS FRESH
+    assert!(db.profiles.values().all(|p| p.seen && p.updated > 0));
+    for _ in 0..=pandemonium::procdb::STALE_TICKS {
+        db.tick();
+    }
+    assert!(db.profiles.is_empty());
+    db.persist();
+    assert_eq!(db.stored(), 0);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn db_restored_profiles_survive_a_new_run() {
+    let path = tmp_path("store_restart.map");
+    {
+        let mut db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+        for _ in 0..MIN_OBSERVATIONS {
+            db.record(key(7, b"rustc"), &observation(0, 5_000_000));
+        }
+        db.persist();
+    }
+    // RESTART: NOTHING RUNS rustc FOR LONGER THAN STALE_TICKS
+    let mut db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+    assert!(db.profiles.values().all(|p| p.updated > 0));
+    for _ in 0..=pandemonium::procdb::STALE_TICKS {
+        db.tick();
+    }
+    db.persist();
+    assert_eq!(db.profiles.len(), 2);
+    assert_eq!(db.stored(), 2);
+    drop(db);
+    let db = ProcessDb::detached(Some(ProfileStore::open(&path).unwrap()));
+    assert_eq!(db.profiles[&key(7, b"rustc")].observations, MIN_OBSERVATIONS);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn flush_batch_only_carries_changes() {
+    let mut db = ProcessDb::detached(None);
+    let gcc = key(1, b"gcc");
+    let ld = key(2, b"ld");
+    for _ in 0..MIN_OBSERVATIONS {
+        db.record(gcc, &observation(0, 5_000_000));
+        db.record(ld, &observation(0, 5_000_000));
+    }
+    let first = db.take_flush_batch();
+    // BOTH EXACT PROFILES AND THEIR FALLBACKS BECAME CONFIDENT
+    assert_eq!(first.len(), 4);
+    assert!(first.iter().all(|(_, e)| e.is_some()));
+
+    // NOTHING CHANGED: NOTHING TO PUSH
+    assert!(db.take_flush_batch().is_empty());
+
+    // ONE OBSERVATION: ONLY THAT PROFILE AND ITS FALLBACK
+    db.record(gcc, &observation(0, 5_000_000));
+    let second = db.take_flush_batch();
+    let keys: Vec<ProfileKey> = second.iter().map(|(k, _)| *k).collect();
+    assert_eq!(keys, vec![gcc.fallback(), gcc]);
+}
+
+#[test]
+fn flush_batch_withdraws_lost_confidence() {
+    let mut db = ProcessDb::detached(None);
+    let k = ProfileKey::comm_only(key(0, b"sh").comm);
+    for _ in 0..MIN_OBSERVATIONS {
+        db.record(k, &observation(0, 5_000_000));
+    }
+    assert_eq!(db.take_flush_batch().len(), 1);
+
+    // VOTES SPLIT ACROSS TIERS: NO LONGER CONFIDENT, SO WITHDRAW IT
+    for _ in 0..3 {
+        db.record(k, &observation(1, 5_000_000));
+        db.record(k, &observation(2, 5_000_000));
+    }
+    let batch = db.take_flush_batch();
+    assert_eq!(batch.len(), 1);
+    assert_eq!(batch[0].0, k);
+    assert!(batch[0].1.is_none());
+
+    // AN UNPUBLISHED, UNCONFIDENT PROFILE NEVER GENERATES A DELETE
+    db.record(k, &observation(0, 5_000_000));
+    assert!(db.take_flush_batch().is_empty());
+}
+
+#[test]
+fn store_is_single_writer() {
+    let path = tmp_path("store_lock.map");
+    let mut store = ProfileStore::open(&path).unwrap();
+    store.put(&key(1, b"nginx"), &profile(10)).unwrap();
+    assert!(ProfileStore::open(&path).is_err());
+
+    // EXPORT READS THE LIVE FILE WITHOUT THE LOCK
+    let records = ProfileStore::read_records(&path).unwrap();
+    assert_eq!(records.len(), 1);
+    assert_eq!(records[0].0, key(1, b"nginx"));
+
+    drop(store);
+    assert!(ProfileStore::open(&path).is_ok());
+    let _ = std::fs::remove_file(&path);
+}
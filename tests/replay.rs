@@ -0,0 +1,177 @@
+// PANDEMONIUM CONTROLLER REPLAY TESTS
+// RECORD A SYNTHETIC RUN THE WAY THE ADAPTIVE LOOP DOES, THEN REPLAY IT:
+// DEFAULT PARAMETERS REPRODUCE IT, CANDIDATES DIVERGE WHERE EXPECTED.
+
+use pandemonium::controller::{
+    ControlParams, Controller, TickInput, DECISION_FAST_PROMOTE, DECISION_SCALE_PRESSURE,
+    DECISION_TIGHTEN,
+};
+use pandemonium::event::Snapshot;
+use pandemonium::flight::{read_flight_set, FlightRecorder};
+use pandemonium::replay::{replay, trace_cpus, trace_period_ns};
+use pandemonium::tuning::TuningKnobs;
+
+const SEC: u64 = 1_000_000_000;
+
+fn knob_array(k: &TuningKnobs) -> [u64; 11] {
+    [
+        k.slice_ns,
+        k.preempt_thresh_ns,
+        k.lag_scale,
+        k.batch_slice_ns,
+        k.cpu_bound_thresh_ns,
+        k.lat_cri_thresh_high,
+        k.lat_cri_thresh_low,
+        k.affinity_mode,
+        k.sojourn_thresh_ns,
+        k.burst_slice_ns,
+        k.smt_mode,
+    ]
+}
+
+fn window(idle_pct: u64, p99_us: u64) -> TickInput {
+    TickInput {
+        elapsed_ns: SEC,
+        dispatches: 20_000,
+        idle_hits: 200 * idle_pct,
+        p99_ns: p99_us * 1000,
+        samples: 500,
+        p99_i_ns: p99_us * 1000 / 2,
+        samples_i: 300,
+        io_pct: 40,
+        ..Default::default()
+    }
+}
+
+// QUIET, A HELD P99 SPIKE, RECOVERY, IDLE INTO LIGHT, A BURST, ANOTHER SPIKE
+fn workload() -> Vec<(TickInput, bool)> {
+    let mut w = Vec::new();
+    w.extend((0..5).map(|_| (window(30, 1000), false)));
+    w.extend((0..4).map(|_| (window(30, 9000), false)));
+    w.extend((0..6).map(|_| (window(30, 1000), false)));
+    w.extend((0..3).map(|_| (window(80, 500), false)));
+    w.push((window(30, 1000), true));
+    w.extend((0..3).map(|_| (window(30, 9000), false)));
+    w
+}
+
+// WHAT monitor_loop RECORDS PER TICK
+fn record(work: &[(TickInput, bool)], cpus: u64) -> Vec<Snapshot> {
+    let mut ctl = Controller::new(ControlParams::new(SEC), cpus);
+    let mut trace = Vec::new();
+    for (i, (input, burst)) in work.iter().enumerate() {
+        if *burst {
+            ctl.contention();
+        }
+        let decisions = ctl.tick(input);
+        let mut s = Snapshot {
+            ts_ns: (i as u64 + 1) * SEC,
+            elapsed_ns: input.elapsed_ns,
+            tick: i as u64 + 1,
+            knobs: knob_array(ctl.knobs()),
+            p99_ns: input.p99_ns,
+            tier_p99_ns: [0, input.p99_i_ns, 0],
+            tier_samples: [input.samples - input.samples_i, input.samples_i, 0],
+            decisions,
+            io_pct: input.io_pct as u32,
+            regime: ctl.regime() as u8,
+            pending_regime: ctl.pending_regime() as u8,
+            scale_cpus: cpus as u32,
+            // RESCUES HERE ARE ALL EVT_STARVATION EVENTS, NOT THE COUNTER
+            starvations: input.rescues as u32,
+            ..Default::default()
+        };
+        s.stats[0] = input.dispatches;
+        s.stats[1] = input.idle_hits;
+        trace.push(s);
+    }
+    trace
+}
+
+#[test]
+fn default_params_reproduce_recording() {
+    let work = workload();
+    let trace = record(&work, 8);
+    assert_eq!(trace[0].tick_input(), work[0].0);
+    assert!(trace[18].contended());
+    assert_eq!(trace_period_ns(&trace), SEC);
+    assert_eq!(trace_cpus(&trace), Some(8));
+
+    let run = replay(&trace, ControlParams::new(SEC), 8);
+    assert_eq!(run.ticks.len(), trace.len());
+    assert!(run.first_divergence().is_none(), "{:?}", run.first_divergence());
+    let (rec, pred) = run.count(DECISION_TIGHTEN);
+    assert_eq!(rec, 2);
+    assert_eq!(pred, rec);
+    assert_eq!(run.count(DECISION_FAST_PROMOTE), (1, 1));
+    assert_eq!(run.restarts, 0);
+}
+
+#[test]
+fn candidate_params_predict_other_decisions() {
+    let trace = record(&workload(), 8);
+
+    // A 10S HOLD NEVER TIGHTENS ON THESE 3-4S SPIKES
+    let mut params = ControlParams::new(SEC);
+    params.tighten_hold_ns = 10 * SEC;
+    let run = replay(&trace, params, 8);
+    assert_eq!(run.count(DECISION_TIGHTEN), (2, 0));
+    let first = run.first_divergence().unwrap();
+    assert_eq!(first.tick, 7); // THE RECORDED TIGHTEN
+    let (rec_min, pred_min) = run.min_slice_ns();
+    assert!(rec_min < pred_min);
+
+    // A DEEPER CUT REACHES A LOWER SLICE ON THE SAME TICKS
+    let mut params = ControlParams::new(SEC);
+    params.tighten_pct = 60;
+    let run = replay(&trace, params, 8);
+    assert_eq!(run.count(DECISION_TIGHTEN), (2, 2));
+    assert_eq!(run.min_slice_ns().1, 600_000);
+}
+
+#[test]
+fn starvation_rescues_replay_to_recorded_pressure() {
+    // 1000 RESCUES/S ON 8 CPUs IS PAST THE 50/CPU-SECOND PRESSURE LINE
+    let starving = TickInput {
+        rescues: 1000,
+        ..window(30, 1000)
+    };
+    let mut work: Vec<(TickInput, bool)> = (0..3).map(|_| (window(30, 1000), false)).collect();
+    work.extend((0..8).map(|_| (starving, false)));
+    work.extend((0..12).map(|_| (window(30, 1000), false)));
+    let trace = record(&work, 8);
+    assert_eq!(trace[3].tick_input(), starving);
+
+    let run = replay(&trace, ControlParams::new(SEC), 8);
+    assert!(run.first_divergence().is_none(), "{:?}", run.first_divergence());
+    let (rec, pred) = run.count(DECISION_SCALE_PRESSURE);
+    assert!(rec > 0);
+    assert_eq!(pred, rec);
+}
+
+#[test]
+fn replays_flight_files_across_restarts() {
+    let dir = std::env::temp_dir().join("pandemonium-test");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = dir.join("replay_restart.bin");
+    let _ = std::fs::remove_file(&path);
+
+    // TWO SCHEDULER RUNS IN ONE FILE: THE SECOND RESTARTS AT TICK 1
+    let work = workload();
+    let mut trace = record(&work, 8);
+    trace.extend(record(&work[..10], 8));
+    {
+        let mut rec = FlightRecorder::open(&path, 64).unwrap();
+        for s in &trace {
+            rec.append(s).unwrap();
+        }
+    }
+    let read = read_flight_set(&path).unwrap();
+    assert_eq!(read, trace);
+
+    let run = replay(&read, ControlParams::new(SEC), 8);
+    assert_eq!(run.restarts, 1);
+    assert!(run.first_divergence().is_none());
+    assert_eq!(run.count(DECISION_TIGHTEN), (3, 3));
+    assert_eq!(run.regime_ns.iter().sum::<u64>(), read.len() as u64 * SEC);
+}
@@ -0,0 +1,121 @@
+// PANDEMONIUM SCHEDULING TRACE TESTS
+// RECORD DECODING, TRACE FILE ROUND TRIP AND APPEND, FILTER RESOLUTION
+
+mod common;
+
+use common::tmp_path;
+use pandemonium::trace::{
+    read_trace_file, TraceOptions, TracePath, TraceRecord, TraceWriter, TRACE_HEADER_SIZE,
+    TRACE_RECORD_SIZE,
+};
+
+fn rec(ts_ns: u64, path: u8) -> TraceRecord {
+    TraceRecord {
+        ts_ns,
+        lat_ns: ts_ns / 10,
+        dsq: 12,
+        pid: 4242,
+        cpu: 3,
+        path,
+        tier: 1,
+        wake_path: 0,
+        _pad: [0; 5],
+    }
+}
+
+fn opts(path: &std::path::Path) -> TraceOptions {
+    TraceOptions {
+        path: path.to_path_buf(),
+        sample: 0,
+        pid: None,
+        comm: None,
+        cgroup: None,
+    }
+}
+
+#[test]
+fn record_decode_and_paths() {
+    let r = rec(1_000, 5);
+    let bytes = unsafe {
+        std::slice::from_raw_parts(&r as *const TraceRecord as *const u8, TRACE_RECORD_SIZE)
+    };
+    assert_eq!(TraceRecord::parse(bytes), Some(r));
+    assert!(TraceRecord::parse(&bytes[..TRACE_RECORD_SIZE - 1]).is_none());
+    assert_eq!(r.path(), Some(TracePath::Running));
+    assert_eq!(TracePath::from_raw(3).unwrap().label(), "enq tier2");
+    assert!(TracePath::from_raw(0).is_none());
+}
+
+#[test]
+fn file_round_trip_and_append() {
+    let path = tmp_path("trace_round_trip.bin");
+    {
+        let mut w = TraceWriter::open(&path).unwrap();
+        w.push(&rec(1, 1)).unwrap();
+        w.push(&rec(2, 4)).unwrap();
+        w.flush().unwrap();
+        assert_eq!(w.written(), 2);
+    }
+    // A RESTARTED SCHEDULER APPENDS
+    {
+        let mut w = TraceWriter::open(&path).unwrap();
+        w.push(&rec(3, 5)).unwrap();
+        w.flush().unwrap();
+        assert_eq!(w.written(), 1);
+    }
+    let got = read_trace_file(&path).unwrap();
+    assert_eq!(got, vec![rec(1, 1), rec(2, 4), rec(3, 5)]);
+    let len = std::fs::metadata(&path).unwrap().len() as usize;
+    assert_eq!(len, TRACE_HEADER_SIZE + 3 * TRACE_RECORD_SIZE);
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn torn_tail_and_foreign_file() {
+    let path = tmp_path("trace_torn.bin");
+    {
+        let mut w = TraceWriter::open(&path).unwrap();
+        w.push(&rec(1, 2)).unwrap();
+        w.flush().unwrap();
+    }
+    // HALF A RECORD FROM A CRASHED RUN: READERS SKIP IT, WRITERS CUT IT
+    let mut data = std::fs::read(&path).unwrap();
+    data.extend_from_slice(&[0xab; TRACE_RECORD_SIZE / 2]);
+    std::fs::write(&path, &data).unwrap();
+    assert_eq!(read_trace_file(&path).unwrap().len(), 1);
+    {
+        let mut w = TraceWriter::open(&path).unwrap();
+        w.push(&rec(2, 3)).unwrap();
+        w.flush().unwrap();
+    }
+    assert_eq!(read_trace_file(&path).unwrap(), vec![rec(1, 2), rec(2, 3)]);
+
+    // NOT A TRACE FILE: REJECTED ON READ, REPLACED ON OPEN
+    std::fs::write(&path, b"PAND: select_cpu pid=1 cpu=0\n").unwrap();
+    assert!(read_trace_file(&path).is_err());
+    drop(TraceWriter::open(&path).unwrap());
+    assert!(read_trace_file(&path).unwrap().is_empty());
+    let _ = std::fs::remove_file(&path);
+}
+
+#[test]
+fn ctl_resolves_filters() {
+    let path = tmp_path("trace_ctl.bin");
+    let mut o = opts(&path);
+    o.pid = Some(77);
+    o.comm = Some("a-very-long-process-name".to_string());
+    let ctl = o.ctl().unwrap();
+    assert_eq!(ctl.sample, 1); // 0 WOULD LEAVE TRACING OFF
+    assert_eq!(ctl.pid, 77);
+    assert_eq!(&ctl.comm[..15], b"a-very-long-pro");
+    assert_eq!(ctl.comm[15], 0);
+    assert_eq!(ctl.cgid, 0);
+
+    // A CGROUP IS ITS DIRECTORY'S INODE; A MISSING ONE IS AN ERROR
+    let dir = std::env::temp_dir().join("pandemonium-test");
+    o.cgroup = Some(dir.clone());
+    use std::os::unix::fs::MetadataExt;
+    assert_eq!(o.ctl().unwrap().cgid, std::fs::metadata(&dir).unwrap().ino());
+    o.cgroup = Some(dir.join("no-such-cgroup"));
+    assert!(o.ctl().is_err());
+}